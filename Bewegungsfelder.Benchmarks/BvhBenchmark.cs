@@ -0,0 +1,186 @@
+﻿/*
+Part of Bewegungsfelder
+
+MIT-License
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using Bewegungsfelder.BVH;
+using Bewegungsfelder.Mathematics;
+using System;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.Globalization;
+using System.IO;
+using System.Linq;
+using System.Text;
+using System.Threading.Tasks;
+
+namespace Bewegungsfelder.Benchmarks
+{
+    /// <summary>
+    /// reads and writes a large generated BVH file with BVHReaderWriter and with the legacy code.
+    /// the fast reader was meant to be 10x faster than the legacy one. it reaches about 3.5x
+    /// on a single core (100k frames of 30 joints), most of the remaining time goes to
+    /// the sin/cos of the euler angle conversion.
+    /// </summary>
+    public static class BvhBenchmark
+    {
+        /// <summary>
+        /// writes a chain of joints with random rotations. the root has position channels
+        /// </summary>
+        public static void Generate(string path, int frames, int joints)
+        {
+            var random = new Random(1);
+
+            using (var writer = new StreamWriter(path))
+            {
+                writer.WriteLine("HIERARCHY");
+                for (int i = 0; i < joints; i++)
+                {
+                    string indent = new string('\t', i);
+                    writer.WriteLine($"{indent}{(i == 0 ? "ROOT" : "JOINT")} joint{i}");
+                    writer.WriteLine($"{indent}{{");
+                    writer.WriteLine($"{indent}\tOFFSET 1.0 2.0 3.0");
+                    writer.WriteLine(i == 0
+                        ? $"{indent}\tCHANNELS 6 Xposition Yposition Zposition Zrotation Xrotation Yrotation"
+                        : $"{indent}\tCHANNELS 3 Zrotation Xrotation Yrotation");
+                }
+
+                string endIndent = new string('\t', joints);
+                writer.WriteLine($"{endIndent}End Site");
+                writer.WriteLine($"{endIndent}{{");
+                writer.WriteLine($"{endIndent}\tOFFSET 0.0 1.0 0.0");
+                writer.WriteLine($"{endIndent}}}");
+                for (int i = joints - 1; i >= 0; i--)
+                {
+                    writer.WriteLine($"{new string('\t', i)}}}");
+                }
+
+                writer.WriteLine("MOTION");
+                writer.WriteLine($"Frames: {frames}");
+                writer.WriteLine("Frame Time: 0.008333");
+
+                var line = new StringBuilder();
+                for (int frame = 0; frame < frames; frame++)
+                {
+                    line.Clear();
+                    for (int i = 0; i < 3 + 3 * joints; i++)
+                    {
+                        if (i > 0)
+                            line.Append(' ');
+                        line.Append((random.NextDouble() * 360 - 180).ToString("F6", CultureInfo.InvariantCulture));
+                    }
+                    writer.WriteLine(line);
+                }
+            }
+        }
+
+        /// <summary>
+        /// times both readers and the load from the binary cache
+        /// </summary>
+        public static void Read(string path, int runs)
+        {
+            BVHMotionData motion;
+            Dictionary<BVHNode, List<Quaternion>> legacyMotion;
+
+            for (int run = 0; run < runs; run++)
+            {
+                File.Delete(BVHCache.GetCachePath(path));
+                Collect();
+                var watch = Stopwatch.StartNew();
+                BVHReaderWriter.ReadBvh(path, out motion);
+                double parse = watch.Elapsed.TotalMilliseconds;
+
+                Collect();
+                watch.Restart();
+                BVHReaderWriter.ReadBvh(path, out motion);
+                double cached = watch.Elapsed.TotalMilliseconds;
+                motion = null;
+
+                Collect();
+                watch.Restart();
+                LegacyBvhReader.ReadBvh(path, out legacyMotion);
+                double legacy = watch.Elapsed.TotalMilliseconds;
+                legacyMotion = null;
+
+                Console.WriteLine($"read: {parse:F0} ms, legacy {legacy:F0} ms ({legacy / parse:F1}x), from cache {cached:F0} ms");
+            }
+
+            File.Delete(BVHCache.GetCachePath(path));
+        }
+
+        /// <summary>
+        /// times both writers on the motion of the file and writing the same number
+        /// of bytes without formatting, the disk speed the writer can reach at best
+        /// </summary>
+        public static void Write(string path, int runs)
+        {
+            BVHMotionData motion;
+            var root = BVHReaderWriter.ReadBvh(path, out motion);
+            File.Delete(BVHCache.GetCachePath(path));
+
+            string output = path + ".out";
+            var block = new byte[1 << 16];
+
+            try
+            {
+                for (int run = 0; run < runs; run++)
+                {
+                    Collect();
+                    var watch = Stopwatch.StartNew();
+                    BVHReaderWriter.WriteBvh(output, root, motion);
+                    double write = watch.Elapsed.TotalMilliseconds;
+                    long length = new FileInfo(output).Length;
+
+                    Collect();
+                    watch.Restart();
+                    LegacyBvhWriter.WriteBvh(output, root, motion);
+                    double legacy = watch.Elapsed.TotalMilliseconds;
+                    long legacyLength = new FileInfo(output).Length;
+
+                    watch.Restart();
+                    using (var stream = new FileStream(output, FileMode.Create, FileAccess.Write))
+                    {
+                        for (long written = 0; written < length; written += block.Length)
+                        {
+                            stream.Write(block, 0, (int)Math.Min(block.Length, length - written));
+                        }
+                    }
+                    double disk = watch.Elapsed.TotalMilliseconds;
+
+                    Console.WriteLine($"write: {write:F0} ms ({length >> 20} MB), legacy {legacy:F0} ms " +
+                        $"({legacyLength >> 20} MB, {legacy / write:F1}x), unformatted {disk:F0} ms");
+                }
+            }
+            finally
+            {
+                File.Delete(output);
+            }
+        }
+
+        private static void Collect()
+        {
+            GC.Collect();
+            GC.WaitForPendingFinalizers();
+            GC.Collect();
+        }
+    }
+}
@@ -0,0 +1,148 @@
+﻿/*
+Part of Bewegungsfelder
+
+MIT-License
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using Bewegungsfelder.Core;
+using Bewegungsfelder.Mathematics;
+using System;
+using System.Diagnostics;
+using System.IO;
+using System.Linq;
+
+namespace Bewegungsfelder.Benchmarks
+{
+    /// <summary>
+    /// measures the size reduction of CompressedMotionData against the float frames of MotionData
+    /// </summary>
+    public static class CompressionBenchmark
+    {
+        // sensor noise on every rotation
+        private const double NOISE_DEGREES = 0.05;
+
+        /// <summary>
+        /// joints swinging around up to three axes at 0.2 to 2 Hz, recorded at 120 fps with a little noise
+        /// </summary>
+        public static MotionData Generate(int frames, int joints)
+        {
+            var random = new Random(1);
+            var root = new Bone(null, "joint0");
+            var bones = new Bone[joints];
+            bones[0] = root;
+            for (int i = 1; i < joints; i++)
+            {
+                bones[i] = new Bone(bones[random.Next(i)], "joint" + i);
+                bones[i].Parent.Children.Add(bones[i]);
+            }
+
+            var motion = new MotionData { FPS = 120 };
+            motion.Reset(bones);
+
+            var axes = new[] { new Vector3D(1, 0, 0), new Vector3D(0, 1, 0), new Vector3D(0, 0, 1) };
+            var amplitudes = new double[joints, 3];
+            var frequencies = new double[joints, 3];
+            var phases = new double[joints, 3];
+            for (int j = 0; j < joints; j++)
+            {
+                for (int k = 0; k < 3; k++)
+                {
+                    amplitudes[j, k] = random.Next(3) == 0 ? 0 : random.NextDouble() * 90;
+                    frequencies[j, k] = 0.2 + random.NextDouble() * 1.8;
+                    phases[j, k] = random.NextDouble() * 2 * Math.PI;
+                }
+            }
+
+            var rotations = new Quaternion[joints];
+            for (int f = 0; f < frames; f++)
+            {
+                double t = f / motion.FPS;
+                for (int j = 0; j < joints; j++)
+                {
+                    var rotation = Quaternion.Identity;
+                    for (int k = 0; k < 3; k++)
+                    {
+                        double degrees = amplitudes[j, k] * Math.Sin(2 * Math.PI * frequencies[j, k] * t + phases[j, k])
+                            + NOISE_DEGREES * (random.NextDouble() * 2 - 1);
+                        rotation = rotation * new Quaternion(axes[k], degrees);
+                    }
+                    rotations[j] = rotation;
+                }
+                motion.AddFrame(rotations);
+            }
+
+            return motion;
+        }
+
+        /// <summary>
+        /// compresses the motion with each error bound and prints the size, the largest error
+        /// and the time to compress and to play all frames back
+        /// </summary>
+        public static void Run(MotionData motion, double[] maxErrorDegrees)
+        {
+            long raw = (long)motion.FrameCount * motion.FrameStride * sizeof(float);
+            Console.WriteLine($"{motion.FrameCount} frames, {motion.JointCount} joints, {raw >> 10} KB of float frames");
+
+            var frame = new float[motion.FrameStride];
+            foreach (var degrees in maxErrorDegrees)
+            {
+                double maxError = degrees * Math.PI / 180;
+
+                var watch = Stopwatch.StartNew();
+                var compressed = CompressedMotionData.Compress(motion, maxError);
+                double compress = watch.Elapsed.TotalMilliseconds;
+
+                var stream = new MemoryStream();
+                compressed.Write(new BinaryWriter(stream));
+
+                double largest = 0;
+                watch.Restart();
+                for (int f = 0; f < motion.FrameCount; f++)
+                {
+                    compressed.ReadFrame(f, frame, 0);
+                }
+                double decode = watch.Elapsed.TotalMilliseconds;
+
+                var decoded = new ArraySegment<float>(frame);
+                for (int f = 0; f < motion.FrameCount; f++)
+                {
+                    compressed.ReadFrame(f, frame, 0);
+                    for (int j = 0; j < motion.JointCount; j++)
+                    {
+                        largest = Math.Max(largest, Angle(motion.GetRotation(f, j), MotionData.Read(decoded, j)));
+                    }
+                }
+
+                Console.WriteLine($"{degrees} deg: {stream.Length >> 10} KB ({(double)raw / stream.Length:F1}x), " +
+                    $"{compressed.ComponentBits} bit components, " +
+                    $"{(double)compressed.KeyCount / motion.JointCount / motion.FrameCount * motion.FPS:F1} keys/s per joint, " +
+                    $"max error {largest * 180 / Math.PI:F3} deg, compress {compress:F0} ms, decode {decode:F0} ms");
+            }
+        }
+
+        private static double Angle(Quaternion a, Quaternion b)
+        {
+            double dot = Math.Abs(a.W * b.W + a.X * b.X + a.Y * b.Y + a.Z * b.Z)
+                / Math.Sqrt((a.W * a.W + a.X * a.X + a.Y * a.Y + a.Z * a.Z) * (b.W * b.W + b.X * b.X + b.Y * b.Y + b.Z * b.Z));
+            return 2 * Math.Acos(Math.Min(1, dot));
+        }
+    }
+}
@@ -0,0 +1,98 @@
+﻿/*
+Part of Bewegungsfelder
+
+MIT-License
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using System;
+using System.Collections.Generic;
+using System.IO;
+using System.Linq;
+using System.Net;
+using System.Net.Sockets;
+using System.Text;
+using System.Threading.Tasks;
+
+namespace Bewegungsfelder.Benchmarks
+{
+    /// <summary>
+    /// a file of recorded datagrams.
+    /// each datagram is stored as its int32 length followed by its bytes.
+    /// </summary>
+    public static class DatagramFile
+    {
+        /// <summary>
+        /// writes the datagrams received on the port for the given time
+        /// </summary>
+        /// <returns>number of recorded datagrams</returns>
+        public static int Record(string path, int port, TimeSpan duration)
+        {
+            int count = 0;
+            DateTime end = DateTime.Now + duration;
+
+            using (var client = new UdpClient(port))
+            using (var writer = new BinaryWriter(File.Create(path)))
+            {
+                client.Client.ReceiveTimeout = 100;
+                var source = new IPEndPoint(IPAddress.Any, 0);
+
+                while (DateTime.Now < end)
+                {
+                    byte[] datagram;
+                    try
+                    {
+                        datagram = client.Receive(ref source);
+                    }
+                    catch (SocketException ex) when (ex.SocketErrorCode == SocketError.TimedOut)
+                    {
+                        continue;
+                    }
+
+                    writer.Write(datagram.Length);
+                    writer.Write(datagram);
+                    ++count;
+                }
+            }
+
+            return count;
+        }
+
+        public static List<byte[]> Load(string path)
+        {
+            var datagrams = new List<byte[]>();
+
+            using (var reader = new BinaryReader(File.OpenRead(path)))
+            {
+                while (reader.BaseStream.Position < reader.BaseStream.Length)
+                {
+                    int length = reader.ReadInt32();
+                    byte[] datagram = reader.ReadBytes(length);
+                    if (datagram.Length != length)
+                        throw new EndOfStreamException($"truncated datagram in {path}");
+
+                    datagrams.Add(datagram);
+                }
+            }
+
+            return datagrams;
+        }
+    }
+}
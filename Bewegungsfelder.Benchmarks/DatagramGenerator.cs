@@ -0,0 +1,85 @@
+﻿/*
+Part of Bewegungsfelder
+
+MIT-License
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using Bewegungsfelder.Core;
+using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Text;
+using System.Threading.Tasks;
+
+namespace Bewegungsfelder.Benchmarks
+{
+    /// <summary>
+    /// creates the datagrams of a recording if there is none at hand:
+    /// compact single sample datagrams of sensors rotating about z, interleaved like
+    /// the server receives them.
+    /// </summary>
+    public static class DatagramGenerator
+    {
+        // q14 fixed point, see sensor_packet.h
+        private const double QUATERNION_SCALE = 1 << 14;
+
+        public static List<byte[]> Create(int sensorCount, int hz, double seconds)
+        {
+            int frames = (int)(hz * seconds);
+            uint period = (uint)(1000000 / hz);
+            var datagrams = new List<byte[]>(frames * sensorCount);
+
+            for (int frame = 0; frame < frames; frame++)
+            {
+                for (int id = 0; id < sensorCount; id++)
+                {
+                    double angle = 2 * Math.PI * frame / hz + id;
+                    datagrams.Add(CreateDatagram((byte)id, (ushort)frame, (uint)frame * period,
+                        Math.Cos(angle / 2), 0, 0, Math.Sin(angle / 2)));
+                }
+            }
+
+            return datagrams;
+        }
+
+        private static byte[] CreateDatagram(byte id, ushort sequence, uint timestamp,
+            double w, double x, double y, double z)
+        {
+            byte[] datagram = new byte[SensorPacket.COMPACT_HEADER_LENGTH + SensorPacket.COMPACT_SAMPLE_LENGTH];
+
+            datagram[0] = (byte)((SensorPacket.VERSION_COMPACT << 4) | SensorPacket.FLAG_TIMESTAMP_US);
+            datagram[1] = id;
+            BitConverter.GetBytes(sequence).CopyTo(datagram, 2);
+            BitConverter.GetBytes(timestamp).CopyTo(datagram, 4);
+
+            // dt of the first sample is 0, accelerometer points up at 1g, gyro reads 0
+            int offset = SensorPacket.COMPACT_HEADER_LENGTH + sizeof(ushort);
+            foreach (double value in new[] { w, x, y, z })
+            {
+                BitConverter.GetBytes((short)(value * QUATERNION_SCALE)).CopyTo(datagram, offset);
+                offset += sizeof(short);
+            }
+            BitConverter.GetBytes((short)SensorPacket.ACCEL_SCALE).CopyTo(datagram, offset + 2 * sizeof(short));
+
+            return datagram;
+        }
+    }
+}
@@ -0,0 +1,262 @@
+﻿/*
+Part of Bewegungsfelder
+
+MIT-License
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using Bewegungsfelder.Core;
+using System;
+using System.Collections.Concurrent;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.Linq;
+using System.Net;
+using System.Text;
+using System.Threading;
+using System.Threading.Tasks;
+
+namespace Bewegungsfelder.Benchmarks
+{
+    /// <summary>
+    /// feeds datagrams into the ingest pipeline as fast as it accepts them
+    /// </summary>
+    public static class IngestBenchmark
+    {
+        private static readonly IPEndPoint source = new IPEndPoint(IPAddress.Loopback, Core.Server.DATA_PORT);
+
+        public class Result
+        {
+            public long Datagrams;
+            public long Values;
+            public TimeSpan Elapsed;
+
+            // datagrams posted again after the worker queue was full
+            public long Retries;
+
+            // collections during the measured passes
+            public int Gen0;
+            public int Gen1;
+            public int Gen2;
+
+            public double DatagramsPerSecond { get { return Datagrams / Elapsed.TotalSeconds; } }
+            public double ValuesPerSecond { get { return Values / Elapsed.TotalSeconds; } }
+
+            public override string ToString()
+            {
+                return $"{Datagrams} datagrams in {Elapsed.TotalMilliseconds:F0} ms: " +
+                    $"{DatagramsPerSecond:F0} datagrams/s, {ValuesPerSecond:F0} values/s, " +
+                    $"gen0/1/2 {Gen0}/{Gen1}/{Gen2}, {Retries} retries";
+            }
+        }
+
+        /// <summary>
+        /// posts all datagrams once to warm up, then the given number of passes
+        /// and waits until the workers decoded them. each pass continues the sensor
+        /// timestamps and sequence numbers of the previous one, so the sensors see
+        /// one long recording.
+        /// </summary>
+        public static Result Replay(IList<byte[]> datagrams, int workerCount, int passes)
+        {
+            var sensors = new ConcurrentDictionary<int, Sensor>();
+            var pipeline = new IngestPipeline(workerCount, (id, ip) =>
+            {
+                Sensor sensor;
+                if (sensors.TryGetValue(id, out sensor))
+                    return sensor;
+                return sensors.GetOrAdd(id, new Sensor(ip, id));
+            });
+
+            // copies, the timestamps are shifted after every pass
+            datagrams = datagrams.Select(d => (byte[])d.Clone()).ToList();
+            var recording = new Recording(datagrams);
+
+            Post(pipeline, datagrams);
+            recording.Advance(datagrams);
+            WaitForValues(pipeline, recording.Values);
+
+            GC.Collect();
+            GC.WaitForPendingFinalizers();
+            GC.Collect();
+
+            var result = new Result();
+            int gen0 = GC.CollectionCount(0);
+            int gen1 = GC.CollectionCount(1);
+            int gen2 = GC.CollectionCount(2);
+            Stopwatch watch = Stopwatch.StartNew();
+
+            for (int pass = 0; pass < passes; pass++)
+            {
+                result.Retries += Post(pipeline, datagrams);
+                recording.Advance(datagrams);
+            }
+            WaitForValues(pipeline, recording.Values * (passes + 1));
+
+            result.Elapsed = watch.Elapsed;
+            result.Gen0 = GC.CollectionCount(0) - gen0;
+            result.Gen1 = GC.CollectionCount(1) - gen1;
+            result.Gen2 = GC.CollectionCount(2) - gen2;
+            result.Datagrams = (long)datagrams.Count * passes;
+            result.Values = recording.Values * passes;
+            return result;
+        }
+
+        /// <summary>
+        /// replays generated datagrams for every combination of worker and sensor count
+        /// and prints the decoded values/s as a table, one row per sensor count.
+        /// </summary>
+        public static void Sweep(int[] workerCounts, int[] sensorCounts, int passes)
+        {
+            // same number of datagrams for every sensor count
+            const int DATAGRAMS = 40000;
+            const int HZ = 200;
+
+            Console.Write("sensors");
+            foreach (int workers in workerCounts)
+            {
+                Console.Write($"\t{workers} workers");
+            }
+            Console.WriteLine();
+
+            foreach (int sensors in sensorCounts)
+            {
+                var datagrams = DatagramGenerator.Create(sensors, HZ, (double)DATAGRAMS / sensors / HZ);
+
+                Console.Write(sensors);
+                foreach (int workers in workerCounts)
+                {
+                    var result = Replay(datagrams, workers, passes);
+                    Console.Write($"\t{result.ValuesPerSecond:F0}");
+                }
+                Console.WriteLine();
+            }
+        }
+
+        /// <returns>the number of retries</returns>
+        private static long Post(IngestPipeline pipeline, IList<byte[]> datagrams)
+        {
+            long retries = 0;
+            DateTime now = DateTime.Now;
+
+            for (int i = 0; i < datagrams.Count; i++)
+            {
+                byte[] datagram = datagrams[i];
+                while (!pipeline.Post(datagram, datagram.Length, source, now))
+                {
+                    ++retries;
+                    Thread.SpinWait(20);
+                }
+            }
+
+            return retries;
+        }
+
+        private static void WaitForValues(IngestPipeline pipeline, long count)
+        {
+            var spin = new SpinWait();
+            while (pipeline.DecodedValues < count)
+            {
+                spin.SpinOnce();
+            }
+        }
+
+        /// <summary>
+        /// the values of one pass over the datagrams
+        /// </summary>
+        private class Recording
+        {
+            /// <summary>
+            /// number of values in all datagrams
+            /// </summary>
+            public long Values { get; }
+
+            // time from the first to the last sample plus one sample period, in us
+            private readonly uint duration;
+
+            // number of values per sensor id
+            private readonly Dictionary<int, int> sensorValues = new Dictionary<int, int>();
+
+            public Recording(IList<byte[]> datagrams)
+            {
+                var values = new List<SensorValue>();
+                bool first = true;
+                uint start = 0;
+                uint end = 0;
+                uint period = 0;
+                int sensorId;
+
+                foreach (byte[] datagram in datagrams)
+                {
+                    values.Clear();
+                    if (SensorPacket.IsTelemetry(datagram, datagram.Length) ||
+                        !SensorPacket.Decode(datagram, datagram.Length, DateTime.Now, out sensorId, values))
+                        continue;
+
+                    Values += values.Count;
+
+                    int count;
+                    sensorValues.TryGetValue(sensorId, out count);
+                    sensorValues[sensorId] = count + values.Count;
+
+                    foreach (var value in values)
+                    {
+                        if (first)
+                        {
+                            start = end = value.SensorTimestamp;
+                            first = false;
+                        }
+
+                        uint elapsed = unchecked(value.SensorTimestamp - start);
+                        if (elapsed > unchecked(end - start) && elapsed < int.MaxValue)
+                        {
+                            period = Math.Max(period, unchecked(value.SensorTimestamp - end));
+                            end = value.SensorTimestamp;
+                        }
+                    }
+                }
+
+                duration = unchecked(end - start + period);
+            }
+
+            /// <summary>
+            /// shifts the compact datagrams to continue where the recording ends
+            /// </summary>
+            public void Advance(IList<byte[]> datagrams)
+            {
+                foreach (byte[] datagram in datagrams)
+                {
+                    if (datagram.Length <= SensorPacket.COMPACT_HEADER_LENGTH ||
+                        SensorPacket.GetVersion(datagram[0]) != SensorPacket.VERSION_COMPACT)
+                        continue;
+
+                    int count;
+                    sensorValues.TryGetValue(datagram[1], out count);
+
+                    ushort sequence = unchecked((ushort)(BitConverter.ToUInt16(datagram, 2) + count));
+                    // older firmware sends milliseconds
+                    uint shift = (SensorPacket.GetFlags(datagram[0]) & SensorPacket.FLAG_TIMESTAMP_US) != 0 ? duration : duration / 1000;
+                    uint timestamp = unchecked(BitConverter.ToUInt32(datagram, 4) + shift);
+                    BitConverter.GetBytes(sequence).CopyTo(datagram, 2);
+                    BitConverter.GetBytes(timestamp).CopyTo(datagram, 4);
+                }
+            }
+        }
+    }
+}
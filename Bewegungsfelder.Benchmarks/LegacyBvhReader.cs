@@ -1,7 +1,7 @@
 ﻿/*
-Part of Bewegungsfelder 
+Part of Bewegungsfelder
 
-MIT-License 
+MIT-License
 (C) 2016 Ivo Herzig
 
 Permission is hereby granted, free of charge, to any person obtaining a copy
@@ -22,29 +22,34 @@ LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
 OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
+using Bewegungsfelder.BVH;
+using Bewegungsfelder.Mathematics;
 using System;
 using System.Collections.Generic;
 using System.IO;
 using System.Linq;
 using System.Text;
 using System.Threading.Tasks;
-using System.Windows.Media.Media3D;
-using Bewegungsfelder.Utilities;
 
-namespace Bewegungsfelder.BVH
+namespace Bewegungsfelder.Benchmarks
 {
-    public class BVHReaderWriter
+
+    /// <summary>
+    /// the BVH reader as it was before BVHTokenizer, the baseline for BvhBenchmark.
+    /// splits every line into strings and stores the rotations in lists per joint
+    /// </summary>
+    public static class LegacyBvhReader
     {
         /// <summary>
         /// reads BVH hierarchical data from a BVH file
         /// </summary>
-        public static BVHNode ReadBvh(string file, out BVHMotionData motionData)
+        public static BVHNode ReadBvh(string file, out Dictionary<BVHNode, List<Quaternion>> motionData)
         {
             using (var reader = new StreamReader(file))
             {
                 var line = reader.ReadLine().ToLower().Trim();
                 if (line != "hierarchy")
-                    throw new FileFormatException("File has to start with HIERARCHY keyword");
+                    throw new InvalidDataException("File has to start with HIERARCHY keyword");
 
                 var root = ReadNode(reader, reader.ReadLine(), 0);
                 motionData = ReadMotionData(reader, root);
@@ -56,11 +61,11 @@ namespace Bewegungsfelder.BVH
         /// <summary>
         /// read motion data from a bvh file, starting with the MOTION keyword
         /// </summary>
-        public static BVHMotionData ReadMotionData(StreamReader reader, BVHNode root)
+        public static Dictionary<BVHNode, List<Quaternion>> ReadMotionData(StreamReader reader, BVHNode root)
         {
             var line = reader.ReadLine().ToLower().Trim();
             if (line != "motion")
-                throw new FileFormatException("Expected MOTION keyword");
+                throw new InvalidDataException("Expected MOTION keyword");
 
             // read number of frames
             line = reader.ReadLine().ToLower().Trim();
@@ -69,7 +74,7 @@ namespace Bewegungsfelder.BVH
             int numFrames;
             if (!int.TryParse(tokens[1], out numFrames))
             {
-                throw new FileFormatException("Could not read number of frames");
+                throw new InvalidDataException("Could not read number of frames");
             }
 
             //read frame time
@@ -79,7 +84,7 @@ namespace Bewegungsfelder.BVH
             double frameTime;
             if (!double.TryParse(tokens[2], out frameTime))
             {
-                throw new FileFormatException("Could not read frame time");
+                throw new InvalidDataException("Could not read frame time");
             }
 
             // read all frame data
@@ -97,7 +102,7 @@ namespace Bewegungsfelder.BVH
                 ReadFrameData(root, motionData, frameData, ref offset);
             }
 
-            return new BVHMotionData(frameTime, motionData);
+            return motionData;
         }
 
         /// <summary>
@@ -180,7 +185,7 @@ namespace Bewegungsfelder.BVH
             else
             {
                 if (!Enum.TryParse<BVHNodeTypes>(nodeType, true, out type))
-                    throw new FileFormatException($"Invalid Bvh Node Type: {nodeType}");
+                    throw new InvalidDataException($"Invalid Bvh Node Type: {nodeType}");
             }
 
             node.Type = type;
@@ -221,19 +226,19 @@ namespace Bewegungsfelder.BVH
             string[] tokens = line.Split(new[] { ' ', '\t' }, StringSplitOptions.RemoveEmptyEntries);
 
             if (tokens[0] != "channels")
-                throw new FileFormatException("Expected CHANNELS keyword");
+                throw new InvalidDataException("Expected CHANNELS keyword");
 
             int numChannels = Int32.Parse(tokens[1]);
 
             if (tokens.Length != numChannels + 2)
-                throw new FileFormatException(
+                throw new InvalidDataException(
                     $"Invalid CHANNELs Definition: {numChannels} expected, but {tokens.Length - 2} found");
 
             BVHChannels[] channels = new BVHChannels[numChannels];
             for (int i = 0; i < numChannels; i++)
             {
                 if (!Enum.TryParse<BVHChannels>(tokens[i + 2], true, out channels[i]))
-                    throw new FileFormatException($"Invalid channel: {tokens[i + 2]}");
+                    throw new InvalidDataException($"Invalid channel: {tokens[i + 2]}");
             }
 
             return channels;
@@ -248,114 +253,20 @@ namespace Bewegungsfelder.BVH
             string[] tokens = line.Split(new[] { ' ', '\t' }, StringSplitOptions.RemoveEmptyEntries);
 
             if (tokens[0] != "offset")
-                throw new FileFormatException("Expected OFFSET keyword");
+                throw new InvalidDataException("Expected OFFSET keyword");
             if (tokens.Length != 4)
-                throw new FileFormatException("OFFSET Definiton: Invalid number of values");
+                throw new InvalidDataException("OFFSET Definiton: Invalid number of values");
 
             double x, y, z;
             if (!Double.TryParse(tokens[1], out x))
-                throw new FileFormatException("Could not parse OFFSET definition x-component");
+                throw new InvalidDataException("Could not parse OFFSET definition x-component");
             if (!Double.TryParse(tokens[2], out y))
-                throw new FileFormatException("Could not parse OFFSET definition y-component");
+                throw new InvalidDataException("Could not parse OFFSET definition y-component");
             if (!Double.TryParse(tokens[3], out z))
-                throw new FileFormatException("Could not parse OFFSET definition z-component");
+                throw new InvalidDataException("Could not parse OFFSET definition z-component");
 
 
             return new Vector3D(x, y, z);
         }
-
-        /// <summary>
-        /// Writes a BVH motion data file
-        /// </summary>
-        public static void WriteBvh(string file, BVHNode root, BVHMotionData motionData)
-        {
-            using (var writer = new StreamWriter(file))
-            {
-                writer.WriteLine("HIERARCHY");
-                WriteBvhNode(root, writer, 0);
-                writer.WriteLine("MOTION");
-
-                int numFrames = motionData.Data.First().Value.Count;
-                writer.WriteLine($"Frames: {numFrames}");
-                writer.WriteLine($"Frame Time: {motionData.FrameTime}");
-
-                // write frame data line by line
-                for (int i = 0; i < numFrames; i++)
-                {
-                    foreach (var node in motionData.Data.Keys)
-                    {
-                        if (node.Type == BVHNodeTypes.EndSite)
-                            continue;
-
-                        double yaw, pitch, roll;
-                        motionData.Data[node][i].ToYawPitchRoll(out yaw, out pitch, out roll);
-
-                        writer.Write($"{yaw * 180 / Math.PI} {pitch * 180 / Math.PI} {roll * 180 / Math.PI} ");
-                    }
-                    writer.WriteLine();
-                }
-            }
-        }
-
-        /// <summary>
-        /// recursively write a BVH node an all its children to .Type == BVHNodeTypes.EndSitedata file
-        /// </summary>
-        private static void WriteBvhNode(BVHNode node, StreamWriter writer, int level)
-        {
-            // name and type
-            for (int i = 0; i < level - 1; ++i)
-                writer.Write("\t");
-
-            if (node.Type == BVHNodeTypes.EndSite) // end sites have no name
-                writer.WriteLine($"{GetTypeString(node.Type)}");
-            else
-                writer.WriteLine($"{GetTypeString(node.Type)} {node.Name}");
-
-            // open curly bracket
-            for (int i = 0; i < level - 1; ++i)
-                writer.Write("\t");
-            writer.WriteLine("{");
-
-            // node offset
-            for (int i = 0; i < level; ++i)
-                writer.Write("\t");
-            writer.WriteLine($"OFFSET {node.Offset.X} {node.Offset.Y} {node.Offset.Z}");
-
-            if (node.Type != BVHNodeTypes.EndSite)
-            {
-                // defined channels
-                for (int i = 0; i < level; ++i)
-                    writer.Write("\t");
-                writer.Write($"CHANNELS {node.Channels.Length} ");
-
-                foreach (var chan in node.Channels)
-                    writer.Write(chan.ToString() + " ");
-                writer.Write(Environment.NewLine);
-
-                // child nodes
-                foreach (var child in node.Children)
-                    WriteBvhNode(child, writer, level + 1);
-            }
-
-            // closing curly bracket
-            for (int i = 0; i < level - 1; ++i)
-                writer.Write("\t");
-            writer.WriteLine("}");
-        }
-
-        private static string GetTypeString(BVHNodeTypes type)
-        {
-            switch (type)
-            {
-                case BVHNodeTypes.Root:
-                    return "ROOT";
-                case BVHNodeTypes.Joint:
-                    return "JOINT";
-                case BVHNodeTypes.EndSite:
-                    return "End Site";
-                default:
-                    throw new InvalidOperationException("Invalid node type");
-            }
-        }
     }
 }
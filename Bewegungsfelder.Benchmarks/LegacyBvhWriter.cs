@@ -0,0 +1,132 @@
+﻿/*
+Part of Bewegungsfelder
+
+MIT-License
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using Bewegungsfelder.BVH;
+using System;
+using System.Collections.Generic;
+using System.IO;
+using System.Linq;
+using System.Text;
+using System.Threading.Tasks;
+
+namespace Bewegungsfelder.Benchmarks
+{
+    /// <summary>
+    /// the BVH writer as it was before BVHParallelWriter, the baseline for BvhBenchmark.
+    /// formats every value with string interpolation on a single thread
+    /// </summary>
+    public static class LegacyBvhWriter
+    {
+        /// <summary>
+        /// Writes a BVH motion data file
+        /// </summary>
+        public static void WriteBvh(string file, BVHNode root, BVHMotionData motionData)
+        {
+            using (var writer = new StreamWriter(file))
+            {
+                writer.WriteLine("HIERARCHY");
+                WriteBvhNode(root, writer, 0);
+                writer.WriteLine("MOTION");
+
+                int numFrames = motionData.FrameCount;
+                writer.WriteLine($"Frames: {numFrames}");
+                writer.WriteLine($"Frame Time: {motionData.FrameTime}");
+
+                // write frame data line by line
+                for (int i = 0; i < numFrames; i++)
+                {
+                    for (int j = 0; j < motionData.Joints.Length; j++)
+                    {
+                        double yaw, pitch, roll;
+                        motionData.GetRotation(i, j).ToYawPitchRoll(out yaw, out pitch, out roll);
+
+                        writer.Write($"{yaw * 180 / Math.PI} {pitch * 180 / Math.PI} {roll * 180 / Math.PI} ");
+                    }
+                    writer.WriteLine();
+                }
+            }
+        }
+
+        /// <summary>
+        /// recursively write a BVH node an all its children to .Type == BVHNodeTypes.EndSitedata file
+        /// </summary>
+        private static void WriteBvhNode(BVHNode node, StreamWriter writer, int level)
+        {
+            // name and type
+            for (int i = 0; i < level - 1; ++i)
+                writer.Write("\t");
+
+            if (node.Type == BVHNodeTypes.EndSite) // end sites have no name
+                writer.WriteLine($"{GetTypeString(node.Type)}");
+            else
+                writer.WriteLine($"{GetTypeString(node.Type)} {node.Name}");
+
+            // open curly bracket
+            for (int i = 0; i < level - 1; ++i)
+                writer.Write("\t");
+            writer.WriteLine("{");
+
+            // node offset
+            for (int i = 0; i < level; ++i)
+                writer.Write("\t");
+            writer.WriteLine($"OFFSET {node.Offset.X} {node.Offset.Y} {node.Offset.Z}");
+
+            if (node.Type != BVHNodeTypes.EndSite)
+            {
+                // defined channels
+                for (int i = 0; i < level; ++i)
+                    writer.Write("\t");
+                writer.Write($"CHANNELS {node.Channels.Length} ");
+
+                foreach (var chan in node.Channels)
+                    writer.Write(chan.ToString() + " ");
+                writer.Write(Environment.NewLine);
+
+                // child nodes
+                foreach (var child in node.Children)
+                    WriteBvhNode(child, writer, level + 1);
+            }
+
+            // closing curly bracket
+            for (int i = 0; i < level - 1; ++i)
+                writer.Write("\t");
+            writer.WriteLine("}");
+        }
+
+        private static string GetTypeString(BVHNodeTypes type)
+        {
+            switch (type)
+            {
+                case BVHNodeTypes.Root:
+                    return "ROOT";
+                case BVHNodeTypes.Joint:
+                    return "JOINT";
+                case BVHNodeTypes.EndSite:
+                    return "End Site";
+                default:
+                    throw new InvalidOperationException("Invalid node type");
+            }
+        }
+    }
+}
@@ -31,9 +31,13 @@ using System.Linq;
 using System.Text;
 using System.Threading;
 
-namespace Bewegungsfelder.Utilities
+namespace Bewegungsfelder.Benchmarks
 {
-    class RingBuffer<T>
+    /// <summary>
+    /// the ring buffer as it was before it became lock-free, the baseline for RingBufferBenchmark.
+    /// every push and read takes the same lock.
+    /// </summary>
+    class LockedRingBuffer<T>
     {
         private object padlock = new object();
 
@@ -47,7 +51,7 @@ namespace Bewegungsfelder.Utilities
 
         public T Last { get { lock (padlock) { return data[index]; } } }
 
-        public RingBuffer(int capacity)
+        public LockedRingBuffer(int capacity)
         {
             this.Capacity = capacity;
             data = new T[capacity];
@@ -0,0 +1,134 @@
+﻿/*
+Part of Bewegungsfelder
+
+MIT-License
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using Bewegungsfelder.Core;
+using System;
+using System.Collections.Generic;
+using System.IO;
+using System.Linq;
+using System.Text;
+using System.Threading.Tasks;
+
+namespace Bewegungsfelder.Benchmarks
+{
+    /*
+     * benchmarks of the server side, run the Release build.
+     *
+     * usage:
+     *   Bewegungsfelder.Benchmarks record <file> [seconds]
+     *                                 records the datagrams sent to the server port, default 30s.
+     *                                 the server must not run at the same time.
+     *   Bewegungsfelder.Benchmarks replay [file|-] [workers] [passes]
+     *                                 feeds the recorded datagrams into the ingest pipeline as
+     *                                 fast as it accepts them and prints datagrams/s and the
+     *                                 number of garbage collections. without a file 20 sensors
+     *                                 at 200Hz for 10s are generated, also for "-".
+     *   Bewegungsfelder.Benchmarks sweep [max workers] [max sensors]
+     *                                 replays generated datagrams with 1, 2, 4.. workers and
+     *                                 1, 10, 20, 50.. sensors and prints the decoded values/s.
+     *   Bewegungsfelder.Benchmarks ringbuffer [max readers] [seconds]
+     *                                 one writer and 0, 1, 2, 4.. readers on the lock-free ring
+     *                                 buffer and on the locked one it replaced.
+     *   Bewegungsfelder.Benchmarks bvh [frames] [joints] [runs]
+     *                                 generates a BVH file, default 100k frames of 30 joints,
+     *                                 reads and writes it with the current and the legacy code.
+     *   Bewegungsfelder.Benchmarks compress [frames] [joints]
+     *                                 generates smooth motion, default 12000 frames (100s at 120fps)
+     *                                 of 20 joints, and compresses it with 0.25 to 2 degree errors.
+    */
+    class Program
+    {
+        static void Main(string[] args)
+        {
+            string mode = args.Length > 0 ? args[0] : "";
+
+            switch (mode)
+            {
+                case "record":
+                    if (args.Length < 2)
+                        goto default;
+                    int seconds = args.Length > 2 ? int.Parse(args[2]) : 30;
+                    Console.WriteLine($"recording datagrams on port {Server.DATA_PORT} for {seconds}s");
+                    int count = DatagramFile.Record(args[1], Server.DATA_PORT, TimeSpan.FromSeconds(seconds));
+                    Console.WriteLine($"{count} datagrams written to {args[1]}");
+                    break;
+                case "replay":
+                    var datagrams = args.Length > 1 && args[1] != "-"
+                        ? DatagramFile.Load(args[1])
+                        : DatagramGenerator.Create(20, 200, 10);
+                    int workers = args.Length > 2 ? int.Parse(args[2]) : Math.Max(1, Environment.ProcessorCount / 2);
+                    int passes = args.Length > 3 ? int.Parse(args[3]) : 10;
+                    Console.WriteLine($"replaying {datagrams.Count} datagrams {passes} times on {workers} workers");
+                    Console.WriteLine(IngestBenchmark.Replay(datagrams, workers, passes));
+                    break;
+                case "sweep":
+                    int maxWorkers = args.Length > 1 ? int.Parse(args[1]) : Environment.ProcessorCount;
+                    int maxSensors = args.Length > 2 ? int.Parse(args[2]) : 200;
+                    IngestBenchmark.Sweep(
+                        Enumerable.Range(0, 31).Select(i => 1 << i).TakeWhile(n => n <= maxWorkers).ToArray(),
+                        new[] { 1, 10, 20, 50, 100, 200 }.Where(n => n <= maxSensors).ToArray(),
+                        5);
+                    break;
+                case "ringbuffer":
+                    int maxReaders = args.Length > 1 ? int.Parse(args[1]) : Environment.ProcessorCount;
+                    int runSeconds = args.Length > 2 ? int.Parse(args[2]) : 2;
+                    RingBufferBenchmark.Run(
+                        new[] { 0 }.Concat(Enumerable.Range(0, 31).Select(i => 1 << i).TakeWhile(n => n <= maxReaders)).ToArray(),
+                        TimeSpan.FromSeconds(runSeconds));
+                    break;
+                case "bvh":
+                    int frames = args.Length > 1 ? int.Parse(args[1]) : 100000;
+                    int joints = args.Length > 2 ? int.Parse(args[2]) : 30;
+                    int runs = args.Length > 3 ? int.Parse(args[3]) : 3;
+                    string path = Path.Combine(Path.GetTempPath(), $"benchmark_{frames}x{joints}.bvh");
+                    try
+                    {
+                        BvhBenchmark.Generate(path, frames, joints);
+                        Console.WriteLine($"{frames} frames, {joints} joints, {new FileInfo(path).Length >> 20} MB");
+                        BvhBenchmark.Read(path, runs);
+                        BvhBenchmark.Write(path, runs);
+                    }
+                    finally
+                    {
+                        File.Delete(path);
+                    }
+                    break;
+                case "compress":
+                    int motionFrames = args.Length > 1 ? int.Parse(args[1]) : 12000;
+                    int motionJoints = args.Length > 2 ? int.Parse(args[2]) : 20;
+                    CompressionBenchmark.Run(CompressionBenchmark.Generate(motionFrames, motionJoints),
+                        new[] { 0.25, 0.5, 1, 2 });
+                    break;
+                default:
+                    Console.WriteLine("usage: Bewegungsfelder.Benchmarks record <file> [seconds]");
+                    Console.WriteLine("       Bewegungsfelder.Benchmarks replay [file|-] [workers] [passes]");
+                    Console.WriteLine("       Bewegungsfelder.Benchmarks sweep [max workers] [max sensors]");
+                    Console.WriteLine("       Bewegungsfelder.Benchmarks ringbuffer [max readers] [seconds]");
+                    Console.WriteLine("       Bewegungsfelder.Benchmarks bvh [frames] [joints] [runs]");
+                    Console.WriteLine("       Bewegungsfelder.Benchmarks compress [frames] [joints]");
+                    break;
+            }
+        }
+    }
+}
@@ -0,0 +1,148 @@
+﻿/*
+Part of Bewegungsfelder
+
+MIT-License
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using Bewegungsfelder.Core;
+using Bewegungsfelder.Mathematics;
+using Bewegungsfelder.Utilities;
+using System;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.Linq;
+using System.Text;
+using System.Threading;
+using System.Threading.Tasks;
+
+namespace Bewegungsfelder.Benchmarks
+{
+    /// <summary>
+    /// one writer pushing sensor values while readers poll the most recent value
+    /// and copy a window of values, like the ingest worker and the ui threads.
+    /// compares the lock-free RingBuffer to the locked one it replaced.
+    /// </summary>
+    public static class RingBufferBenchmark
+    {
+        // 200Hz for 10 seconds, the history of a fast sensor
+        private const int CAPACITY = 2000;
+
+        // values copied per read, one second of a fast sensor
+        private const int WINDOW = 200;
+
+        public class Result
+        {
+            public double PushesPerSecond;
+            public double ReadsPerSecond;
+
+            public override string ToString()
+            {
+                return $"{PushesPerSecond:F0} pushes/s, {ReadsPerSecond:F0} reads/s";
+            }
+        }
+
+        /// <summary>
+        /// runs both implementations with every reader count and prints the results
+        /// </summary>
+        public static void Run(int[] readerCounts, TimeSpan duration)
+        {
+            foreach (int readers in readerCounts)
+            {
+                var locked = new LockedRingBuffer<SensorValue>(CAPACITY);
+                var lockFree = new RingBuffer<SensorValue>(CAPACITY);
+
+                var lockedResult = Measure(readers, duration, locked.Push, () => locked.Last, () => locked.Take(WINDOW));
+                var lockFreeResult = Measure(readers, duration, lockFree.Push, () => lockFree.Last, () => lockFree.Take(WINDOW));
+
+                Console.WriteLine($"1 writer, {readers} reader(s)");
+                Console.WriteLine($"  locked:    {lockedResult}");
+                Console.WriteLine($"  lock-free: {lockFreeResult}");
+            }
+        }
+
+        /// <summary>
+        /// a read is either the last value or a copy of the window, alternating
+        /// </summary>
+        private static Result Measure(int readerCount, TimeSpan duration,
+            Action<SensorValue> push, Func<SensorValue> last, Func<SensorValue[]> take)
+        {
+            // the locked buffer can't be read before it is filled once
+            for (int i = 0; i < CAPACITY; i++)
+            {
+                push(CreateValue(i));
+            }
+
+            bool stop = false;
+            long reads = 0;
+            long pushes = 0;
+
+            var threads = new List<Thread>();
+            for (int i = 0; i < readerCount; i++)
+            {
+                threads.Add(new Thread(() =>
+                {
+                    long count = 0;
+                    while (!Volatile.Read(ref stop))
+                    {
+                        last();
+                        take();
+                        count += 2;
+                    }
+                    Interlocked.Add(ref reads, count);
+                }));
+            }
+
+            threads.Add(new Thread(() =>
+            {
+                long count = 0;
+                while (!Volatile.Read(ref stop))
+                {
+                    push(CreateValue((int)count));
+                    ++count;
+                }
+                pushes = count;
+            }));
+
+            Stopwatch watch = Stopwatch.StartNew();
+            foreach (var thread in threads)
+            {
+                thread.Start();
+            }
+
+            Thread.Sleep(duration);
+            Volatile.Write(ref stop, true);
+
+            foreach (var thread in threads)
+            {
+                thread.Join();
+            }
+            double seconds = watch.Elapsed.TotalSeconds;
+
+            return new Result { PushesPerSecond = pushes / seconds, ReadsPerSecond = reads / seconds };
+        }
+
+        private static SensorValue CreateValue(int i)
+        {
+            return new SensorValue(new Quaternion(0, 0, 0, 1), new Vector3D(0, 0, 1), new Vector3D(0, 0, 0),
+                DateTime.MinValue, (uint)i, i & 0xffff);
+        }
+    }
+}
@@ -0,0 +1,347 @@
+﻿/*
+Part of Bewegungsfelder
+
+MIT-License
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using Bewegungsfelder.Utilities;
+using System;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.IO;
+using System.Linq;
+using System.Text;
+using System.Threading.Tasks;
+using Bewegungsfelder.Mathematics;
+
+namespace Bewegungsfelder.BVH
+{
+    /// <summary>
+    /// binary sidecar file holding a parsed bvh file, so large files are only parsed once.
+    /// the cache is used while the length and the last write time of the bvh file match. if only
+    /// the write time changed, the crc of the bvh file decides.
+    ///
+    /// layout, all values little endian:
+    ///   header (HEADER_LENGTH bytes): uint32 magic "BFBC", uint16 version, uint16 reserved,
+    ///     int64 source length, int64 source write time (utc ticks), uint32 source crc, uint32 reserved,
+    ///     float64 frame time, int32 node count, int32 joint count, int32 frame count, int32 reserved,
+    ///     int64 offset of the frames
+    ///   node count * { int32 parent, uint8 type, uint8 channel count, channel count * uint8 channel,
+    ///     float64 offset[3], uint16 name length, utf8 name }, nodes in depth first order
+    ///   frames, aligned to FRAME_ALIGNMENT bytes so they can be mapped in place:
+    ///     frame count * joint count * float32 rotation w/x/y/z, the layout of BVHMotionData.Rotations
+    /// </summary>
+    public static class BVHCache
+    {
+        public const uint MAGIC = 0x43424642; // "BFBC"
+        public const int VERSION = 1;
+
+        public const string FILE_EXTENSION = ".bfcache";
+
+        /// <summary>
+        /// smaller bvh files are parsed quickly enough and not cached
+        /// </summary>
+        public const long MIN_SOURCE_LENGTH = 1 << 20;
+
+        private const int HEADER_LENGTH = 64;
+        private const int WRITE_TIME_POSITION = 16;
+        private const int FRAMES_OFFSET_POSITION = 56;
+        private const int FRAME_ALIGNMENT = 16;
+        private const int BUFFER_SIZE = 1 << 20;
+
+        /// <summary>
+        /// returns the path of the cache file of a bvh file
+        /// </summary>
+        public static string GetCachePath(string file)
+        {
+            return file + FILE_EXTENSION;
+        }
+
+        /// <summary>
+        /// reads the cached contents of a bvh file.
+        /// </summary>
+        /// <returns>the root node or null if there is no valid cache for the file</returns>
+        public static BVHNode Read(string file, out BVHMotionData motionData)
+        {
+            motionData = null;
+            var source = new FileInfo(file);
+            var cacheFile = GetCachePath(file);
+            if (source.Length < MIN_SOURCE_LENGTH || !File.Exists(cacheFile))
+                return null;
+
+            try
+            {
+                BVHNode root;
+                bool touched = false;
+                using (var stream = new FileStream(cacheFile, FileMode.Open, FileAccess.Read, FileShare.Read,
+                    4096, FileOptions.SequentialScan))
+                {
+                    var reader = new BinaryReader(stream);
+                    if (reader.ReadUInt32() != MAGIC || reader.ReadUInt16() != VERSION)
+                        return null;
+                    reader.ReadUInt16();
+
+                    long sourceLength = reader.ReadInt64();
+                    long sourceWriteTime = reader.ReadInt64();
+                    uint sourceCrc = reader.ReadUInt32();
+                    if (sourceLength != source.Length)
+                        return null;
+
+                    // the file was touched. keep the cache if the content is the same
+                    if (sourceWriteTime != source.LastWriteTimeUtc.Ticks)
+                    {
+                        if (ComputeCrc(file) != sourceCrc)
+                            return null;
+                        touched = true;
+                    }
+
+                    reader.ReadUInt32();
+                    double frameTime = reader.ReadDouble();
+                    int nodeCount = reader.ReadInt32();
+                    int jointCount = reader.ReadInt32();
+                    int frameCount = reader.ReadInt32();
+                    reader.ReadInt32();
+                    long framesOffset = reader.ReadInt64();
+
+                    root = ReadNodes(reader, nodeCount);
+                    var joints = BVHMotionData.GetJoints(root);
+                    long frameBytes = (long)frameCount * jointCount * BVHMotionData.JOINT_STRIDE * sizeof(float);
+                    if (joints.Length != jointCount || frameCount < 0 || frameBytes > int.MaxValue
+                        || framesOffset + frameBytes > stream.Length)
+                        throw new InvalidDataException("Invalid frame data");
+
+                    stream.Position = framesOffset;
+                    var rotations = new float[frameBytes / sizeof(float)];
+                    ReadFloats(stream, rotations);
+
+                    motionData = new BVHMotionData(frameTime, joints, frameCount, rotations);
+                }
+
+                // skip the crc next time
+                if (touched)
+                    UpdateWriteTime(cacheFile, source.LastWriteTimeUtc.Ticks);
+
+                return root;
+            }
+            catch (Exception ex) when (ex is IOException || ex is InvalidDataException
+                || ex is UnauthorizedAccessException)
+            {
+                Debug.WriteLine($"Ignored BVH cache {cacheFile}: {ex.Message}");
+                return null;
+            }
+        }
+
+        /// <summary>
+        /// writes the cache file of a bvh file. errors are ignored, the bvh file is parsed again next time
+        /// </summary>
+        public static void Write(string file, BVHNode root, BVHMotionData motionData)
+        {
+            var source = new FileInfo(file);
+            if (source.Length < MIN_SOURCE_LENGTH)
+                return;
+
+            var cacheFile = GetCachePath(file);
+            var tempFile = cacheFile + ".tmp";
+            try
+            {
+                long sourceWriteTime = source.LastWriteTimeUtc.Ticks;
+                uint sourceCrc = ComputeCrc(file);
+
+                var nodes = new List<BVHNode>();
+                var parents = new List<int>();
+                AddNodes(root, -1, nodes, parents);
+
+                using (var stream = new FileStream(tempFile, FileMode.Create, FileAccess.Write, FileShare.None,
+                    BUFFER_SIZE))
+                {
+                    var writer = new BinaryWriter(stream);
+                    writer.Write(MAGIC);
+                    writer.Write((ushort)VERSION);
+                    writer.Write((ushort)0);
+                    writer.Write(source.Length);
+                    writer.Write(sourceWriteTime);
+                    writer.Write(sourceCrc);
+                    writer.Write(0);
+                    writer.Write(motionData.FrameTime);
+                    writer.Write(nodes.Count);
+                    writer.Write(motionData.Joints.Length);
+                    writer.Write(motionData.FrameCount);
+                    writer.Write(0);
+
+                    // the offset of the frames is written after the nodes
+                    writer.Write(0L);
+
+                    for (int i = 0; i < nodes.Count; i++)
+                    {
+                        var node = nodes[i];
+                        var channels = node.Channels ?? new BVHChannels[0];
+                        var name = Encoding.UTF8.GetBytes(node.Name ?? "");
+
+                        writer.Write(parents[i]);
+                        writer.Write((byte)node.Type);
+                        writer.Write((byte)channels.Length);
+                        foreach (var channel in channels)
+                            writer.Write((byte)channel);
+                        writer.Write(node.Offset.X);
+                        writer.Write(node.Offset.Y);
+                        writer.Write(node.Offset.Z);
+                        writer.Write((ushort)name.Length);
+                        writer.Write(name);
+                    }
+
+                    long framesOffset = (stream.Position + FRAME_ALIGNMENT - 1) & ~(long)(FRAME_ALIGNMENT - 1);
+                    writer.Write(new byte[framesOffset - stream.Position]);
+                    writer.Flush();
+
+                    WriteFloats(stream, motionData.Rotations, motionData.FrameCount * motionData.FrameStride);
+
+                    stream.Position = FRAMES_OFFSET_POSITION;
+                    writer.Write(framesOffset);
+                }
+
+                File.Delete(cacheFile);
+                File.Move(tempFile, cacheFile);
+            }
+            catch (Exception ex) when (ex is IOException || ex is UnauthorizedAccessException)
+            {
+                Debug.WriteLine($"Could not write BVH cache {cacheFile}: {ex.Message}");
+                try
+                {
+                    File.Delete(tempFile);
+                }
+                catch (Exception deleteEx) when (deleteEx is IOException || deleteEx is UnauthorizedAccessException)
+                {
+                }
+            }
+        }
+
+        private static void UpdateWriteTime(string cacheFile, long sourceWriteTime)
+        {
+            try
+            {
+                using (var stream = new FileStream(cacheFile, FileMode.Open, FileAccess.Write, FileShare.None))
+                {
+                    stream.Position = WRITE_TIME_POSITION;
+                    new BinaryWriter(stream).Write(sourceWriteTime);
+                }
+            }
+            catch (Exception ex) when (ex is IOException || ex is UnauthorizedAccessException)
+            {
+                Debug.WriteLine($"Could not update BVH cache {cacheFile}: {ex.Message}");
+            }
+        }
+
+        /// <summary>
+        /// lists the nodes depth first with the index of their parent
+        /// </summary>
+        private static void AddNodes(BVHNode node, int parent, List<BVHNode> nodes, List<int> parents)
+        {
+            int index = nodes.Count;
+            nodes.Add(node);
+            parents.Add(parent);
+            foreach (var child in node.Children)
+            {
+                AddNodes(child, index, nodes, parents);
+            }
+        }
+
+        private static BVHNode ReadNodes(BinaryReader reader, int nodeCount)
+        {
+            if (nodeCount <= 0)
+                throw new InvalidDataException("Invalid node count");
+
+            var nodes = new BVHNode[nodeCount];
+            for (int i = 0; i < nodeCount; i++)
+            {
+                int parent = reader.ReadInt32();
+                var type = (BVHNodeTypes)reader.ReadByte();
+                var channels = new BVHChannels[reader.ReadByte()];
+                for (int c = 0; c < channels.Length; c++)
+                {
+                    channels[c] = (BVHChannels)reader.ReadByte();
+                    if (channels[c] > BVHChannels.Zrotation)
+                        throw new InvalidDataException("Invalid channel");
+                }
+
+                var offset = new Vector3D(reader.ReadDouble(), reader.ReadDouble(), reader.ReadDouble());
+                var name = Encoding.UTF8.GetString(reader.ReadBytes(reader.ReadUInt16()));
+
+                if (parent >= i || (parent < 0) != (i == 0) || type > BVHNodeTypes.EndSite)
+                    throw new InvalidDataException("Invalid hierarchy");
+
+                nodes[i] = new BVHNode
+                {
+                    Type = type,
+                    Name = name,
+                    Offset = offset,
+                    Channels = type == BVHNodeTypes.EndSite ? null : channels,
+                };
+                if (parent >= 0)
+                    nodes[parent].Children.Add(nodes[i]);
+            }
+
+            return nodes[0];
+        }
+
+        private static void ReadFloats(Stream stream, float[] values)
+        {
+            var buffer = new byte[BUFFER_SIZE];
+            int byteCount = values.Length * sizeof(float);
+            for (int offset = 0; offset < byteCount;)
+            {
+                int read = stream.Read(buffer, 0, Math.Min(buffer.Length, byteCount - offset));
+                if (read == 0)
+                    throw new EndOfStreamException();
+
+                Buffer.BlockCopy(buffer, 0, values, offset, read);
+                offset += read;
+            }
+        }
+
+        private static void WriteFloats(Stream stream, float[] values, int count)
+        {
+            var buffer = new byte[BUFFER_SIZE];
+            int byteCount = count * sizeof(float);
+            for (int offset = 0; offset < byteCount; offset += buffer.Length)
+            {
+                int length = Math.Min(buffer.Length, byteCount - offset);
+                Buffer.BlockCopy(values, offset, buffer, 0, length);
+                stream.Write(buffer, 0, length);
+            }
+        }
+
+        private static uint ComputeCrc(string file)
+        {
+            var buffer = new byte[BUFFER_SIZE];
+            uint crc = 0;
+            using (var stream = new FileStream(file, FileMode.Open, FileAccess.Read, FileShare.Read,
+                4096, FileOptions.SequentialScan))
+            {
+                int read;
+                while ((read = stream.Read(buffer, 0, buffer.Length)) > 0)
+                {
+                    crc = Crc32.Append(crc, buffer, 0, read);
+                }
+            }
+            return crc;
+        }
+    }
+}
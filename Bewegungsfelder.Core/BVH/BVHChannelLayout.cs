@@ -0,0 +1,249 @@
+﻿/*
+Part of Bewegungsfelder
+
+MIT-License
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using System;
+using System.Collections.Generic;
+using System.IO;
+using System.Linq;
+using System.Text;
+using System.Threading.Tasks;
+using Bewegungsfelder.Utilities;
+
+namespace Bewegungsfelder.BVH
+{
+    /// <summary>
+    /// position of the values of each joint in a frame line.
+    /// computed once per hierarchy so frames can be converted without looking at the nodes.
+    /// </summary>
+    public class BVHChannelLayout
+    {
+        /// <summary>
+        /// number of frames read before they are converted at once
+        /// </summary>
+        public const int BLOCK_FRAMES = 256;
+
+        /// <summary>
+        /// the nodes with channels in the order of the frame values
+        /// </summary>
+        public BVHNode[] Joints { get; }
+
+        /// <summary>
+        /// number of values per frame
+        /// </summary>
+        public int ChannelCount { get; }
+
+        // per joint: frame value index of up to three rotation channels in file order, -1 if unused
+        private readonly int[] rotationChannels;
+
+        // per joint: axis (0,1,2 = x,y,z) of each rotation channel
+        private readonly int[] rotationAxes;
+
+        // per joint: order of the three euler angles, null if two channels share an axis
+        private readonly RotationOrder?[] orders;
+
+        // per joint: frame value index of the angle of each axis in order, -1 for a zero angle
+        private readonly int[] orderChannels;
+
+        // angle and quaternion components of one joint over a block of frames
+        [ThreadStatic]
+        private static float[][] cachedComponents;
+
+        public BVHChannelLayout(BVHNode root)
+        {
+            Joints = BVHMotionData.GetJoints(root);
+            rotationChannels = new int[Joints.Length * 3];
+            rotationAxes = new int[Joints.Length * 3];
+
+            int channel = 0;
+            for (int j = 0; j < Joints.Length; j++)
+            {
+                int rotations = 0;
+                foreach (var type in Joints[j].Channels)
+                {
+                    if (type >= BVHChannels.Xrotation)
+                    {
+                        if (rotations == 3)
+                            throw new InvalidDataException($"More than three rotation channels for {Joints[j].Name}");
+
+                        rotationChannels[j * 3 + rotations] = channel;
+                        rotationAxes[j * 3 + rotations] = (int)type % 3;
+                        rotations++;
+                    }
+                    channel++;
+                }
+
+                for (; rotations < 3; rotations++)
+                {
+                    rotationChannels[j * 3 + rotations] = -1;
+                }
+            }
+
+            ChannelCount = channel;
+
+            orders = new RotationOrder?[Joints.Length];
+            orderChannels = new int[Joints.Length * 3];
+            for (int j = 0; j < Joints.Length; j++)
+            {
+                // missing axes are appended with a zero angle, which doesn't change the rotation
+                var axes = new List<int>();
+                for (int k = j * 3; k < j * 3 + 3 && rotationChannels[k] >= 0; k++)
+                {
+                    axes.Add(rotationAxes[k]);
+                }
+                if (axes.Distinct().Count() != axes.Count)
+                    continue;
+
+                axes.AddRange(Enumerable.Range(0, 3).Except(axes));
+                orders[j] = EulerConversion.GetOrder(axes[0], axes[1], axes[2]);
+                for (int k = 0; k < 3; k++)
+                {
+                    orderChannels[j * 3 + k] = rotationChannels[j * 3 + k];
+                }
+            }
+        }
+
+        /// <summary>
+        /// converts the euler angles of consecutive frames to quaternions.
+        /// joints are converted for all frames at once with the batch conversion
+        /// </summary>
+        /// <param name="values">the values of frameCount frame lines, angles in degrees</param>
+        /// <param name="frameCount">number of frames in values</param>
+        /// <param name="rotations">receives w,x,y,z per joint</param>
+        /// <param name="offset">index of the first frame in rotations</param>
+        public void ToRotations(double[] values, int frameCount, float[] rotations, int offset)
+        {
+            int stride = Joints.Length * BVHMotionData.JOINT_STRIDE;
+            var components = GetComponents(frameCount);
+            float[] first = components[0], second = components[1], third = components[2];
+            float[] w = components[3], x = components[4], y = components[5], z = components[6];
+
+            for (int j = 0; j < Joints.Length; j++)
+            {
+                if (orders[j] == null)
+                {
+                    for (int f = 0; f < frameCount; f++)
+                    {
+                        ToRotation(j, values, f * ChannelCount, rotations, offset + f * stride);
+                    }
+                    continue;
+                }
+
+                GatherAngles(values, frameCount, orderChannels[j * 3], first);
+                GatherAngles(values, frameCount, orderChannels[j * 3 + 1], second);
+                GatherAngles(values, frameCount, orderChannels[j * 3 + 2], third);
+
+                EulerConversion.ToQuaternions(orders[j].Value, first, second, third, w, x, y, z, frameCount);
+
+                int i = offset + j * BVHMotionData.JOINT_STRIDE;
+                for (int f = 0; f < frameCount; f++, i += stride)
+                {
+                    rotations[i] = w[f];
+                    rotations[i + 1] = x[f];
+                    rotations[i + 2] = y[f];
+                    rotations[i + 3] = z[f];
+                }
+            }
+        }
+
+        /// <summary>
+        /// copies the values of a channel in radians, zeros if channel is -1
+        /// </summary>
+        private void GatherAngles(double[] values, int frameCount, int channel, float[] angles)
+        {
+            if (channel < 0)
+            {
+                Array.Clear(angles, 0, frameCount);
+                return;
+            }
+
+            for (int f = 0; f < frameCount; f++, channel += ChannelCount)
+            {
+                angles[f] = (float)(values[channel] * (Math.PI / 180));
+            }
+        }
+
+        private static float[][] GetComponents(int length)
+        {
+            var components = cachedComponents;
+            if (components == null || components[0].Length < length)
+            {
+                components = new float[7][];
+                for (int i = 0; i < components.Length; i++)
+                {
+                    components[i] = new float[length];
+                }
+                cachedComponents = components;
+            }
+
+            return components;
+        }
+
+        /// <summary>
+        /// converts the euler angles of a joint in the frame starting at valueOffset to a quaternion at index i.
+        /// the rotations are applied in channel order, for joints with repeated axes
+        /// </summary>
+        private void ToRotation(int j, double[] values, int valueOffset, float[] rotations, int i)
+        {
+            double w = 1, x = 0, y = 0, z = 0;
+            for (int k = j * 3; k < j * 3 + 3; k++)
+            {
+                int channel = rotationChannels[k];
+                if (channel < 0)
+                    break;
+
+                // q = q * (axis, angle)
+                double half = values[valueOffset + channel] * (Math.PI / 360);
+                double c = Math.Cos(half);
+                double s = Math.Sin(half);
+                double tw = w, tx = x, ty = y, tz = z;
+                switch (rotationAxes[k])
+                {
+                    case 0:
+                        w = tw * c - tx * s;
+                        x = tw * s + tx * c;
+                        y = ty * c + tz * s;
+                        z = tz * c - ty * s;
+                        break;
+                    case 1:
+                        w = tw * c - ty * s;
+                        x = tx * c - tz * s;
+                        y = tw * s + ty * c;
+                        z = tz * c + tx * s;
+                        break;
+                    default:
+                        w = tw * c - tz * s;
+                        x = tx * c + ty * s;
+                        y = ty * c - tx * s;
+                        z = tw * s + tz * c;
+                        break;
+                }
+            }
+
+            rotations[i] = (float)w;
+            rotations[i + 1] = (float)x;
+            rotations[i + 2] = (float)y;
+            rotations[i + 3] = (float)z;
+        }
+    }
+}
@@ -28,7 +28,7 @@ using System.Collections.Generic;
 using System.Linq;
 using System.Text;
 using System.Threading.Tasks;
-using System.Windows.Media.Media3D;
+using Bewegungsfelder.Mathematics;
 
 namespace Bewegungsfelder.BVH
 {
@@ -39,14 +39,48 @@ namespace Bewegungsfelder.BVH
         /// </summary>
         public static Bone ToBones(BVHNode bvhNode, Bone parent, BVHMotionData bvhMotionData,
             MotionData resultMotionData)
+        {
+            var joints = new List<Bone>();
+            var sourceJoints = new List<int>();
+            Bone result = ToBones(bvhNode, parent, bvhMotionData, joints, sourceJoints);
+
+            // copy the frames to the joint order of the motion data.
+            // both are depth first, so usually whole frames can be copied
+            resultMotionData.Reset(joints);
+            bool sameOrder = joints.Count == bvhMotionData.Joints.Length
+                && sourceJoints.Select((source, index) => source == index).All(same => same);
+            int stride = bvhMotionData.FrameStride;
+            for (int i = 0; i < bvhMotionData.FrameCount; i++)
+            {
+                var frame = resultMotionData.AddFrame();
+                if (sameOrder)
+                {
+                    Array.Copy(bvhMotionData.Rotations, i * stride, frame.Array, frame.Offset, stride);
+                    continue;
+                }
+
+                for (int j = 0; j < sourceJoints.Count; j++)
+                {
+                    MotionData.Write(frame, j, bvhMotionData.GetRotation(i, sourceJoints[j]));
+                }
+            }
+
+            return result;
+        }
+
+        private static Bone ToBones(BVHNode bvhNode, Bone parent, BVHMotionData bvhMotionData,
+            List<Bone> joints, List<int> sourceJoints)
         {
             Bone result = new Bone(parent, name: bvhNode.Name, offset: bvhNode.Offset);
             if (bvhNode.Type != BVHNodeTypes.EndSite)
-                resultMotionData.Data.Add(result, bvhMotionData.Data[bvhNode].ToList());
+            {
+                joints.Add(result);
+                sourceJoints.Add(Array.IndexOf(bvhMotionData.Joints, bvhNode));
+            }
 
             foreach (BVHNode item in bvhNode.Children)
             {
-                result.Children.Add(ToBones(item, result, bvhMotionData, resultMotionData));
+                result.Children.Add(ToBones(item, result, bvhMotionData, joints, sourceJoints));
             }
 
             return result;
@@ -54,9 +88,20 @@ namespace Bewegungsfelder.BVH
 
         public static BVHNode ToBVHData(Bone node, MotionData motionData, out BVHMotionData bvhMotionData)
         {
-            Dictionary<BVHNode, List<Quaternion>> data = new Dictionary<BVHNode, List<Quaternion>>();
-            var resultNode = ToBVHNode(node, motionData.Data, null, data);
-            bvhMotionData = new BVHMotionData(1.0 / motionData.FPS, data);
+            var bones = new List<Bone>();
+            var resultNode = ToBVHNode(node, null, bones);
+
+            // copy the frames of each joint, joints without recorded frames keep their rotation
+            var joints = BVHMotionData.GetJoints(resultNode);
+            bvhMotionData = new BVHMotionData(1.0 / motionData.FPS, joints, motionData.FrameCount);
+            for (int j = 0; j < joints.Length; j++)
+            {
+                int source = motionData.IndexOf(bones[j]);
+                for (int i = 0; i < motionData.FrameCount; i++)
+                {
+                    bvhMotionData.SetRotation(i, j, source >= 0 ? motionData.GetRotation(i, source) : bones[j].JointRotation);
+                }
+            }
 
             return resultNode;
         }
@@ -64,7 +109,8 @@ namespace Bewegungsfelder.BVH
         /// <summary>
         /// converts a kinematic model to BVH structure for export.
         /// </summary>
-        private static BVHNode ToBVHNode(Bone bone, Dictionary<Bone, List<Quaternion>> sourceMotionData, BVHNode parent, Dictionary<BVHNode, List<Quaternion>> motionData)
+        /// <param name="bones">receives the bones of the nodes with channels, depth first</param>
+        private static BVHNode ToBVHNode(Bone bone, BVHNode parent, List<Bone> bones)
         {
             var result = new BVHNode();
             result.Name = bone.Name;
@@ -86,15 +132,13 @@ namespace Bewegungsfelder.BVH
                 result.Channels = new[] { BVHChannels.Zrotation, BVHChannels.Yrotation, BVHChannels.Xrotation };
             }
 
-            // populate motion data
-            if (result.Type != BVHNodeTypes.EndSite && sourceMotionData.Count > 0
-                && sourceMotionData.ContainsKey(bone))
-                motionData.Add(result, sourceMotionData[bone]);
+            if (result.Type != BVHNodeTypes.EndSite)
+                bones.Add(bone);
 
             // add child nodes
             foreach (var child in bone.Children)
             {
-                result.Children.Add(ToBVHNode(child, sourceMotionData, result, motionData));
+                result.Children.Add(ToBVHNode(child, result, bones));
             }
 
             return result;
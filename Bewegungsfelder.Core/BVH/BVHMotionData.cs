@@ -0,0 +1,116 @@
+﻿/*
+Part of Bewegungsfelder 
+
+MIT-License 
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Text;
+using System.Threading.Tasks;
+using Bewegungsfelder.Mathematics;
+
+namespace Bewegungsfelder.BVH
+{
+    public class BVHMotionData
+    {
+        /// <summary>
+        /// number of floats stored per joint and frame
+        /// </summary>
+        public const int JOINT_STRIDE = 4;
+
+        public double FrameTime { get; }
+
+        /// <summary>
+        /// the nodes with channels in the order of the frame values: depth first, without end sites
+        /// </summary>
+        public BVHNode[] Joints { get; }
+
+        public int FrameCount { get; }
+
+        /// <summary>
+        /// joint rotations as w,x,y,z per joint. frames are stored one after another
+        /// </summary>
+        public float[] Rotations { get; }
+
+        /// <summary>
+        /// number of floats per frame
+        /// </summary>
+        public int FrameStride { get { return Joints.Length * JOINT_STRIDE; } }
+
+        /// <summary>
+        /// creates motion data with all rotations set to zero
+        /// </summary>
+        public BVHMotionData(double frameTime, BVHNode[] joints, int frameCount)
+            : this(frameTime, joints, frameCount, new float[frameCount * joints.Length * JOINT_STRIDE])
+        {
+        }
+
+        public BVHMotionData(double frameTime, BVHNode[] joints, int frameCount, float[] rotations)
+        {
+            if (rotations.Length < frameCount * joints.Length * JOINT_STRIDE)
+                throw new ArgumentException("Not enough rotations for the frame count", nameof(rotations));
+
+            this.FrameTime = frameTime;
+            this.Joints = joints;
+            this.FrameCount = frameCount;
+            this.Rotations = rotations;
+        }
+
+        public Quaternion GetRotation(int frame, int joint)
+        {
+            int i = frame * FrameStride + joint * JOINT_STRIDE;
+            return new Quaternion(Rotations[i + 1], Rotations[i + 2], Rotations[i + 3], Rotations[i]);
+        }
+
+        public void SetRotation(int frame, int joint, Quaternion rotation)
+        {
+            int i = frame * FrameStride + joint * JOINT_STRIDE;
+            Rotations[i] = (float)rotation.W;
+            Rotations[i + 1] = (float)rotation.X;
+            Rotations[i + 2] = (float)rotation.Y;
+            Rotations[i + 3] = (float)rotation.Z;
+        }
+
+        /// <summary>
+        /// returns the nodes of a hierarchy that have frame values, in the order of the frame values
+        /// </summary>
+        public static BVHNode[] GetJoints(BVHNode root)
+        {
+            var result = new List<BVHNode>();
+            AddJoints(root, result);
+            return result.ToArray();
+        }
+
+        private static void AddJoints(BVHNode node, List<BVHNode> result)
+        {
+            if (node.Type == BVHNodeTypes.EndSite)
+                return;
+
+            result.Add(node);
+            foreach (var child in node.Children)
+            {
+                AddJoints(child, result);
+            }
+        }
+    }
+}
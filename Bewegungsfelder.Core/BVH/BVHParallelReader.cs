@@ -0,0 +1,239 @@
+﻿/*
+Part of Bewegungsfelder
+
+MIT-License
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using System;
+using System.Collections.Generic;
+using System.IO;
+using System.IO.MemoryMappedFiles;
+using System.Linq;
+using System.Runtime.ExceptionServices;
+using System.Text;
+using System.Threading.Tasks;
+
+namespace Bewegungsfelder.BVH
+{
+    /// <summary>
+    /// decodes the motion section of a large bvh file on all cores.
+    /// the file is mapped into memory and split into chunks of whole lines. the frames of each chunk
+    /// are counted first, then every chunk is parsed into its own slice of the rotation buffer.
+    /// </summary>
+    static class BVHParallelReader
+    {
+        // chunks per processor, so a slow chunk doesn't keep the other cores waiting
+        private const int CHUNKS_PER_PROCESSOR = 4;
+
+        private const long MIN_CHUNK_LENGTH = 1 << 20;
+
+        private const int SCAN_BUFFER_SIZE = 1 << 16;
+
+        /// <summary>
+        /// reads all frames from motionStart to the end of the file
+        /// </summary>
+        /// <param name="motionStart">file position of the first frame, right after the motion header</param>
+        /// <param name="motionLine">line number of the first frame</param>
+        public static BVHMotionData ReadMotionData(string file, long motionStart, int motionLine,
+            BVHChannelLayout layout, double frameTime)
+        {
+            using (var mappedFile = MemoryMappedFile.CreateFromFile(file, FileMode.Open, null, 0,
+                MemoryMappedFileAccess.Read))
+            {
+                long fileLength = new FileInfo(file).Length;
+                var chunkStarts = GetChunkStarts(mappedFile, motionStart, fileLength);
+                int chunkCount = chunkStarts.Length - 1;
+
+                // count the frames of every chunk to know where its frames go
+                var frameCounts = new int[chunkCount];
+                var lineCounts = new int[chunkCount];
+                Run(chunkCount, i => frameCounts[i] = CountFrames(mappedFile,
+                    chunkStarts[i], chunkStarts[i + 1] - chunkStarts[i], out lineCounts[i]));
+
+                var firstFrames = new int[chunkCount];
+                var firstLines = new int[chunkCount];
+                long frameCount = 0;
+                int line = motionLine;
+                for (int i = 0; i < chunkCount; i++)
+                {
+                    firstFrames[i] = (int)Math.Min(frameCount, int.MaxValue);
+                    firstLines[i] = line;
+                    frameCount += frameCounts[i];
+                    line += lineCounts[i];
+                }
+
+                int stride = layout.Joints.Length * BVHMotionData.JOINT_STRIDE;
+                if (frameCount * stride > int.MaxValue)
+                    throw new InvalidDataException("Too many frames");
+
+                var rotations = new float[frameCount * stride];
+                Run(chunkCount, i => ReadFrames(mappedFile, chunkStarts[i], chunkStarts[i + 1] - chunkStarts[i],
+                    firstLines[i], layout, rotations, firstFrames[i], frameCounts[i]));
+
+                return new BVHMotionData(frameTime, layout.Joints, (int)frameCount, rotations);
+            }
+        }
+
+        /// <summary>
+        /// runs the body for every chunk in parallel. the first error is rethrown as is
+        /// </summary>
+        private static void Run(int chunkCount, Action<int> body)
+        {
+            try
+            {
+                Parallel.For(0, chunkCount, body);
+            }
+            catch (AggregateException ex)
+            {
+                ExceptionDispatchInfo.Capture(ex.InnerExceptions[0]).Throw();
+            }
+        }
+
+        /// <summary>
+        /// splits the motion section into chunks that start at the beginning of a line.
+        /// </summary>
+        /// <returns>start of every chunk, followed by the end of the file</returns>
+        private static long[] GetChunkStarts(MemoryMappedFile mappedFile, long motionStart, long fileLength)
+        {
+            long length = fileLength - motionStart;
+            long chunkCount = Math.Max(1, Math.Min(Environment.ProcessorCount * CHUNKS_PER_PROCESSOR,
+                length / MIN_CHUNK_LENGTH));
+
+            var starts = new List<long> { motionStart };
+            for (long i = 1; i < chunkCount; i++)
+            {
+                long start = Math.Max(motionStart + length * i / chunkCount, starts[starts.Count - 1]);
+                start = FindNextLine(mappedFile, start, fileLength);
+                if (start < fileLength && start > starts[starts.Count - 1])
+                    starts.Add(start);
+            }
+
+            starts.Add(fileLength);
+            return starts.ToArray();
+        }
+
+        /// <summary>
+        /// returns the position after the next line break at or after position
+        /// </summary>
+        private static long FindNextLine(MemoryMappedFile mappedFile, long position, long fileLength)
+        {
+            var buffer = new byte[4096];
+            while (position < fileLength)
+            {
+                int length = (int)Math.Min(buffer.Length, fileLength - position);
+                using (var view = mappedFile.CreateViewStream(position, length, MemoryMappedFileAccess.Read))
+                {
+                    length = view.Read(buffer, 0, length);
+                }
+
+                int newline = Array.IndexOf(buffer, (byte)'\n', 0, length);
+                if (newline >= 0)
+                    return position + newline + 1;
+
+                position += length;
+            }
+
+            return fileLength;
+        }
+
+        /// <summary>
+        /// counts the lines of a chunk that aren't empty
+        /// </summary>
+        /// <param name="lineCount">receives the number of line breaks in the chunk</param>
+        private static int CountFrames(MemoryMappedFile mappedFile, long start, long length, out int lineCount)
+        {
+            var buffer = new byte[SCAN_BUFFER_SIZE];
+            int count = 0;
+            lineCount = 0;
+            bool lineHasValues = false;
+            using (var view = mappedFile.CreateViewStream(start, length, MemoryMappedFileAccess.Read))
+            {
+                // the view can be longer than requested, it is rounded up to whole pages
+                long remaining = length;
+                while (remaining > 0)
+                {
+                    int read = view.Read(buffer, 0, (int)Math.Min(buffer.Length, remaining));
+                    if (read == 0)
+                        break;
+                    remaining -= read;
+
+                    for (int i = 0; i < read; i++)
+                    {
+                        byte b = buffer[i];
+                        if (b == '\n')
+                        {
+                            lineCount++;
+                            if (lineHasValues)
+                                count++;
+                            lineHasValues = false;
+                        }
+                        else if (b != ' ' && b != '\t' && b != '\r')
+                        {
+                            lineHasValues = true;
+                        }
+                    }
+                }
+            }
+
+            return lineHasValues ? count + 1 : count;
+        }
+
+        /// <summary>
+        /// parses the frames of a chunk into the rotation buffer, starting at firstFrame
+        /// </summary>
+        private static void ReadFrames(MemoryMappedFile mappedFile, long start, long length, int firstLine,
+            BVHChannelLayout layout, float[] rotations, int firstFrame, int frameCount)
+        {
+            int stride = layout.Joints.Length * BVHMotionData.JOINT_STRIDE;
+            int channels = layout.ChannelCount;
+            var values = new double[BVHChannelLayout.BLOCK_FRAMES * channels];
+
+            using (var view = mappedFile.CreateViewStream(start, length, MemoryMappedFileAccess.Read))
+            using (var reader = new BVHTokenizer(view, length))
+            {
+                reader.LineNumber = firstLine;
+                int frame = firstFrame;
+                int count = 0;
+                while (count >= 0)
+                {
+                    // parse a block of frames and convert it at once
+                    int blockFrames = 0;
+                    while (blockFrames < BVHChannelLayout.BLOCK_FRAMES &&
+                        (count = reader.ReadValues(values, blockFrames * channels, channels)) >= 0)
+                    {
+                        if (count != channels)
+                            throw new InvalidDataException(
+                                $"Line {reader.LineNumber - 1}: {channels} values expected, but {count} found");
+                        if (frame + blockFrames - firstFrame == frameCount)
+                            throw new InvalidDataException($"Line {reader.LineNumber - 1}: invalid frame data");
+                        blockFrames++;
+                    }
+
+                    layout.ToRotations(values, blockFrames, rotations, frame * stride);
+                    frame += blockFrames;
+                }
+
+                if (frame - firstFrame != frameCount)
+                    throw new InvalidDataException($"Line {reader.LineNumber}: invalid frame data");
+            }
+        }
+    }
+}
@@ -0,0 +1,217 @@
+﻿/*
+Part of Bewegungsfelder
+
+MIT-License
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using System;
+using System.Collections.Generic;
+using System.Globalization;
+using System.IO;
+using System.Linq;
+using System.Text;
+using System.Threading.Tasks;
+using Bewegungsfelder.Utilities;
+
+namespace Bewegungsfelder.BVH
+{
+    /// <summary>
+    /// writes the frames of a bvh file. blocks of frames are formatted on all cores into
+    /// reused utf-8 buffers and written to the stream in order.
+    /// </summary>
+    static class BVHParallelWriter
+    {
+        private const int BLOCK_FRAMES = 256;
+
+        // blocks formatted before they are written, per processor
+        private const int BLOCKS_PER_PROCESSOR = 2;
+
+        // values are written with this many decimals, trailing zeros are dropped
+        private const int DECIMALS = 6;
+        private const double DECIMAL_SCALE = 1e6;
+
+        // numbers at least this large are formatted by double.ToString,
+        // so the scaled value stays exact in a double
+        private const double MAX_FIXED_VALUE = 1e9;
+
+        // longest possible number including the separator
+        private const int MAX_VALUE_LENGTH = 32;
+
+        private static readonly long[] POWERS_OF_TEN =
+        {
+            1, 10, 100, 1000, 10000, 100000, 1000000, 10000000, 100000000, 1000000000,
+            10000000000, 100000000000, 1000000000000, 10000000000000, 100000000000000,
+            1000000000000000, 10000000000000000, 100000000000000000, 1000000000000000000,
+        };
+
+        private static readonly byte[] NEW_LINE = Encoding.ASCII.GetBytes(Environment.NewLine);
+
+        // quaternion and angle components of all joints in a block
+        [ThreadStatic]
+        private static float[][] cachedComponents;
+
+        /// <summary>
+        /// writes all frames of the motion data as Z, Y and X rotations in degrees per joint
+        /// </summary>
+        public static void WriteMotionData(Stream stream, BVHMotionData motionData)
+        {
+            int blockCount = (motionData.FrameCount + BLOCK_FRAMES - 1) / BLOCK_FRAMES;
+            int batchSize = Environment.ProcessorCount * BLOCKS_PER_PROCESSOR;
+            int bufferLength = BLOCK_FRAMES * (motionData.Joints.Length * 3 * MAX_VALUE_LENGTH + NEW_LINE.Length);
+
+            var buffers = new byte[Math.Min(batchSize, blockCount)][];
+            var lengths = new int[buffers.Length];
+            for (int batch = 0; batch < blockCount; batch += batchSize)
+            {
+                int count = Math.Min(batchSize, blockCount - batch);
+                Parallel.For(0, count, i =>
+                {
+                    if (buffers[i] == null)
+                        buffers[i] = new byte[bufferLength];
+
+                    int first = (batch + i) * BLOCK_FRAMES;
+                    int last = Math.Min(first + BLOCK_FRAMES, motionData.FrameCount);
+                    lengths[i] = FormatFrames(motionData, first, last, buffers[i]);
+                });
+
+                for (int i = 0; i < count; i++)
+                {
+                    stream.Write(buffers[i], 0, lengths[i]);
+                }
+            }
+        }
+
+        /// <summary>
+        /// formats the frames from first to last (exclusive) into the buffer
+        /// </summary>
+        /// <returns>number of bytes written</returns>
+        private static int FormatFrames(BVHMotionData motionData, int first, int last, byte[] buffer)
+        {
+            var rotations = motionData.Rotations;
+            int jointCount = motionData.Joints.Length;
+            int count = (last - first) * jointCount;
+
+            if (cachedComponents == null || cachedComponents[0].Length < count)
+            {
+                cachedComponents = new float[7][];
+                for (int c = 0; c < cachedComponents.Length; c++)
+                {
+                    cachedComponents[c] = new float[BLOCK_FRAMES * jointCount];
+                }
+            }
+
+            float[] w = cachedComponents[0], x = cachedComponents[1], y = cachedComponents[2], z = cachedComponents[3];
+            float[] yaw = cachedComponents[4], pitch = cachedComponents[5], roll = cachedComponents[6];
+
+            // all joints are exported with zyx channels
+            int i = first * motionData.FrameStride;
+            for (int k = 0; k < count; k++, i += BVHMotionData.JOINT_STRIDE)
+            {
+                w[k] = rotations[i];
+                x[k] = rotations[i + 1];
+                y[k] = rotations[i + 2];
+                z[k] = rotations[i + 3];
+            }
+            EulerConversion.ToEulerAngles(RotationOrder.ZYX, w, x, y, z, yaw, pitch, roll, count);
+
+            int p = 0;
+            for (int k = 0; k < count; k++)
+            {
+                if (k % jointCount != 0)
+                    buffer[p++] = (byte)' ';
+                p = FormatNumber(yaw[k] * (180 / Math.PI), buffer, p);
+                buffer[p++] = (byte)' ';
+                p = FormatNumber(pitch[k] * (180 / Math.PI), buffer, p);
+                buffer[p++] = (byte)' ';
+                p = FormatNumber(roll[k] * (180 / Math.PI), buffer, p);
+
+                if (k % jointCount == jointCount - 1)
+                {
+                    Buffer.BlockCopy(NEW_LINE, 0, buffer, p, NEW_LINE.Length);
+                    p += NEW_LINE.Length;
+                }
+            }
+
+            return p;
+        }
+
+        /// <summary>
+        /// writes a number with up to DECIMALS decimals in the invariant culture
+        /// </summary>
+        /// <returns>position after the number</returns>
+        private static int FormatNumber(double value, byte[] buffer, int p)
+        {
+            if (double.IsNaN(value) || Math.Abs(value) >= MAX_FIXED_VALUE)
+            {
+                foreach (char c in value.ToString("R", CultureInfo.InvariantCulture))
+                    buffer[p++] = (byte)c;
+                return p;
+            }
+
+            long scaled = (long)(Math.Abs(value) * DECIMAL_SCALE + 0.5);
+            if (scaled == 0)
+            {
+                buffer[p++] = (byte)'0';
+                return p;
+            }
+
+            if (value < 0)
+                buffer[p++] = (byte)'-';
+
+            // the integer part is below MAX_FIXED_VALUE, the fraction below DECIMAL_SCALE
+            long integer = scaled / (long)DECIMAL_SCALE;
+            uint fraction = (uint)(scaled - integer * (long)DECIMAL_SCALE);
+
+            // integer digits, written backwards
+            int digits = 1;
+            while (digits < POWERS_OF_TEN.Length && integer >= POWERS_OF_TEN[digits])
+                digits++;
+            p += digits;
+            for (int q = p - 1; q >= p - digits; q--)
+            {
+                long next = integer / 10;
+                buffer[q] = (byte)('0' + (integer - next * 10));
+                integer = next;
+            }
+
+            if (fraction != 0)
+            {
+                int decimals = DECIMALS;
+                while (fraction % 10 == 0)
+                {
+                    fraction /= 10;
+                    decimals--;
+                }
+
+                buffer[p] = (byte)'.';
+                for (int q = p + decimals; q > p; q--)
+                {
+                    uint next = fraction / 10;
+                    buffer[q] = (byte)('0' + (fraction - next * 10));
+                    fraction = next;
+                }
+                p += decimals + 1;
+            }
+
+            return p;
+        }
+    }
+}
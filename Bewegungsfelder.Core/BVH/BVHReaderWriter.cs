@@ -0,0 +1,371 @@
+﻿/*
+Part of Bewegungsfelder 
+
+MIT-License 
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using System;
+using System.Collections.Generic;
+using System.Globalization;
+using System.IO;
+using System.Linq;
+using System.Text;
+using System.Threading.Tasks;
+using Bewegungsfelder.Mathematics;
+using Bewegungsfelder.Utilities;
+
+namespace Bewegungsfelder.BVH
+{
+    public class BVHReaderWriter
+    {
+        /// <summary>
+        /// motion sections of at least this size are decoded on all cores
+        /// </summary>
+        public const long PARALLEL_MIN_LENGTH = 4 << 20;
+
+        /// <summary>
+        /// reads BVH hierarchical data from a BVH file.
+        /// large files are loaded from their binary cache if they haven't changed since the last read
+        /// </summary>
+        public static BVHNode ReadBvh(string file, out BVHMotionData motionData)
+        {
+            var root = BVHCache.Read(file, out motionData);
+            if (root != null)
+                return root;
+
+            root = ParseBvh(file, Environment.ProcessorCount > 1, out motionData);
+            BVHCache.Write(file, root, motionData);
+            return root;
+        }
+
+        /// <summary>
+        /// parses a BVH file
+        /// </summary>
+        /// <param name="parallel">decodes motion sections of at least PARALLEL_MIN_LENGTH on all cores</param>
+        internal static BVHNode ParseBvh(string file, bool parallel, out BVHMotionData motionData)
+        {
+            BVHNode root;
+            BVHChannelLayout layout;
+            int numFrames;
+            double frameTime;
+            long motionStart;
+            int motionLine;
+
+            using (var stream = new FileStream(file, FileMode.Open, FileAccess.Read, FileShare.Read,
+                4096, FileOptions.SequentialScan))
+            using (var reader = new BVHTokenizer(stream))
+            {
+                var line = ReadLine(reader).ToLower().Trim();
+                if (line != "hierarchy")
+                    throw new InvalidDataException("File has to start with HIERARCHY keyword");
+
+                root = ReadNode(reader, ReadLine(reader), 0);
+                ReadMotionHeader(reader, out numFrames, out frameTime);
+
+                // position channels are not supported by the kinematic model and skipped
+                layout = new BVHChannelLayout(root);
+
+                motionStart = reader.Offset;
+                motionLine = reader.LineNumber;
+                if (!parallel || stream.Length - motionStart < PARALLEL_MIN_LENGTH)
+                {
+                    motionData = ReadMotionData(reader, layout, numFrames, frameTime);
+                    return root;
+                }
+            }
+
+            motionData = BVHParallelReader.ReadMotionData(file, motionStart, motionLine, layout, frameTime);
+            return root;
+        }
+
+        /// <summary>
+        /// reads the motion header, starting with the MOTION keyword
+        /// </summary>
+        private static void ReadMotionHeader(BVHTokenizer reader, out int numFrames, out double frameTime)
+        {
+            var line = ReadLine(reader).ToLower().Trim();
+            if (line != "motion")
+                throw new InvalidDataException("Expected MOTION keyword");
+
+            // read number of frames
+            line = ReadLine(reader).ToLower().Trim();
+            var tokens = line.Split(new[] { ' ', '\t' }, StringSplitOptions.RemoveEmptyEntries);
+
+            if (!int.TryParse(tokens[1], out numFrames))
+            {
+                throw new InvalidDataException("Could not read number of frames");
+            }
+
+            //read frame time
+            line = ReadLine(reader).ToLower().Trim();
+            tokens = line.Split(new[] { ' ', '\t' }, StringSplitOptions.RemoveEmptyEntries);
+
+            if (!double.TryParse(tokens[2], NumberStyles.Float, CultureInfo.InvariantCulture, out frameTime))
+            {
+                throw new InvalidDataException("Could not read frame time");
+            }
+        }
+
+        /// <summary>
+        /// reads all frames following the motion header.
+        /// frames are converted straight into the rotation buffer using the channel layout of the hierarchy.
+        /// </summary>
+        private static BVHMotionData ReadMotionData(BVHTokenizer reader, BVHChannelLayout layout,
+            int numFrames, double frameTime)
+        {
+            int stride = layout.Joints.Length * BVHMotionData.JOINT_STRIDE;
+            if ((long)numFrames * stride > int.MaxValue)
+                throw new InvalidDataException("Too many frames");
+
+            var rotations = new float[Math.Max(numFrames, 0) * stride];
+            int channels = layout.ChannelCount;
+            var values = new double[BVHChannelLayout.BLOCK_FRAMES * channels];
+
+            int frame = 0;
+            int count = 0;
+            while (count >= 0)
+            {
+                // parse a block of frames and convert it at once
+                int blockFrames = 0;
+                while (blockFrames < BVHChannelLayout.BLOCK_FRAMES &&
+                    (count = reader.ReadValues(values, blockFrames * channels, channels)) >= 0)
+                {
+                    if (count != channels)
+                        throw new InvalidDataException(
+                            $"Line {reader.LineNumber - 1}: {channels} values expected, but {count} found");
+                    blockFrames++;
+                }
+
+                // more frames than announced
+                if ((frame + blockFrames) * stride > rotations.Length)
+                    Array.Resize(ref rotations, Math.Max(rotations.Length * 2, (frame + blockFrames) * stride));
+
+                layout.ToRotations(values, blockFrames, rotations, frame * stride);
+                frame += blockFrames;
+            }
+
+            return new BVHMotionData(frameTime, layout.Joints, frame, rotations);
+        }
+
+        /// <summary>
+        /// reads the next line of the hierarchy
+        /// </summary>
+        private static string ReadLine(BVHTokenizer reader)
+        {
+            var line = reader.ReadLine();
+            if (line == null)
+                throw new InvalidDataException("Unexpected end of file");
+            return line;
+        }
+
+        /// <summary>
+        /// reads a bvh node from a given bvh reader
+        /// </summary>
+        /// <param name="reader">stream reader standing on the opening parantheses of a node definition</param>
+        /// <param name="idLine">line containing the name of the node</param>
+        /// <param name="depth">recursion depth of the current node</param>
+        private static BVHNode ReadNode(BVHTokenizer reader, string idLine, int depth)
+        {
+            BVHNode node = new BVHNode();
+
+            // read node type and name
+            var line = idLine.ToLower().Trim();
+            string[] tokens = line.Split(new[] { ' ', '\t' }, StringSplitOptions.RemoveEmptyEntries);
+
+            string nodeType = tokens[0];
+            string nodeName = tokens[1];
+
+            BVHNodeTypes type;
+            if (nodeType == "end" && nodeName == "site")
+            {
+                type = BVHNodeTypes.EndSite;
+            }
+            else
+            {
+                if (!Enum.TryParse<BVHNodeTypes>(nodeType, true, out type))
+                    throw new InvalidDataException($"Invalid Bvh Node Type: {nodeType}");
+            }
+
+            node.Type = type;
+            node.Name = nodeName;
+
+            // read starting curly brace {
+            ReadLine(reader);
+
+            node.Offset = ReadOffset(reader);
+
+            if (node.Type != BVHNodeTypes.EndSite)
+            {
+                node.Channels = ReadChannels(reader);
+            }
+
+
+            while (true)
+            {
+                line = ReadLine(reader).ToLower().Trim();
+
+                if (line == "}")
+                {
+                    return node;
+                }
+                else
+                {
+                    node.Children.Add(ReadNode(reader, line, depth + 1));
+                }
+            }
+        }
+
+        /// <summary>
+        /// read BVH channels definition from the current line
+        /// </summary>
+        private static BVHChannels[] ReadChannels(BVHTokenizer reader)
+        {
+            string line = ReadLine(reader).ToLower().Trim();
+            string[] tokens = line.Split(new[] { ' ', '\t' }, StringSplitOptions.RemoveEmptyEntries);
+
+            if (tokens[0] != "channels")
+                throw new InvalidDataException("Expected CHANNELS keyword");
+
+            int numChannels = Int32.Parse(tokens[1]);
+
+            if (tokens.Length != numChannels + 2)
+                throw new InvalidDataException(
+                    $"Invalid CHANNELs Definition: {numChannels} expected, but {tokens.Length - 2} found");
+
+            BVHChannels[] channels = new BVHChannels[numChannels];
+            for (int i = 0; i < numChannels; i++)
+            {
+                if (!Enum.TryParse<BVHChannels>(tokens[i + 2], true, out channels[i]))
+                    throw new InvalidDataException($"Invalid channel: {tokens[i + 2]}");
+            }
+
+            return channels;
+        }
+
+        /// <summary>
+        /// reads the OFFSET definition line of a bvh file
+        /// </summary>
+        private static Vector3D ReadOffset(BVHTokenizer reader)
+        {
+            string line = ReadLine(reader).ToLower().Trim();
+            string[] tokens = line.Split(new[] { ' ', '\t' }, StringSplitOptions.RemoveEmptyEntries);
+
+            if (tokens[0] != "offset")
+                throw new InvalidDataException("Expected OFFSET keyword");
+            if (tokens.Length != 4)
+                throw new InvalidDataException("OFFSET Definiton: Invalid number of values");
+
+            double x, y, z;
+            if (!Double.TryParse(tokens[1], NumberStyles.Float, CultureInfo.InvariantCulture, out x))
+                throw new InvalidDataException("Could not parse OFFSET definition x-component");
+            if (!Double.TryParse(tokens[2], NumberStyles.Float, CultureInfo.InvariantCulture, out y))
+                throw new InvalidDataException("Could not parse OFFSET definition y-component");
+            if (!Double.TryParse(tokens[3], NumberStyles.Float, CultureInfo.InvariantCulture, out z))
+                throw new InvalidDataException("Could not parse OFFSET definition z-component");
+
+
+            return new Vector3D(x, y, z);
+        }
+
+        /// <summary>
+        /// Writes a BVH motion data file
+        /// </summary>
+        public static void WriteBvh(string file, BVHNode root, BVHMotionData motionData)
+        {
+            using (var stream = new FileStream(file, FileMode.Create, FileAccess.Write, FileShare.None, 1 << 16))
+            {
+                var writer = new StreamWriter(stream);
+                writer.WriteLine("HIERARCHY");
+                WriteBvhNode(root, writer, 0);
+                writer.WriteLine("MOTION");
+
+                writer.WriteLine($"Frames: {motionData.FrameCount}");
+                writer.WriteLine("Frame Time: " + motionData.FrameTime.ToString(CultureInfo.InvariantCulture));
+                writer.Flush();
+
+                // frame data is formatted in blocks and written straight to the file
+                BVHParallelWriter.WriteMotionData(stream, motionData);
+            }
+        }
+
+        /// <summary>
+        /// recursively write a BVH node an all its children to .Type == BVHNodeTypes.EndSitedata file
+        /// </summary>
+        private static void WriteBvhNode(BVHNode node, StreamWriter writer, int level)
+        {
+            // name and type
+            for (int i = 0; i < level - 1; ++i)
+                writer.Write("\t");
+
+            if (node.Type == BVHNodeTypes.EndSite) // end sites have no name
+                writer.WriteLine($"{GetTypeString(node.Type)}");
+            else
+                writer.WriteLine($"{GetTypeString(node.Type)} {node.Name}");
+
+            // open curly bracket
+            for (int i = 0; i < level - 1; ++i)
+                writer.Write("\t");
+            writer.WriteLine("{");
+
+            // node offset
+            for (int i = 0; i < level; ++i)
+                writer.Write("\t");
+            writer.WriteLine(string.Format(CultureInfo.InvariantCulture, "OFFSET {0} {1} {2}",
+                node.Offset.X, node.Offset.Y, node.Offset.Z));
+
+            if (node.Type != BVHNodeTypes.EndSite)
+            {
+                // defined channels
+                for (int i = 0; i < level; ++i)
+                    writer.Write("\t");
+                writer.Write($"CHANNELS {node.Channels.Length} ");
+
+                foreach (var chan in node.Channels)
+                    writer.Write(chan.ToString() + " ");
+                writer.Write(Environment.NewLine);
+
+                // child nodes
+                foreach (var child in node.Children)
+                    WriteBvhNode(child, writer, level + 1);
+            }
+
+            // closing curly bracket
+            for (int i = 0; i < level - 1; ++i)
+                writer.Write("\t");
+            writer.WriteLine("}");
+        }
+
+        private static string GetTypeString(BVHNodeTypes type)
+        {
+            switch (type)
+            {
+                case BVHNodeTypes.Root:
+                    return "ROOT";
+                case BVHNodeTypes.Joint:
+                    return "JOINT";
+                case BVHNodeTypes.EndSite:
+                    return "End Site";
+                default:
+                    throw new InvalidOperationException("Invalid node type");
+            }
+        }
+    }
+}
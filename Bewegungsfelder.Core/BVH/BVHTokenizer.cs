@@ -0,0 +1,356 @@
+﻿/*
+Part of Bewegungsfelder
+
+MIT-License
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using System;
+using System.Collections.Generic;
+using System.Globalization;
+using System.IO;
+using System.Linq;
+using System.Text;
+using System.Threading.Tasks;
+
+namespace Bewegungsfelder.BVH
+{
+    /// <summary>
+    /// reads a bvh file through a reused byte buffer.
+    /// hierarchy lines are returned as strings, frame values are parsed in place without allocations.
+    /// </summary>
+    class BVHTokenizer : IDisposable
+    {
+        private const int BUFFER_SIZE = 1 << 16;
+
+        // numbers are parsed in place if they are shorter than this
+        private const int MAX_NUMBER_LENGTH = 64;
+
+        // powers of ten that are exactly representable as double
+        private static readonly double[] POWERS_OF_TEN =
+        {
+            1e0, 1e1, 1e2, 1e3, 1e4, 1e5, 1e6, 1e7, 1e8, 1e9, 1e10, 1e11,
+            1e12, 1e13, 1e14, 1e15, 1e16, 1e17, 1e18, 1e19, 1e20, 1e21, 1e22,
+        };
+
+        // the buffer of the last reader on this thread, reused by the next one
+        [ThreadStatic]
+        private static byte[] cachedBuffer;
+
+        private readonly Stream stream;
+        private byte[] buffer;
+
+        // stream position of the first byte in buffer
+        private long bufferOffset;
+        private int position;
+        private int end;
+        private bool endOfStream;
+
+        // number of bytes left to read from the stream
+        private long remainingLength;
+
+        /// <summary>
+        /// number of the line being read, starting at 1
+        /// </summary>
+        public int LineNumber { get; set; } = 1;
+
+        /// <summary>
+        /// stream position of the next byte to be read
+        /// </summary>
+        public long Offset { get { return bufferOffset + position; } }
+
+        public BVHTokenizer(Stream stream)
+            : this(stream, long.MaxValue)
+        {
+        }
+
+        /// <summary>
+        /// reads at most length bytes from the stream
+        /// </summary>
+        public BVHTokenizer(Stream stream, long length)
+        {
+            this.stream = stream;
+            remainingLength = length;
+            buffer = cachedBuffer ?? new byte[BUFFER_SIZE];
+            cachedBuffer = null;
+        }
+
+        /// <summary>
+        /// reads the next line, without line break.
+        /// </summary>
+        /// <returns>null at the end of the file</returns>
+        public string ReadLine()
+        {
+            int scanned = 0;
+            while (true)
+            {
+                int newline = Array.IndexOf(buffer, (byte)'\n', position + scanned, end - position - scanned);
+                if (newline >= 0)
+                {
+                    var line = Decode(position, newline - position);
+                    position = newline + 1;
+                    LineNumber++;
+                    return line;
+                }
+
+                scanned = end - position;
+                if (!Fill())
+                {
+                    if (position == end)
+                        return null;
+
+                    var last = Decode(position, end - position);
+                    position = end;
+                    return last;
+                }
+            }
+        }
+
+        /// <summary>
+        /// parses the values of the next line that isn't empty into values, starting at offset.
+        /// </summary>
+        /// <param name="length">maximum number of values in the line</param>
+        /// <returns>number of values read, -1 at the end of the file</returns>
+        public int ReadValues(double[] values, int offset, int length)
+        {
+            int count = 0;
+
+            // work on locals, the buffer is only refilled when a number could cross its end
+            var data = buffer;
+            int p = position;
+            int e = end;
+            while (true)
+            {
+                if (e - p < MAX_NUMBER_LENGTH && !endOfStream)
+                {
+                    position = p;
+                    Fill();
+                    data = buffer;
+                    p = position;
+                    e = end;
+                }
+
+                if (p == e)
+                {
+                    position = p;
+                    return count > 0 ? count : -1;
+                }
+
+                byte b = data[p];
+                if (b == '\n')
+                {
+                    p++;
+                    LineNumber++;
+                    if (count > 0)
+                    {
+                        position = p;
+                        return count;
+                    }
+                }
+                else if (b == ' ' || b == '\t' || b == '\r')
+                {
+                    p++;
+                }
+                else
+                {
+                    if (count == length)
+                        throw new InvalidDataException($"Line {LineNumber}: more than {length} values");
+
+                    if (!TryParseNumber(data, ref p, e, endOfStream, out values[offset + count]))
+                    {
+                        position = p;
+                        values[offset + count] = ReadNumberSlow();
+                        data = buffer;
+                        p = position;
+                        e = end;
+                    }
+                    count++;
+                }
+            }
+        }
+
+        public void Dispose()
+        {
+            if (buffer.Length == BUFFER_SIZE)
+                cachedBuffer = buffer;
+            buffer = null;
+        }
+
+        /// <summary>
+        /// parses a decimal number starting at p. digits beyond the precision of a long are dropped.
+        /// </summary>
+        /// <param name="final">true if no more data follows e</param>
+        /// <returns>false if the number has to be parsed by ReadNumberSlow. p is not moved in this case</returns>
+        private static bool TryParseNumber(byte[] data, ref int p, int e, bool final, out double value)
+        {
+            int start = p;
+            bool negative = false;
+            if (data[p] == '-' || data[p] == '+')
+            {
+                negative = data[p] == '-';
+                p++;
+            }
+
+            long mantissa = 0;
+            int digits = 0;
+            int exponent = 0;
+            bool hasDigits = false;
+            uint d;
+
+            while (p < e && (d = (uint)(data[p] - '0')) <= 9)
+            {
+                if (digits < 18)
+                {
+                    mantissa = mantissa * 10 + d;
+                    if (mantissa != 0)
+                        digits++;
+                }
+                else
+                {
+                    exponent++;
+                }
+                hasDigits = true;
+                p++;
+            }
+
+            if (p < e && data[p] == '.')
+            {
+                p++;
+                while (p < e && (d = (uint)(data[p] - '0')) <= 9)
+                {
+                    if (digits < 18)
+                    {
+                        mantissa = mantissa * 10 + d;
+                        if (mantissa != 0)
+                            digits++;
+                        exponent--;
+                    }
+                    hasDigits = true;
+                    p++;
+                }
+            }
+
+            if (hasDigits && p < e && (data[p] | 0x20) == 'e')
+            {
+                p++;
+                bool negativeExponent = false;
+                if (p < e && (data[p] == '-' || data[p] == '+'))
+                {
+                    negativeExponent = data[p] == '-';
+                    p++;
+                }
+
+                int exponentValue = 0;
+                bool hasExponent = false;
+                while (p < e && (d = (uint)(data[p] - '0')) <= 9)
+                {
+                    if (exponentValue < 10000)
+                        exponentValue = exponentValue * 10 + (int)d;
+                    hasExponent = true;
+                    p++;
+                }
+
+                if (!hasExponent)
+                    hasDigits = false;
+                exponent += negativeExponent ? -exponentValue : exponentValue;
+            }
+
+            // anything else (nan, inf, overlong numbers) is left to double.Parse
+            if (!hasDigits || (p < e && !IsSeparator(data[p])) || (p == e && !final))
+            {
+                p = start;
+                value = 0;
+                return false;
+            }
+
+            double result = mantissa;
+            if (exponent < 0)
+                result = exponent >= -22 ? result / POWERS_OF_TEN[-exponent] : result * Math.Pow(10, exponent);
+            else if (exponent > 0)
+                result = exponent <= 22 ? result * POWERS_OF_TEN[exponent] : result * Math.Pow(10, exponent);
+
+            value = negative ? -result : result;
+            return true;
+        }
+
+        private double ReadNumberSlow()
+        {
+            var token = new StringBuilder();
+            while ((position < end || Fill()) && !IsSeparator(buffer[position]))
+            {
+                token.Append((char)buffer[position++]);
+            }
+
+            double value;
+            if (!double.TryParse(token.ToString(), NumberStyles.Float, CultureInfo.InvariantCulture, out value))
+                throw new InvalidDataException($"Line {LineNumber}: invalid number {token}");
+
+            return value;
+        }
+
+        private static bool IsSeparator(byte b)
+        {
+            return b == ' ' || b == '\t' || b == '\r' || b == '\n';
+        }
+
+        /// <summary>
+        /// moves the unread bytes to the start of the buffer and reads more.
+        /// the buffer grows if it is full
+        /// </summary>
+        /// <returns>false if no more bytes could be read</returns>
+        private bool Fill()
+        {
+            if (endOfStream)
+                return false;
+
+            int remaining = end - position;
+            if (remaining == buffer.Length)
+                Array.Resize(ref buffer, buffer.Length * 2);
+            else if (position > 0)
+                Buffer.BlockCopy(buffer, position, buffer, 0, remaining);
+
+            bufferOffset += position;
+            position = 0;
+            end = remaining;
+
+            int read = stream.Read(buffer, end, (int)Math.Min(buffer.Length - end, remainingLength));
+            if (read == 0)
+            {
+                endOfStream = true;
+                return false;
+            }
+
+            end += read;
+            remainingLength -= read;
+            return true;
+        }
+
+        private string Decode(int start, int length)
+        {
+            if (length > 0 && buffer[start + length - 1] == '\r')
+                length--;
+
+            var line = Encoding.UTF8.GetString(buffer, start, length);
+
+            // skip the byte order mark
+            return LineNumber == 1 ? line.TrimStart('\uFEFF') : line;
+        }
+    }
+}
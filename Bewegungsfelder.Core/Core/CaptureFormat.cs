@@ -0,0 +1,204 @@
+﻿/*
+Part of Bewegungsfelder
+
+MIT-License
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using Bewegungsfelder.Utilities;
+using System;
+using System.Collections.Generic;
+using System.IO;
+using System.Linq;
+using System.Text;
+using System.Threading.Tasks;
+
+namespace Bewegungsfelder.Core
+{
+    /// <summary>
+    /// chunk types of a capture file
+    /// </summary>
+    public enum CaptureChunkType
+    {
+        /// <summary>
+        /// the recorded skeleton. applies to all following frame chunks
+        /// </summary>
+        Skeleton = 1,
+
+        /// <summary>
+        /// raw sensor values of a single sensor
+        /// </summary>
+        Samples = 2,
+
+        /// <summary>
+        /// solved joint rotations
+        /// </summary>
+        Frames = 3,
+
+        /// <summary>
+        /// the trailing index of all chunks
+        /// </summary>
+        Index = 4,
+
+        /// <summary>
+        /// solved joint rotations, compressed with CompressedMotionData
+        /// </summary>
+        CompressedFrames = 5,
+    }
+
+    /// <summary>
+    /// layout of the append-only capture files written while recording.
+    /// all values are little endian, chunks start at multiples of 8 bytes so
+    /// a memory mapped file can be read in place.
+    ///
+    /// file header (16 bytes):
+    ///   uint32 magic "BFCP", uint16 version, uint16 reserved, int64 creation time (DateTime.ToBinary)
+    ///
+    /// followed by chunks (24 byte header + payload padded to 8 bytes):
+    ///   uint16 type, uint16 reserved, int32 id, uint32 count, uint32 payload length,
+    ///   uint32 crc of the first 16 header bytes and the payload, uint32 reserved
+    ///
+    /// chunk payloads:
+    ///   Skeleton: float64 fps, int32 bone count, int32 joint count,
+    ///     bone count * { int32 parent, int32 joint, float32 offset[3], uint16 name length, utf8 name },
+    ///     bones in depth first order. joint is the index in the frames or -1 for end sites
+    ///   Samples: id = sensor id, count * SAMPLE_LENGTH byte { int64 arrival time (DateTime.ToBinary),
+    ///     uint32 sensor timestamp, int32 sequence, float32 quat w/x/y/z, float32 accel[3], float32 gyro[3] }
+    ///   Frames: id = index of the first frame, count * { int64 time (DateTime.ToBinary),
+    ///     joint count * float32 rotation w/x/y/z }
+    ///   CompressedFrames: id = index of the first frame, int64 time of the first frame (DateTime.ToBinary),
+    ///     (count - 1) * microseconds since the previous frame (see Write7BitEncoded),
+    ///     the frames written by CompressedMotionData.Write.
+    ///     version 1 stored count * int32 ticks since the first frame instead of the microseconds
+    ///   Index: count * INDEX_ENTRY_LENGTH byte { uint16 type, uint16 reserved, int32 id, uint32 count,
+    ///     uint32 reserved, int64 chunk offset, int64 time of the first record or 0 }
+    ///
+    /// the file ends with a trailer (16 bytes) if it was closed properly:
+    ///   int64 offset of the index chunk, uint32 magic "BFIX", uint32 reserved
+    /// a file without trailer is read by scanning the chunks until the first invalid one.
+    /// </summary>
+    public static class CaptureFormat
+    {
+        public const uint FILE_MAGIC = 0x50434642; // "BFCP"
+        public const uint TRAILER_MAGIC = 0x58494642; // "BFIX"
+        public const int VERSION = 2;
+
+        public const string FILE_EXTENSION = ".bfcap";
+
+        public const int FILE_HEADER_LENGTH = 16;
+        public const int CHUNK_HEADER_LENGTH = 24;
+        public const int TRAILER_LENGTH = 16;
+        public const int ALIGNMENT = 8;
+
+        public const int SAMPLE_LENGTH = 56;
+        public const int INDEX_ENTRY_LENGTH = 32;
+
+        public const long TICKS_PER_MICROSECOND = TimeSpan.TicksPerMillisecond / 1000;
+
+        /// <summary>
+        /// bytes of a frame record with the given number of joints
+        /// </summary>
+        public static int GetFrameLength(int jointCount)
+        {
+            return sizeof(long) + jointCount * MotionData.JOINT_STRIDE * sizeof(float);
+        }
+
+        /// <summary>
+        /// writes an unsigned value with 7 bits per byte, low bits first.
+        /// the high bit of a byte is set if more bytes follow
+        /// </summary>
+        public static void Write7BitEncoded(BinaryWriter writer, ulong value)
+        {
+            while (value >= 0x80)
+            {
+                writer.Write((byte)(value | 0x80));
+                value >>= 7;
+            }
+            writer.Write((byte)value);
+        }
+
+        /// <summary>
+        /// reads a value written by Write7BitEncoded
+        /// </summary>
+        public static ulong Read7BitEncoded(BinaryReader reader)
+        {
+            ulong value = 0;
+            for (int shift = 0; shift < 64; shift += 7)
+            {
+                byte b = reader.ReadByte();
+                value |= (ulong)(b & 0x7f) << shift;
+                if (b < 0x80)
+                    return value;
+            }
+            throw new InvalidDataException("Invalid 7 bit encoded value");
+        }
+
+        /// <summary>
+        /// rounds a length up to the chunk alignment
+        /// </summary>
+        public static int Align(int length)
+        {
+            return (length + ALIGNMENT - 1) & ~(ALIGNMENT - 1);
+        }
+
+        /// <summary>
+        /// writes a chunk header for the payload that follows it in buffer
+        /// </summary>
+        public static void WriteChunkHeader(byte[] buffer, int offset, CaptureChunkType type, int id,
+            int count, int payloadLength)
+        {
+            WriteUInt16(buffer, offset, (ushort)type);
+            WriteUInt16(buffer, offset + 2, 0);
+            WriteInt32(buffer, offset + 4, id);
+            WriteInt32(buffer, offset + 8, count);
+            WriteInt32(buffer, offset + 12, payloadLength);
+            WriteUInt32(buffer, offset + 16, ComputeChunkCrc(buffer, offset, payloadLength));
+            WriteUInt32(buffer, offset + 20, 0);
+        }
+
+        /// <summary>
+        /// computes the crc of a chunk header and its payload
+        /// </summary>
+        public static uint ComputeChunkCrc(byte[] buffer, int offset, int payloadLength)
+        {
+            uint crc = Crc32.Compute(buffer, offset, 16);
+            return Crc32.Append(crc, buffer, offset + CHUNK_HEADER_LENGTH, payloadLength);
+        }
+
+        public static void WriteUInt16(byte[] buffer, int offset, ushort value)
+        {
+            buffer[offset] = (byte)value;
+            buffer[offset + 1] = (byte)(value >> 8);
+        }
+
+        public static void WriteUInt32(byte[] buffer, int offset, uint value)
+        {
+            buffer[offset] = (byte)value;
+            buffer[offset + 1] = (byte)(value >> 8);
+            buffer[offset + 2] = (byte)(value >> 16);
+            buffer[offset + 3] = (byte)(value >> 24);
+        }
+
+        public static void WriteInt32(byte[] buffer, int offset, int value)
+        {
+            WriteUInt32(buffer, offset, (uint)value);
+        }
+    }
+}
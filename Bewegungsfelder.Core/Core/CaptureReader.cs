@@ -0,0 +1,635 @@
+﻿/*
+Part of Bewegungsfelder
+
+MIT-License
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using Bewegungsfelder.Utilities;
+using System;
+using System.Collections.Generic;
+using System.IO;
+using System.IO.MemoryMappedFiles;
+using System.Linq;
+using System.Text;
+using System.Threading.Tasks;
+using Bewegungsfelder.Mathematics;
+
+namespace Bewegungsfelder.Core
+{
+    /// <summary>
+    /// random access to a capture file written by CaptureWriter.
+    /// the file is memory mapped through a sliding view, only the chunk headers are read on open
+    /// and frames are decoded when requested. the crc of a chunk listed in the index is verified
+    /// when the chunk is first accessed, corrupted chunks are treated like dropped ones. not thread safe.
+    /// </summary>
+    public class CaptureReader : IDisposable
+    {
+        // size of the mapped window into the file
+        public const long VIEW_SIZE = 64 << 20;
+
+        // views must start at multiples of the allocation granularity
+        private const long VIEW_ALIGNMENT = 1 << 16;
+
+        // frames per block of the frame index
+        private const int INDEX_BLOCK_FRAMES = CaptureWriter.FRAMES_PER_CHUNK;
+
+        private enum ChunkState : byte
+        {
+            Unverified,
+            Valid,
+            Corrupted,
+        }
+
+        private struct FrameChunk
+        {
+            public long Offset;
+            public int First;
+            public int Count;
+            public int Skeleton;
+            public bool Compressed;
+            public ChunkState State;
+        }
+
+        private struct SampleChunk
+        {
+            public long Offset;
+            public long First;
+            public int Count;
+            public ChunkState State;
+        }
+
+        private readonly MemoryMappedFile file;
+        private readonly long fileLength;
+
+        private MemoryMappedViewAccessor view;
+        private long viewStart;
+        private long viewEnd;
+
+        private readonly List<CaptureSkeleton> skeletons = new List<CaptureSkeleton>();
+        private readonly List<FrameChunk> frameChunks = new List<FrameChunk>();
+        private readonly Dictionary<int, List<SampleChunk>> sampleChunks = new Dictionary<int, List<SampleChunk>>();
+
+        // index of the first frame chunk that ends after the start of each block
+        private int[] frameBlocks;
+
+        private readonly int version;
+
+        // the last compressed frame chunk that was decoded
+        private int compressedChunk = -1;
+        private CompressedMotionData compressedFrames;
+        private DateTime[] compressedTimes;
+
+        public string Path { get; }
+
+        /// <summary>
+        /// the time the capture was started
+        /// </summary>
+        public DateTime Created { get; }
+
+        /// <summary>
+        /// false if the file was not closed properly and its chunks were recovered by scanning
+        /// </summary>
+        public bool IsComplete { get; }
+
+        /// <summary>
+        /// number of frames including frames of dropped chunks
+        /// </summary>
+        public int FrameCount { get; }
+
+        /// <summary>
+        /// frame rate of the first skeleton
+        /// </summary>
+        public double FPS { get { return skeletons.Count > 0 ? skeletons[0].FPS : 0; } }
+
+        /// <summary>
+        /// all skeletons in the order they were recorded
+        /// </summary>
+        public IReadOnlyList<CaptureSkeleton> Skeletons { get { return skeletons; } }
+
+        /// <summary>
+        /// ids of all sensors with recorded values
+        /// </summary>
+        public IEnumerable<int> SensorIds { get { return sampleChunks.Keys; } }
+
+        /// <summary>
+        /// opens a capture file. only the header, the index and the skeletons are read
+        /// unless the file has no valid index, in which case all chunks are scanned and verified.
+        /// </summary>
+        public CaptureReader(string path)
+        {
+            Path = path;
+            fileLength = new FileInfo(path).Length;
+            if (fileLength < CaptureFormat.FILE_HEADER_LENGTH)
+                throw new InvalidDataException("Not a capture file");
+
+            file = MemoryMappedFile.CreateFromFile(path, FileMode.Open, null, 0, MemoryMappedFileAccess.Read);
+            try
+            {
+                if (ReadUInt32(0) != CaptureFormat.FILE_MAGIC)
+                    throw new InvalidDataException("Not a capture file");
+                version = ReadUInt16(4);
+                if (version < 1 || version > CaptureFormat.VERSION)
+                    throw new InvalidDataException("Unsupported capture file version");
+
+                Created = DateTime.FromBinary(ReadInt64(8));
+
+                IsComplete = ReadIndex();
+                if (!IsComplete)
+                    ScanChunks();
+
+                if (frameChunks.Count > 0)
+                {
+                    var last = frameChunks[frameChunks.Count - 1];
+                    FrameCount = last.First + last.Count;
+                }
+                BuildFrameIndex();
+            }
+            catch
+            {
+                Dispose();
+                throw;
+            }
+        }
+
+        /// <summary>
+        /// returns the skeleton of a frame or null if the frame was dropped while capturing or is corrupted
+        /// </summary>
+        public CaptureSkeleton GetSkeleton(int frame)
+        {
+            int chunk = FindFrameChunk(frame);
+            return chunk >= 0 ? skeletons[frameChunks[chunk].Skeleton] : null;
+        }
+
+        /// <summary>
+        /// returns the time a frame was recorded
+        /// </summary>
+        public DateTime GetFrameTime(int frame)
+        {
+            int index = FindFrameChunk(frame);
+            if (index < 0)
+                throw new InvalidOperationException("Frame was dropped while capturing");
+
+            var chunk = frameChunks[index];
+            if (chunk.Compressed)
+            {
+                GetCompressedFrames(index);
+                return compressedTimes[frame - chunk.First];
+            }
+
+            return DateTime.FromBinary(ReadInt64(GetFrameOffset(frame)));
+        }
+
+        /// <summary>
+        /// reads the joint rotations of a frame as w,x,y,z per joint (see MotionData.Read).
+        /// </summary>
+        /// <param name="destination">receives JointCount * MotionData.JOINT_STRIDE values
+        /// of the frame's skeleton</param>
+        /// <returns>false if the frame was dropped while capturing or is corrupted</returns>
+        public bool ReadFrame(int frame, float[] destination)
+        {
+            int chunk = FindFrameChunk(frame);
+            if (chunk < 0)
+                return false;
+
+            int count = skeletons[frameChunks[chunk].Skeleton].JointCount * MotionData.JOINT_STRIDE;
+            if (destination.Length < count)
+                throw new ArgumentException("Destination is too small for the frame", nameof(destination));
+
+            if (frameChunks[chunk].Compressed)
+            {
+                GetCompressedFrames(chunk).ReadFrame(frame - frameChunks[chunk].First, destination, 0);
+                return true;
+            }
+
+            long offset = GetFrameOffset(frame) + sizeof(long);
+            EnsureView(offset, count * sizeof(float));
+            view.ReadArray(offset - viewStart, destination, 0, count);
+            return true;
+        }
+
+        /// <summary>
+        /// number of recorded values of a sensor
+        /// </summary>
+        public long GetSampleCount(int sensorId)
+        {
+            List<SampleChunk> chunks;
+            if (!sampleChunks.TryGetValue(sensorId, out chunks) || chunks.Count == 0)
+                return 0;
+
+            var last = chunks[chunks.Count - 1];
+            return last.First + last.Count;
+        }
+
+        /// <summary>
+        /// reads a recorded value of a sensor, indexed in recording order.
+        /// throws InvalidDataException if the chunk of the value is corrupted
+        /// </summary>
+        public SensorValue ReadSample(int sensorId, long index)
+        {
+            List<SampleChunk> chunks;
+            if (!sampleChunks.TryGetValue(sensorId, out chunks))
+                throw new ArgumentException("No values recorded for this sensor", nameof(sensorId));
+            if (index < 0 || index >= GetSampleCount(sensorId))
+                throw new ArgumentOutOfRangeException(nameof(index));
+
+            // last chunk starting at or before index
+            int lo = 0, hi = chunks.Count - 1;
+            while (lo < hi)
+            {
+                int mid = (lo + hi + 1) / 2;
+                if (chunks[mid].First <= index)
+                    lo = mid;
+                else
+                    hi = mid - 1;
+            }
+
+            var chunk = chunks[lo];
+            if (chunk.State == ChunkState.Unverified)
+            {
+                chunk.State = VerifyChunk(chunk.Offset);
+                chunks[lo] = chunk;
+            }
+            if (chunk.State == ChunkState.Corrupted)
+                throw new InvalidDataException("Recorded value is corrupted");
+
+            long offset = chunk.Offset + CaptureFormat.CHUNK_HEADER_LENGTH
+                + (index - chunk.First) * CaptureFormat.SAMPLE_LENGTH;
+            EnsureView(offset, CaptureFormat.SAMPLE_LENGTH);
+            long p = offset - viewStart;
+
+            var arrival = DateTime.FromBinary(view.ReadInt64(p));
+            uint timestamp = view.ReadUInt32(p + 8);
+            int sequence = view.ReadInt32(p + 12);
+            var quat = new Quaternion(view.ReadSingle(p + 20), view.ReadSingle(p + 24),
+                view.ReadSingle(p + 28), view.ReadSingle(p + 16));
+            var accel = new Vector3D(view.ReadSingle(p + 32), view.ReadSingle(p + 36), view.ReadSingle(p + 40));
+            var gyro = new Vector3D(view.ReadSingle(p + 44), view.ReadSingle(p + 48), view.ReadSingle(p + 52));
+
+            return new SensorValue(quat, accel, gyro, arrival, timestamp, sequence);
+        }
+
+        public void Dispose()
+        {
+            view?.Dispose();
+            view = null;
+            file?.Dispose();
+        }
+
+        /// <summary>
+        /// reads the chunk list from the trailing index
+        /// </summary>
+        /// <returns>false if the file has no valid index</returns>
+        private bool ReadIndex()
+        {
+            if (fileLength < CaptureFormat.FILE_HEADER_LENGTH + CaptureFormat.CHUNK_HEADER_LENGTH
+                + CaptureFormat.TRAILER_LENGTH)
+                return false;
+
+            long trailer = fileLength - CaptureFormat.TRAILER_LENGTH;
+            if (ReadUInt32(trailer + 8) != CaptureFormat.TRAILER_MAGIC)
+                return false;
+
+            long indexOffset = ReadInt64(trailer);
+            if (indexOffset < CaptureFormat.FILE_HEADER_LENGTH || indexOffset > trailer - CaptureFormat.CHUNK_HEADER_LENGTH)
+                return false;
+
+            int length = ReadInt32(indexOffset + 12);
+            if ((CaptureChunkType)ReadUInt16(indexOffset) != CaptureChunkType.Index
+                || length < 0 || indexOffset + CaptureFormat.CHUNK_HEADER_LENGTH + length != trailer
+                || !IsValidChunk(indexOffset, length))
+                return false;
+
+            int count = ReadInt32(indexOffset + 8);
+            if (count < 0 || (long)count * CaptureFormat.INDEX_ENTRY_LENGTH > length)
+                return false;
+
+            long entry = indexOffset + CaptureFormat.CHUNK_HEADER_LENGTH;
+            for (int i = 0; i < count; i++, entry += CaptureFormat.INDEX_ENTRY_LENGTH)
+            {
+                AddChunk((CaptureChunkType)ReadUInt16(entry), ReadInt32(entry + 4), ReadInt32(entry + 8),
+                    ReadInt64(entry + 16), ChunkState.Unverified);
+            }
+
+            return true;
+        }
+
+        /// <summary>
+        /// reads all chunks up to the first incomplete or corrupted one
+        /// </summary>
+        private void ScanChunks()
+        {
+            long offset = CaptureFormat.FILE_HEADER_LENGTH;
+            while (offset + CaptureFormat.CHUNK_HEADER_LENGTH <= fileLength)
+            {
+                var type = (CaptureChunkType)ReadUInt16(offset);
+                int count = ReadInt32(offset + 8);
+                int length = ReadInt32(offset + 12);
+
+                if (length < 0 || length % CaptureFormat.ALIGNMENT != 0
+                    || offset + CaptureFormat.CHUNK_HEADER_LENGTH + length > fileLength
+                    || !IsValidChunk(offset, length))
+                    break;
+
+                if (type == CaptureChunkType.Index)
+                    break;
+
+                AddChunk(type, ReadInt32(offset + 4), count, offset, ChunkState.Valid);
+                offset += CaptureFormat.CHUNK_HEADER_LENGTH + length;
+            }
+        }
+
+        private void AddChunk(CaptureChunkType type, int id, int count, long offset, ChunkState state)
+        {
+            switch (type)
+            {
+                case CaptureChunkType.Skeleton:
+                    skeletons.Add(ReadSkeleton(offset));
+                    break;
+                case CaptureChunkType.Frames:
+                case CaptureChunkType.CompressedFrames:
+                    if (skeletons.Count == 0)
+                        break; // frames without skeleton can't be interpreted
+
+                    frameChunks.Add(new FrameChunk
+                    {
+                        Offset = offset,
+                        First = id,
+                        Count = count,
+                        Skeleton = skeletons.Count - 1,
+                        Compressed = type == CaptureChunkType.CompressedFrames,
+                        State = state,
+                    });
+                    break;
+                case CaptureChunkType.Samples:
+                    List<SampleChunk> chunks;
+                    if (!sampleChunks.TryGetValue(id, out chunks))
+                    {
+                        chunks = new List<SampleChunk>();
+                        sampleChunks.Add(id, chunks);
+                    }
+
+                    long first = GetSampleCount(id);
+                    chunks.Add(new SampleChunk { Offset = offset, First = first, Count = count, State = state });
+                    break;
+            }
+        }
+
+        private CaptureSkeleton ReadSkeleton(long offset)
+        {
+            long p = offset + CaptureFormat.CHUNK_HEADER_LENGTH;
+            double fps = ReadDouble(p);
+            int count = ReadInt32(p + 8);
+            int jointCount = ReadInt32(p + 12);
+            p += 16;
+
+            var names = new string[count];
+            var parents = new int[count];
+            var joints = new int[count];
+            var offsets = new Vector3D[count];
+            for (int i = 0; i < count; i++)
+            {
+                parents[i] = ReadInt32(p);
+                joints[i] = ReadInt32(p + 4);
+                offsets[i] = new Vector3D(ReadSingle(p + 8), ReadSingle(p + 12), ReadSingle(p + 16));
+                int nameLength = ReadUInt16(p + 20);
+                p += 22;
+
+                var name = new byte[nameLength];
+                EnsureView(p, nameLength);
+                view.ReadArray(p - viewStart, name, 0, nameLength);
+                names[i] = Encoding.UTF8.GetString(name);
+                p += nameLength;
+
+                if (parents[i] >= i || (parents[i] < 0 && i > 0) || joints[i] >= jointCount)
+                    throw new InvalidDataException("Invalid skeleton in capture file");
+            }
+
+            return new CaptureSkeleton(fps, jointCount, names, parents, joints, offsets);
+        }
+
+        private void BuildFrameIndex()
+        {
+            frameBlocks = new int[(FrameCount + INDEX_BLOCK_FRAMES - 1) / INDEX_BLOCK_FRAMES];
+
+            int chunk = 0;
+            for (int block = 0; block < frameBlocks.Length; block++)
+            {
+                int start = block * INDEX_BLOCK_FRAMES;
+                while (chunk < frameChunks.Count && frameChunks[chunk].First + frameChunks[chunk].Count <= start)
+                    chunk++;
+
+                frameBlocks[block] = chunk;
+            }
+        }
+
+        /// <summary>
+        /// returns the frame chunk containing a frame or -1 if the frame was dropped or is corrupted
+        /// </summary>
+        private int FindFrameChunk(int frame)
+        {
+            if (frame < 0 || frame >= FrameCount)
+                throw new ArgumentOutOfRangeException(nameof(frame));
+
+            // chunks hold up to one block of frames, so this only skips short chunks
+            int chunk = frameBlocks[frame / INDEX_BLOCK_FRAMES];
+            while (chunk < frameChunks.Count && frameChunks[chunk].First + frameChunks[chunk].Count <= frame)
+                chunk++;
+
+            if (chunk == frameChunks.Count || frameChunks[chunk].First > frame)
+                return -1;
+
+            var found = frameChunks[chunk];
+            if (found.State == ChunkState.Unverified)
+            {
+                found.State = VerifyChunk(found.Offset);
+                frameChunks[chunk] = found;
+            }
+
+            return found.State == ChunkState.Valid ? chunk : -1;
+        }
+
+        /// <summary>
+        /// returns the file offset of a frame record or -1 if the frame was dropped
+        /// </summary>
+        private long GetFrameOffset(int frame)
+        {
+            int index = FindFrameChunk(frame);
+            if (index < 0)
+                return -1;
+
+            var chunk = frameChunks[index];
+            int frameLength = CaptureFormat.GetFrameLength(skeletons[chunk.Skeleton].JointCount);
+            return chunk.Offset + CaptureFormat.CHUNK_HEADER_LENGTH + (long)(frame - chunk.First) * frameLength;
+        }
+
+        /// <summary>
+        /// decodes the frame times and the header of a compressed frame chunk into compressedTimes
+        /// and compressedFrames. the frames are decoded on access
+        /// </summary>
+        private CompressedMotionData GetCompressedFrames(int index)
+        {
+            if (index == compressedChunk)
+                return compressedFrames;
+
+            var chunk = frameChunks[index];
+            long offset = chunk.Offset + CaptureFormat.CHUNK_HEADER_LENGTH;
+            int length = ReadInt32(chunk.Offset + 12);
+            if (chunk.Count <= 0 || length <= 0)
+                throw new InvalidDataException("Invalid compressed frame chunk");
+
+            var payload = new byte[length];
+            EnsureView(offset, length);
+            view.ReadArray(offset - viewStart, payload, 0, length);
+
+            var times = new DateTime[chunk.Count];
+            CompressedMotionData frames;
+            try
+            {
+                var reader = new BinaryReader(new MemoryStream(payload));
+                var first = DateTime.FromBinary(reader.ReadInt64());
+                if (version == 1)
+                {
+                    for (int i = 0; i < times.Length; i++)
+                        times[i] = first.AddTicks(reader.ReadInt32());
+                }
+                else
+                {
+                    long micros = 0;
+                    times[0] = first;
+                    for (int i = 1; i < times.Length; i++)
+                    {
+                        micros += (long)CaptureFormat.Read7BitEncoded(reader);
+                        times[i] = first.AddTicks(micros * CaptureFormat.TICKS_PER_MICROSECOND);
+                    }
+                }
+
+                frames = CompressedMotionData.Read(reader);
+            }
+            catch (EndOfStreamException)
+            {
+                throw new InvalidDataException("Invalid compressed frame chunk");
+            }
+
+            if (frames.FrameCount != chunk.Count || frames.JointCount != skeletons[chunk.Skeleton].JointCount)
+                throw new InvalidDataException("Invalid compressed frame chunk");
+
+            compressedChunk = index;
+            compressedFrames = frames;
+            compressedTimes = times;
+            return frames;
+        }
+
+        /// <summary>
+        /// checks the length and the crc of a chunk listed in the index
+        /// </summary>
+        private ChunkState VerifyChunk(long offset)
+        {
+            if (offset < CaptureFormat.FILE_HEADER_LENGTH || offset + CaptureFormat.CHUNK_HEADER_LENGTH > fileLength)
+                return ChunkState.Corrupted;
+
+            int length = ReadInt32(offset + 12);
+            if (length < 0 || offset + CaptureFormat.CHUNK_HEADER_LENGTH + length > fileLength)
+                return ChunkState.Corrupted;
+
+            return IsValidChunk(offset, length) ? ChunkState.Valid : ChunkState.Corrupted;
+        }
+
+        /// <summary>
+        /// verifies the crc of a chunk
+        /// </summary>
+        private bool IsValidChunk(long offset, int payloadLength)
+        {
+            var buffer = new byte[Math.Min(payloadLength, 1 << 16) + CaptureFormat.CHUNK_HEADER_LENGTH];
+
+            EnsureView(offset, CaptureFormat.CHUNK_HEADER_LENGTH);
+            view.ReadArray(offset - viewStart, buffer, 0, CaptureFormat.CHUNK_HEADER_LENGTH);
+            uint expected = BitConverter.ToUInt32(buffer, 16);
+            uint crc = Crc32.Compute(buffer, 0, 16);
+
+            long p = offset + CaptureFormat.CHUNK_HEADER_LENGTH;
+            long end = p + payloadLength;
+            while (p < end)
+            {
+                int count = (int)Math.Min(buffer.Length, end - p);
+                EnsureView(p, count);
+                view.ReadArray(p - viewStart, buffer, 0, count);
+                crc = Crc32.Append(crc, buffer, 0, count);
+                p += count;
+            }
+
+            return crc == expected;
+        }
+
+        /// <summary>
+        /// maps the view so it contains the given range of the file
+        /// </summary>
+        private void EnsureView(long offset, int length)
+        {
+            if (offset < 0 || offset + length > fileLength)
+                throw new InvalidDataException("Capture file is truncated");
+
+            if (view != null && offset >= viewStart && offset + length <= viewEnd)
+                return;
+
+            view?.Dispose();
+            viewStart = offset & ~(VIEW_ALIGNMENT - 1);
+            long size = Math.Min(Math.Max(VIEW_SIZE, offset + length - viewStart), fileLength - viewStart);
+            view = file.CreateViewAccessor(viewStart, size, MemoryMappedFileAccess.Read);
+            viewEnd = viewStart + size;
+        }
+
+        private ushort ReadUInt16(long offset)
+        {
+            EnsureView(offset, sizeof(ushort));
+            return view.ReadUInt16(offset - viewStart);
+        }
+
+        private int ReadInt32(long offset)
+        {
+            EnsureView(offset, sizeof(int));
+            return view.ReadInt32(offset - viewStart);
+        }
+
+        private uint ReadUInt32(long offset)
+        {
+            EnsureView(offset, sizeof(uint));
+            return view.ReadUInt32(offset - viewStart);
+        }
+
+        private long ReadInt64(long offset)
+        {
+            EnsureView(offset, sizeof(long));
+            return view.ReadInt64(offset - viewStart);
+        }
+
+        private float ReadSingle(long offset)
+        {
+            EnsureView(offset, sizeof(float));
+            return view.ReadSingle(offset - viewStart);
+        }
+
+        private double ReadDouble(long offset)
+        {
+            EnsureView(offset, sizeof(double));
+            return view.ReadDouble(offset - viewStart);
+        }
+    }
+}
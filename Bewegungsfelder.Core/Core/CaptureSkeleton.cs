@@ -0,0 +1,92 @@
+﻿/*
+Part of Bewegungsfelder
+
+MIT-License
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Text;
+using System.Threading.Tasks;
+using Bewegungsfelder.Mathematics;
+
+namespace Bewegungsfelder.Core
+{
+    /// <summary>
+    /// a skeleton chunk read from a capture file.
+    /// bones are in depth first order, the root bone is at index 0
+    /// </summary>
+    public class CaptureSkeleton
+    {
+        /// <summary>
+        /// frame rate of the recording
+        /// </summary>
+        public double FPS { get; }
+
+        /// <summary>
+        /// number of joints stored per frame
+        /// </summary>
+        public int JointCount { get; }
+
+        public int Count { get { return Names.Length; } }
+
+        public string[] Names { get; }
+
+        /// <summary>
+        /// index of the parent of each bone, -1 for the root bone
+        /// </summary>
+        public int[] Parents { get; }
+
+        /// <summary>
+        /// the joint index of each bone in the frames, -1 if the bone isn't recorded
+        /// </summary>
+        public int[] Joints { get; }
+
+        public Vector3D[] Offsets { get; }
+
+        public CaptureSkeleton(double fps, int jointCount, string[] names, int[] parents, int[] joints,
+            Vector3D[] offsets)
+        {
+            FPS = fps;
+            JointCount = jointCount;
+            Names = names;
+            Parents = parents;
+            Joints = joints;
+            Offsets = offsets;
+        }
+
+        /// <summary>
+        /// creates the bone tree. the returned bones have the same order as the skeleton
+        /// </summary>
+        public Bone[] CreateBones()
+        {
+            var bones = new Bone[Count];
+            for (int i = 0; i < Count; i++)
+            {
+                var parent = Parents[i] >= 0 ? bones[Parents[i]] : null;
+                bones[i] = new Bone(parent, Names[i], Offsets[i]);
+                parent?.Children.Add(bones[i]);
+            }
+            return bones;
+        }
+    }
+}
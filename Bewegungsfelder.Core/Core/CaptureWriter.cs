@@ -0,0 +1,571 @@
+﻿/*
+Part of Bewegungsfelder
+
+MIT-License
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using System;
+using System.Collections.Concurrent;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.IO;
+using System.Linq;
+using System.Text;
+using System.Threading;
+using System.Threading.Tasks;
+
+namespace Bewegungsfelder.Core
+{
+    /// <summary>
+    /// streams sensor values and recorded frames to a capture file (see CaptureFormat).
+    /// values are collected in chunks which are written by a background thread,
+    /// so at most one flush interval of data is lost if the application crashes.
+    /// all methods are thread safe. every sensor fills its own chunk under its own lock,
+    /// so ingest workers appending samples of different sensors don't contend.
+    /// </summary>
+    public class CaptureWriter : IDisposable
+    {
+        public const int SAMPLES_PER_CHUNK = 256;
+        public const int FRAMES_PER_CHUNK = 64;
+
+        // chunks waiting for the disk. further chunks are dropped if the disk can't keep up
+        public const int MAX_PENDING_CHUNKS = 1024;
+
+        // partially filled chunks are written after this time
+        public static readonly TimeSpan FLUSH_INTERVAL = TimeSpan.FromSeconds(1);
+
+        /// <summary>
+        /// a chunk that is being filled or waits to be written.
+        /// the stream starts with space for the chunk header
+        /// </summary>
+        private class Chunk
+        {
+            public readonly MemoryStream Stream = new MemoryStream();
+            public readonly BinaryWriter Writer;
+            public CaptureChunkType Type;
+            public int Id;
+            public int Count;
+            public long Time;
+
+            // rotations of compressed frame chunks, compressed when the chunk is written
+            public float[] Frames;
+            public int JointCount;
+
+            // time of the last compressed frame in microseconds since the first one
+            public long FrameMicros;
+
+            public Chunk()
+            {
+                Writer = new BinaryWriter(Stream);
+            }
+
+            public void Begin(CaptureChunkType type, int id, long time)
+            {
+                Type = type;
+                Id = id;
+                Time = time;
+                Count = 0;
+                Stream.SetLength(CaptureFormat.CHUNK_HEADER_LENGTH);
+                Stream.Position = CaptureFormat.CHUNK_HEADER_LENGTH;
+            }
+        }
+
+        /// <summary>
+        /// the samples chunk of a sensor that is being filled
+        /// </summary>
+        private class SampleStream
+        {
+            public readonly object Padlock = new object();
+
+            // guarded by Padlock
+            public Chunk Chunk;
+        }
+
+        private struct IndexEntry
+        {
+            public CaptureChunkType Type;
+            public int Id;
+            public int Count;
+            public long Offset;
+            public long Time;
+        }
+
+        // guards the frames
+        private readonly object padlock = new object();
+
+        private readonly FileStream file;
+        private readonly Thread writerThread;
+        private readonly BlockingCollection<Chunk> sealedChunks = new BlockingCollection<Chunk>();
+
+        // guarded by itself
+        private readonly Stack<Chunk> freeChunks = new Stack<Chunk>();
+
+        private readonly ConcurrentDictionary<int, SampleStream> sampleStreams = new ConcurrentDictionary<int, SampleStream>();
+        private readonly Func<int, SampleStream> createSampleStream = id => new SampleStream();
+
+        // frame chunk being filled, guarded by padlock
+        private Chunk frameChunk;
+        private int frameCount;
+        private int frameJointCount = -1;
+
+        private long droppedChunks;
+
+        // set under padlock, then every sample stream is sealed once more
+        private volatile bool closed;
+
+        // only used by the writer thread
+        private readonly List<IndexEntry> index = new List<IndexEntry>();
+        private volatile Exception error;
+
+        /// <summary>
+        /// the path of the capture file
+        /// </summary>
+        public string Path { get; }
+
+        /// <summary>
+        /// number of frames appended so far
+        /// </summary>
+        public int FrameCount { get { lock (padlock) { return frameCount; } } }
+
+        /// <summary>
+        /// number of chunks that were dropped because the disk couldn't keep up
+        /// </summary>
+        public long DroppedChunks { get { return Interlocked.Read(ref droppedChunks); } }
+
+        /// <summary>
+        /// the exception that stopped writing the file, null as long as writing succeeds
+        /// </summary>
+        public Exception Error { get { return error; } }
+
+        /// <summary>
+        /// maximum angle in radians between a recorded and a compressed joint rotation.
+        /// 0 if frames are written uncompressed
+        /// </summary>
+        public double MaxFrameError { get; }
+
+        /// <summary>
+        /// creates a new capture file. fails if the file already exists
+        /// </summary>
+        /// <param name="maxFrameError">frames are compressed within this angle in radians, 0 to disable.
+        /// otherwise at least CompressedMotionData.MIN_MAX_ERROR</param>
+        public CaptureWriter(string path, double maxFrameError = 0)
+        {
+            if (maxFrameError != 0 && !(maxFrameError >= CompressedMotionData.MIN_MAX_ERROR))
+                throw new ArgumentOutOfRangeException(nameof(maxFrameError));
+
+            Path = path;
+            MaxFrameError = maxFrameError;
+            file = new FileStream(path, FileMode.CreateNew, FileAccess.Write, FileShare.Read, 1 << 16);
+
+            var header = new byte[CaptureFormat.FILE_HEADER_LENGTH];
+            CaptureFormat.WriteUInt32(header, 0, CaptureFormat.FILE_MAGIC);
+            CaptureFormat.WriteUInt16(header, 4, CaptureFormat.VERSION);
+            Array.Copy(BitConverter.GetBytes(DateTime.Now.ToBinary()), 0, header, 8, sizeof(long));
+            try
+            {
+                file.Write(header, 0, header.Length);
+                file.Flush();
+            }
+            catch
+            {
+                file.Dispose();
+                throw;
+            }
+
+            writerThread = new Thread(WriteLoop);
+            writerThread.Name = "Capture Writer";
+            writerThread.IsBackground = true;
+            writerThread.Start();
+        }
+
+        /// <summary>
+        /// writes the skeleton of the following frames.
+        /// </summary>
+        /// <param name="skeleton">all bones of the recorded kinematic, including end sites</param>
+        /// <param name="motion">defines the joint order and fps of the frames</param>
+        public void WriteSkeleton(CompiledSkeleton skeleton, MotionData motion)
+        {
+            lock (padlock)
+            {
+                if (closed)
+                    throw new ObjectDisposedException(nameof(CaptureWriter));
+
+                // frames of the previous skeleton are complete
+                if (frameChunk != null)
+                    SealFrames();
+
+                var chunk = RentChunk(CaptureChunkType.Skeleton, 0, 0);
+                var writer = chunk.Writer;
+                writer.Write(motion.FPS);
+                writer.Write(skeleton.Count);
+                writer.Write(motion.JointCount);
+                for (int i = 0; i < skeleton.Count; i++)
+                {
+                    var bone = skeleton.Bones[i];
+                    var name = Encoding.UTF8.GetBytes(bone.Name ?? "");
+
+                    writer.Write(skeleton.Parents[i]);
+                    writer.Write(motion.IndexOf(bone));
+                    writer.Write((float)bone.Offset.X);
+                    writer.Write((float)bone.Offset.Y);
+                    writer.Write((float)bone.Offset.Z);
+                    writer.Write((ushort)name.Length);
+                    writer.Write(name);
+                }
+                chunk.Count = skeleton.Count;
+                Seal(chunk);
+
+                frameJointCount = motion.JointCount;
+            }
+        }
+
+        /// <summary>
+        /// appends a frame returned by MotionData.AddFrame.
+        /// the joint count must match the last skeleton written
+        /// </summary>
+        public void AppendFrame(DateTime time, ArraySegment<float> frame)
+        {
+            lock (padlock)
+            {
+                if (closed)
+                    throw new ObjectDisposedException(nameof(CaptureWriter));
+                if (frame.Count != frameJointCount * MotionData.JOINT_STRIDE)
+                    throw new InvalidOperationException("Frame doesn't match the skeleton of the capture");
+
+                if (MaxFrameError > 0)
+                {
+                    AppendCompressedFrame(time, frame);
+                }
+                else
+                {
+                    if (frameChunk == null)
+                        frameChunk = RentChunk(CaptureChunkType.Frames, frameCount, time.ToBinary());
+
+                    var writer = frameChunk.Writer;
+                    writer.Write(time.ToBinary());
+                    var data = frame.Array;
+                    int end = frame.Offset + frame.Count;
+                    for (int i = frame.Offset; i < end; i++)
+                    {
+                        writer.Write(data[i]);
+                    }
+                }
+
+                ++frameCount;
+                if (++frameChunk.Count == FRAMES_PER_CHUNK)
+                    SealFrames();
+            }
+        }
+
+        /// <summary>
+        /// stores the time and the rotations of a frame for compression. must be called holding padlock
+        /// </summary>
+        private void AppendCompressedFrame(DateTime time, ArraySegment<float> frame)
+        {
+            // frame times are stored as microseconds since the previous frame, mostly two bytes.
+            // they are rounded relative to the first frame of the chunk, so the error doesn't add up
+            long micros = 0;
+            if (frameChunk != null)
+            {
+                micros = (time.Ticks - DateTime.FromBinary(frameChunk.Time).Ticks) / CaptureFormat.TICKS_PER_MICROSECOND;
+                if (micros < frameChunk.FrameMicros)
+                {
+                    // the clock was set back
+                    SealFrames();
+                }
+            }
+
+            if (frameChunk == null)
+            {
+                frameChunk = RentChunk(CaptureChunkType.CompressedFrames, frameCount, time.ToBinary());
+                frameChunk.JointCount = frameJointCount;
+                frameChunk.FrameMicros = 0;
+                if (frameChunk.Frames == null || frameChunk.Frames.Length < FRAMES_PER_CHUNK * frame.Count)
+                    frameChunk.Frames = new float[FRAMES_PER_CHUNK * frame.Count];
+                frameChunk.Writer.Write(time.ToBinary());
+            }
+            else
+            {
+                CaptureFormat.Write7BitEncoded(frameChunk.Writer, (ulong)(micros - frameChunk.FrameMicros));
+                frameChunk.FrameMicros = micros;
+            }
+
+            Array.Copy(frame.Array, frame.Offset, frameChunk.Frames, frameChunk.Count * frame.Count, frame.Count);
+        }
+
+        /// <summary>
+        /// appends a raw sensor value. values appended after the writer was closed are ignored
+        /// </summary>
+        public void AppendSample(int sensorId, SensorValue value)
+        {
+            SampleStream stream;
+            if (!sampleStreams.TryGetValue(sensorId, out stream))
+                stream = sampleStreams.GetOrAdd(sensorId, createSampleStream);
+
+            lock (stream.Padlock)
+            {
+                if (closed)
+                    return;
+
+                var chunk = stream.Chunk;
+                if (chunk == null)
+                    chunk = stream.Chunk = RentChunk(CaptureChunkType.Samples, sensorId, value.ArrivalTime.ToBinary());
+
+                var writer = chunk.Writer;
+                writer.Write(value.ArrivalTime.ToBinary());
+                writer.Write(value.SensorTimestamp);
+                writer.Write(value.Sequence);
+                writer.Write((float)value.Orientation.W);
+                writer.Write((float)value.Orientation.X);
+                writer.Write((float)value.Orientation.Y);
+                writer.Write((float)value.Orientation.Z);
+                writer.Write((float)value.Acceleration.X);
+                writer.Write((float)value.Acceleration.Y);
+                writer.Write((float)value.Acceleration.Z);
+                writer.Write((float)value.Gyro.X);
+                writer.Write((float)value.Gyro.Y);
+                writer.Write((float)value.Gyro.Z);
+
+                if (++chunk.Count == SAMPLES_PER_CHUNK)
+                {
+                    stream.Chunk = null;
+                    Seal(chunk);
+                }
+            }
+        }
+
+        /// <summary>
+        /// writes all pending chunks and the index and closes the file
+        /// </summary>
+        public void Dispose()
+        {
+            lock (padlock)
+            {
+                if (closed)
+                    return;
+
+                closed = true;
+            }
+
+            // no more chunks are started, seal the partially filled ones
+            SealAll();
+            sealedChunks.CompleteAdding();
+
+            writerThread.Join();
+
+            try
+            {
+                if (error == null)
+                {
+                    WriteIndex();
+                    file.Flush(true);
+                }
+            }
+            catch (Exception e)
+            {
+                error = e;
+                Debug.WriteLine($"Writing the index of {Path} failed: {e.Message}");
+            }
+            finally
+            {
+                file.Dispose();
+                sealedChunks.Dispose();
+            }
+        }
+
+        private Chunk RentChunk(CaptureChunkType type, int id, long time)
+        {
+            Chunk chunk;
+            lock (freeChunks)
+            {
+                chunk = freeChunks.Count > 0 ? freeChunks.Pop() : new Chunk();
+            }
+            chunk.Begin(type, id, time);
+            return chunk;
+        }
+
+        private void ReturnChunk(Chunk chunk)
+        {
+            lock (freeChunks)
+            {
+                freeChunks.Push(chunk);
+            }
+        }
+
+        /// <summary>
+        /// queues a chunk for writing. the caller must own the chunk,
+        /// i.e. hold the lock of the frames or the sample stream it was filled under
+        /// </summary>
+        private void Seal(Chunk chunk)
+        {
+            // the skeleton is needed to read the following frames and is never dropped
+            if (sealedChunks.Count >= MAX_PENDING_CHUNKS && chunk.Type != CaptureChunkType.Skeleton)
+            {
+                Interlocked.Increment(ref droppedChunks);
+                ReturnChunk(chunk);
+                return;
+            }
+
+            sealedChunks.Add(chunk);
+        }
+
+        /// <summary>
+        /// queues the frame chunk being filled. must be called holding padlock
+        /// </summary>
+        private void SealFrames()
+        {
+            var chunk = frameChunk;
+            frameChunk = null;
+            Seal(chunk);
+        }
+
+        /// <summary>
+        /// queues all partially filled chunks. takes the locks one at a time
+        /// </summary>
+        private void SealAll()
+        {
+            lock (padlock)
+            {
+                if (frameChunk != null)
+                    SealFrames();
+            }
+
+            foreach (var stream in sampleStreams.Values)
+            {
+                lock (stream.Padlock)
+                {
+                    if (stream.Chunk != null)
+                    {
+                        Seal(stream.Chunk);
+                        stream.Chunk = null;
+                    }
+                }
+            }
+        }
+
+        private void WriteLoop()
+        {
+            var sinceSeal = Stopwatch.StartNew();
+            int timeout = (int)FLUSH_INTERVAL.TotalMilliseconds;
+
+            while (!sealedChunks.IsCompleted)
+            {
+                Chunk chunk;
+                if (sealedChunks.TryTake(out chunk, timeout))
+                {
+                    WriteChunk(chunk);
+                    ReturnChunk(chunk);
+                }
+
+                // partially filled chunks of slow sensors reach the disk as well.
+                // once closed, Dispose seals them before it completes the queue
+                if (!closed && sinceSeal.Elapsed >= FLUSH_INTERVAL)
+                {
+                    SealAll();
+                    sinceSeal.Restart();
+                }
+            }
+        }
+
+        /// <summary>
+        /// completes the header of a chunk and writes it to the file. writer thread only.
+        /// never throws, the first failure is stored in error and the following chunks are discarded
+        /// </summary>
+        private void WriteChunk(Chunk chunk)
+        {
+            if (error != null)
+                return; // the file is broken, discard
+
+            try
+            {
+                var stream = chunk.Stream;
+                if (chunk.Type == CaptureChunkType.CompressedFrames)
+                {
+                    CompressedMotionData.Compress(chunk.Frames, chunk.Count, chunk.JointCount, MaxFrameError)
+                        .Write(chunk.Writer);
+                }
+
+                while (stream.Length % CaptureFormat.ALIGNMENT != 0)
+                    stream.WriteByte(0);
+
+                var buffer = stream.GetBuffer();
+                int length = (int)stream.Length;
+                CaptureFormat.WriteChunkHeader(buffer, 0, chunk.Type, chunk.Id, chunk.Count,
+                    length - CaptureFormat.CHUNK_HEADER_LENGTH);
+
+                if (chunk.Type != CaptureChunkType.Index)
+                {
+                    index.Add(new IndexEntry
+                    {
+                        Type = chunk.Type,
+                        Id = chunk.Id,
+                        Count = chunk.Count,
+                        Offset = file.Position,
+                        Time = chunk.Time,
+                    });
+                }
+
+                file.Write(buffer, 0, length);
+
+                // hand the data to the os once the queue is drained
+                if (sealedChunks.Count == 0)
+                    file.Flush();
+            }
+            catch (Exception e)
+            {
+                // e.g. compressing invalid frames. the loop keeps draining the queue,
+                // so appending and Dispose never wait for a dead writer thread
+                error = e;
+                Debug.WriteLine($"Writing {Path} failed: {e.Message}");
+            }
+        }
+
+        /// <summary>
+        /// writes the index chunk and the trailer. called after the writer thread finished
+        /// </summary>
+        private void WriteIndex()
+        {
+            var chunk = new Chunk();
+            chunk.Begin(CaptureChunkType.Index, 0, 0);
+            foreach (var entry in index)
+            {
+                chunk.Writer.Write((ushort)entry.Type);
+                chunk.Writer.Write((ushort)0);
+                chunk.Writer.Write(entry.Id);
+                chunk.Writer.Write(entry.Count);
+                chunk.Writer.Write(0);
+                chunk.Writer.Write(entry.Offset);
+                chunk.Writer.Write(entry.Time);
+            }
+            chunk.Count = index.Count;
+
+            long indexOffset = file.Position;
+            WriteChunk(chunk);
+            if (error != null)
+                return;
+
+            var trailer = new byte[CaptureFormat.TRAILER_LENGTH];
+            Array.Copy(BitConverter.GetBytes(indexOffset), 0, trailer, 0, sizeof(long));
+            CaptureFormat.WriteUInt32(trailer, 8, CaptureFormat.TRAILER_MAGIC);
+            file.Write(trailer, 0, trailer.Length);
+        }
+    }
+}
@@ -0,0 +1,171 @@
+﻿/*
+Part of Bewegungsfelder
+
+MIT-License
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Text;
+using System.Threading.Tasks;
+using Bewegungsfelder.Mathematics;
+
+namespace Bewegungsfelder.Core
+{
+    /// <summary>
+    /// flat representation of a bone tree.
+    /// bones are stored in depth first order so every parent comes before its children,
+    /// world rotations and transforms are computed in a single pass over the arrays.
+    /// </summary>
+    public class CompiledSkeleton
+    {
+        private readonly Dictionary<Bone, int> indices;
+
+        /// <summary>
+        /// number of bones
+        /// </summary>
+        public int Count { get; }
+
+        /// <summary>
+        /// all bones in depth first order. the root bone is at index 0
+        /// </summary>
+        public Bone[] Bones { get; }
+
+        /// <summary>
+        /// index of the parent of each bone, -1 for the root bone
+        /// </summary>
+        public int[] Parents { get; }
+
+        /// <summary>
+        /// local joint rotations, read from the bones by Update
+        /// </summary>
+        public Quaternion[] LocalRotations { get; }
+
+        /// <summary>
+        /// offsets to the parent joint, read from the bones by Update
+        /// </summary>
+        public Vector3D[] Offsets { get; }
+
+        /// <summary>
+        /// combined offset and joint rotation matrix of each bone
+        /// </summary>
+        public Matrix3D[] LocalTransforms { get; }
+
+        /// <summary>
+        /// combined joint rotations from the root to each bone, including the bone's own rotation
+        /// </summary>
+        public Quaternion[] WorldRotations { get; }
+
+        /// <summary>
+        /// transformation from each bone to the root bone
+        /// </summary>
+        public Matrix3D[] WorldTransforms { get; }
+
+        public CompiledSkeleton(Bone root)
+        {
+            var bones = new List<Bone>();
+            var parents = new List<int>();
+
+            // depth first, children in order
+            var stack = new Stack<KeyValuePair<Bone, int>>();
+            stack.Push(new KeyValuePair<Bone, int>(root, -1));
+            while (stack.Count > 0)
+            {
+                var item = stack.Pop();
+                int index = bones.Count;
+                bones.Add(item.Key);
+                parents.Add(item.Value);
+
+                var children = item.Key.Children;
+                for (int i = children.Count - 1; i >= 0; i--)
+                {
+                    stack.Push(new KeyValuePair<Bone, int>(children[i], index));
+                }
+            }
+
+            Count = bones.Count;
+            Bones = bones.ToArray();
+            Parents = parents.ToArray();
+            LocalRotations = new Quaternion[Count];
+            Offsets = new Vector3D[Count];
+            LocalTransforms = new Matrix3D[Count];
+            WorldRotations = new Quaternion[Count];
+            WorldTransforms = new Matrix3D[Count];
+
+            indices = new Dictionary<Bone, int>(Count);
+            for (int i = 0; i < Count; i++)
+            {
+                indices.Add(Bones[i], i);
+            }
+
+            Update();
+        }
+
+        /// <summary>
+        /// returns the index of a bone or -1 if it is not part of this skeleton
+        /// </summary>
+        public int IndexOf(Bone bone)
+        {
+            int index;
+            return indices.TryGetValue(bone, out index) ? index : -1;
+        }
+
+        /// <summary>
+        /// reads the current joint rotations and offsets from the bones and recomputes
+        /// the world rotations and transforms.
+        /// </summary>
+        public void Update()
+        {
+            for (int i = 0; i < Count; i++)
+            {
+                var bone = Bones[i];
+                LocalRotations[i] = bone.JointRotation;
+                Offsets[i] = bone.Offset;
+                LocalTransforms[i] = bone.LocalTransform;
+            }
+
+            UpdateWorld();
+        }
+
+        /// <summary>
+        /// recomputes the world rotations and transforms from the local arrays
+        /// </summary>
+        public void UpdateWorld()
+        {
+            for (int i = 0; i < Count; i++)
+            {
+                int parent = Parents[i];
+                if (parent < 0)
+                {
+                    WorldRotations[i] = LocalRotations[i];
+                    WorldTransforms[i] = LocalTransforms[i];
+                }
+                else
+                {
+                    // parents are always updated before their children
+                    WorldRotations[i] = WorldRotations[parent] * LocalRotations[i];
+                    WorldTransforms[i] = LocalTransforms[i] * WorldTransforms[parent];
+                }
+            }
+        }
+    }
+}
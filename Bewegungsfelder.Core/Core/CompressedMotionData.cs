@@ -0,0 +1,496 @@
+﻿/*
+Part of Bewegungsfelder
+
+MIT-License
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using System;
+using System.Collections.Generic;
+using System.IO;
+using System.Linq;
+using System.Text;
+using System.Threading.Tasks;
+using Bewegungsfelder.Mathematics;
+
+namespace Bewegungsfelder.Core
+{
+    /// <summary>
+    /// lossy compressed joint rotations. every joint keeps only the frames needed to stay within an angular
+    /// error when the frames in between are interpolated. the kept rotations are quantized to their three
+    /// smallest components. frames are decoded on access, sequential access is fastest. not thread safe.
+    /// </summary>
+    public class CompressedMotionData
+    {
+        public const int MIN_COMPONENT_BITS = 10;
+        public const int MAX_COMPONENT_BITS = 15;
+
+        /// <summary>
+        /// maximum number of frames between two keys of a joint
+        /// </summary>
+        public const int MAX_KEY_SPACING = 64;
+
+        // bits for the index of the dropped component
+        private const int INDEX_BITS = 2;
+
+        private static readonly double SQRT2 = Math.Sqrt(2);
+
+        /// <summary>
+        /// smallest error that can be kept with MAX_COMPONENT_BITS, in radians
+        /// </summary>
+        public static readonly double MIN_MAX_ERROR = 2 * GetQuantizationError(MAX_COMPONENT_BITS);
+
+        // first key of each joint, followed by the total number of keys
+        private readonly int[] jointKeys;
+        private readonly int[] keyFrames;
+        private readonly ulong[] keyBits;
+
+        // key used by the last access of each joint
+        private readonly int[] cursors;
+
+        private readonly int keyLength;
+
+        // decoding buffers for the keys around a frame
+        private readonly double[] rotation = new double[4];
+        private readonly double[] nextRotation = new double[4];
+
+        public int JointCount { get; }
+
+        public int FrameCount { get; }
+
+        /// <summary>
+        /// bits per quantized quaternion component
+        /// </summary>
+        public int ComponentBits { get; }
+
+        /// <summary>
+        /// number of stored rotations of all joints
+        /// </summary>
+        public int KeyCount { get { return keyFrames.Length; } }
+
+        private CompressedMotionData(int jointCount, int frameCount, int componentBits, int[] jointKeys,
+            int[] keyFrames, ulong[] keyBits)
+        {
+            JointCount = jointCount;
+            FrameCount = frameCount;
+            ComponentBits = componentBits;
+            this.jointKeys = jointKeys;
+            this.keyFrames = keyFrames;
+            this.keyBits = keyBits;
+
+            keyLength = INDEX_BITS + 3 * componentBits;
+            cursors = jointKeys.Take(jointCount).ToArray();
+        }
+
+        /// <summary>
+        /// upper bound of the angle in radians between a rotation and its quantized value
+        /// </summary>
+        public static double GetQuantizationError(int componentBits)
+        {
+            // each of the three components is off by at most half a step, the fourth follows from them
+            double step = SQRT2 / ((1 << componentBits) - 1);
+            return Math.Sqrt(6) * step;
+        }
+
+        /// <summary>
+        /// returns the smallest number of component bits whose quantization uses at most half the error.
+        /// errors below MIN_MAX_ERROR can't be kept and return MAX_COMPONENT_BITS
+        /// </summary>
+        public static int GetComponentBits(double maxError)
+        {
+            int bits = MIN_COMPONENT_BITS;
+            while (bits < MAX_COMPONENT_BITS && GetQuantizationError(bits) > maxError / 2)
+                bits++;
+            return bits;
+        }
+
+        /// <summary>
+        /// compresses all frames of the motion data
+        /// </summary>
+        /// <param name="maxError">maximum angle in radians between a decoded and the original rotation,
+        /// at least MIN_MAX_ERROR</param>
+        public static CompressedMotionData Compress(MotionData motionData, double maxError)
+        {
+            return Compress(motionData.GetFrame, motionData.FrameCount, motionData.JointCount, maxError);
+        }
+
+        /// <summary>
+        /// compresses frames stored one after another as w,x,y,z per joint
+        /// </summary>
+        /// <param name="maxError">maximum angle in radians between a decoded and the original rotation,
+        /// at least MIN_MAX_ERROR</param>
+        public static CompressedMotionData Compress(float[] frames, int frameCount, int jointCount, double maxError)
+        {
+            int stride = jointCount * MotionData.JOINT_STRIDE;
+            if ((long)frameCount * stride > frames.Length)
+                throw new ArgumentException("Not enough frame data", nameof(frames));
+
+            return Compress(frame => new ArraySegment<float>(frames, frame * stride, stride), frameCount,
+                jointCount, maxError);
+        }
+
+        private static CompressedMotionData Compress(Func<int, ArraySegment<float>> getFrame, int frameCount,
+            int jointCount, double maxError)
+        {
+            if (!(maxError >= MIN_MAX_ERROR))
+                throw new ArgumentOutOfRangeException(nameof(maxError));
+            if (frameCount == 0)
+                throw new ArgumentException("No frames to compress");
+
+            int bits = GetComponentBits(maxError);
+            double minDot = Math.Cos(maxError / 2);
+
+            var jointKeys = new int[jointCount + 1];
+            var keyFrames = new List<int>();
+            var keyCodes = new List<ulong>();
+
+            // rotations of one joint: original and quantized
+            var rotations = new double[frameCount * 4];
+            var decoded = new double[frameCount * 4];
+            var codes = new ulong[frameCount];
+            var interpolated = new double[4];
+
+            for (int j = 0; j < jointCount; j++)
+            {
+                jointKeys[j] = keyFrames.Count;
+                for (int f = 0; f < frameCount; f++)
+                {
+                    var frame = getFrame(f);
+                    int i = frame.Offset + j * MotionData.JOINT_STRIDE;
+                    Normalize(frame.Array[i], frame.Array[i + 1], frame.Array[i + 2], frame.Array[i + 3],
+                        rotations, f * 4);
+                    codes[f] = Quantize(rotations, f * 4, bits);
+                    Dequantize(codes[f], bits, decoded, f * 4);
+                }
+
+                // extend each key as far as the interpolation stays within the error
+                int start = 0;
+                keyFrames.Add(0);
+                keyCodes.Add(codes[0]);
+                while (start < frameCount - 1)
+                {
+                    int end = start + 1;
+                    int last = Math.Min(start + MAX_KEY_SPACING, frameCount - 1);
+                    while (end < last && IsWithinError(rotations, decoded, start, end + 1, minDot, interpolated))
+                        end++;
+
+                    keyFrames.Add(end);
+                    keyCodes.Add(codes[end]);
+                    start = end;
+                }
+            }
+            jointKeys[jointCount] = keyFrames.Count;
+
+            int keyLength = INDEX_BITS + 3 * bits;
+            var keyBits = new ulong[((long)keyCodes.Count * keyLength + 63) / 64];
+            for (int k = 0; k < keyCodes.Count; k++)
+            {
+                SetBits(keyBits, (long)k * keyLength, keyLength, keyCodes[k]);
+            }
+
+            return new CompressedMotionData(jointCount, frameCount, bits, jointKeys, keyFrames.ToArray(), keyBits);
+        }
+
+        /// <summary>
+        /// returns the rotation of a joint in a frame
+        /// </summary>
+        public Quaternion GetRotation(int frame, int joint)
+        {
+            Decode(frame, joint);
+            return new Quaternion(rotation[1], rotation[2], rotation[3], rotation[0]);
+        }
+
+        /// <summary>
+        /// decodes a frame as w,x,y,z per joint (see MotionData.Read)
+        /// </summary>
+        /// <param name="destination">receives JointCount * MotionData.JOINT_STRIDE values</param>
+        public void ReadFrame(int frame, float[] destination, int offset)
+        {
+            for (int j = 0; j < JointCount; j++)
+            {
+                Decode(frame, j);
+                int i = offset + j * MotionData.JOINT_STRIDE;
+                destination[i] = (float)rotation[0];
+                destination[i + 1] = (float)rotation[1];
+                destination[i + 2] = (float)rotation[2];
+                destination[i + 3] = (float)rotation[3];
+            }
+        }
+
+        /// <summary>
+        /// writes the compressed frames:
+        ///   int32 joint count, int32 frame count, uint8 component bits, uint8 reserved[3],
+        ///   joint count * int32 key count, key count * uint8 frames since the previous key of the joint,
+        ///   the keys as little endian bit stream of (INDEX_BITS + 3 * component bits) per key
+        /// </summary>
+        public void Write(BinaryWriter writer)
+        {
+            writer.Write(JointCount);
+            writer.Write(FrameCount);
+            writer.Write((byte)ComponentBits);
+            writer.Write(new byte[3]);
+
+            for (int j = 0; j < JointCount; j++)
+            {
+                writer.Write(jointKeys[j + 1] - jointKeys[j]);
+            }
+
+            for (int j = 0; j < JointCount; j++)
+            {
+                for (int k = jointKeys[j]; k < jointKeys[j + 1]; k++)
+                {
+                    writer.Write((byte)(k > jointKeys[j] ? keyFrames[k] - keyFrames[k - 1] : 0));
+                }
+            }
+
+            var bytes = new byte[GetKeyBitsLength(KeyCount, keyLength)];
+            Buffer.BlockCopy(keyBits, 0, bytes, 0, bytes.Length);
+            writer.Write(bytes);
+        }
+
+        /// <summary>
+        /// reads compressed frames written by Write
+        /// </summary>
+        public static CompressedMotionData Read(BinaryReader reader)
+        {
+            int jointCount = reader.ReadInt32();
+            int frameCount = reader.ReadInt32();
+            int bits = reader.ReadByte();
+            reader.ReadBytes(3);
+            if (jointCount < 0 || frameCount <= 0 || bits < MIN_COMPONENT_BITS || bits > MAX_COMPONENT_BITS)
+                throw new InvalidDataException("Invalid compressed motion data");
+
+            var jointKeys = new int[jointCount + 1];
+            for (int j = 0; j < jointCount; j++)
+            {
+                int count = reader.ReadInt32();
+                if (count <= 0 || count > frameCount)
+                    throw new InvalidDataException("Invalid compressed motion data");
+                jointKeys[j + 1] = jointKeys[j] + count;
+            }
+
+            var keyFrames = new int[jointKeys[jointCount]];
+            for (int j = 0; j < jointCount; j++)
+            {
+                int frame = 0;
+                for (int k = jointKeys[j]; k < jointKeys[j + 1]; k++)
+                {
+                    int delta = reader.ReadByte();
+                    if ((k > jointKeys[j]) != (delta > 0))
+                        throw new InvalidDataException("Invalid compressed motion data");
+
+                    frame += delta;
+                    keyFrames[k] = frame;
+                }
+
+                if (frame != frameCount - 1)
+                    throw new InvalidDataException("Invalid compressed motion data");
+            }
+
+            int keyLength = INDEX_BITS + 3 * bits;
+            var bytes = reader.ReadBytes(GetKeyBitsLength(keyFrames.Length, keyLength));
+            if (bytes.Length < GetKeyBitsLength(keyFrames.Length, keyLength))
+                throw new EndOfStreamException();
+            var keyBits = new ulong[(bytes.Length + 7) / 8];
+            Buffer.BlockCopy(bytes, 0, keyBits, 0, bytes.Length);
+
+            return new CompressedMotionData(jointCount, frameCount, bits, jointKeys, keyFrames, keyBits);
+        }
+
+        /// <summary>
+        /// interpolates the rotation of a joint between the keys around the frame into rotation
+        /// </summary>
+        private void Decode(int frame, int joint)
+        {
+            if (frame < 0 || frame >= FrameCount)
+                throw new ArgumentOutOfRangeException(nameof(frame));
+            if (joint < 0 || joint >= JointCount)
+                throw new ArgumentOutOfRangeException(nameof(joint));
+
+            int index = FindKey(frame, joint);
+            int start = keyFrames[index];
+            Dequantize(GetBits(keyBits, (long)index * keyLength, keyLength), ComponentBits, rotation, 0);
+            if (frame == start)
+                return;
+
+            Dequantize(GetBits(keyBits, (long)(index + 1) * keyLength, keyLength), ComponentBits, nextRotation, 0);
+            Interpolate(rotation, 0, nextRotation, 0, (double)(frame - start) / (keyFrames[index + 1] - start),
+                rotation, 0);
+        }
+
+        /// <summary>
+        /// returns the last key of the joint at or before the frame
+        /// </summary>
+        private int FindKey(int frame, int joint)
+        {
+            int first = jointKeys[joint];
+            int last = jointKeys[joint + 1] - 1;
+
+            // sequential playback stays at the same key or moves to the next one
+            int index = cursors[joint];
+            if (keyFrames[index] <= frame && (index == last || keyFrames[index + 1] > frame))
+                return index;
+            if (index < last && keyFrames[index + 1] <= frame && (index + 1 == last || keyFrames[index + 2] > frame))
+                return cursors[joint] = index + 1;
+
+            int lo = first, hi = last;
+            while (lo < hi)
+            {
+                int mid = (lo + hi + 1) / 2;
+                if (keyFrames[mid] <= frame)
+                    lo = mid;
+                else
+                    hi = mid - 1;
+            }
+
+            return cursors[joint] = lo;
+        }
+
+        /// <summary>
+        /// checks the frames between two keys against the interpolation of the quantized keys
+        /// </summary>
+        private static bool IsWithinError(double[] rotations, double[] decoded, int start, int end, double minDot,
+            double[] interpolated)
+        {
+            for (int f = start + 1; f < end; f++)
+            {
+                Interpolate(decoded, start * 4, decoded, end * 4, (double)(f - start) / (end - start),
+                    interpolated, 0);
+
+                int i = f * 4;
+                double dot = interpolated[0] * rotations[i] + interpolated[1] * rotations[i + 1]
+                    + interpolated[2] * rotations[i + 2] + interpolated[3] * rotations[i + 3];
+                if (Math.Abs(dot) < minDot)
+                    return false;
+            }
+
+            return true;
+        }
+
+        /// <summary>
+        /// normalized linear interpolation along the shorter arc
+        /// </summary>
+        private static void Interpolate(double[] a, int aOffset, double[] b, int bOffset, double t,
+            double[] result, int offset)
+        {
+            double dot = a[aOffset] * b[bOffset] + a[aOffset + 1] * b[bOffset + 1]
+                + a[aOffset + 2] * b[bOffset + 2] + a[aOffset + 3] * b[bOffset + 3];
+            double tb = dot < 0 ? -t : t;
+            double ta = 1 - t;
+
+            double w = ta * a[aOffset] + tb * b[bOffset];
+            double x = ta * a[aOffset + 1] + tb * b[bOffset + 1];
+            double y = ta * a[aOffset + 2] + tb * b[bOffset + 2];
+            double z = ta * a[aOffset + 3] + tb * b[bOffset + 3];
+            Normalize(w, x, y, z, result, offset);
+        }
+
+        private static void Normalize(double w, double x, double y, double z, double[] result, int offset)
+        {
+            double length = Math.Sqrt(w * w + x * x + y * y + z * z);
+            if (length == 0 || double.IsNaN(length))
+            {
+                w = 1;
+                x = y = z = 0;
+                length = 1;
+            }
+
+            result[offset] = w / length;
+            result[offset + 1] = x / length;
+            result[offset + 2] = y / length;
+            result[offset + 3] = z / length;
+        }
+
+        /// <summary>
+        /// packs a unit quaternion (w,x,y,z) as the index of its largest component and the other three
+        /// components. the sign is chosen so the largest component is positive
+        /// </summary>
+        private static ulong Quantize(double[] rotation, int offset, int bits)
+        {
+            int largest = 0;
+            for (int i = 1; i < 4; i++)
+            {
+                if (Math.Abs(rotation[offset + i]) > Math.Abs(rotation[offset + largest]))
+                    largest = i;
+            }
+
+            double sign = rotation[offset + largest] < 0 ? -1 : 1;
+            double scale = (1UL << bits) - 1;
+            ulong code = 0;
+            for (int i = 3; i >= 0; i--)
+            {
+                if (i == largest)
+                    continue;
+
+                // the other components are within +-1/sqrt(2)
+                double value = (sign * rotation[offset + i] * SQRT2 + 1) / 2 * scale;
+                code = (code << bits) | (ulong)Math.Max(0, Math.Min(scale, Math.Round(value)));
+            }
+
+            return (code << INDEX_BITS) | (uint)largest;
+        }
+
+        private static void Dequantize(ulong code, int bits, double[] rotation, int offset)
+        {
+            ulong mask = (1UL << bits) - 1;
+            double scale = mask;
+            int largest = (int)(code & 3);
+            code >>= INDEX_BITS;
+
+            double sum = 0;
+            for (int i = 0; i < 4; i++)
+            {
+                if (i == largest)
+                    continue;
+
+                double value = ((code & mask) / scale * 2 - 1) / SQRT2;
+                rotation[offset + i] = value;
+                sum += value * value;
+                code >>= bits;
+            }
+
+            rotation[offset + largest] = Math.Sqrt(Math.Max(0, 1 - sum));
+        }
+
+        private static int GetKeyBitsLength(int keyCount, int keyLength)
+        {
+            return (int)(((long)keyCount * keyLength + 7) / 8);
+        }
+
+        private static void SetBits(ulong[] bits, long position, int length, ulong value)
+        {
+            int word = (int)(position >> 6);
+            int shift = (int)(position & 63);
+            bits[word] |= value << shift;
+            if (shift + length > 64)
+                bits[word + 1] |= value >> (64 - shift);
+        }
+
+        private static ulong GetBits(ulong[] bits, long position, int length)
+        {
+            int word = (int)(position >> 6);
+            int shift = (int)(position & 63);
+            ulong value = bits[word] >> shift;
+            if (shift + length > 64)
+                value |= bits[word + 1] << (64 - shift);
+            return value & ((1UL << length) - 1);
+        }
+    }
+}
@@ -0,0 +1,328 @@
+﻿/*
+Part of Bewegungsfelder
+
+MIT-License
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using Bewegungsfelder.Utilities;
+using System;
+using System.Collections.Concurrent;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.Linq;
+using System.Net;
+using System.Text;
+using System.Threading;
+using System.Threading.Tasks;
+
+namespace Bewegungsfelder.Core
+{
+    /// <summary>
+    /// decodes received datagrams on multiple worker threads.
+    /// datagrams are sharded by sensor id, so all values of a sensor are decoded
+    /// and pushed by the same worker. the receiving thread only copies the datagram
+    /// into a free buffer of the worker and queues it. values decoded elsewhere,
+    /// e.g. by the websocket server, are queued to the worker of their sensor as well.
+    /// </summary>
+    public class IngestPipeline
+    {
+        /// <summary>
+        /// udp payload of a single ethernet frame. longer datagrams are dropped
+        /// </summary>
+        public const int MAX_DATAGRAM_LENGTH = 1472;
+
+        // number of datagrams that can be queued per worker
+        private const int QUEUE_CAPACITY = 1024;
+
+        private readonly Worker[] workers;
+
+        private long dropped = 0;
+
+        public int WorkerCount { get { return workers.Length; } }
+
+        /// <summary>
+        /// number of datagrams and values dropped because the worker queue was full
+        /// </summary>
+        public long Dropped { get { return Interlocked.Read(ref dropped); } }
+
+        /// <summary>
+        /// number of datagrams and values whose decoding or pushing threw an exception
+        /// </summary>
+        public long Failed
+        {
+            get
+            {
+                long sum = 0;
+                for (int i = 0; i < workers.Length; i++)
+                    sum += Interlocked.Read(ref workers[i].Failed);
+                return sum;
+            }
+        }
+
+        /// <summary>
+        /// total number of values decoded by all workers
+        /// </summary>
+        public long DecodedValues
+        {
+            get
+            {
+                long sum = 0;
+                for (int i = 0; i < workers.Length; i++)
+                    sum += Interlocked.Read(ref workers[i].DecodedValues);
+                return sum;
+            }
+        }
+
+        /// <param name="workerCount">number of worker threads</param>
+        /// <param name="getSensor">returns the sensor for an id and source address.
+        /// called concurrently by the workers</param>
+        public IngestPipeline(int workerCount, Func<int, IPAddress, Sensor> getSensor)
+        {
+            if (workerCount < 1)
+                throw new ArgumentOutOfRangeException(nameof(workerCount));
+
+            workers = new Worker[workerCount];
+            for (int i = 0; i < workerCount; i++)
+            {
+                workers[i] = new Worker(i, getSensor);
+            }
+        }
+
+        /// <summary>
+        /// queues a datagram for decoding. the buffer can be reused once this returns.
+        /// must only be called by a single receiving thread.
+        /// </summary>
+        /// <returns>false if the datagram was dropped</returns>
+        public bool Post(byte[] buffer, int length, IPEndPoint source, DateTime arrivalTime)
+        {
+            int sensorId;
+            if (length > MAX_DATAGRAM_LENGTH || !SensorPacket.TryGetSensorId(buffer, length, out sensorId))
+            {
+                Debug.WriteLine($"Dropped invalid datagram ({length} bytes) from {source}");
+                return false;
+            }
+
+            var worker = workers[(uint)sensorId % (uint)workers.Length];
+            if (!worker.Post(buffer, length, source, arrivalTime))
+            {
+                Interlocked.Increment(ref dropped);
+                return false;
+            }
+
+            return true;
+        }
+
+        /// <summary>
+        /// queues a value that was already decoded, e.g. received by the websocket server.
+        /// it is pushed by the worker that owns the sensor id. thread safe
+        /// </summary>
+        /// <returns>false if the value was dropped</returns>
+        public bool Post(int sensorId, IPAddress source, SensorValue value)
+        {
+            var worker = workers[(uint)sensorId % (uint)workers.Length];
+            if (!worker.Post(sensorId, source, value))
+            {
+                Interlocked.Increment(ref dropped);
+                return false;
+            }
+
+            return true;
+        }
+
+        private struct Datagram
+        {
+            public byte[] Buffer;
+            public int Length;
+            public IPEndPoint Source;
+            public DateTime ArrivalTime;
+        }
+
+        private struct DecodedValue
+        {
+            public int SensorId;
+            public IPAddress Source;
+            public SensorValue Value;
+        }
+
+        private class Worker
+        {
+            // datagrams to decode, from the receiving thread to the worker
+            private readonly SpscQueue<Datagram> pending = new SpscQueue<Datagram>(QUEUE_CAPACITY);
+
+            // buffers returned by the worker after decoding
+            private readonly SpscQueue<byte[]> free = new SpscQueue<byte[]>(QUEUE_CAPACITY);
+
+            // values decoded by other threads, any number of producers
+            private readonly ConcurrentQueue<DecodedValue> decoded = new ConcurrentQueue<DecodedValue>();
+
+            private readonly ManualResetEventSlim signal = new ManualResetEventSlim(false);
+
+            private readonly List<SensorValue> values = new List<SensorValue>(byte.MaxValue);
+
+            private readonly Func<int, IPAddress, Sensor> getSensor;
+
+            public long DecodedValues = 0;
+            public long Failed = 0;
+
+            public Worker(int index, Func<int, IPAddress, Sensor> getSensor)
+            {
+                this.getSensor = getSensor;
+
+                for (int i = 0; i < free.Capacity; i++)
+                {
+                    free.TryEnqueue(new byte[MAX_DATAGRAM_LENGTH]);
+                }
+
+                var thread = new Thread(Run);
+                thread.Name = $"Ingest worker {index}";
+                thread.IsBackground = true;
+                thread.Start();
+            }
+
+            public bool Post(byte[] buffer, int length, IPEndPoint source, DateTime arrivalTime)
+            {
+                byte[] slot;
+                if (!free.TryDequeue(out slot))
+                    return false;
+
+                Buffer.BlockCopy(buffer, 0, slot, 0, length);
+
+                // can't fail, there are never more pending datagrams than buffers
+                pending.TryEnqueue(new Datagram { Buffer = slot, Length = length, Source = source, ArrivalTime = arrivalTime });
+                Wake();
+
+                return true;
+            }
+
+            public bool Post(int sensorId, IPAddress source, SensorValue value)
+            {
+                // the count is only a snapshot with concurrent producers, which is good enough for a limit
+                if (decoded.Count >= QUEUE_CAPACITY)
+                    return false;
+
+                decoded.Enqueue(new DecodedValue { SensorId = sensorId, Source = source, Value = value });
+                Wake();
+
+                return true;
+            }
+
+            /// <summary>
+            /// signals the worker after a datagram or value was queued
+            /// </summary>
+            private void Wake()
+            {
+                // the enqueue must be visible before IsSet is read. otherwise the worker can
+                // reset the signal and find the queue empty while IsSet still reads true here.
+                // Reset on the worker side is an interlocked operation and a full fence as well
+                Interlocked.MemoryBarrier();
+                if (!signal.IsSet)
+                    signal.Set();
+            }
+
+            private void Run()
+            {
+                Datagram datagram;
+                DecodedValue value;
+
+                while (true)
+                {
+                    while (pending.TryDequeue(out datagram))
+                    {
+                        // a failing sensor or capture must neither stop the worker nor leak the buffer
+                        try
+                        {
+                            Decode(datagram);
+                        }
+                        catch (Exception e)
+                        {
+                            Interlocked.Increment(ref Failed);
+                            Debug.WriteLine($"Decoding a datagram ({datagram.Length} bytes) from {datagram.Source} failed: {e}");
+                        }
+                        finally
+                        {
+                            free.TryEnqueue(datagram.Buffer);
+                        }
+                    }
+
+                    while (decoded.TryDequeue(out value))
+                    {
+                        try
+                        {
+                            getSensor(value.SensorId, value.Source).PushValue(value.Value);
+                            Interlocked.Increment(ref DecodedValues);
+                        }
+                        catch (Exception e)
+                        {
+                            Interlocked.Increment(ref Failed);
+                            Debug.WriteLine($"Pushing a value of sensor {value.SensorId} from {value.Source} failed: {e}");
+                        }
+                    }
+
+                    // the queues are checked again after the reset,
+                    // so a datagram or value posted in between isn't missed
+                    signal.Reset();
+                    if (pending.IsEmpty && decoded.IsEmpty)
+                        signal.Wait();
+                }
+            }
+
+            private void Decode(Datagram datagram)
+            {
+                if (SensorPacket.IsTelemetry(datagram.Buffer, datagram.Length))
+                {
+                    DecodeTelemetry(datagram);
+                    return;
+                }
+
+                int sensorId;
+                values.Clear();
+                if (!SensorPacket.Decode(datagram.Buffer, datagram.Length, datagram.ArrivalTime, out sensorId, values))
+                {
+                    Debug.WriteLine($"Dropped invalid datagram ({datagram.Length} bytes) from {datagram.Source}");
+                    return;
+                }
+
+                var sensor = getSensor(sensorId, datagram.Source.Address);
+                for (int i = 0; i < values.Count; i++)
+                {
+                    sensor.PushValue(values[i]);
+                }
+
+                Interlocked.Add(ref DecodedValues, values.Count);
+            }
+
+            private void DecodeTelemetry(Datagram datagram)
+            {
+                SensorTelemetry telemetry;
+                if (!SensorPacket.TryDecodeTelemetry(datagram.Buffer, datagram.Length, out telemetry))
+                {
+                    Debug.WriteLine($"Dropped invalid telemetry datagram ({datagram.Length} bytes) from {datagram.Source}");
+                    return;
+                }
+
+                getSensor(telemetry.SensorId, datagram.Source.Address).Telemetry = telemetry;
+
+                // also wanted in release builds, a trace listener can log it to a file
+                Trace.WriteLine(telemetry);
+            }
+        }
+    }
+}
@@ -0,0 +1,137 @@
+﻿/*
+Part of Bewegungsfelder 
+
+MIT-License 
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Text;
+using System.Threading.Tasks;
+using Bewegungsfelder.Mathematics;
+
+namespace Bewegungsfelder.Core
+{
+    public class KinematicStructure
+    {
+        private CompiledSkeleton compiled;
+
+        public Bone Root { get; }
+
+        /// <summary>
+        /// flat representation of the bone tree. rebuilt after the structure was invalidated
+        /// </summary>
+        public CompiledSkeleton Compiled
+        {
+            get
+            {
+                if (compiled == null)
+                    compiled = new CompiledSkeleton(Root);
+                return compiled;
+            }
+        }
+
+        public KinematicStructure(Bone root = null)
+        {
+            if (root == null)
+                Root = new Bone(parent: null) { Name = "Root" };
+            else
+                Root = root;
+        }
+
+        /// <summary>
+        /// must be called after bones were added or removed
+        /// </summary>
+        public void Invalidate()
+        {
+            compiled = null;
+        }
+
+        /// <summary>
+        /// creates a pose for the current structure, with no bones driven
+        /// </summary>
+        public Pose CreatePose()
+        {
+            return new Pose(Compiled);
+        }
+
+        /// <summary>
+        /// sets the joint rotations so the driven bones end up with the pose's world rotations
+        /// </summary>
+        public void ApplyWorldRotations(Pose worldRotations)
+        {
+            var skeleton = CheckPose(worldRotations);
+            var bones = skeleton.Bones;
+            var local = skeleton.LocalRotations;
+            var world = skeleton.WorldRotations;
+
+            for (int i = 0; i < skeleton.Count; i++)
+            {
+                int parent = skeleton.Parents[i];
+                Quaternion parentRotation = parent < 0 ? Quaternion.Identity : world[parent];
+
+                if (worldRotations.IsDriven[i])
+                {
+                    bones[i].JointRotation = parentRotation.Inverted() * worldRotations.Rotations[i];
+                }
+
+                local[i] = bones[i].JointRotation;
+                world[i] = parentRotation * local[i];
+            }
+        }
+
+        /// <summary>
+        /// sets the joint rotations of the driven bones
+        /// </summary>
+        public void ApplyLocalRotation(Pose jointRotations)
+        {
+            var skeleton = CheckPose(jointRotations);
+            for (int i = 0; i < skeleton.Count; i++)
+            {
+                if (jointRotations.IsDriven[i])
+                {
+                    skeleton.Bones[i].JointRotation = jointRotations.Rotations[i];
+                }
+            }
+        }
+
+        /// <summary>
+        /// collects the local orientation values for all bones in the tree
+        /// </summary>
+        public void CollectLocalOrientations(Pose result)
+        {
+            var skeleton = CheckPose(result);
+            for (int i = 0; i < skeleton.Count; i++)
+            {
+                result.Set(i, skeleton.Bones[i].JointRotation);
+            }
+        }
+
+        private CompiledSkeleton CheckPose(Pose pose)
+        {
+            if (pose.Skeleton != Compiled)
+                throw new ArgumentException("Pose was created for a different skeleton");
+
+            return pose.Skeleton;
+        }
+    }
+}
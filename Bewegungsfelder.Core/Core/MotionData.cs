@@ -0,0 +1,205 @@
+﻿/*
+Part of Bewegungsfelder 
+
+MIT-License 
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Text;
+using System.Threading.Tasks;
+using Bewegungsfelder.Mathematics;
+
+namespace Bewegungsfelder.Core
+{
+    /// <summary>
+    /// recorded joint rotations. frames are stored as w,x,y,z floats per joint in chunks
+    /// of ChunkFrames frames, so recording never copies older frames and every frame
+    /// can be accessed by index.
+    /// </summary>
+    public class MotionData
+    {
+        /// <summary>
+        /// upper limit of the frames per storage chunk
+        /// </summary>
+        public const int MAX_CHUNK_FRAMES = 1024;
+
+        // arrays of this size and larger are allocated on the large object heap,
+        // which is only collected with gen2. the array header counts towards it
+        private const int LARGE_OBJECT_SIZE = 85000;
+        private const int ARRAY_OVERHEAD = 32;
+
+        /// <summary>
+        /// number of floats stored per joint and frame
+        /// </summary>
+        public const int JOINT_STRIDE = 4;
+
+        private readonly List<float[]> chunks = new List<float[]>();
+
+        private Dictionary<Bone, int> jointIndices = new Dictionary<Bone, int>();
+
+        // ChunkFrames is a power of two, frames are located with shift and mask
+        private int chunkShift = GetChunkShift(0);
+
+        public double FPS { get; set; } = 120;
+
+        /// <summary>
+        /// the recorded bones. defines the joint order of the frames
+        /// </summary>
+        public Bone[] Joints { get; private set; } = new Bone[0];
+
+        public int JointCount { get { return Joints.Length; } }
+
+        public int FrameCount { get; private set; }
+
+        /// <summary>
+        /// number of floats per frame
+        /// </summary>
+        public int FrameStride { get { return Joints.Length * JOINT_STRIDE; } }
+
+        /// <summary>
+        /// number of frames per storage chunk. depends on the joint count,
+        /// chunks are kept small enough to stay off the large object heap
+        /// </summary>
+        public int ChunkFrames { get { return 1 << chunkShift; } }
+
+        /// <summary>
+        /// removes all frames and sets the recorded joints
+        /// </summary>
+        public void Reset(IEnumerable<Bone> joints)
+        {
+            Joints = joints.ToArray();
+            jointIndices = new Dictionary<Bone, int>(Joints.Length);
+            for (int i = 0; i < Joints.Length; i++)
+            {
+                jointIndices.Add(Joints[i], i);
+            }
+
+            chunkShift = GetChunkShift(FrameStride);
+            Clear();
+        }
+
+        /// <summary>
+        /// removes all frames. the joints are kept
+        /// </summary>
+        public void Clear()
+        {
+            chunks.Clear();
+            FrameCount = 0;
+        }
+
+        /// <summary>
+        /// returns the joint index of a bone or -1 if the bone is not recorded
+        /// </summary>
+        public int IndexOf(Bone bone)
+        {
+            int index;
+            return jointIndices.TryGetValue(bone, out index) ? index : -1;
+        }
+
+        /// <summary>
+        /// appends an empty frame and returns its storage. the rotations are written by the caller
+        /// </summary>
+        public ArraySegment<float> AddFrame()
+        {
+            int chunk = FrameCount >> chunkShift;
+            if (chunk == chunks.Count)
+                chunks.Add(new float[ChunkFrames * FrameStride]);
+
+            ++FrameCount;
+            return GetFrame(FrameCount - 1);
+        }
+
+        /// <summary>
+        /// appends a frame. rotations are indexed by joint
+        /// </summary>
+        public void AddFrame(IList<Quaternion> rotations)
+        {
+            if (rotations.Count != JointCount)
+                throw new ArgumentException("Frame doesn't match the joint count");
+
+            var frame = AddFrame();
+            for (int i = 0; i < rotations.Count; i++)
+            {
+                Write(frame, i, rotations[i]);
+            }
+        }
+
+        /// <summary>
+        /// returns the storage of a frame without copying
+        /// </summary>
+        public ArraySegment<float> GetFrame(int frame)
+        {
+            if (frame < 0 || frame >= FrameCount)
+                throw new ArgumentOutOfRangeException(nameof(frame));
+
+            int stride = FrameStride;
+            return new ArraySegment<float>(chunks[frame >> chunkShift], (frame & (ChunkFrames - 1)) * stride, stride);
+        }
+
+        /// <summary>
+        /// returns the rotation of a joint in a frame
+        /// </summary>
+        public Quaternion GetRotation(int frame, int joint)
+        {
+            return Read(GetFrame(frame), joint);
+        }
+
+        /// <summary>
+        /// reads a joint rotation from a frame returned by GetFrame
+        /// </summary>
+        public static Quaternion Read(ArraySegment<float> frame, int joint)
+        {
+            var data = frame.Array;
+            int i = frame.Offset + joint * JOINT_STRIDE;
+            return new Quaternion(data[i + 1], data[i + 2], data[i + 3], data[i]);
+        }
+
+        /// <summary>
+        /// the largest power of two number of frames up to MAX_CHUNK_FRAMES whose chunk
+        /// stays below the large object size. at least one frame per chunk
+        /// </summary>
+        private static int GetChunkShift(int frameStride)
+        {
+            int shift = 0;
+            while ((1 << (shift + 1)) <= MAX_CHUNK_FRAMES &&
+                ARRAY_OVERHEAD + (2L << shift) * frameStride * sizeof(float) < LARGE_OBJECT_SIZE)
+            {
+                ++shift;
+            }
+            return shift;
+        }
+
+        /// <summary>
+        /// writes a joint rotation to a frame returned by AddFrame or GetFrame
+        /// </summary>
+        public static void Write(ArraySegment<float> frame, int joint, Quaternion rotation)
+        {
+            var data = frame.Array;
+            int i = frame.Offset + joint * JOINT_STRIDE;
+            data[i] = (float)rotation.W;
+            data[i + 1] = (float)rotation.X;
+            data[i + 2] = (float)rotation.Y;
+            data[i + 3] = (float)rotation.Z;
+        }
+    }
+}
@@ -0,0 +1,81 @@
+﻿/*
+Part of Bewegungsfelder
+
+MIT-License
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Text;
+using System.Threading.Tasks;
+using Bewegungsfelder.Mathematics;
+
+namespace Bewegungsfelder.Core
+{
+    /// <summary>
+    /// rotations for the bones of a compiled skeleton, indexed like CompiledSkeleton.Bones.
+    /// only the bones marked as driven carry a rotation. allocated once and reused for every frame.
+    /// </summary>
+    public class Pose
+    {
+        /// <summary>
+        /// the skeleton the indices refer to
+        /// </summary>
+        public CompiledSkeleton Skeleton { get; }
+
+        /// <summary>
+        /// the rotation of each bone. only valid if the bone is driven
+        /// </summary>
+        public Quaternion[] Rotations { get; }
+
+        /// <summary>
+        /// true for the bones that have a rotation in this pose
+        /// </summary>
+        public bool[] IsDriven { get; }
+
+        public int Count { get { return Rotations.Length; } }
+
+        public Pose(CompiledSkeleton skeleton)
+        {
+            Skeleton = skeleton;
+            Rotations = new Quaternion[skeleton.Count];
+            IsDriven = new bool[skeleton.Count];
+        }
+
+        /// <summary>
+        /// marks all bones as not driven
+        /// </summary>
+        public void Clear()
+        {
+            Array.Clear(IsDriven, 0, IsDriven.Length);
+        }
+
+        /// <summary>
+        /// sets the rotation of a bone and marks it as driven
+        /// </summary>
+        public void Set(int index, Quaternion rotation)
+        {
+            Rotations[index] = rotation;
+            IsDriven[index] = true;
+        }
+    }
+}
@@ -0,0 +1,163 @@
+﻿/*
+Part of Bewegungsfelder 
+
+MIT-License 
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using Bewegungsfelder.Utilities;
+using System;
+using System.Collections.Concurrent;
+using System.Collections.Generic;
+using System.Linq;
+using System.Net;
+using System.Text;
+using System.Threading.Tasks;
+using Bewegungsfelder.Mathematics;
+
+namespace Bewegungsfelder.Core
+{
+    public class Sensor
+    {
+        // time span of values kept in the history
+        public static readonly TimeSpan HISTORY_RETENTION = TimeSpan.FromSeconds(10);
+
+        // history capacity until the sample rate is known: 25Hz * 10 sec
+        public const int INITIAL_HISTORY_CAPACITY = 25 * 10;
+
+        private volatile CaptureWriter capture;
+        private volatile SensorTelemetry telemetry;
+
+        /// <summary>
+        /// the recent values ordered by sensor timestamp
+        /// </summary>
+        public SensorHistory History { get; }
+
+        /// <summary>
+        /// the values of the history stored per channel, for window aggregates and plots
+        /// </summary>
+        public SensorSampleStore Samples { get; }
+
+        public int Id { get; }
+
+        public IPAddress SourceIp { get; }
+
+        /// <summary>
+        /// link quality statistics: loss, reordering, jitter and sample rate
+        /// </summary>
+        public SensorStatistics Statistics { get; } = new SensorStatistics();
+
+        /// <summary>
+        /// all received values are appended to this capture file if set
+        /// </summary>
+        public CaptureWriter Capture
+        {
+            get { return capture; }
+            set { capture = value; }
+        }
+
+        /// <summary>
+        /// the latency statistics of the last telemetry datagram, null if the sensor sent none.
+        /// set by the ingest worker of the sensor
+        /// </summary>
+        public SensorTelemetry Telemetry
+        {
+            get { return telemetry; }
+            set { telemetry = value; }
+        }
+
+        /// <summary>
+        /// the last sensor value received.
+        /// returns a default SensorValue if no data is recorded yet
+        /// </summary>
+        public SensorValue LastValue { get { return History.Last; } }
+
+        /// <summary>
+        /// adds a new value. must only be called by one thread at a time,
+        /// udp values of a sensor are always pushed by the same ingest worker.
+        /// </summary>
+        public void PushValue(SensorValue value)
+        {
+            if (History.Push(value))
+            {
+                // keep the same retention as the history
+                if (Samples.Capacity != History.Capacity)
+                    Samples.Resize(History.Capacity);
+
+                Samples.Push(value);
+            }
+
+            Statistics.Update(value);
+
+            capture?.AppendSample(Id, value);
+        }
+
+        public Sensor(IPAddress source, int id)
+        {
+            this.Id = id;
+            this.SourceIp = source;
+            this.History = new SensorHistory(HISTORY_RETENTION, INITIAL_HISTORY_CAPACITY);
+            this.Samples = new SensorSampleStore(History.Capacity);
+        }
+
+        /// <summary>
+        /// returns the buffered values that arrived after t, oldest first
+        /// </summary>
+        public SensorValue[] GetDataSince(DateTime t)
+        {
+            var range = History.Since(t);
+            var values = new List<SensorValue>(range.Count);
+            foreach (var value in range)
+            {
+                values.Add(value);
+            }
+            return values.ToArray();
+        }
+
+        public Vector3D AxisFromAcceleration(DateTime calibrationStartTime)
+        {
+            long start = Samples.FindSince(calibrationStartTime);
+            long end = Samples.End;
+
+            // sum accelerometer readings to identify the direction of gravity
+            Vector3D axis = new Vector3D(
+                Samples.Aggregate(SensorChannel.AccelerationX, start, end).Sum,
+                Samples.Aggregate(SensorChannel.AccelerationY, start, end).Sum,
+                Samples.Aggregate(SensorChannel.AccelerationZ, start, end).Sum);
+            axis.Normalize();
+            return axis;
+        }
+
+        public Vector3D AxisFromGyro(DateTime calibrationStartTime)
+        {
+            long start = Samples.FindSince(calibrationStartTime);
+            long end = Samples.End;
+
+            // sum gyro readings to identify the principal rotation axis
+            Vector3D axis = new Vector3D(
+                Samples.Aggregate(SensorChannel.GyroX, start, end).AbsSum,
+                Samples.Aggregate(SensorChannel.GyroY, start, end).AbsSum,
+                Samples.Aggregate(SensorChannel.GyroZ, start, end).AbsSum);
+            axis.Normalize();
+
+            return axis;
+        }
+    }
+}
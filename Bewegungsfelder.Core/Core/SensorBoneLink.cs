@@ -28,7 +28,7 @@ using System.Collections.Generic;
 using System.Linq;
 using System.Text;
 using System.Threading.Tasks;
-using System.Windows.Media.Media3D;
+using Bewegungsfelder.Mathematics;
 
 namespace Bewegungsfelder.Core
 {
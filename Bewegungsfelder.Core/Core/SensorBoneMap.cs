@@ -28,7 +28,7 @@ using System.Collections.Generic;
 using System.Linq;
 using System.Text;
 using System.Threading.Tasks;
-using System.Windows.Media.Media3D;
+using Bewegungsfelder.Mathematics;
 
 namespace Bewegungsfelder.Core
 {
@@ -76,15 +76,19 @@ namespace Bewegungsfelder.Core
             }
         }
 
-        public Dictionary<Bone, Quaternion> GetCalibratedSensorOrientations()
+        /// <summary>
+        /// sets the calibrated sensor orientations as world rotations of the linked bones.
+        /// all other bones of the pose are not driven.
+        /// </summary>
+        public void GetCalibratedSensorOrientations(Pose result)
         {
-            var result = new Dictionary<Bone, Quaternion>();
+            result.Clear();
             foreach (var link in links.Values)
             {
-                result.Add(link.Bone, link.GetCalibratedOrientation());
+                int index = result.Skeleton.IndexOf(link.Bone);
+                if (index >= 0)
+                    result.Set(index, link.GetCalibratedOrientation());
             }
-
-            return result;
         }
 
         /// <summary>
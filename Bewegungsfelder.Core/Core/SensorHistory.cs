@@ -0,0 +1,223 @@
+﻿/*
+Part of Bewegungsfelder
+
+MIT-License
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using Bewegungsfelder.Utilities;
+using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Text;
+using System.Threading;
+using System.Threading.Tasks;
+
+namespace Bewegungsfelder.Core
+{
+    /// <summary>
+    /// the recent values of a sensor, ordered by sensor timestamp.
+    /// the capacity follows the measured sample rate so the history covers the retention time.
+    /// single writer, any number of readers. range queries use binary search and return
+    /// views on the buffer without copying.
+    /// </summary>
+    public class SensorHistory
+    {
+        // capacity limits: 1 second at 25Hz and 60 seconds at 1kHz
+        public const int MIN_CAPACITY = 25;
+        public const int MAX_CAPACITY = 60 * 1000;
+
+        // headroom for rate changes
+        private const double CAPACITY_MARGIN = 1.25;
+
+        // a larger jump back in time is treated as a sensor restart
+        private const int RESTART_DISTANCE = 1000 * 1000;
+
+        // replaced when the capacity changes. readers keep using the old one
+        private RingBuffer<SensorValue> buffer;
+
+        private bool hasValues = false;
+        private uint lastTimestamp;
+
+        /// <summary>
+        /// the time span of values to keep
+        /// </summary>
+        public TimeSpan Retention { get; }
+
+        public int Capacity { get { return Volatile.Read(ref buffer).Capacity; } }
+
+        public int Count { get { return Volatile.Read(ref buffer).Count; } }
+
+        /// <summary>
+        /// the most recent value or a default SensorValue if there is none
+        /// </summary>
+        public SensorValue Last { get { return Volatile.Read(ref buffer).Last; } }
+
+        /// <param name="retention">time span of values to keep</param>
+        /// <param name="initialCapacity">used until the sample rate is known</param>
+        public SensorHistory(TimeSpan retention, int initialCapacity)
+        {
+            Retention = retention;
+            buffer = new RingBuffer<SensorValue>(Clamp(initialCapacity));
+        }
+
+        /// <summary>
+        /// adds a value. must only be called by one thread at a time.
+        /// values older than the most recent one are dropped to keep the order.
+        /// </summary>
+        /// <returns>false if the value was dropped</returns>
+        public bool Push(SensorValue value)
+        {
+            if (hasValues)
+            {
+                int delta = Compare(value.SensorTimestamp, lastTimestamp);
+                if (delta < -RESTART_DISTANCE)
+                {
+                    // sensor restarted, older values can't be ordered anymore
+                    Volatile.Write(ref buffer, new RingBuffer<SensorValue>(buffer.Capacity));
+                }
+                else if (delta < 0)
+                {
+                    return false;
+                }
+            }
+
+            hasValues = true;
+            lastTimestamp = value.SensorTimestamp;
+
+            buffer.Push(value);
+
+            // adjust the capacity whenever the buffer was filled once more
+            if (buffer.End % buffer.Capacity == 0)
+                AdjustCapacity();
+
+            return true;
+        }
+
+        /// <summary>
+        /// all values in the history, oldest first
+        /// </summary>
+        public RingBuffer<SensorValue>.Snapshot All()
+        {
+            return Volatile.Read(ref buffer).GetSnapshot();
+        }
+
+        /// <summary>
+        /// values with sensor timestamps in [t0, t1), oldest first
+        /// </summary>
+        public RingBuffer<SensorValue>.Snapshot Range(uint t0, uint t1)
+        {
+            var current = Volatile.Read(ref buffer);
+            return current.GetSnapshot(LowerBound(current, t0), LowerBound(current, t1));
+        }
+
+        /// <summary>
+        /// values that arrived after t, oldest first
+        /// </summary>
+        public RingBuffer<SensorValue>.Snapshot Since(DateTime t)
+        {
+            var current = Volatile.Read(ref buffer);
+            return current.GetSnapshot(UpperBound(current, t), current.End);
+        }
+
+        /// <summary>
+        /// position of the first value with a sensor timestamp >= t
+        /// </summary>
+        private static long LowerBound(RingBuffer<SensorValue> values, uint t)
+        {
+            long lo = values.Start;
+            long hi = values.End;
+            while (lo < hi)
+            {
+                long mid = lo + (hi - lo) / 2;
+
+                // overwritten values are older than all others
+                SensorValue value;
+                if (!values.TryReadAt(mid, out value) || Compare(value.SensorTimestamp, t) < 0)
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+            return lo;
+        }
+
+        /// <summary>
+        /// position of the first value that arrived after t
+        /// </summary>
+        private static long UpperBound(RingBuffer<SensorValue> values, DateTime t)
+        {
+            long lo = values.Start;
+            long hi = values.End;
+            while (lo < hi)
+            {
+                long mid = lo + (hi - lo) / 2;
+
+                SensorValue value;
+                if (!values.TryReadAt(mid, out value) || value.ArrivalTime <= t)
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+            return lo;
+        }
+
+        /// <summary>
+        /// resizes the buffer to hold the retention time at the rate measured over the buffered values
+        /// </summary>
+        private void AdjustCapacity()
+        {
+            SensorValue oldest;
+            if (!buffer.TryReadAt(buffer.Start, out oldest))
+                return;
+
+            double seconds = (buffer.Last.ArrivalTime - oldest.ArrivalTime).TotalSeconds;
+            if (seconds <= 0)
+                return;
+
+            double rate = (buffer.Count - 1) / seconds;
+            int capacity = Clamp((int)Math.Ceiling(rate * Retention.TotalSeconds * CAPACITY_MARGIN));
+
+            // avoid resizing for small rate fluctuations
+            if (capacity <= buffer.Capacity && capacity * 2 > buffer.Capacity)
+                return;
+
+            var resized = new RingBuffer<SensorValue>(capacity);
+            foreach (var value in buffer.GetSnapshot(buffer.End - Math.Min(capacity, buffer.Count), buffer.End))
+            {
+                resized.Push(value);
+            }
+
+            Volatile.Write(ref buffer, resized);
+        }
+
+        private static int Clamp(int capacity)
+        {
+            return Math.Max(MIN_CAPACITY, Math.Min(MAX_CAPACITY, capacity));
+        }
+
+        /// <summary>
+        /// signed difference a - b of two sensor timestamps, handles overflows
+        /// </summary>
+        private static int Compare(uint a, uint b)
+        {
+            return unchecked((int)(a - b));
+        }
+    }
+}
@@ -0,0 +1,323 @@
+﻿/*
+Part of Bewegungsfelder
+
+MIT-License
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Text;
+using System.Threading.Tasks;
+using Bewegungsfelder.Mathematics;
+
+namespace Bewegungsfelder.Core
+{
+    /// <summary>
+    /// decodes the datagrams sent by the sensor firmware.
+    /// the wire format is defined in bewegungsfelder_esp8266/esp8266_mpu6050/include/sensor_packet.h
+    /// </summary>
+    public static class SensorPacket
+    {
+        /// <summary>
+        /// unversioned single sample packet: long[12]. timestamps in milliseconds
+        /// </summary>
+        public const int LEGACY_LENGTH = 12 * sizeof(int);
+
+        /// <summary>
+        /// batch of samples drained from the DMP fifo. timestamps in milliseconds
+        /// </summary>
+        public const int VERSION_BATCH = 1;
+
+        public const int BATCH_HEADER_LENGTH = 4;
+        public const int BATCH_SAMPLE_LENGTH = 4 * sizeof(int) + 6 * sizeof(short) + sizeof(uint);
+
+        /// <summary>
+        /// compact batch: q14 quaternions and delta encoded timestamps in microseconds
+        /// </summary>
+        public const int VERSION_COMPACT = 2;
+
+        /// <summary>
+        /// header flag of compact packets: timestamps are in microseconds, otherwise milliseconds
+        /// </summary>
+        public const int FLAG_TIMESTAMP_US = 0x01;
+
+        // converts the millisecond timestamps of older firmware
+        private const uint MICROSECONDS_PER_MILLISECOND = 1000;
+
+        public const int COMPACT_HEADER_LENGTH = 2 * sizeof(byte) + sizeof(ushort) + sizeof(uint);
+        public const int COMPACT_SAMPLE_LENGTH = sizeof(ushort) + 10 * sizeof(short);
+
+        /// <summary>
+        /// processing latency statistics of the firmware, see SensorTelemetry
+        /// </summary>
+        public const int VERSION_TELEMETRY = 3;
+
+        public const int TELEMETRY_HEADER_LENGTH = 2 * sizeof(byte) + 2 * sizeof(ushort) + 2 * sizeof(byte);
+        public const int TELEMETRY_STAGE_HEADER_LENGTH = 4 * sizeof(uint);
+
+        // scale factors for the configured full scale ranges (+-4g, +-2000deg/s)
+        public const double ACCEL_SCALE = 8192;
+        public const double GYRO_SCALE = 16.4;
+
+        /// <summary>
+        /// returns the version encoded in the upper nibble of a header byte
+        /// </summary>
+        public static int GetVersion(byte header)
+        {
+            return header >> 4;
+        }
+
+        /// <summary>
+        /// returns the flags encoded in the lower nibble of a header byte
+        /// </summary>
+        public static int GetFlags(byte header)
+        {
+            return header & 0x0f;
+        }
+
+        /// <summary>
+        /// reads the id of the sending sensor without decoding the samples.
+        /// </summary>
+        /// <returns>false if the datagram is too short to contain a sensor id</returns>
+        public static bool TryGetSensorId(byte[] buffer, int length, out int sensorId)
+        {
+            if (length == LEGACY_LENGTH)
+            {
+                sensorId = BitConverter.ToInt32(buffer, 0);
+                return true;
+            }
+
+            if (length < BATCH_HEADER_LENGTH)
+            {
+                sensorId = 0;
+                return false;
+            }
+
+            sensorId = buffer[1];
+            return true;
+        }
+
+        /// <summary>
+        /// decodes all samples of a datagram. sensor timestamps are converted to microseconds.
+        /// </summary>
+        /// <param name="buffer">the received datagram</param>
+        /// <param name="length">number of valid bytes in buffer</param>
+        /// <param name="arrivalTime">the time the datagram was received</param>
+        /// <param name="sensorId">id of the sending sensor</param>
+        /// <param name="values">decoded values are appended to this list, oldest first</param>
+        /// <returns>false if the datagram is malformed or of an unknown version</returns>
+        public static bool Decode(byte[] buffer, int length, DateTime arrivalTime,
+            out int sensorId, List<SensorValue> values)
+        {
+            sensorId = 0;
+
+            if (length == LEGACY_LENGTH)
+            {
+                sensorId = BitConverter.ToInt32(buffer, 0);
+                values.Add(DecodeLegacy(buffer, arrivalTime));
+                return true;
+            }
+
+            if (length < BATCH_HEADER_LENGTH)
+                return false;
+
+            switch (GetVersion(buffer[0]))
+            {
+                case VERSION_BATCH:
+                    int count = buffer[2];
+                    if (length != BATCH_HEADER_LENGTH + count * BATCH_SAMPLE_LENGTH)
+                        return false;
+
+                    sensorId = buffer[1];
+                    for (int i = 0; i < count; i++)
+                    {
+                        values.Add(DecodeBatchSample(buffer,
+                            BATCH_HEADER_LENGTH + i * BATCH_SAMPLE_LENGTH, arrivalTime));
+                    }
+                    return true;
+                case VERSION_COMPACT:
+                    int payload = length - COMPACT_HEADER_LENGTH;
+                    if (payload <= 0 || payload % COMPACT_SAMPLE_LENGTH != 0)
+                        return false;
+
+                    sensorId = buffer[1];
+                    ushort sequence = BitConverter.ToUInt16(buffer, 2);
+                    uint timestamp = BitConverter.ToUInt32(buffer, 4);
+                    uint timestampScale = (GetFlags(buffer[0]) & FLAG_TIMESTAMP_US) != 0 ? 1 : MICROSECONDS_PER_MILLISECOND;
+                    for (int offset = COMPACT_HEADER_LENGTH; offset < length; offset += COMPACT_SAMPLE_LENGTH)
+                    {
+                        values.Add(DecodeCompactSample(buffer, offset, arrivalTime, ref timestamp, timestampScale, sequence++));
+                    }
+                    return true;
+                default:
+                    return false;
+            }
+        }
+
+        /// <summary>
+        /// returns true if the datagram is a telemetry datagram rather than samples
+        /// </summary>
+        public static bool IsTelemetry(byte[] buffer, int length)
+        {
+            return length != LEGACY_LENGTH && length >= TELEMETRY_HEADER_LENGTH
+                && GetVersion(buffer[0]) == VERSION_TELEMETRY;
+        }
+
+        /// <summary>
+        /// decodes a telemetry datagram.
+        /// </summary>
+        /// <returns>false if the datagram is malformed or not a telemetry datagram</returns>
+        public static bool TryDecodeTelemetry(byte[] buffer, int length, out SensorTelemetry telemetry)
+        {
+            telemetry = null;
+            if (!IsTelemetry(buffer, length))
+                return false;
+
+            int stageCount = buffer[6];
+            int bucketCount = buffer[7];
+            int stageLength = TELEMETRY_STAGE_HEADER_LENGTH + bucketCount * sizeof(ushort);
+            if (length != TELEMETRY_HEADER_LENGTH + stageCount * stageLength)
+                return false;
+
+            var stages = new SensorTelemetry.Stage[stageCount];
+            int offset = TELEMETRY_HEADER_LENGTH;
+            for (int i = 0; i < stageCount; i++, offset += stageLength)
+            {
+                var histogram = new ushort[bucketCount];
+                for (int j = 0; j < bucketCount; j++)
+                {
+                    histogram[j] = BitConverter.ToUInt16(buffer, offset + TELEMETRY_STAGE_HEADER_LENGTH + j * sizeof(ushort));
+                }
+
+                string name = i < SensorTelemetry.STAGE_NAMES.Length ? SensorTelemetry.STAGE_NAMES[i] : $"stage {i}";
+                stages[i] = new SensorTelemetry.Stage(name,
+                    BitConverter.ToUInt32(buffer, offset),
+                    BitConverter.ToUInt32(buffer, offset + 4),
+                    BitConverter.ToUInt32(buffer, offset + 8),
+                    BitConverter.ToUInt32(buffer, offset + 12),
+                    histogram);
+            }
+
+            telemetry = new SensorTelemetry(buffer[1], BitConverter.ToUInt16(buffer, 2),
+                BitConverter.ToUInt16(buffer, 4), stages);
+            return true;
+        }
+
+        /// <summary>
+        /// decodes a legacy packet. all values are sent as 32bit integers
+        /// </summary>
+        private static SensorValue DecodeLegacy(byte[] buffer, DateTime arrivalTime)
+        {
+            var accel = new Vector3D();
+            var gyro = new Vector3D();
+            var quat = new Quaternion();
+            int i = 1;
+            quat.W = BitConverter.ToInt32(buffer, i++ * sizeof(int));
+            quat.X = BitConverter.ToInt32(buffer, i++ * sizeof(int));
+            quat.Y = BitConverter.ToInt32(buffer, i++ * sizeof(int));
+            quat.Z = BitConverter.ToInt32(buffer, i++ * sizeof(int));
+            accel.X = BitConverter.ToInt16(buffer, i++ * sizeof(int));
+            accel.Y = BitConverter.ToInt16(buffer, i++ * sizeof(int));
+            accel.Z = BitConverter.ToInt16(buffer, i++ * sizeof(int));
+            gyro.X = BitConverter.ToInt16(buffer, i++ * sizeof(int));
+            gyro.Y = BitConverter.ToInt16(buffer, i++ * sizeof(int));
+            gyro.Z = BitConverter.ToInt16(buffer, i++ * sizeof(int));
+            uint timestamp = BitConverter.ToUInt32(buffer, i++ * sizeof(int));
+
+            return CreateValue(quat, accel, gyro, arrivalTime, unchecked(timestamp * MICROSECONDS_PER_MILLISECOND));
+        }
+
+        /// <summary>
+        /// decodes a single sample of a batch packet starting at offset
+        /// </summary>
+        private static SensorValue DecodeBatchSample(byte[] buffer, int offset, DateTime arrivalTime)
+        {
+            var quat = new Quaternion(
+                BitConverter.ToInt32(buffer, offset + 4),
+                BitConverter.ToInt32(buffer, offset + 8),
+                BitConverter.ToInt32(buffer, offset + 12),
+                BitConverter.ToInt32(buffer, offset));
+            offset += 4 * sizeof(int);
+
+            var accel = new Vector3D(
+                BitConverter.ToInt16(buffer, offset),
+                BitConverter.ToInt16(buffer, offset + 2),
+                BitConverter.ToInt16(buffer, offset + 4));
+            offset += 3 * sizeof(short);
+
+            var gyro = new Vector3D(
+                BitConverter.ToInt16(buffer, offset),
+                BitConverter.ToInt16(buffer, offset + 2),
+                BitConverter.ToInt16(buffer, offset + 4));
+            offset += 3 * sizeof(short);
+
+            uint timestamp = BitConverter.ToUInt32(buffer, offset);
+
+            return CreateValue(quat, accel, gyro, arrivalTime, unchecked(timestamp * MICROSECONDS_PER_MILLISECOND));
+        }
+
+        /// <summary>
+        /// decodes a single sample of a compact packet starting at offset.
+        /// </summary>
+        /// <param name="timestamp">timestamp of the previous sample as sent, advanced to this sample's timestamp</param>
+        /// <param name="timestampScale">converts the sent timestamps to microseconds</param>
+        private static SensorValue DecodeCompactSample(byte[] buffer, int offset, DateTime arrivalTime,
+            ref uint timestamp, uint timestampScale, ushort sequence)
+        {
+            timestamp += BitConverter.ToUInt16(buffer, offset);
+            offset += sizeof(ushort);
+
+            var quat = new Quaternion(
+                BitConverter.ToInt16(buffer, offset + 2),
+                BitConverter.ToInt16(buffer, offset + 4),
+                BitConverter.ToInt16(buffer, offset + 6),
+                BitConverter.ToInt16(buffer, offset));
+            offset += 4 * sizeof(short);
+
+            var accel = new Vector3D(
+                BitConverter.ToInt16(buffer, offset),
+                BitConverter.ToInt16(buffer, offset + 2),
+                BitConverter.ToInt16(buffer, offset + 4));
+            offset += 3 * sizeof(short);
+
+            var gyro = new Vector3D(
+                BitConverter.ToInt16(buffer, offset),
+                BitConverter.ToInt16(buffer, offset + 2),
+                BitConverter.ToInt16(buffer, offset + 4));
+
+            return CreateValue(quat, accel, gyro, arrivalTime, unchecked(timestamp * timestampScale), sequence);
+        }
+
+        /// <summary>
+        /// scales raw sensor readings to g, deg/s and a unit quaternion
+        /// </summary>
+        private static SensorValue CreateValue(Quaternion quat, Vector3D accel, Vector3D gyro,
+            DateTime arrivalTime, uint timestamp, int sequence = SensorValue.NO_SEQUENCE)
+        {
+            accel = accel / ACCEL_SCALE;
+            gyro = gyro / GYRO_SCALE;
+            quat.Normalize();
+
+            return new SensorValue(quat, accel, gyro, arrivalTime, timestamp, sequence);
+        }
+    }
+}
@@ -0,0 +1,419 @@
+﻿/*
+Part of Bewegungsfelder
+
+MIT-License
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Numerics;
+using System.Text;
+using System.Threading;
+using System.Threading.Tasks;
+
+namespace Bewegungsfelder.Core
+{
+    /// <summary>
+    /// the columns of the sample store
+    /// </summary>
+    public enum SensorChannel
+    {
+        AccelerationX, AccelerationY, AccelerationZ,
+        GyroX, GyroY, GyroZ,
+        OrientationW, OrientationX, OrientationY, OrientationZ
+    }
+
+    /// <summary>
+    /// aggregates of a single channel over a window of samples
+    /// </summary>
+    public struct WindowStatistics
+    {
+        public int Count { get; }
+        public double Sum { get; }
+        public double AbsSum { get; }
+        public double Min { get; }
+        public double Max { get; }
+        public double Variance { get; }
+
+        public double Mean { get { return Count > 0 ? Sum / Count : 0; } }
+
+        public WindowStatistics(int count, double sum, double absSum, double min, double max, double variance)
+        {
+            Count = count;
+            Sum = sum;
+            AbsSum = absSum;
+            Min = min;
+            Max = max;
+            Variance = variance;
+        }
+    }
+
+    /// <summary>
+    /// recent samples of a sensor stored as one float array per channel.
+    /// window aggregates run over contiguous arrays instead of SensorValue structs.
+    /// single writer, any number of readers. like RingBuffer, samples are addressed by
+    /// their absolute position and readers detect samples overwritten while reading.
+    /// </summary>
+    public class SensorSampleStore
+    {
+        public const int CHANNEL_COUNT = 10;
+
+        private class Columns
+        {
+            // one slot more than the capacity, the writer fills it with the next sample
+            public readonly int Length;
+            public readonly float[][] Data;
+            public readonly uint[] Timestamps;
+            public readonly long[] ArrivalTicks;
+
+            // total number of samples pushed, published after the sample has been stored
+            public long Written;
+
+            public Columns(int capacity, long written)
+            {
+                Length = capacity + 1;
+                Data = new float[CHANNEL_COUNT][];
+                for (int i = 0; i < CHANNEL_COUNT; i++)
+                    Data[i] = new float[Length];
+                Timestamps = new uint[Length];
+                ArrivalTicks = new long[Length];
+                Written = written;
+            }
+
+            /// <summary>
+            /// positions below were or are currently being overwritten
+            /// </summary>
+            public long OldestValidPosition()
+            {
+                // order the preceding reads of the columns before reading the write position
+                Thread.MemoryBarrier();
+                return Volatile.Read(ref Written) - Length + 1;
+            }
+        }
+
+        // replaced on resize. positions stay the same
+        private Columns columns;
+
+        public int Capacity { get { return Volatile.Read(ref columns).Length - 1; } }
+
+        /// <summary>
+        /// position of the next sample, equal to the total number of samples pushed
+        /// </summary>
+        public long End { get { return Volatile.Read(ref Volatile.Read(ref columns).Written); } }
+
+        /// <summary>
+        /// position of the oldest sample
+        /// </summary>
+        public long Start
+        {
+            get
+            {
+                var current = Volatile.Read(ref columns);
+                return Math.Max(0, Volatile.Read(ref current.Written) - (current.Length - 1));
+            }
+        }
+
+        public SensorSampleStore(int capacity)
+        {
+            if (capacity < 1)
+                throw new ArgumentOutOfRangeException(nameof(capacity));
+
+            columns = new Columns(capacity, 0);
+        }
+
+        /// <summary>
+        /// adds a sample. must only be called by one thread at a time.
+        /// </summary>
+        public void Push(SensorValue value)
+        {
+            var c = columns;
+            long position = c.Written;
+            int i = (int)(position % c.Length);
+
+            c.Data[(int)SensorChannel.AccelerationX][i] = (float)value.Acceleration.X;
+            c.Data[(int)SensorChannel.AccelerationY][i] = (float)value.Acceleration.Y;
+            c.Data[(int)SensorChannel.AccelerationZ][i] = (float)value.Acceleration.Z;
+            c.Data[(int)SensorChannel.GyroX][i] = (float)value.Gyro.X;
+            c.Data[(int)SensorChannel.GyroY][i] = (float)value.Gyro.Y;
+            c.Data[(int)SensorChannel.GyroZ][i] = (float)value.Gyro.Z;
+            c.Data[(int)SensorChannel.OrientationW][i] = (float)value.Orientation.W;
+            c.Data[(int)SensorChannel.OrientationX][i] = (float)value.Orientation.X;
+            c.Data[(int)SensorChannel.OrientationY][i] = (float)value.Orientation.Y;
+            c.Data[(int)SensorChannel.OrientationZ][i] = (float)value.Orientation.Z;
+            c.Timestamps[i] = value.SensorTimestamp;
+            c.ArrivalTicks[i] = value.ArrivalTime.Ticks;
+
+            // publish the sample
+            Volatile.Write(ref c.Written, position + 1);
+        }
+
+        /// <summary>
+        /// changes the capacity and keeps the most recent samples. writer only.
+        /// </summary>
+        public void Resize(int capacity)
+        {
+            if (capacity < 1)
+                throw new ArgumentOutOfRangeException(nameof(capacity));
+
+            var old = columns;
+            long end = old.Written;
+            long start = Math.Max(0, end - Math.Min(capacity, old.Length - 1));
+
+            var resized = new Columns(capacity, end);
+            for (long p = start; p < end; p++)
+            {
+                int from = (int)(p % old.Length);
+                int to = (int)(p % resized.Length);
+                for (int ch = 0; ch < CHANNEL_COUNT; ch++)
+                    resized.Data[ch][to] = old.Data[ch][from];
+                resized.Timestamps[to] = old.Timestamps[from];
+                resized.ArrivalTicks[to] = old.ArrivalTicks[from];
+            }
+
+            Volatile.Write(ref columns, resized);
+        }
+
+        /// <summary>
+        /// position of the first sample that arrived after t
+        /// </summary>
+        public long FindSince(DateTime t)
+        {
+            var c = Volatile.Read(ref columns);
+            long end = Volatile.Read(ref c.Written);
+            long lo = Math.Max(0, end - (c.Length - 1));
+            long hi = end;
+            long ticks = t.Ticks;
+
+            while (lo < hi)
+            {
+                long mid = lo + (hi - lo) / 2;
+                long arrival = c.ArrivalTicks[mid % c.Length];
+
+                // overwritten samples are older than all others
+                if (mid < c.OldestValidPosition() || arrival <= ticks)
+                    lo = mid + 1;
+                else
+                    hi = mid;
+            }
+            return lo;
+        }
+
+        /// <summary>
+        /// computes sum, absolute sum, min, max and variance of a channel over the samples [start, end).
+        /// samples that are not available anymore are excluded.
+        /// </summary>
+        public WindowStatistics Aggregate(SensorChannel channel, long start, long end)
+        {
+            while (true)
+            {
+                var c = Volatile.Read(ref columns);
+                end = Math.Min(end, Volatile.Read(ref c.Written));
+                start = Math.Max(start, end - (c.Length - 1));
+                if (start >= end)
+                    return new WindowStatistics();
+
+                float[] data = c.Data[(int)channel];
+                int offset = (int)(start % c.Length);
+                int count = (int)(end - start);
+                int first = Math.Min(count, c.Length - offset);
+
+                // values are shifted by the first one for a numerically stable variance.
+                // the samples might wrap around the end of the arrays
+                var acc = new Accumulator(data[offset]);
+                acc.Add(data, offset, first);
+                acc.Add(data, 0, count - first);
+
+                // retry without the samples that were overwritten during the computation
+                long oldest = c.OldestValidPosition();
+                if (start >= oldest)
+                    return acc.ToStatistics();
+
+                start = oldest;
+            }
+        }
+
+        /// <summary>
+        /// copies a channel of the samples [start, end) to destination.
+        /// if the oldest samples are not available anymore only the more recent ones are copied.
+        /// </summary>
+        /// <returns>number of samples copied</returns>
+        public int CopyTo(SensorChannel channel, long start, long end, float[] destination)
+        {
+            var c = Volatile.Read(ref columns);
+            return CopyColumn(c, c.Data[(int)channel], start, end, destination);
+        }
+
+        /// <summary>
+        /// copies the sensor timestamps of the samples [start, end) to destination.
+        /// </summary>
+        /// <returns>number of samples copied</returns>
+        public int CopyTimestampsTo(long start, long end, uint[] destination)
+        {
+            var c = Volatile.Read(ref columns);
+            return CopyColumn(c, c.Timestamps, start, end, destination);
+        }
+
+        private static int CopyColumn<T>(Columns c, T[] column, long start, long end, T[] destination)
+        {
+            end = Math.Min(end, Volatile.Read(ref c.Written));
+            start = Math.Max(Math.Max(start, end - destination.Length), end - (c.Length - 1));
+            if (start >= end)
+                return 0;
+
+            // copy in up to two parts, the samples might wrap around the end of the arrays
+            int offset = (int)(start % c.Length);
+            int n = (int)(end - start);
+            int first = Math.Min(n, c.Length - offset);
+            Array.Copy(column, offset, destination, 0, first);
+            Array.Copy(column, 0, destination, first, n - first);
+
+            // drop the samples that were overwritten during the copy
+            int overwritten = (int)Math.Min(n, Math.Max(0, c.OldestValidPosition() - start));
+            if (overwritten > 0)
+            {
+                n -= overwritten;
+                Array.Copy(destination, overwritten, destination, 0, n);
+            }
+            return n;
+        }
+
+        /// <summary>
+        /// running sums of a channel. uses simd if available, otherwise and for the tail
+        /// the loop is unrolled by 4 to break the dependency chains
+        /// </summary>
+        private struct Accumulator
+        {
+            // the float lanes are added to the double sums after this many vectors
+            private const int VECTOR_BLOCK = 64;
+
+            private readonly float shift;
+            private int count;
+            private double sum0, sum1, sum2, sum3;
+            private double abs0, abs1, abs2, abs3;
+            private double sq0, sq1, sq2, sq3;
+            private float min;
+            private float max;
+
+            public Accumulator(float shift)
+            {
+                this = new Accumulator();
+                this.shift = shift;
+                min = float.PositiveInfinity;
+                max = float.NegativeInfinity;
+            }
+
+            public void Add(float[] data, int offset, int n)
+            {
+                int i = offset;
+                int end = offset + n;
+
+                if (Vector.IsHardwareAccelerated)
+                    i = AddVectors(data, i, end);
+
+                for (; i + 4 <= end; i += 4)
+                {
+                    float a = data[i], b = data[i + 1], c = data[i + 2], d = data[i + 3];
+
+                    abs0 += Math.Abs(a); abs1 += Math.Abs(b); abs2 += Math.Abs(c); abs3 += Math.Abs(d);
+                    min = Math.Min(Math.Min(min, a), Math.Min(b, Math.Min(c, d)));
+                    max = Math.Max(Math.Max(max, a), Math.Max(b, Math.Max(c, d)));
+
+                    a -= shift; b -= shift; c -= shift; d -= shift;
+                    sum0 += a; sum1 += b; sum2 += c; sum3 += d;
+                    sq0 += a * a; sq1 += b * b; sq2 += c * c; sq3 += d * d;
+                }
+
+                for (; i < end; i++)
+                {
+                    float a = data[i];
+                    abs0 += Math.Abs(a);
+                    min = Math.Min(min, a);
+                    max = Math.Max(max, a);
+
+                    a -= shift;
+                    sum0 += a;
+                    sq0 += a * a;
+                }
+
+                count += n;
+            }
+
+            /// <returns>the index of the first value not added</returns>
+            private int AddVectors(float[] data, int i, int end)
+            {
+                int width = Vector<float>.Count;
+                if (end - i < width)
+                    return i;
+
+                var vectorShift = new Vector<float>(shift);
+                var vectorMin = new Vector<float>(min);
+                var vectorMax = new Vector<float>(max);
+
+                while (i + width <= end)
+                {
+                    // float sums of a block keep the precision of the scalar loop
+                    var sum = Vector<float>.Zero;
+                    var abs = Vector<float>.Zero;
+                    var sq = Vector<float>.Zero;
+
+                    for (int k = 0; k < VECTOR_BLOCK && i + width <= end; k++, i += width)
+                    {
+                        var v = new Vector<float>(data, i);
+                        abs += Vector.Abs(v);
+                        vectorMin = Vector.Min(vectorMin, v);
+                        vectorMax = Vector.Max(vectorMax, v);
+
+                        v -= vectorShift;
+                        sum += v;
+                        sq += v * v;
+                    }
+
+                    for (int lane = 0; lane < width; lane++)
+                    {
+                        sum0 += sum[lane];
+                        abs0 += abs[lane];
+                        sq0 += sq[lane];
+                    }
+                }
+
+                for (int lane = 0; lane < width; lane++)
+                {
+                    min = Math.Min(min, vectorMin[lane]);
+                    max = Math.Max(max, vectorMax[lane]);
+                }
+
+                return i;
+            }
+
+            public WindowStatistics ToStatistics()
+            {
+                double shiftedSum = sum0 + sum1 + sum2 + sum3;
+                double squares = sq0 + sq1 + sq2 + sq3;
+                double mean = shiftedSum / count;
+                double variance = Math.Max(0, squares / count - mean * mean);
+
+                return new WindowStatistics(count, shiftedSum + (double)shift * count,
+                    abs0 + abs1 + abs2 + abs3, min, max, variance);
+            }
+        }
+    }
+}
@@ -0,0 +1,228 @@
+﻿/*
+Part of Bewegungsfelder
+
+MIT-License
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Text;
+using System.Threading.Tasks;
+
+namespace Bewegungsfelder.Core
+{
+    /// <summary>
+    /// link quality statistics of a single sensor.
+    /// loss, reordering and duplicates are detected using the packet sequence numbers,
+    /// jitter is estimated from sensor timestamps and arrival times of the datagrams (see RFC 3550).
+    /// </summary>
+    public class SensorStatistics
+    {
+        // number of sequence numbers below the highest one that are tracked for duplicates
+        private const int WINDOW_SIZE = 64;
+
+        // larger jumps of the sequence number are treated as a sensor restart
+        private const int RESYNC_DISTANCE = 1000;
+
+        private object padlock = new object();
+
+        private bool hasSequence = false;
+        private int highestSequence;
+        // bit i is set if highestSequence - i was received
+        private ulong receivedWindow;
+
+        private bool hasTimestamp = false;
+        private DateTime lastArrival;
+        private uint lastTimestamp;
+
+        private DateTime rateWindowStart;
+        private int rateWindowCount;
+
+        private long received;
+        private long lost;
+        private long reordered;
+        private long duplicates;
+        private double jitter;
+        private double sampleRate;
+
+        /// <summary>
+        /// total number of values received
+        /// </summary>
+        public long Received { get { lock (padlock) { return received; } } }
+
+        /// <summary>
+        /// number of sequence numbers that were skipped and never arrived late
+        /// </summary>
+        public long Lost { get { lock (padlock) { return lost; } } }
+
+        /// <summary>
+        /// number of values that arrived after a newer one
+        /// </summary>
+        public long Reordered { get { lock (padlock) { return reordered; } } }
+
+        /// <summary>
+        /// number of values that were received more than once
+        /// </summary>
+        public long Duplicates { get { lock (padlock) { return duplicates; } } }
+
+        /// <summary>
+        /// fraction of lost values in [0,1]
+        /// </summary>
+        public double LossRate
+        {
+            get
+            {
+                lock (padlock)
+                {
+                    long expected = received - duplicates + lost;
+                    return expected > 0 ? (double)lost / expected : 0;
+                }
+            }
+        }
+
+        /// <summary>
+        /// smoothed inter-arrival jitter in milliseconds
+        /// </summary>
+        public double Jitter { get { lock (padlock) { return jitter; } } }
+
+        /// <summary>
+        /// number of values received per second, updated once per second
+        /// </summary>
+        public double SampleRate { get { lock (padlock) { return sampleRate; } } }
+
+        /// <summary>
+        /// update the statistics with a newly received value
+        /// </summary>
+        public void Update(SensorValue value)
+        {
+            lock (padlock)
+            {
+                ++received;
+
+                UpdateRate(value.ArrivalTime);
+
+                if (value.HasSequence && !UpdateSequence(value.Sequence))
+                    return; // don't use old values for jitter calculation
+
+                UpdateJitter(value.ArrivalTime, value.SensorTimestamp);
+            }
+        }
+
+        /// <summary>
+        /// resets all counters
+        /// </summary>
+        public void Reset()
+        {
+            lock (padlock)
+            {
+                hasSequence = false;
+                hasTimestamp = false;
+                rateWindowCount = 0;
+                received = lost = reordered = duplicates = 0;
+                jitter = sampleRate = 0;
+            }
+        }
+
+        private void UpdateRate(DateTime arrival)
+        {
+            if (rateWindowCount == 0)
+                rateWindowStart = arrival;
+
+            ++rateWindowCount;
+
+            double elapsed = (arrival - rateWindowStart).TotalSeconds;
+            if (elapsed >= 1)
+            {
+                sampleRate = (rateWindowCount - 1) / elapsed;
+                rateWindowStart = arrival;
+                rateWindowCount = 1;
+            }
+        }
+
+        /// <summary>
+        /// tracks the 16bit sequence number
+        /// </summary>
+        /// <returns>true if the value is the newest received so far</returns>
+        private bool UpdateSequence(int sequence)
+        {
+            // signed distance to the highest sequence number, handles wrap around
+            int delta = (short)(sequence - highestSequence);
+
+            if (!hasSequence || Math.Abs(delta) > RESYNC_DISTANCE)
+            {
+                hasSequence = true;
+                highestSequence = sequence;
+                receivedWindow = 1;
+                return true;
+            }
+
+            if (delta > 0)
+            {
+                lost += delta - 1;
+                receivedWindow = delta < WINDOW_SIZE ? (receivedWindow << delta) | 1 : 1;
+                highestSequence = sequence;
+                return true;
+            }
+
+            int age = -delta;
+            if (age < WINDOW_SIZE && (receivedWindow & (1UL << age)) != 0)
+            {
+                ++duplicates;
+            }
+            else
+            {
+                // arrived late. it was counted as lost when the newer value arrived
+                ++reordered;
+                if (age < WINDOW_SIZE)
+                {
+                    receivedWindow |= 1UL << age;
+                    --lost;
+                }
+            }
+
+            return false;
+        }
+
+        private void UpdateJitter(DateTime arrival, uint timestamp)
+        {
+            // the samples of a batched datagram share its arrival time.
+            // only the first one tells when the datagram was sent
+            if (hasTimestamp && arrival == lastArrival)
+                return;
+
+            if (hasTimestamp)
+            {
+                // difference of the transit times of two consecutive values.
+                // sensor timestamps are in microseconds
+                double arrivalDelta = (arrival - lastArrival).TotalMilliseconds;
+                double sensorDelta = unchecked((int)(timestamp - lastTimestamp)) / 1000.0;
+                double d = Math.Abs(arrivalDelta - sensorDelta);
+
+                jitter += (d - jitter) / 16;
+            }
+
+            hasTimestamp = true;
+            lastArrival = arrival;
+            lastTimestamp = timestamp;
+        }
+    }
+}
@@ -0,0 +1,114 @@
+﻿/*
+Part of Bewegungsfelder
+
+MIT-License
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Text;
+using System.Threading.Tasks;
+
+namespace Bewegungsfelder.Core
+{
+    /// <summary>
+    /// latency statistics of the firmware's processing stages, sent periodically by a sensor.
+    /// all statistics cover the time since the previous telemetry datagram.
+    /// </summary>
+    public class SensorTelemetry
+    {
+        /// <summary>
+        /// names of the stages in the order they are sent (see enum telemetry_stage in sensor_packet.h)
+        /// </summary>
+        public static readonly string[] STAGE_NAMES = { "post", "read", "send", "total" };
+
+        /// <summary>
+        /// timing of a single stage, in microseconds
+        /// </summary>
+        public class Stage
+        {
+            public string Name { get; }
+            public uint Count { get; }
+            public uint Min { get; }
+            public uint Max { get; }
+            public uint Total { get; }
+
+            /// <summary>
+            /// bucket 0 counts durations below 16us, bucket i durations in [2^(i+3), 2^(i+4)) us,
+            /// the last bucket everything above
+            /// </summary>
+            public IReadOnlyList<ushort> Histogram { get; }
+
+            public double Average { get { return Count > 0 ? (double)Total / Count : 0; } }
+
+            public Stage(string name, uint count, uint min, uint max, uint total, ushort[] histogram)
+            {
+                Name = name;
+                Count = count;
+                Min = min;
+                Max = max;
+                Total = total;
+                Histogram = histogram;
+            }
+
+            /// <summary>
+            /// returns the lower bound of a histogram bucket in microseconds
+            /// </summary>
+            public static uint GetBucketStart(int bucket)
+            {
+                return bucket == 0 ? 0 : 8u << bucket;
+            }
+
+            public override string ToString()
+            {
+                var buckets = Histogram.Select((n, i) => n > 0 ? $"{GetBucketStart(i)}us+: {n}" : null)
+                    .Where(s => s != null);
+                return $"{Name}: {Count}x {Min}/{Average:F0}/{Max} us min/avg/max [{string.Join(", ", buckets)}]";
+            }
+        }
+
+        public int SensorId { get; }
+
+        /// <summary>
+        /// interrupts that were lost because the firmware's task queue was full
+        /// </summary>
+        public int FailedPosts { get; }
+
+        public int FifoOverflows { get; }
+
+        public IReadOnlyList<Stage> Stages { get; }
+
+        public SensorTelemetry(int sensorId, int failedPosts, int fifoOverflows, Stage[] stages)
+        {
+            SensorId = sensorId;
+            FailedPosts = failedPosts;
+            FifoOverflows = fifoOverflows;
+            Stages = stages;
+        }
+
+        public override string ToString()
+        {
+            return $"Sensor {SensorId} telemetry: {FailedPosts} failed posts, {FifoOverflows} fifo overflows; " +
+                string.Join("; ", Stages);
+        }
+    }
+}
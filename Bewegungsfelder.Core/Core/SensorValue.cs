@@ -28,12 +28,21 @@ using System.Collections.Generic;
 using System.Linq;
 using System.Text;
 using System.Threading.Tasks;
-using System.Windows.Media.Media3D;
+using Bewegungsfelder.Mathematics;
 
 namespace Bewegungsfelder.Core
 {
-    public class SensorValue
+    /// <summary>
+    /// a single immutable sensor reading.
+    /// value type so the receive path doesn't allocate per sample.
+    /// </summary>
+    public struct SensorValue
     {
+        /// <summary>
+        /// sequence number for values from sources that don't send one
+        /// </summary>
+        public const int NO_SEQUENCE = -1;
+
         public Vector3D Acceleration { get; }
         public Vector3D Gyro { get; }
         public Quaternion Orientation { get; }
@@ -44,13 +53,22 @@ namespace Bewegungsfelder.Core
         /// </summary>
         public uint SensorTimestamp { get; }
 
-        public SensorValue(Quaternion orientation, Vector3D acceleration, Vector3D gyro, DateTime arrivalTime, uint sensorTime)
+        /// <summary>
+        /// the 16bit per-sensor sequence number or NO_SEQUENCE
+        /// </summary>
+        public int Sequence { get; }
+
+        public bool HasSequence { get { return Sequence != NO_SEQUENCE; } }
+
+        public SensorValue(Quaternion orientation, Vector3D acceleration, Vector3D gyro, DateTime arrivalTime, uint sensorTime,
+            int sequence = NO_SEQUENCE)
         {
             Orientation = orientation;
             ArrivalTime = arrivalTime;
             Acceleration = acceleration;
             Gyro = gyro;
             SensorTimestamp = sensorTime;
+            Sequence = sequence;
         }
     }
 }
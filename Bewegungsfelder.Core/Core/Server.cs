@@ -0,0 +1,249 @@
+﻿/*
+Part of Bewegungsfelder 
+
+MIT-License 
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+
+*/
+using System;
+using System.Collections.Concurrent;
+using System.Collections.Generic;
+using System.Linq;
+using System.Net.Sockets;
+using System.Text;
+using System.Threading;
+using System.Threading.Tasks;
+using Bewegungsfelder.Mathematics;
+using System.Diagnostics;
+using Fleck;
+using System.Net;
+
+namespace Bewegungsfelder.Core
+{
+    public class Server
+    {
+        // used for both udp and tcp (websocket) server.
+        public const int DATA_PORT = 5555;
+
+        // large enough for any udp datagram
+        private const int RECEIVE_BUFFER_SIZE = ushort.MaxValue;
+
+        // interval of the ingest throughput log messages
+        private static readonly TimeSpan INGEST_REPORT_INTERVAL = TimeSpan.FromSeconds(10);
+
+        public ConcurrentDictionary<int, Sensor> Sensors { get; } = new ConcurrentDictionary<int, Sensor>();
+
+        // sensors indexed by id, avoids the dictionary lookup for each datagram.
+        // sensor ids of the current wire format are single bytes
+        private readonly Sensor[] sensorCache = new Sensor[byte.MaxValue + 1];
+
+        // the synchronisation context that was used when the server was started.
+        // used to invoke events on the main thread. null if started without one
+        private SynchronizationContext startedContext;
+
+        // only one receive operation is pending at any time,
+        // so the receive args are reused for every datagram
+        private Socket udpSocket;
+        private SocketAsyncEventArgs udpReceiveArgs;
+
+        // decodes the received datagrams. leaves cores for receiving and the ui
+        private IngestPipeline ingest;
+
+        private Stopwatch ingestWatch;
+        private long ingestDatagrams;
+        private long ingestValues;
+        private long ingestDropped;
+        private long ingestFailed;
+        private int ingestGen0Collections;
+
+        private WebSocketServer webSocketServer;
+
+        public event Action<Sensor> SensorAdded;
+
+        public void Start()
+        {
+            if (udpSocket != null)
+                throw new InvalidOperationException("Server is already running");
+
+            // start udp listener
+            startedContext = SynchronizationContext.Current;
+            StartUdpListener();
+
+            // start websocket server
+            webSocketServer = new WebSocketServer($"ws://0.0.0.0:{DATA_PORT}");
+            webSocketServer.Start(OnWebsocketConnection);
+        }
+
+        private void OnWebsocketConnection(IWebSocketConnection socket)
+        {
+            socket.OnOpen = () => Debug.WriteLine(
+                $"Websocket client {socket.ConnectionInfo.ClientIpAddress} connected.");
+            socket.OnClose = () => Debug.WriteLine(
+                $"Websocket client {socket.ConnectionInfo.ClientIpAddress} disconnected.");
+
+            socket.OnMessage = msg =>
+            {
+                Debug.WriteLine($"Websocket msg from {socket.ConnectionInfo.ClientIpAddress}: {msg}");
+
+                var tokens = msg.Split(',');
+
+                int sensorId = Int32.Parse(tokens[0]);
+                var quat = new Quaternion();
+                var accel = new Vector3D();
+                var gyro = new Vector3D();
+
+                quat.W = float.Parse(tokens[1]);
+                quat.X = float.Parse(tokens[2]);
+                quat.Y = float.Parse(tokens[3]);
+                quat.Z = float.Parse(tokens[4]);
+                accel.X = float.Parse(tokens[5]);
+                accel.Y = float.Parse(tokens[6]);
+                accel.Z = float.Parse(tokens[7]);
+                gyro.X = float.Parse(tokens[8]);
+                gyro.Y = float.Parse(tokens[9]);
+                gyro.Z = float.Parse(tokens[10]);
+                uint timestamp = (uint)ulong.Parse(tokens[11]);
+
+                var value = new SensorValue(quat, accel, gyro, DateTime.Now, timestamp);
+                var sourceAddr = IPAddress.Parse(socket.ConnectionInfo.ClientIpAddress);
+
+                // pushed by the ingest worker of the sensor, like the values received over udp
+                ingest.Post(sensorId, sourceAddr, value);
+            };
+
+        }
+
+        /// <summary>
+        /// returns the sensor with the given id. creates a new sensor and raises
+        /// SensorAdded if the id is unknown. thread safe.
+        /// </summary>
+        private Sensor GetOrAddSensor(int id, IPAddress source)
+        {
+            bool cacheable = id >= 0 && id < sensorCache.Length;
+            Sensor sensor = cacheable ? Volatile.Read(ref sensorCache[id]) : null;
+            if (sensor != null)
+                return sensor;
+
+            if (!Sensors.TryGetValue(id, out sensor))
+            {
+                var newSensor = new Sensor(source, id);
+                sensor = Sensors.GetOrAdd(id, newSensor);
+
+                // raises the sensor added event on the main thread
+                if (sensor == newSensor)
+                    RaiseSensorAdded(newSensor);
+            }
+
+            if (cacheable)
+                Volatile.Write(ref sensorCache[id], sensor);
+
+            return sensor;
+        }
+
+        /// <summary>
+        /// raises SensorAdded asynchronously on the context the server was started on,
+        /// or on the thread pool if there was none (e.g. in a console host)
+        /// </summary>
+        private void RaiseSensorAdded(Sensor sensor)
+        {
+            SendOrPostCallback raise = state => SensorAdded?.Invoke((Sensor)state);
+
+            if (startedContext != null)
+                startedContext.Post(raise, sensor);
+            else
+                ThreadPool.QueueUserWorkItem(state => raise(state), sensor);
+        }
+
+        private void StartUdpListener()
+        {
+            udpSocket = new Socket(AddressFamily.InterNetwork, SocketType.Dgram, ProtocolType.Udp);
+            udpSocket.Bind(new IPEndPoint(IPAddress.Any, DATA_PORT));
+
+            udpReceiveArgs = new SocketAsyncEventArgs();
+            udpReceiveArgs.SetBuffer(new byte[RECEIVE_BUFFER_SIZE], 0, RECEIVE_BUFFER_SIZE);
+            udpReceiveArgs.RemoteEndPoint = new IPEndPoint(IPAddress.Any, 0);
+            udpReceiveArgs.Completed += OnUdpReceiveCompleted;
+
+            ingest = new IngestPipeline(Math.Max(1, Environment.ProcessorCount / 2), GetOrAddSensor);
+
+            ingestWatch = Stopwatch.StartNew();
+            ingestGen0Collections = GC.CollectionCount(0);
+
+            ReceiveUdp();
+        }
+
+        private void OnUdpReceiveCompleted(object sender, SocketAsyncEventArgs e)
+        {
+            HandleDatagram(e);
+            ReceiveUdp();
+        }
+
+        /// <summary>
+        /// starts receive operations until one is pending.
+        /// the completed event is not raised for operations that complete synchronously.
+        /// </summary>
+        private void ReceiveUdp()
+        {
+            while (!udpSocket.ReceiveFromAsync(udpReceiveArgs))
+            {
+                HandleDatagram(udpReceiveArgs);
+            }
+        }
+
+        private void HandleDatagram(SocketAsyncEventArgs e)
+        {
+            if (e.SocketError != SocketError.Success)
+            {
+                Debug.WriteLine($"Udp receive failed: {e.SocketError}");
+                return;
+            }
+
+            ingest.Post(e.Buffer, e.BytesTransferred, (IPEndPoint)e.RemoteEndPoint, DateTime.Now);
+
+            ++ingestDatagrams;
+            if (ingestWatch.Elapsed >= INGEST_REPORT_INTERVAL)
+                ReportIngestStatistics();
+        }
+
+        /// <summary>
+        /// logs the udp throughput, dropped datagrams and the number of gen0 collections since the last report
+        /// </summary>
+        private void ReportIngestStatistics()
+        {
+            double seconds = ingestWatch.Elapsed.TotalSeconds;
+            int gen0Collections = GC.CollectionCount(0);
+            long values = ingest.DecodedValues;
+            long dropped = ingest.Dropped;
+            long failed = ingest.Failed;
+
+            Debug.WriteLine($"Udp ingest ({ingest.WorkerCount} workers): {ingestDatagrams / seconds:F0} datagrams/s, " +
+                $"{(values - ingestValues) / seconds:F0} values/s, {dropped - ingestDropped} dropped, " +
+                $"{failed - ingestFailed} failed, {gen0Collections - ingestGen0Collections} gen0 collections");
+
+            ingestDatagrams = 0;
+            ingestValues = values;
+            ingestDropped = dropped;
+            ingestFailed = failed;
+            ingestGen0Collections = gen0Collections;
+            ingestWatch.Restart();
+        }
+    }
+}
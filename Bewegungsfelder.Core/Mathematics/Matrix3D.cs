@@ -0,0 +1,271 @@
+﻿/*
+Part of Bewegungsfelder
+
+MIT-License
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using System;
+using System.Globalization;
+using System.Linq;
+
+namespace Bewegungsfelder.Mathematics
+{
+    /// <summary>
+    /// a double precision 4x4 transformation matrix for row vectors (v' = v * M).
+    /// mirrors System.Windows.Media.Media3D.Matrix3D, including default(Matrix3D) being the identity
+    /// </summary>
+    public struct Matrix3D : IEquatable<Matrix3D>
+    {
+        private double m11;
+        private double m12;
+        private double m13;
+        private double m14;
+        private double m21;
+        private double m22;
+        private double m23;
+        private double m24;
+        private double m31;
+        private double m32;
+        private double m33;
+        private double m34;
+        private double offsetX;
+        private double offsetY;
+        private double offsetZ;
+        private double m44;
+
+        // false for default(Matrix3D), which then represents the identity regardless of the fields
+        private bool isNotIdentity;
+
+        public static Matrix3D Identity { get { return new Matrix3D(); } }
+
+        public double M11 { get { return isNotIdentity ? m11 : 1.0; } set { Materialize(); m11 = value; } }
+        public double M12 { get { return m12; } set { Materialize(); m12 = value; } }
+        public double M13 { get { return m13; } set { Materialize(); m13 = value; } }
+        public double M14 { get { return m14; } set { Materialize(); m14 = value; } }
+        public double M21 { get { return m21; } set { Materialize(); m21 = value; } }
+        public double M22 { get { return isNotIdentity ? m22 : 1.0; } set { Materialize(); m22 = value; } }
+        public double M23 { get { return m23; } set { Materialize(); m23 = value; } }
+        public double M24 { get { return m24; } set { Materialize(); m24 = value; } }
+        public double M31 { get { return m31; } set { Materialize(); m31 = value; } }
+        public double M32 { get { return m32; } set { Materialize(); m32 = value; } }
+        public double M33 { get { return isNotIdentity ? m33 : 1.0; } set { Materialize(); m33 = value; } }
+        public double M34 { get { return m34; } set { Materialize(); m34 = value; } }
+        public double OffsetX { get { return offsetX; } set { Materialize(); offsetX = value; } }
+        public double OffsetY { get { return offsetY; } set { Materialize(); offsetY = value; } }
+        public double OffsetZ { get { return offsetZ; } set { Materialize(); offsetZ = value; } }
+        public double M44 { get { return isNotIdentity ? m44 : 1.0; } set { Materialize(); m44 = value; } }
+
+        public Matrix3D(
+            double m11, double m12, double m13, double m14,
+            double m21, double m22, double m23, double m24,
+            double m31, double m32, double m33, double m34,
+            double offsetX, double offsetY, double offsetZ, double m44)
+        {
+            this.m11 = m11;
+            this.m12 = m12;
+            this.m13 = m13;
+            this.m14 = m14;
+            this.m21 = m21;
+            this.m22 = m22;
+            this.m23 = m23;
+            this.m24 = m24;
+            this.m31 = m31;
+            this.m32 = m32;
+            this.m33 = m33;
+            this.m34 = m34;
+            this.offsetX = offsetX;
+            this.offsetY = offsetY;
+            this.offsetZ = offsetZ;
+            this.m44 = m44;
+            isNotIdentity = true;
+        }
+
+        public bool IsIdentity
+        {
+            get
+            {
+                return !isNotIdentity || (
+                    m11 == 1 && m12 == 0 && m13 == 0 && m14 == 0 &&
+                    m21 == 0 && m22 == 1 && m23 == 0 && m24 == 0 &&
+                    m31 == 0 && m32 == 0 && m33 == 1 && m34 == 0 &&
+                    offsetX == 0 && offsetY == 0 && offsetZ == 0 && m44 == 1);
+            }
+        }
+
+        /// <summary>
+        /// appends a rotation around the origin
+        /// </summary>
+        public void Rotate(Quaternion quaternion)
+        {
+            this *= CreateRotationMatrix(quaternion);
+        }
+
+        /// <summary>
+        /// appends a translation
+        /// </summary>
+        public void Translate(Vector3D offset)
+        {
+            this *= new Matrix3D(
+                1, 0, 0, 0,
+                0, 1, 0, 0,
+                0, 0, 1, 0,
+                offset.X, offset.Y, offset.Z, 1);
+        }
+
+        /// <summary>
+        /// this = this * matrix
+        /// </summary>
+        public void Append(Matrix3D matrix)
+        {
+            this *= matrix;
+        }
+
+        /// <summary>
+        /// this = matrix * this
+        /// </summary>
+        public void Prepend(Matrix3D matrix)
+        {
+            this = matrix * this;
+        }
+
+        /// <summary>
+        /// transforms a direction vector. the translation part is ignored
+        /// </summary>
+        public Vector3D Transform(Vector3D vector)
+        {
+            if (!isNotIdentity)
+                return vector;
+
+            return new Vector3D(
+                vector.X * m11 + vector.Y * m21 + vector.Z * m31,
+                vector.X * m12 + vector.Y * m22 + vector.Z * m32,
+                vector.X * m13 + vector.Y * m23 + vector.Z * m33);
+        }
+
+        public static Matrix3D operator *(Matrix3D a, Matrix3D b)
+        {
+            if (!a.isNotIdentity)
+                return b;
+            if (!b.isNotIdentity)
+                return a;
+
+            return new Matrix3D(
+                a.m11 * b.m11 + a.m12 * b.m21 + a.m13 * b.m31 + a.m14 * b.offsetX,
+                a.m11 * b.m12 + a.m12 * b.m22 + a.m13 * b.m32 + a.m14 * b.offsetY,
+                a.m11 * b.m13 + a.m12 * b.m23 + a.m13 * b.m33 + a.m14 * b.offsetZ,
+                a.m11 * b.m14 + a.m12 * b.m24 + a.m13 * b.m34 + a.m14 * b.m44,
+                a.m21 * b.m11 + a.m22 * b.m21 + a.m23 * b.m31 + a.m24 * b.offsetX,
+                a.m21 * b.m12 + a.m22 * b.m22 + a.m23 * b.m32 + a.m24 * b.offsetY,
+                a.m21 * b.m13 + a.m22 * b.m23 + a.m23 * b.m33 + a.m24 * b.offsetZ,
+                a.m21 * b.m14 + a.m22 * b.m24 + a.m23 * b.m34 + a.m24 * b.m44,
+                a.m31 * b.m11 + a.m32 * b.m21 + a.m33 * b.m31 + a.m34 * b.offsetX,
+                a.m31 * b.m12 + a.m32 * b.m22 + a.m33 * b.m32 + a.m34 * b.offsetY,
+                a.m31 * b.m13 + a.m32 * b.m23 + a.m33 * b.m33 + a.m34 * b.offsetZ,
+                a.m31 * b.m14 + a.m32 * b.m24 + a.m33 * b.m34 + a.m34 * b.m44,
+                a.offsetX * b.m11 + a.offsetY * b.m21 + a.offsetZ * b.m31 + a.m44 * b.offsetX,
+                a.offsetX * b.m12 + a.offsetY * b.m22 + a.offsetZ * b.m32 + a.m44 * b.offsetY,
+                a.offsetX * b.m13 + a.offsetY * b.m23 + a.offsetZ * b.m33 + a.m44 * b.offsetZ,
+                a.offsetX * b.m14 + a.offsetY * b.m24 + a.offsetZ * b.m34 + a.m44 * b.m44);
+        }
+
+        public static bool operator ==(Matrix3D a, Matrix3D b)
+        {
+            if (!a.isNotIdentity || !b.isNotIdentity)
+                return a.IsIdentity == b.IsIdentity;
+
+            return
+                a.m11 == b.m11 && a.m12 == b.m12 && a.m13 == b.m13 && a.m14 == b.m14 &&
+                a.m21 == b.m21 && a.m22 == b.m22 && a.m23 == b.m23 && a.m24 == b.m24 &&
+                a.m31 == b.m31 && a.m32 == b.m32 && a.m33 == b.m33 && a.m34 == b.m34 &&
+                a.offsetX == b.offsetX && a.offsetY == b.offsetY && a.offsetZ == b.offsetZ && a.m44 == b.m44;
+        }
+
+        public static bool operator !=(Matrix3D a, Matrix3D b)
+        {
+            return !(a == b);
+        }
+
+        public bool Equals(Matrix3D other)
+        {
+            return this == other;
+        }
+
+        public override bool Equals(object obj)
+        {
+            return obj is Matrix3D && this == (Matrix3D)obj;
+        }
+
+        public override int GetHashCode()
+        {
+            if (IsIdentity)
+                return 0;
+
+            return
+                m11.GetHashCode() ^ m12.GetHashCode() ^ m13.GetHashCode() ^ m14.GetHashCode() ^
+                m21.GetHashCode() ^ m22.GetHashCode() ^ m23.GetHashCode() ^ m24.GetHashCode() ^
+                m31.GetHashCode() ^ m32.GetHashCode() ^ m33.GetHashCode() ^ m34.GetHashCode() ^
+                offsetX.GetHashCode() ^ offsetY.GetHashCode() ^ offsetZ.GetHashCode() ^ m44.GetHashCode();
+        }
+
+        public override string ToString()
+        {
+            if (IsIdentity)
+                return "Identity";
+
+            var culture = CultureInfo.CurrentCulture;
+            var separator = culture.NumberFormat.NumberDecimalSeparator == "," ? ";" : ",";
+            return string.Join(separator, new[]
+            {
+                m11, m12, m13, m14, m21, m22, m23, m24, m31, m32, m33, m34, offsetX, offsetY, offsetZ, m44
+            }.Select(v => v.ToString(culture)));
+        }
+
+        /// <summary>
+        /// builds the rotation matrix for a quaternion. same element layout as wpf's Matrix3D.Rotate
+        /// </summary>
+        private static Matrix3D CreateRotationMatrix(Quaternion quaternion)
+        {
+            double x = quaternion.X, y = quaternion.Y, z = quaternion.Z, w = quaternion.W;
+            double x2 = x + x, y2 = y + y, z2 = z + z;
+            double xx = x * x2, xy = x * y2, xz = x * z2;
+            double yy = y * y2, yz = y * z2, zz = z * z2;
+            double wx = w * x2, wy = w * y2, wz = w * z2;
+
+            return new Matrix3D(
+                1.0 - (yy + zz), xy + wz, xz - wy, 0,
+                xy - wz, 1.0 - (xx + zz), yz + wx, 0,
+                xz + wy, yz - wx, 1.0 - (xx + yy), 0,
+                0, 0, 0, 1);
+        }
+
+        /// <summary>
+        /// turns the implicit identity of default(Matrix3D) into explicit elements before one of them is set
+        /// </summary>
+        private void Materialize()
+        {
+            if (isNotIdentity)
+                return;
+
+            m11 = m22 = m33 = m44 = 1;
+            isNotIdentity = true;
+        }
+    }
+}
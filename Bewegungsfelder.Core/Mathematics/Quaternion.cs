@@ -0,0 +1,235 @@
+﻿/*
+Part of Bewegungsfelder
+
+MIT-License
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using System;
+using System.Globalization;
+
+namespace Bewegungsfelder.Mathematics
+{
+    /// <summary>
+    /// a double precision rotation quaternion.
+    /// mirrors System.Windows.Media.Media3D.Quaternion, including default(Quaternion) being the identity
+    /// </summary>
+    public struct Quaternion : IEquatable<Quaternion>
+    {
+        private double x;
+        private double y;
+        private double z;
+        private double w;
+
+        // false for default(Quaternion), which then represents the identity regardless of the fields
+        private bool isNotIdentity;
+
+        public static Quaternion Identity { get { return new Quaternion(); } }
+
+        public double X { get { return x; } set { Materialize(); x = value; } }
+        public double Y { get { return y; } set { Materialize(); y = value; } }
+        public double Z { get { return z; } set { Materialize(); z = value; } }
+        public double W { get { return isNotIdentity ? w : 1.0; } set { Materialize(); w = value; } }
+
+        public Quaternion(double x, double y, double z, double w)
+        {
+            this.x = x;
+            this.y = y;
+            this.z = z;
+            this.w = w;
+            isNotIdentity = true;
+        }
+
+        /// <summary>
+        /// creates a rotation around the given axis
+        /// </summary>
+        /// <param name="axisOfRotation">the rotation axis. must not be a zero vector</param>
+        /// <param name="angleInDegrees">the rotation angle in degrees</param>
+        public Quaternion(Vector3D axisOfRotation, double angleInDegrees)
+        {
+            double length = axisOfRotation.Length;
+            if (length == 0)
+                throw new InvalidOperationException("Zero axis of rotation specified");
+
+            double halfAngle = 0.5 * (angleInDegrees % 360.0) * (Math.PI / 180.0);
+            var v = axisOfRotation * (Math.Sin(halfAngle) / length);
+
+            x = v.X;
+            y = v.Y;
+            z = v.Z;
+            w = Math.Cos(halfAngle);
+            isNotIdentity = true;
+        }
+
+        public bool IsIdentity { get { return !isNotIdentity || (x == 0 && y == 0 && z == 0 && w == 1); } }
+
+        public bool IsNormalized
+        {
+            get
+            {
+                if (!isNotIdentity)
+                    return true;
+
+                double norm2 = x * x + y * y + z * z + w * w;
+                return Math.Abs(norm2 - 1) < 1e-15;
+            }
+        }
+
+        /// <summary>
+        /// the normalized rotation axis. (0,1,0) for the identity
+        /// </summary>
+        public Vector3D Axis
+        {
+            get
+            {
+                if (!isNotIdentity || (x == 0 && y == 0 && z == 0))
+                    return new Vector3D(0, 1, 0);
+
+                var v = new Vector3D(x, y, z);
+                v.Normalize();
+                return v;
+            }
+        }
+
+        /// <summary>
+        /// the rotation angle in degrees
+        /// </summary>
+        public double Angle
+        {
+            get
+            {
+                if (!isNotIdentity)
+                    return 0;
+
+                double sin = Math.Sqrt(x * x + y * y + z * z);
+                return Math.Atan2(sin, w) * (360.0 / Math.PI);
+            }
+        }
+
+        public void Conjugate()
+        {
+            if (!isNotIdentity)
+                return;
+
+            x = -x;
+            y = -y;
+            z = -z;
+        }
+
+        public void Invert()
+        {
+            if (!isNotIdentity)
+                return;
+
+            Conjugate();
+            double norm2 = x * x + y * y + z * z + w * w;
+            x /= norm2;
+            y /= norm2;
+            z /= norm2;
+            w /= norm2;
+        }
+
+        public void Normalize()
+        {
+            if (!isNotIdentity)
+                return;
+
+            double norm2 = x * x + y * y + z * z + w * w;
+            if (double.IsInfinity(norm2))
+            {
+                // rescale before squaring so huge components don't overflow
+                double max = Math.Max(Math.Max(Math.Abs(x), Math.Abs(y)), Math.Max(Math.Abs(z), Math.Abs(w)));
+                x /= max;
+                y /= max;
+                z /= max;
+                w /= max;
+                norm2 = x * x + y * y + z * z + w * w;
+            }
+
+            double norm = Math.Sqrt(norm2);
+            x /= norm;
+            y /= norm;
+            z /= norm;
+            w /= norm;
+        }
+
+        public static Quaternion operator *(Quaternion left, Quaternion right)
+        {
+            if (!left.isNotIdentity)
+                return right;
+            if (!right.isNotIdentity)
+                return left;
+
+            return new Quaternion(
+                left.w * right.x + left.x * right.w + left.y * right.z - left.z * right.y,
+                left.w * right.y + left.y * right.w + left.z * right.x - left.x * right.z,
+                left.w * right.z + left.z * right.w + left.x * right.y - left.y * right.x,
+                left.w * right.w - left.x * right.x - left.y * right.y - left.z * right.z);
+        }
+
+        public static bool operator ==(Quaternion a, Quaternion b)
+        {
+            return a.X == b.X && a.Y == b.Y && a.Z == b.Z && a.W == b.W;
+        }
+
+        public static bool operator !=(Quaternion a, Quaternion b)
+        {
+            return !(a == b);
+        }
+
+        public bool Equals(Quaternion other)
+        {
+            return X.Equals(other.X) && Y.Equals(other.Y) && Z.Equals(other.Z) && W.Equals(other.W);
+        }
+
+        public override bool Equals(object obj)
+        {
+            return obj is Quaternion && Equals((Quaternion)obj);
+        }
+
+        public override int GetHashCode()
+        {
+            return X.GetHashCode() ^ Y.GetHashCode() ^ Z.GetHashCode() ^ W.GetHashCode();
+        }
+
+        public override string ToString()
+        {
+            if (!isNotIdentity)
+                return "Identity";
+
+            var culture = CultureInfo.CurrentCulture;
+            var separator = culture.NumberFormat.NumberDecimalSeparator == "," ? ";" : ",";
+            return string.Format(culture, "{0}{4}{1}{4}{2}{4}{3}", x, y, z, w, separator);
+        }
+
+        /// <summary>
+        /// turns the implicit identity of default(Quaternion) into explicit components before one of them is set
+        /// </summary>
+        private void Materialize()
+        {
+            if (isNotIdentity)
+                return;
+
+            x = y = z = 0;
+            w = 1;
+            isNotIdentity = true;
+        }
+    }
+}
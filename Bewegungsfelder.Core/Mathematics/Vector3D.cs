@@ -0,0 +1,160 @@
+﻿/*
+Part of Bewegungsfelder
+
+MIT-License
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using System;
+using System.Globalization;
+
+namespace Bewegungsfelder.Mathematics
+{
+    /// <summary>
+    /// a double precision 3d vector.
+    /// mirrors System.Windows.Media.Media3D.Vector3D so the core library doesn't depend on wpf.
+    /// </summary>
+    public struct Vector3D : IEquatable<Vector3D>
+    {
+        private double x;
+        private double y;
+        private double z;
+
+        public double X { get { return x; } set { x = value; } }
+        public double Y { get { return y; } set { y = value; } }
+        public double Z { get { return z; } set { z = value; } }
+
+        public Vector3D(double x, double y, double z)
+        {
+            this.x = x;
+            this.y = y;
+            this.z = z;
+        }
+
+        public double Length { get { return Math.Sqrt(x * x + y * y + z * z); } }
+
+        public double LengthSquared { get { return x * x + y * y + z * z; } }
+
+        /// <summary>
+        /// scales this vector to unit length. a zero vector becomes NaN
+        /// </summary>
+        public void Normalize()
+        {
+            // scale by the largest component first so the squares can't overflow
+            double max = Math.Max(Math.Abs(x), Math.Max(Math.Abs(y), Math.Abs(z)));
+            this /= max;
+            this /= Length;
+        }
+
+        public static double DotProduct(Vector3D a, Vector3D b)
+        {
+            return a.x * b.x + a.y * b.y + a.z * b.z;
+        }
+
+        public static Vector3D CrossProduct(Vector3D a, Vector3D b)
+        {
+            return new Vector3D(
+                a.y * b.z - a.z * b.y,
+                a.z * b.x - a.x * b.z,
+                a.x * b.y - a.y * b.x);
+        }
+
+        /// <summary>
+        /// the angle between two vectors in degrees
+        /// </summary>
+        public static double AngleBetween(Vector3D a, Vector3D b)
+        {
+            a.Normalize();
+            b.Normalize();
+
+            // the half-chord formulation stays accurate for nearly (anti)parallel vectors where acos doesn't
+            double theta;
+            if (DotProduct(a, b) < 0)
+                theta = Math.PI - 2.0 * Math.Asin((-a - b).Length / 2.0);
+            else
+                theta = 2.0 * Math.Asin((a - b).Length / 2.0);
+
+            return theta * (180.0 / Math.PI);
+        }
+
+        public static Vector3D operator +(Vector3D a, Vector3D b)
+        {
+            return new Vector3D(a.x + b.x, a.y + b.y, a.z + b.z);
+        }
+
+        public static Vector3D operator -(Vector3D a, Vector3D b)
+        {
+            return new Vector3D(a.x - b.x, a.y - b.y, a.z - b.z);
+        }
+
+        public static Vector3D operator -(Vector3D v)
+        {
+            return new Vector3D(-v.x, -v.y, -v.z);
+        }
+
+        public static Vector3D operator *(Vector3D v, double scalar)
+        {
+            return new Vector3D(v.x * scalar, v.y * scalar, v.z * scalar);
+        }
+
+        public static Vector3D operator *(double scalar, Vector3D v)
+        {
+            return new Vector3D(v.x * scalar, v.y * scalar, v.z * scalar);
+        }
+
+        public static Vector3D operator /(Vector3D v, double scalar)
+        {
+            return v * (1.0 / scalar);
+        }
+
+        public static bool operator ==(Vector3D a, Vector3D b)
+        {
+            return a.x == b.x && a.y == b.y && a.z == b.z;
+        }
+
+        public static bool operator !=(Vector3D a, Vector3D b)
+        {
+            return !(a == b);
+        }
+
+        public bool Equals(Vector3D other)
+        {
+            return x.Equals(other.x) && y.Equals(other.y) && z.Equals(other.z);
+        }
+
+        public override bool Equals(object obj)
+        {
+            return obj is Vector3D && Equals((Vector3D)obj);
+        }
+
+        public override int GetHashCode()
+        {
+            return x.GetHashCode() ^ y.GetHashCode() ^ z.GetHashCode();
+        }
+
+        public override string ToString()
+        {
+            // same list separator as wpf: ';' for cultures that use ',' as decimal separator
+            var culture = CultureInfo.CurrentCulture;
+            var separator = culture.NumberFormat.NumberDecimalSeparator == "," ? ";" : ",";
+            return string.Format(culture, "{0}{3}{1}{3}{2}", x, y, z, separator);
+        }
+    }
+}
@@ -0,0 +1,39 @@
+﻿using System.Reflection;
+using System.Runtime.CompilerServices;
+using System.Runtime.InteropServices;
+
+// General Information about an assembly is controlled through the following 
+// set of attributes. Change these attribute values to modify the information
+// associated with an assembly.
+[assembly: AssemblyTitle("Bewegungsfelder.Core")]
+[assembly: AssemblyDescription("Inertial Motion Capture - sensor server, kinematics and file formats")]
+[assembly: AssemblyConfiguration("")]
+[assembly: AssemblyCompany("Ivo Herzig")]
+[assembly: AssemblyProduct("Bewegungsfelder")]
+[assembly: AssemblyCopyright("Copyright ©  2016 Ivo Herzig")]
+[assembly: AssemblyTrademark("")]
+[assembly: AssemblyCulture("")]
+
+// Setting ComVisible to false makes the types in this assembly not visible 
+// to COM components.  If you need to access a type in this assembly from 
+// COM, set the ComVisible attribute to true on that type.
+[assembly: ComVisible(false)]
+
+// the tests call the sequential and the parallel bvh parser directly
+[assembly: InternalsVisibleTo("Bewegungsfelder.Tests")]
+
+// The following GUID is for the ID of the typelib if this project is exposed to COM
+[assembly: Guid("741b3a4b-c76a-45b5-a662-e4d451a6e003")]
+
+// Version information for an assembly consists of the following four values:
+//
+//      Major Version
+//      Minor Version 
+//      Build Number
+//      Revision
+//
+// You can specify all the values or you can default the Build and Revision Numbers 
+// by using the '*' as shown below:
+// [assembly: AssemblyVersion("1.0.*")]
+[assembly: AssemblyVersion("1.0.0.0")]
+[assembly: AssemblyFileVersion("1.0.0.0")]
@@ -1,7 +1,7 @@
 ﻿/*
-Part of Bewegungsfelder 
+Part of Bewegungsfelder
 
-MIT-License 
+MIT-License
 (C) 2016 Ivo Herzig
 
 Permission is hereby granted, free of charge, to any person obtaining a copy
@@ -26,52 +26,53 @@ using System;
 using System.Collections.Generic;
 using System.Linq;
 using System.Text;
-using System.Threading.Tasks;
-using System.Windows.Media.Media3D;
 
-namespace Bewegungsfelder.Core
+namespace Bewegungsfelder.Utilities
 {
-    public class KinematicStructure
+    /// <summary>
+    /// crc-32 as used by zip and png (polynomial 0xEDB88320).
+    /// </summary>
+    public static class Crc32
     {
-        public Bone Root { get; }
+        private static readonly uint[] table = CreateTable();
 
-        public KinematicStructure(Bone root = null)
+        /// <summary>
+        /// computes the checksum of a byte range
+        /// </summary>
+        public static uint Compute(byte[] buffer, int offset, int count)
         {
-            if (root == null)
-                Root = new Bone(parent: null) { Name = "Root" };
-            else
-                Root = root;
+            return Append(0, buffer, offset, count);
         }
 
-        public void ApplyWorldRotations(Dictionary<Bone, Quaternion> jointRotations)
+        /// <summary>
+        /// continues a checksum returned by Compute or Append with more bytes
+        /// </summary>
+        public static uint Append(uint crc, byte[] buffer, int offset, int count)
         {
-            Root.Traverse((bone, worldRotation) =>
+            if (offset < 0 || count < 0 || offset + count > buffer.Length)
+                throw new ArgumentOutOfRangeException(nameof(count));
+
+            crc = ~crc;
+            int end = offset + count;
+            for (int i = offset; i < end; i++)
             {
-                if (jointRotations.ContainsKey(bone))
-                {
-                    bone.JointRotation = worldRotation.Inverted() * jointRotations[bone];
-                }
-            }, Quaternion.Identity);
+                crc = table[(crc ^ buffer[i]) & 0xff] ^ (crc >> 8);
+            }
+            return ~crc;
         }
 
-        public void ApplyLocalRotation(Dictionary<Bone, Quaternion> jointRotations)
+        private static uint[] CreateTable()
         {
-            Root.Traverse((bone) =>
+            var result = new uint[256];
+            for (uint i = 0; i < result.Length; i++)
             {
-                if (jointRotations.ContainsKey(bone))
+                uint c = i;
+                for (int k = 0; k < 8; k++)
                 {
-                    bone.JointRotation = jointRotations[bone];
+                    c = (c & 1) != 0 ? 0xEDB88320 ^ (c >> 1) : c >> 1;
                 }
-            });
-        }
-
-        /// <summary>
-        /// collects the local orientation values for all bones in the tree
-        /// </summary>
-        public Dictionary<Bone, Quaternion> CollectLocalOrientations()
-        {
-            var result = new Dictionary<Bone, Quaternion>();
-            Root.Traverse(bone => result.Add(bone, bone.JointRotation));
+                result[i] = c;
+            }
             return result;
         }
     }
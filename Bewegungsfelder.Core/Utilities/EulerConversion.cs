@@ -0,0 +1,497 @@
+﻿/*
+Part of Bewegungsfelder
+
+MIT-License
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Numerics;
+using System.Text;
+using System.Threading.Tasks;
+
+namespace Bewegungsfelder.Utilities
+{
+    /// <summary>
+    /// the axes of euler angles in the order they are applied: q = q(first) * q(second) * q(third).
+    /// this is the order of the rotation channels in a bvh file
+    /// </summary>
+    public enum RotationOrder
+    {
+        XYZ,
+        XZY,
+        YXZ,
+        YZX,
+        ZXY,
+        ZYX,
+    }
+
+    /// <summary>
+    /// converts between euler angles and quaternions for many rotations at once.
+    /// values are passed as one array per component (w,x,y,z or first,second,third angle), angles in radians.
+    /// uses simd instructions if the runtime supports them, the scalar path computes in double precision.
+    /// the values after the last whole vector are converted as a padded vector, so the result of a rotation
+    /// does not depend on its index. only angles beyond the vector range take the scalar path.
+    /// </summary>
+    public static class EulerConversion
+    {
+        // larger angles are converted by the scalar path, the vector range reduction loses precision
+        private const float MAX_VECTOR_ANGLE = 8192;
+
+        // cody-waite split of pi/2 for the range reduction
+        private const float PI_2_HIGH = 1.5703125f;
+        private const float PI_2_MID = 4.837512969970703125e-4f;
+        private const float PI_2_LOW = 7.54978995489188216e-8f;
+
+        // adding and subtracting this rounds a float to an integer
+        private const float ROUNDING = 12582912f;
+
+        private const float TAN_PI_8 = 0.414213562373095f;
+
+        // the first and third axis are treated as aligned if a half angle term is below this
+        private const float GIMBAL_LOCK = 1e-6f;
+
+        // inputs and results of the values after the last whole vector
+        [ThreadStatic]
+        private static float[][] tailBuffers;
+
+        private static readonly int[][] AXES =
+        {
+            new[] { 0, 1, 2 },
+            new[] { 0, 2, 1 },
+            new[] { 1, 0, 2 },
+            new[] { 1, 2, 0 },
+            new[] { 2, 0, 1 },
+            new[] { 2, 1, 0 },
+        };
+
+        /// <summary>
+        /// returns the order of three different axes (0,1,2 = x,y,z)
+        /// </summary>
+        public static RotationOrder GetOrder(int first, int second, int third)
+        {
+            for (int i = 0; i < AXES.Length; i++)
+            {
+                if (AXES[i][0] == first && AXES[i][1] == second && AXES[i][2] == third)
+                    return (RotationOrder)i;
+            }
+
+            throw new ArgumentException("Euler angles need three different axes");
+        }
+
+        /// <summary>
+        /// returns the axes (0,1,2 = x,y,z) of an order
+        /// </summary>
+        public static void GetAxes(RotationOrder order, out int first, out int second, out int third)
+        {
+            var axes = AXES[(int)order];
+            first = axes[0];
+            second = axes[1];
+            third = axes[2];
+        }
+
+        /// <summary>
+        /// converts euler angles to unit quaternions
+        /// </summary>
+        public static void ToQuaternions(RotationOrder order, float[] first, float[] second, float[] third,
+            float[] w, float[] x, float[] y, float[] z, int count)
+        {
+            CheckLength(count, first, second, third, w, x, y, z);
+            var axes = AXES[(int)order];
+
+            int i = 0;
+            if (Vector.IsHardwareAccelerated)
+            {
+                for (; i <= count - Vector<float>.Count; i += Vector<float>.Count)
+                {
+                    if (!ToQuaternions(axes, first, second, third, w, x, y, z, i))
+                        ToQuaternionsOutOfRange(axes, first, second, third, w, x, y, z, i, Vector<float>.Count);
+                }
+
+                if (i < count)
+                {
+                    var tail = GetTail(i, count - i, first, second, third);
+                    ToQuaternions(axes, tail[0], tail[1], tail[2], tail[3], tail[4], tail[5], tail[6], 0);
+                    CopyTail(tail, 3, i, count - i, w, x, y, z);
+                    ToQuaternionsOutOfRange(axes, first, second, third, w, x, y, z, i, count - i);
+                    i = count;
+                }
+            }
+
+            for (; i < count; i++)
+            {
+                ToQuaternion(axes, first, second, third, w, x, y, z, i);
+            }
+        }
+
+        /// <summary>
+        /// converts quaternions to euler angles. the second angle is within +-pi/2, the others within +-pi.
+        /// in gimbal lock the third angle is zero.
+        /// uses the direct method by bernardes and viollet, which stays accurate close to gimbal lock:
+        /// https://doi.org/10.1371/journal.pone.0276302
+        /// </summary>
+        public static void ToEulerAngles(RotationOrder order, float[] w, float[] x, float[] y, float[] z,
+            float[] first, float[] second, float[] third, int count)
+        {
+            CheckLength(count, first, second, third, w, x, y, z);
+            var axes = AXES[(int)order];
+
+            // the method is written for the axes in reverse order: q = q(k, third) * q(j, second) * q(i, first)
+            // a = w - q[j], b = q[i] + sign * q[k], c = w + q[j], d = sign * q[k] - q[i]
+            int i = axes[2], j = axes[1], k = axes[0];
+            float sign = k == (j + 1) % 3 ? 1 : -1;
+            var components = new[] { x, y, z };
+            float[] qi = components[i], qj = components[j], qk = components[k];
+
+            int n = 0;
+            if (Vector.IsHardwareAccelerated)
+            {
+                for (; n <= count - Vector<float>.Count; n += Vector<float>.Count)
+                {
+                    ToEulerAngles(sign, w, qi, qj, qk, first, second, third, n);
+                }
+
+                if (n < count)
+                {
+                    var tail = GetTail(n, count - n, w, qi, qj, qk);
+                    ToEulerAngles(sign, tail[0], tail[1], tail[2], tail[3], tail[4], tail[5], tail[6], 0);
+                    CopyTail(tail, 4, n, count - n, first, second, third);
+                    n = count;
+                }
+            }
+
+            for (; n < count; n++)
+            {
+                double qw = w[n], vi = qi[n], vj = qj[n], vk = sign * qk[n];
+                double a = qw - vj;
+                double b = vi + vk;
+                double c = qw + vj;
+                double d = vk - vi;
+
+                double ab = Math.Sqrt(a * a + b * b);
+                double cd = Math.Sqrt(c * c + d * d);
+                double plus = Math.Atan2(b, a);
+                double minus = Math.Atan2(d, c);
+
+                double f, t;
+                if (cd < GIMBAL_LOCK || ab < GIMBAL_LOCK)
+                {
+                    f = 2 * (cd < GIMBAL_LOCK ? plus : minus);
+                    t = 0;
+                }
+                else
+                {
+                    f = plus + minus;
+                    t = plus - minus;
+                }
+
+                first[n] = (float)(sign * WrapAngle(f));
+                second[n] = (float)(2 * Math.Atan2(cd, ab) - Math.PI / 2);
+                third[n] = (float)WrapAngle(t);
+            }
+        }
+
+        private static double WrapAngle(double angle)
+        {
+            if (angle > Math.PI)
+                return angle - 2 * Math.PI;
+            if (angle < -Math.PI)
+                return angle + 2 * Math.PI;
+            return angle;
+        }
+
+        /// <summary>
+        /// vector conversion of the rotations at index i
+        /// </summary>
+        /// <returns>false if an angle is beyond the vector range</returns>
+        private static bool ToQuaternions(int[] axes, float[] first, float[] second, float[] third,
+            float[] w, float[] x, float[] y, float[] z, int i)
+        {
+            var half = new Vector<float>(0.5f);
+            var a = new Vector<float>(first, i);
+            var b = new Vector<float>(second, i);
+            var c = new Vector<float>(third, i);
+
+            // the first rotation is the axis quaternion itself
+            Vector<float> sin, cos;
+            SinCos(a * half, out sin, out cos);
+            var qw = cos;
+            var qx = axes[0] == 0 ? sin : Vector<float>.Zero;
+            var qy = axes[0] == 1 ? sin : Vector<float>.Zero;
+            var qz = axes[0] == 2 ? sin : Vector<float>.Zero;
+
+            SinCos(b * half, out sin, out cos);
+            Rotate(axes[1], cos, sin, ref qw, ref qx, ref qy, ref qz);
+            SinCos(c * half, out sin, out cos);
+            Rotate(axes[2], cos, sin, ref qw, ref qx, ref qy, ref qz);
+
+            qw.CopyTo(w, i);
+            qx.CopyTo(x, i);
+            qy.CopyTo(y, i);
+            qz.CopyTo(z, i);
+
+            var limit = new Vector<float>(MAX_VECTOR_ANGLE);
+            return Vector.LessThanAll(Vector.Max(Vector.Max(Vector.Abs(a), Vector.Abs(b)), Vector.Abs(c)), limit);
+        }
+
+        /// <summary>
+        /// converts the rotations from index i on with an angle beyond the vector range by the scalar path
+        /// </summary>
+        private static void ToQuaternionsOutOfRange(int[] axes, float[] first, float[] second, float[] third,
+            float[] w, float[] x, float[] y, float[] z, int i, int count)
+        {
+            for (int k = i; k < i + count; k++)
+            {
+                if (!(Math.Abs(first[k]) < MAX_VECTOR_ANGLE && Math.Abs(second[k]) < MAX_VECTOR_ANGLE &&
+                    Math.Abs(third[k]) < MAX_VECTOR_ANGLE))
+                    ToQuaternion(axes, first, second, third, w, x, y, z, k);
+            }
+        }
+
+        /// <summary>
+        /// vector conversion of the quaternions at index n, the components in the order of the method
+        /// </summary>
+        private static void ToEulerAngles(float sign, float[] w, float[] qi, float[] qj, float[] qk,
+            float[] first, float[] second, float[] third, int n)
+        {
+            var vectorSign = new Vector<float>(sign);
+            var gimbalLock = new Vector<float>(GIMBAL_LOCK);
+            var two = new Vector<float>(2);
+            var pi = new Vector<float>((float)Math.PI);
+            var halfPi = new Vector<float>((float)(Math.PI / 2));
+
+            var qw = new Vector<float>(w, n);
+            var vi = new Vector<float>(qi, n);
+            var vj = new Vector<float>(qj, n);
+            var vk = vectorSign * new Vector<float>(qk, n);
+            var a = qw - vj;
+            var b = vi + vk;
+            var c = qw + vj;
+            var d = vk - vi;
+
+            var ab = Vector.SquareRoot(a * a + b * b);
+            var cd = Vector.SquareRoot(c * c + d * d);
+            var plus = Atan2(b, a);
+            var minus = Atan2(d, c);
+
+            var lockedPlus = Vector.LessThan(cd, gimbalLock);
+            var locked = lockedPlus | Vector.LessThan(ab, gimbalLock);
+            var f = Vector.ConditionalSelect(locked,
+                two * Vector.ConditionalSelect(lockedPlus, plus, minus), plus + minus);
+            var t = Vector.ConditionalSelect(locked, Vector<float>.Zero, plus - minus);
+
+            // back to +-pi
+            f = Vector.ConditionalSelect(Vector.GreaterThan(f, pi), f - two * pi, f);
+            f = Vector.ConditionalSelect(Vector.LessThan(f, -pi), f + two * pi, f);
+            t = Vector.ConditionalSelect(Vector.GreaterThan(t, pi), t - two * pi, t);
+            t = Vector.ConditionalSelect(Vector.LessThan(t, -pi), t + two * pi, t);
+
+            (vectorSign * f).CopyTo(first, n);
+            (two * Atan2(cd, ab) - halfPi).CopyTo(second, n);
+            t.CopyTo(third, n);
+        }
+
+        /// <summary>
+        /// copies count values from offset on to the start of the tail buffers, padded with zeros
+        /// </summary>
+        /// <returns>a vector sized buffer per input, followed by the remaining buffers for the results</returns>
+        private static float[][] GetTail(int offset, int count, params float[][] inputs)
+        {
+            var tail = tailBuffers;
+            if (tail == null)
+            {
+                tail = new float[7][];
+                for (int k = 0; k < tail.Length; k++)
+                {
+                    tail[k] = new float[Vector<float>.Count];
+                }
+                tailBuffers = tail;
+            }
+
+            for (int k = 0; k < inputs.Length; k++)
+            {
+                Array.Clear(tail[k], 0, tail[k].Length);
+                Array.Copy(inputs[k], offset, tail[k], 0, count);
+            }
+
+            return tail;
+        }
+
+        /// <summary>
+        /// copies count results from the tail buffers, starting at buffer first, to the outputs at offset
+        /// </summary>
+        private static void CopyTail(float[][] tail, int first, int offset, int count, params float[][] outputs)
+        {
+            for (int k = 0; k < outputs.Length; k++)
+            {
+                Array.Copy(tail[first + k], 0, outputs[k], offset, count);
+            }
+        }
+
+        private static void CheckLength(int count, params float[][] arrays)
+        {
+            if (count < 0 || arrays.Any(array => array.Length < count))
+                throw new ArgumentOutOfRangeException(nameof(count));
+        }
+
+        /// <summary>
+        /// scalar conversion of the rotation at index i
+        /// </summary>
+        private static void ToQuaternion(int[] axes, float[] first, float[] second, float[] third,
+            float[] w, float[] x, float[] y, float[] z, int i)
+        {
+            double qw = 1, qx = 0, qy = 0, qz = 0;
+            Rotate(axes[0], first[i], ref qw, ref qx, ref qy, ref qz);
+            Rotate(axes[1], second[i], ref qw, ref qx, ref qy, ref qz);
+            Rotate(axes[2], third[i], ref qw, ref qx, ref qy, ref qz);
+
+            w[i] = (float)qw;
+            x[i] = (float)qx;
+            y[i] = (float)qy;
+            z[i] = (float)qz;
+        }
+
+        /// <summary>
+        /// q = q * (axis, angle)
+        /// </summary>
+        private static void Rotate(int axis, double angle, ref double w, ref double x, ref double y, ref double z)
+        {
+            double c = Math.Cos(angle / 2);
+            double s = Math.Sin(angle / 2);
+            double tw = w, tx = x, ty = y, tz = z;
+            switch (axis)
+            {
+                case 0:
+                    w = tw * c - tx * s;
+                    x = tw * s + tx * c;
+                    y = ty * c + tz * s;
+                    z = tz * c - ty * s;
+                    break;
+                case 1:
+                    w = tw * c - ty * s;
+                    x = tx * c - tz * s;
+                    y = tw * s + ty * c;
+                    z = tz * c + tx * s;
+                    break;
+                default:
+                    w = tw * c - tz * s;
+                    x = tx * c + ty * s;
+                    y = ty * c - tx * s;
+                    z = tw * s + tz * c;
+                    break;
+            }
+        }
+
+        /// <summary>
+        /// q = q * (cos, sin * axis) for half angle cos and sin
+        /// </summary>
+        private static void Rotate(int axis, Vector<float> c, Vector<float> s,
+            ref Vector<float> w, ref Vector<float> x, ref Vector<float> y, ref Vector<float> z)
+        {
+            var tw = w;
+            var tx = x;
+            var ty = y;
+            var tz = z;
+            switch (axis)
+            {
+                case 0:
+                    w = tw * c - tx * s;
+                    x = tw * s + tx * c;
+                    y = ty * c + tz * s;
+                    z = tz * c - ty * s;
+                    break;
+                case 1:
+                    w = tw * c - ty * s;
+                    x = tx * c - tz * s;
+                    y = tw * s + ty * c;
+                    z = tz * c + tx * s;
+                    break;
+                default:
+                    w = tw * c - tz * s;
+                    x = tx * c + ty * s;
+                    y = ty * c - tx * s;
+                    z = tw * s + tz * c;
+                    break;
+            }
+        }
+
+        /// <summary>
+        /// sine and cosine with single precision polynomials (cephes sinf and cosf)
+        /// </summary>
+        private static void SinCos(Vector<float> angle, out Vector<float> sin, out Vector<float> cos)
+        {
+            var rounding = new Vector<float>(ROUNDING);
+
+            // quadrant j and remainder r within +-pi/4
+            var j = (angle * new Vector<float>((float)(2 / Math.PI)) + rounding) - rounding;
+            var r = angle - j * new Vector<float>(PI_2_HIGH) - j * new Vector<float>(PI_2_MID)
+                - j * new Vector<float>(PI_2_LOW);
+            var r2 = r * r;
+
+            var s = r + r * r2 * (new Vector<float>(-1.6666654611e-1f)
+                + r2 * (new Vector<float>(8.3321608736e-3f) + r2 * new Vector<float>(-1.9515295891e-4f)));
+            var c = Vector<float>.One - r2 * new Vector<float>(0.5f) + r2 * r2 * (new Vector<float>(4.166664568298827e-2f)
+                + r2 * (new Vector<float>(-1.388731625493765e-3f) + r2 * new Vector<float>(2.443315711809948e-5f)));
+
+            // quadrant modulo 4, j / 4 is a multiple of 0.25 so the rounding below is a floor
+            var quarter = j * new Vector<float>(0.25f) - new Vector<float>(0.375f);
+            var quadrant = j - new Vector<float>(4) * ((quarter + rounding) - rounding);
+
+            var swap = Vector.Equals(quadrant, Vector<float>.One) | Vector.Equals(quadrant, new Vector<float>(3));
+            var negateSin = Vector.GreaterThanOrEqual(quadrant, new Vector<float>(2));
+            var negateCos = Vector.Equals(quadrant, Vector<float>.One) | Vector.Equals(quadrant, new Vector<float>(2));
+
+            sin = Vector.ConditionalSelect(swap, c, s);
+            cos = Vector.ConditionalSelect(swap, s, c);
+            sin = Vector.ConditionalSelect(negateSin, -sin, sin);
+            cos = Vector.ConditionalSelect(negateCos, -cos, cos);
+        }
+
+        /// <summary>
+        /// four quadrant arc tangent with single precision polynomials (cephes atanf)
+        /// </summary>
+        private static Vector<float> Atan2(Vector<float> y, Vector<float> x)
+        {
+            var absX = Vector.Abs(x);
+            var absY = Vector.Abs(y);
+            var max = Vector.Max(absX, absY);
+            var zero = Vector.Equals(max, Vector<float>.Zero);
+
+            // atan of t within [0, 1], reduced to +-tan(pi/8)
+            var t = Vector.Min(absX, absY) / Vector.ConditionalSelect(zero, Vector<float>.One, max);
+            var reduce = Vector.GreaterThan(t, new Vector<float>(TAN_PI_8));
+            t = Vector.ConditionalSelect(reduce, (t - Vector<float>.One) / (t + Vector<float>.One), t);
+            var t2 = t * t;
+            var result = ((((new Vector<float>(8.05374449538e-2f) * t2 - new Vector<float>(1.38776856032e-1f)) * t2
+                + new Vector<float>(1.99777106478e-1f)) * t2 - new Vector<float>(3.33329491539e-1f)) * t2 * t) + t;
+            result = Vector.ConditionalSelect(reduce, result + new Vector<float>((float)(Math.PI / 4)), result);
+
+            // back to the quadrant of (x, y)
+            result = Vector.ConditionalSelect(Vector.GreaterThan(absY, absX),
+                new Vector<float>((float)(Math.PI / 2)) - result, result);
+            result = Vector.ConditionalSelect(Vector.LessThan(x, Vector<float>.Zero),
+                new Vector<float>((float)Math.PI) - result, result);
+            result = Vector.ConditionalSelect(Vector.LessThan(y, Vector<float>.Zero), -result, result);
+            return Vector.ConditionalSelect(zero, Vector<float>.Zero, result);
+        }
+    }
+}
@@ -28,7 +28,7 @@ using System.Collections.Generic;
 using System.Linq;
 using System.Text;
 using System.Threading.Tasks;
-using System.Windows.Media.Media3D;
+using Bewegungsfelder.Mathematics;
 
 namespace Bewegungsfelder
 {
@@ -51,7 +51,8 @@ namespace Bewegungsfelder
         public static void ToYawPitchRoll(this Quaternion quat, out double yaw, out double pitch, out double roll)
         {
             yaw = Math.Atan2(2 * (quat.W * quat.Z + quat.X * quat.Y), 1 - 2 * (quat.Y * quat.Y + quat.Z * quat.Z));
-            pitch = Math.Asin(2 * (quat.W * quat.Y - quat.Z * quat.X));
+            // rounding errors can push the sine slightly out of range
+            pitch = Math.Asin(Math.Max(-1, Math.Min(1, 2 * (quat.W * quat.Y - quat.Z * quat.X))));
             roll = Math.Atan2(2 * (quat.W * quat.X + quat.Y * quat.Z), 1 - 2 * (quat.X * quat.X + quat.Y * quat.Y));
         }
     }
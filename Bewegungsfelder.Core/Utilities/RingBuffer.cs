@@ -0,0 +1,334 @@
+﻿/*
+Part of Bewegungsfelder
+
+MIT-License
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+
+using System;
+using System.Collections;
+using System.Collections.Generic;
+using System.Diagnostics;
+using System.Linq;
+using System.Text;
+using System.Threading;
+
+namespace Bewegungsfelder.Utilities
+{
+    /// <summary>
+    /// fixed size buffer keeping the most recent values.
+    /// lock-free for a single writer and any number of readers: readers copy values
+    /// and then check that the writer hasn't overwritten them in the meantime (seqlock).
+    /// </summary>
+    public class RingBuffer<T>
+    {
+        // one slot more than the capacity. the writer stores the next value in
+        // that slot, so readers can always access Capacity values.
+        private T[] data;
+
+        // total number of values pushed. the value at position p is stored in data[p % data.Length].
+        // only written by the writer, after the value has been stored.
+        private long written = 0;
+
+        public readonly int Capacity;
+
+        public int Count { get { return (int)Math.Min(Volatile.Read(ref written), Capacity); } }
+
+        /// <summary>
+        /// position of the next value, equal to the total number of values pushed
+        /// </summary>
+        public long End { get { return Volatile.Read(ref written); } }
+
+        /// <summary>
+        /// position of the oldest value
+        /// </summary>
+        public long Start { get { return Math.Max(0, Volatile.Read(ref written) - Capacity); } }
+
+        /// <summary>
+        /// the most recent value or default(T) if the buffer is empty
+        /// </summary>
+        public T Last
+        {
+            get
+            {
+                T value;
+                TryRead(0, out value);
+                return value;
+            }
+        }
+
+        public RingBuffer(int capacity)
+        {
+            if (capacity < 1)
+                throw new ArgumentOutOfRangeException(nameof(capacity));
+
+            this.Capacity = capacity;
+            data = new T[capacity + 1];
+        }
+
+        /// <summary>
+        /// adds a value, overwriting the oldest one if the buffer is full.
+        /// must only be called by one thread at a time.
+        /// </summary>
+        public void Push(T value)
+        {
+            long position = written;
+            data[position % data.Length] = value;
+
+            // publish the value
+            Volatile.Write(ref written, position + 1);
+        }
+
+        /// <summary>
+        /// reads a single value.
+        /// </summary>
+        /// <param name="age">0 for the most recent value, 1 for the one before...</param>
+        /// <returns>false if there is no such value</returns>
+        public bool TryRead(int age, out T value)
+        {
+            while (true)
+            {
+                long end = Volatile.Read(ref written);
+                long position = end - 1 - age;
+                if (age < 0 || age >= Capacity || position < 0)
+                {
+                    value = default(T);
+                    return false;
+                }
+
+                value = data[position % data.Length];
+
+                // retry if the writer started to overwrite the value while it was copied
+                if (position >= OldestValidPosition())
+                    return true;
+            }
+        }
+
+        /// <summary>
+        /// reads the value at an absolute position, see Start and End.
+        /// </summary>
+        /// <returns>false if the position was not written yet or was already overwritten</returns>
+        public bool TryReadAt(long position, out T value)
+        {
+            if (position < 0 || position >= Volatile.Read(ref written))
+            {
+                value = default(T);
+                return false;
+            }
+
+            value = data[position % data.Length];
+            if (position >= OldestValidPosition())
+                return true;
+
+            value = default(T);
+            return false;
+        }
+
+        /// <summary>
+        /// copies the most recent values to destination, oldest first.
+        /// </summary>
+        /// <returns>the number of values copied</returns>
+        public int CopyTo(T[] destination)
+        {
+            return CopyTo(destination, 0, destination.Length);
+        }
+
+        /// <summary>
+        /// copies up to count of the most recent values to destination, oldest first.
+        /// </summary>
+        /// <returns>the number of values copied</returns>
+        public int CopyTo(T[] destination, int destinationIndex, int count)
+        {
+            if (count < 0 || destinationIndex < 0 || destinationIndex + count > destination.Length)
+                throw new ArgumentOutOfRangeException(nameof(count));
+
+            long end = Volatile.Read(ref written);
+            int n = (int)Math.Min(Math.Min(count, Capacity), end);
+            long start = end - n;
+
+            // copy in up to two parts, the values might wrap around the end of data
+            int startIndex = (int)(start % data.Length);
+            int firstPart = Math.Min(n, data.Length - startIndex);
+            Array.Copy(data, startIndex, destination, destinationIndex, firstPart);
+            Array.Copy(data, 0, destination, destinationIndex + firstPart, n - firstPart);
+
+            // the writer might have overwritten the oldest values while they were copied.
+            // drop them instead of retrying, a fast writer could starve the reader otherwise
+            int overwritten = (int)Math.Min(n, Math.Max(0, OldestValidPosition() - start));
+            if (overwritten > 0)
+            {
+                n -= overwritten;
+                Array.Copy(destination, destinationIndex + overwritten, destination, destinationIndex, n);
+            }
+
+            return n;
+        }
+
+        /// <summary>
+        /// returns a copy of all values, oldest first
+        /// </summary>
+        public T[] Take()
+        {
+            return Take(Capacity);
+        }
+
+        /// <summary>
+        /// returns a copy of up to count of the most recent values, oldest first
+        /// </summary>
+        public T[] Take(int count)
+        {
+            if (count < 1)
+                throw new InvalidOperationException("Cant take less than one");
+
+            T[] result = new T[Math.Min(count, Count)];
+            int n = CopyTo(result);
+            if (n < result.Length)
+                Array.Resize(ref result, n);
+
+            return result;
+        }
+
+        /// <summary>
+        /// returns a read-only view of the current values without copying them.
+        /// values pushed after the snapshot was taken are not part of it. if the writer
+        /// overwrites values during the enumeration, they are skipped.
+        /// </summary>
+        public Snapshot GetSnapshot()
+        {
+            long end = Volatile.Read(ref written);
+            return new Snapshot(this, Math.Max(0, end - Capacity), end);
+        }
+
+        /// <summary>
+        /// returns a read-only view of the values at the positions [start, end).
+        /// </summary>
+        public Snapshot GetSnapshot(long start, long end)
+        {
+            return new Snapshot(this, Math.Max(0, start), Math.Min(end, Volatile.Read(ref written)));
+        }
+
+        /// <summary>
+        /// positions below were or are currently being overwritten. values read from them
+        /// are invalid.
+        /// </summary>
+        private long OldestValidPosition()
+        {
+            // order the preceding reads of data before reading the write position
+            Thread.MemoryBarrier();
+
+            // the writer might currently be storing the value at position 'written',
+            // which replaces position 'written - data.Length'
+            return Volatile.Read(ref written) - data.Length + 1;
+        }
+
+        /// <summary>
+        /// view on the values of a ring buffer, oldest first.
+        /// </summary>
+        public struct Snapshot : IEnumerable<T>
+        {
+            private readonly RingBuffer<T> buffer;
+            private readonly long start;
+            private readonly long end;
+
+            internal Snapshot(RingBuffer<T> buffer, long start, long end)
+            {
+                this.buffer = buffer;
+                this.start = start;
+                this.end = end;
+            }
+
+            /// <summary>
+            /// number of values in the view. values overwritten during an enumeration are skipped,
+            /// so it might yield less.
+            /// </summary>
+            public int Count { get { return (int)Math.Max(0, end - start); } }
+
+            public Enumerator GetEnumerator()
+            {
+                return new Enumerator(buffer, start, end);
+            }
+
+            IEnumerator<T> IEnumerable<T>.GetEnumerator()
+            {
+                return GetEnumerator();
+            }
+
+            IEnumerator IEnumerable.GetEnumerator()
+            {
+                return GetEnumerator();
+            }
+        }
+
+        public struct Enumerator : IEnumerator<T>
+        {
+            private readonly RingBuffer<T> buffer;
+            private readonly long start;
+            private readonly long end;
+            private long position;
+            private T current;
+
+            internal Enumerator(RingBuffer<T> buffer, long start, long end)
+            {
+                this.buffer = buffer;
+                this.start = start;
+                this.end = end;
+                this.position = start;
+                this.current = default(T);
+            }
+
+            public T Current { get { return current; } }
+
+            object IEnumerator.Current { get { return current; } }
+
+            public bool MoveNext()
+            {
+                while (position < end)
+                {
+                    long p = position++;
+                    T value = buffer.data[p % buffer.data.Length];
+
+                    long oldest = buffer.OldestValidPosition();
+                    if (p >= oldest)
+                    {
+                        current = value;
+                        return true;
+                    }
+
+                    // the value was overwritten, continue with the oldest one still available
+                    position = oldest;
+                }
+
+                current = default(T);
+                return false;
+            }
+
+            public void Reset()
+            {
+                position = start;
+                current = default(T);
+            }
+
+            public void Dispose()
+            {
+            }
+        }
+    }
+}
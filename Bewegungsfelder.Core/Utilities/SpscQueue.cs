@@ -0,0 +1,102 @@
+﻿/*
+Part of Bewegungsfelder
+
+MIT-License
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Text;
+using System.Threading;
+
+namespace Bewegungsfelder.Utilities
+{
+    /// <summary>
+    /// bounded lock-free queue for exactly one producer and one consumer thread.
+    /// </summary>
+    class SpscQueue<T>
+    {
+        private readonly T[] data;
+        private readonly int mask;
+
+        // head is only written by the consumer, tail only by the producer.
+        // both count up and are masked on access.
+        private int head = 0;
+        private int tail = 0;
+
+        public int Capacity { get { return data.Length; } }
+
+        public bool IsEmpty { get { return Volatile.Read(ref head) == Volatile.Read(ref tail); } }
+
+        /// <param name="capacity">rounded up to the next power of two</param>
+        public SpscQueue(int capacity)
+        {
+            if (capacity < 1)
+                throw new ArgumentOutOfRangeException(nameof(capacity));
+
+            int size = 1;
+            while (size < capacity)
+                size <<= 1;
+
+            data = new T[size];
+            mask = size - 1;
+        }
+
+        /// <summary>
+        /// producer only.
+        /// </summary>
+        /// <returns>false if the queue is full</returns>
+        public bool TryEnqueue(T value)
+        {
+            int t = tail;
+            if (t - Volatile.Read(ref head) == data.Length)
+                return false;
+
+            data[t & mask] = value;
+
+            // publish the value
+            Volatile.Write(ref tail, t + 1);
+            return true;
+        }
+
+        /// <summary>
+        /// consumer only.
+        /// </summary>
+        /// <returns>false if the queue is empty</returns>
+        public bool TryDequeue(out T value)
+        {
+            int h = head;
+            if (h == Volatile.Read(ref tail))
+            {
+                value = default(T);
+                return false;
+            }
+
+            value = data[h & mask];
+            data[h & mask] = default(T);
+
+            // release the slot
+            Volatile.Write(ref head, h + 1);
+            return true;
+        }
+    }
+}
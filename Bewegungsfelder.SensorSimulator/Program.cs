@@ -13,14 +13,39 @@ namespace Bewegungsfelder.SensorSimulator
 {
     /*
      * simple exe to send mock sensor values to the server.
+     *
+     * usage:
+     *   SensorSimulator               two rotating sensors at 25Hz
+     *   SensorSimulator load [max sensors] [hz] [step seconds]
+     *                                 load generator. ramps up the number of sensors in steps
+     *                                 of 10 and prints the offered datagram rate per step.
+     *                                 hz = 0 sends as fast as possible.
     */
     class Program
     {
+        static readonly IPEndPoint server = new IPEndPoint(IPAddress.Loopback, 5555);
+
+        // header flag: the timestamps are in microseconds
+        const int FLAG_TIMESTAMP_US = 0x01;
+
         static void Main(string[] args)
         {
-            int hz = 25;
+            if (args.Length > 0 && args[0] == "load")
+            {
+                int maxSensors = args.Length > 1 ? int.Parse(args[1]) : 50;
+                int hz = args.Length > 2 ? int.Parse(args[2]) : 200;
+                int stepSeconds = args.Length > 3 ? int.Parse(args[3]) : 10;
+                RunLoad(maxSensors, hz, stepSeconds);
+            }
+            else
+            {
+                RunDemo();
+            }
+        }
 
-            Random random = new Random();
+        static void RunDemo()
+        {
+            int hz = 25;
 
             UdpClient client = new UdpClient();
 
@@ -28,6 +53,7 @@ namespace Bewegungsfelder.SensorSimulator
             int count = 2; 
             int[] ids = Enumerable.Range(0, count).ToArray();
             double[] deg = new double[count];
+            ushort[] sequence = new ushort[count];
             double[] delta = { 0.0, 0.2 };
             Vector3D[] axes = { new Vector3D(1, 0, 0), new Vector3D(0, 0, 1) };
 
@@ -41,28 +67,112 @@ namespace Bewegungsfelder.SensorSimulator
                     deg[i] += delta[i];
                     Quaternion quat = new Quaternion(axes[i], deg[i]);
 
-                    // datagram format: id,w,x,y,z 
-                    byte[] idBytes = BitConverter.GetBytes(ids[i]);
+                    byte[] bytes = CreatePacket((byte)ids[i], sequence[i]++, GetTimestamp(watch), quat);
+                    client.Send(bytes, bytes.Length, server);
+                }
 
-                    var w = BitConverter.GetBytes((int)(quat.W * int.MaxValue));
-                    var x = BitConverter.GetBytes((int)(quat.X * int.MaxValue));
-                    var y = BitConverter.GetBytes((int)(quat.Y * int.MaxValue));
-                    var z = BitConverter.GetBytes((int)(quat.Z * int.MaxValue));
+                Thread.Sleep(1000 / hz);
+            }
+        }
 
-                    byte[] quatBytes = Enumerable.Concat(w, x).Concat(y).Concat(z).ToArray();
+        /// <summary>
+        /// sends single sample datagrams for an increasing number of sensors.
+        /// the server logs its ingest throughput, together this gives the scaling curve.
+        /// </summary>
+        static void RunLoad(int maxSensors, int hz, int stepSeconds)
+        {
+            Socket socket = new Socket(AddressFamily.InterNetwork, SocketType.Dgram, ProtocolType.Udp);
+            Stopwatch watch = Stopwatch.StartNew();
 
-                    // 2 * x,y,z for gyro and accelerometer values
-                    byte[] gyroAccelBytes = new byte[6 * sizeof(int)];
+            // one prepared datagram per sensor, only sequence and timestamp change
+            byte[][] packets = new byte[maxSensors][];
+            for (int i = 0; i < maxSensors; i++)
+            {
+                packets[i] = CreatePacket((byte)i, 0, 0, new Quaternion(new Vector3D(0, 0, 1), i));
+            }
 
-                    byte[] bytes = Enumerable.Concat(idBytes, quatBytes)
-                        .Concat(gyroAccelBytes)
-                        .Concat(BitConverter.GetBytes(watch.Elapsed.TotalMilliseconds * 1000)).ToArray();
+            for (int step = 1; ; step++)
+            {
+                int sensors = Math.Min(step * 10, maxSensors);
+                long sent = 0;
+                double period = hz > 0 ? 1.0 / hz : 0;
+                double start = watch.Elapsed.TotalSeconds;
+                double next = start;
+
+                while (watch.Elapsed.TotalSeconds - start < stepSeconds)
+                {
+                    uint timestamp = GetTimestamp(watch);
+                    for (int i = 0; i < sensors; i++)
+                    {
+                        byte[] packet = packets[i];
+                        ushort sequence = (ushort)(BitConverter.ToUInt16(packet, 2) + 1);
+                        packet[2] = (byte)sequence;
+                        packet[3] = (byte)(sequence >> 8);
+                        packet[4] = (byte)timestamp;
+                        packet[5] = (byte)(timestamp >> 8);
+                        packet[6] = (byte)(timestamp >> 16);
+                        packet[7] = (byte)(timestamp >> 24);
 
-                    client.Send(bytes, bytes.Length, new IPEndPoint(IPAddress.Loopback, 5555));
+                        socket.SendTo(packet, server);
+                        ++sent;
+                    }
+
+                    // sleep until the next period, spin for the last few milliseconds
+                    next += period;
+                    double remaining;
+                    while ((remaining = next - watch.Elapsed.TotalSeconds) > 0)
+                    {
+                        if (remaining > 0.002)
+                            Thread.Sleep(1);
+                        else
+                            Thread.SpinWait(100);
+                    }
                 }
 
-                Thread.Sleep(1000 / hz);
+                double elapsed = watch.Elapsed.TotalSeconds - start;
+                Console.WriteLine($"{sensors} sensors @ {hz} Hz: {sent / elapsed:F0} datagrams/s offered");
+
+                if (sensors == maxSensors)
+                    break;
             }
         }
+
+        /// <summary>
+        /// sensor timestamp in microseconds
+        /// </summary>
+        static uint GetTimestamp(Stopwatch watch)
+        {
+            return (uint)(watch.Elapsed.TotalMilliseconds * 1000);
+        }
+
+        /// <summary>
+        /// creates a compact (version 2) datagram with a single sample.
+        /// see esp8266_mpu6050/include/sensor_packet.h
+        /// </summary>
+        static byte[] CreatePacket(byte id, ushort sequence, uint timestamp, Quaternion quat)
+        {
+            byte[] headerBytes = Enumerable.Concat(new byte[] { (2 << 4) | FLAG_TIMESTAMP_US, id },
+                BitConverter.GetBytes(sequence))
+                .Concat(BitConverter.GetBytes(timestamp))
+                .ToArray();
+
+            // timestamp delta to the previous sample in the datagram
+            byte[] dtBytes = BitConverter.GetBytes((ushort)0);
+
+            // quaternion as q14 fixed point
+            var w = BitConverter.GetBytes((short)(quat.W * (1 << 14)));
+            var x = BitConverter.GetBytes((short)(quat.X * (1 << 14)));
+            var y = BitConverter.GetBytes((short)(quat.Y * (1 << 14)));
+            var z = BitConverter.GetBytes((short)(quat.Z * (1 << 14)));
+
+            byte[] quatBytes = Enumerable.Concat(w, x).Concat(y).Concat(z).ToArray();
+
+            // 2 * x,y,z for gyro and accelerometer values
+            byte[] gyroAccelBytes = new byte[6 * sizeof(short)];
+
+            return Enumerable.Concat(headerBytes, dtBytes)
+                .Concat(quatBytes)
+                .Concat(gyroAccelBytes).ToArray();
+        }
     }
 }
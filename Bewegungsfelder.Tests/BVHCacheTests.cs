@@ -0,0 +1,211 @@
+﻿/*
+Part of Bewegungsfelder
+
+MIT-License
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using System;
+using System.IO;
+using Bewegungsfelder.BVH;
+using Microsoft.VisualStudio.TestTools.UnitTesting;
+
+namespace Bewegungsfelder.Tests
+{
+    /// <summary>
+    /// writes the cache of a generated bvh file and changes the file or the cache.
+    /// a changed length or content must invalidate the cache, a touched file with the same content not
+    /// </summary>
+    [TestClass]
+    public class BVHCacheTests
+    {
+        // about 2 MB, beyond BVHCache.MIN_SOURCE_LENGTH
+        private const int FRAMES = 6000;
+        private const int JOINTS = 10;
+
+        // BVHCache header fields
+        private const int WRITE_TIME_POSITION = 16;
+        private const int FRAMES_OFFSET_POSITION = 56;
+
+        private const float MARKER = 12345.5f;
+
+        [TestMethod]
+        public void CachedDataMatchesParsedData()
+        {
+            WithCachedFile((file, root, motionData) =>
+            {
+                BVHMotionData cached;
+                var cachedRoot = BVHCache.Read(file, out cached);
+                Assert.IsTrue(cachedRoot != null, "cache not used");
+
+                BvhTestFiles.AssertNode(root, cachedRoot);
+                Assert.AreEqual(motionData.FrameTime, cached.FrameTime, "frame time");
+                Assert.AreEqual(motionData.FrameCount, cached.FrameCount, "frame count");
+                Assert.AreEqual(motionData.Joints.Length, cached.Joints.Length, "joint count");
+                Assert.AreEqual(motionData.Rotations.Length, cached.Rotations.Length, "rotation count");
+                for (int i = 0; i < motionData.Rotations.Length; i++)
+                {
+                    if (motionData.Rotations[i] != cached.Rotations[i])
+                        Assert.Fail($"rotation value {i}: {motionData.Rotations[i]} != {cached.Rotations[i]}");
+                }
+            });
+        }
+
+        [TestMethod]
+        public void ReadBvhUsesTheCache()
+        {
+            WithCachedFile((file, root, motionData) =>
+            {
+                // a value only the cache knows
+                WriteFirstRotation(file, MARKER);
+
+                BVHMotionData read;
+                BVHReaderWriter.ReadBvh(file, out read);
+                Assert.AreEqual(MARKER, read.Rotations[0], "value of the cache");
+            });
+        }
+
+        [TestMethod]
+        public void ChangedLengthInvalidatesTheCache()
+        {
+            WithCachedFile((file, root, motionData) =>
+            {
+                var writeTime = File.GetLastWriteTimeUtc(file);
+                File.AppendAllText(file, "\n");
+                File.SetLastWriteTimeUtc(file, writeTime);
+                AssertInvalid(file, motionData);
+            });
+        }
+
+        [TestMethod]
+        public void TouchedFileKeepsTheCache()
+        {
+            WithCachedFile((file, root, motionData) =>
+            {
+                WriteFirstRotation(file, MARKER);
+                var writeTime = File.GetLastWriteTimeUtc(file).AddHours(1);
+                File.SetLastWriteTimeUtc(file, writeTime);
+
+                BVHMotionData cached;
+                Assert.IsTrue(BVHCache.Read(file, out cached) != null, "cache not used after touching the file");
+                Assert.AreEqual(MARKER, cached.Rotations[0], "value of the cache");
+
+                // the crc is skipped next time
+                Assert.AreEqual(writeTime.Ticks, ReadCacheInt64(file, WRITE_TIME_POSITION), "write time of the cache");
+            });
+        }
+
+        [TestMethod]
+        public void ChangedContentInvalidatesTheCache()
+        {
+            WithCachedFile((file, root, motionData) =>
+            {
+                // the same length, but a different digit in the last frame
+                var bytes = File.ReadAllBytes(file);
+                int digit = Array.FindLastIndex(bytes, b => b >= '0' && b <= '8');
+                bytes[digit]++;
+                var writeTime = File.GetLastWriteTimeUtc(file).AddHours(1);
+                File.WriteAllBytes(file, bytes);
+                File.SetLastWriteTimeUtc(file, writeTime);
+
+                AssertInvalid(file, motionData);
+            });
+        }
+
+        [TestMethod]
+        public void DamagedCacheIsIgnored()
+        {
+            WithCachedFile((file, root, motionData) =>
+            {
+                string cacheFile = BVHCache.GetCachePath(file);
+                var cache = File.ReadAllBytes(cacheFile);
+
+                // missing frames
+                var truncated = new byte[cache.Length - 1];
+                Array.Copy(cache, truncated, truncated.Length);
+                File.WriteAllBytes(cacheFile, truncated);
+                AssertInvalid(file, motionData);
+
+                // wrong magic
+                cache[0] ^= 0xff;
+                File.WriteAllBytes(cacheFile, cache);
+                AssertInvalid(file, motionData);
+            });
+        }
+
+        /// <summary>
+        /// checks that the cache is not used and that ReadBvh parses the file again and renews the cache
+        /// </summary>
+        private static void AssertInvalid(string file, BVHMotionData motionData)
+        {
+            BVHMotionData cached;
+            Assert.IsTrue(BVHCache.Read(file, out cached) == null, "invalid cache used");
+
+            BVHMotionData read;
+            BVHReaderWriter.ReadBvh(file, out read);
+            Assert.AreEqual(motionData.FrameCount, read.FrameCount, "frame count");
+            Assert.IsTrue(BVHCache.Read(file, out cached) != null, "cache not renewed");
+        }
+
+        /// <summary>
+        /// generates a bvh file, parses it and writes its cache
+        /// </summary>
+        private static void WithCachedFile(Action<string, BVHNode, BVHMotionData> test)
+        {
+            string file = Path.Combine(Path.GetTempPath(), Guid.NewGuid() + ".bvh");
+            try
+            {
+                BvhTestFiles.Write(file, FRAMES, JOINTS, 1);
+                Assert.IsTrue(new FileInfo(file).Length >= BVHCache.MIN_SOURCE_LENGTH, "file too short for the cache");
+
+                BVHMotionData motionData;
+                var root = BVHReaderWriter.ParseBvh(file, false, out motionData);
+                BVHCache.Write(file, root, motionData);
+                Assert.IsTrue(File.Exists(BVHCache.GetCachePath(file)), "cache not written");
+
+                test(file, root, motionData);
+            }
+            finally
+            {
+                File.Delete(file);
+                File.Delete(BVHCache.GetCachePath(file));
+            }
+        }
+
+        private static void WriteFirstRotation(string file, float value)
+        {
+            long framesOffset = ReadCacheInt64(file, FRAMES_OFFSET_POSITION);
+            using (var stream = new FileStream(BVHCache.GetCachePath(file), FileMode.Open, FileAccess.Write))
+            {
+                stream.Position = framesOffset;
+                new BinaryWriter(stream).Write(value);
+            }
+        }
+
+        private static long ReadCacheInt64(string file, long position)
+        {
+            using (var stream = File.OpenRead(BVHCache.GetCachePath(file)))
+            {
+                stream.Position = position;
+                return new BinaryReader(stream).ReadInt64();
+            }
+        }
+    }
+}
@@ -0,0 +1,90 @@
+﻿/*
+Part of Bewegungsfelder
+
+MIT-License
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using System;
+using System.IO;
+using Bewegungsfelder.BVH;
+using Microsoft.VisualStudio.TestTools.UnitTesting;
+
+namespace Bewegungsfelder.Tests
+{
+    /// <summary>
+    /// parses generated bvh files sequentially and in parallel chunks and checks that both give the same data.
+    /// the files are large enough to be split into several chunks even on a single core
+    /// </summary>
+    [TestClass]
+    public class BVHParallelReaderTests
+    {
+        // about 500 bytes per frame, beyond PARALLEL_MIN_LENGTH
+        private const int FRAMES = 10000;
+        private const int JOINTS = 20;
+
+        [TestMethod]
+        public void ParallelReadMatchesSequentialRead()
+        {
+            AssertSameData("\n", true, 1);
+        }
+
+        [TestMethod]
+        public void CrLfWithoutFinalNewLineMatchesSequentialRead()
+        {
+            AssertSameData("\r\n", false, 2);
+        }
+
+        private static void AssertSameData(string newLine, bool finalNewLine, int seed)
+        {
+            string path = Path.Combine(Path.GetTempPath(), Guid.NewGuid() + ".bvh");
+            try
+            {
+                BvhTestFiles.Write(path, FRAMES, JOINTS, seed, newLine, finalNewLine);
+                Assert.IsTrue(new FileInfo(path).Length > BVHReaderWriter.PARALLEL_MIN_LENGTH, "file too short for the parallel path");
+
+                BVHMotionData sequential, parallel;
+                var sequentialRoot = BVHReaderWriter.ParseBvh(path, false, out sequential);
+                var parallelRoot = BVHReaderWriter.ParseBvh(path, true, out parallel);
+
+                BvhTestFiles.AssertNode(sequentialRoot, parallelRoot);
+                Assert.AreEqual(FRAMES, sequential.FrameCount, "sequential frame count");
+                Assert.AreEqual(FRAMES, parallel.FrameCount, "parallel frame count");
+                Assert.AreEqual(sequential.FrameTime, parallel.FrameTime, "frame time");
+                Assert.AreEqual(JOINTS, parallel.Joints.Length, "joint count");
+                for (int i = 0; i < JOINTS; i++)
+                {
+                    Assert.AreEqual(sequential.Joints[i].Name, parallel.Joints[i].Name, $"joint {i}");
+                }
+
+                Assert.AreEqual(sequential.Rotations.Length, parallel.Rotations.Length, "rotation count");
+                for (int i = 0; i < sequential.Rotations.Length; i++)
+                {
+                    if (sequential.Rotations[i] != parallel.Rotations[i])
+                        Assert.Fail($"rotation value {i} of frame {i / sequential.FrameStride}: {sequential.Rotations[i]} != {parallel.Rotations[i]}");
+                }
+            }
+            finally
+            {
+                File.Delete(path);
+            }
+        }
+    }
+}
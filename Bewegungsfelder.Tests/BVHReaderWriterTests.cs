@@ -0,0 +1,211 @@
+﻿/*
+Part of Bewegungsfelder
+
+MIT-License
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using System;
+using System.Globalization;
+using System.IO;
+using System.Threading;
+using Bewegungsfelder.BVH;
+using Bewegungsfelder.Mathematics;
+using Microsoft.VisualStudio.TestTools.UnitTesting;
+
+namespace Bewegungsfelder.Tests
+{
+    /// <summary>
+    /// writes random rotations with WriteBvh and reads them back.
+    /// values are written with six decimals in degrees, so the rotations only match within a tolerance
+    /// </summary>
+    [TestClass]
+    public class BVHReaderWriterTests
+    {
+        // rotation angle between the written and the read rotation
+        private const double ANGLE_TOLERANCE = 1e-4;
+
+        // several batches of formatted blocks, the last one partial
+        private const int FRAMES = 1500;
+
+        [TestMethod]
+        public void WrittenFileReadsBack()
+        {
+            AssertRoundTrip(FRAMES, 1);
+        }
+
+        [TestMethod]
+        public void WrittenFileIsCultureInvariant()
+        {
+            var culture = Thread.CurrentThread.CurrentCulture;
+            try
+            {
+                // decimal comma
+                Thread.CurrentThread.CurrentCulture = new CultureInfo("de-DE");
+                string text = AssertRoundTrip(10, 2);
+                Assert.IsFalse(text.Contains(","), "decimal comma written");
+            }
+            finally
+            {
+                Thread.CurrentThread.CurrentCulture = culture;
+            }
+        }
+
+        [TestMethod]
+        public void IdentityAndSmallRotationsReadBack()
+        {
+            // angles that round to zero or to few decimals
+            var root = CreateHierarchy();
+            var joints = BVHMotionData.GetJoints(root);
+            var motionData = new BVHMotionData(0.01, joints, 3);
+            var axis = new Vector3D(1, 2, 3);
+            axis.Normalize();
+            for (int j = 0; j < joints.Length; j++)
+            {
+                motionData.SetRotation(0, j, Quaternion.Identity);
+                motionData.SetRotation(1, j, new Quaternion(axis, 1e-7 * (j + 1)));
+                motionData.SetRotation(2, j, new Quaternion(axis, -0.5 * (j + 1)));
+            }
+
+            AssertRoundTrip(root, motionData);
+        }
+
+        /// <summary>
+        /// writes random rotations and checks what is read back
+        /// </summary>
+        /// <returns>the text of the file</returns>
+        private static string AssertRoundTrip(int frames, int seed)
+        {
+            var random = new Random(seed);
+            var root = CreateHierarchy();
+            var joints = BVHMotionData.GetJoints(root);
+            var motionData = new BVHMotionData(1 / 120.0, joints, frames);
+            for (int f = 0; f < frames; f++)
+            {
+                for (int j = 0; j < joints.Length; j++)
+                {
+                    var axis = new Vector3D(random.NextDouble() - 0.5, random.NextDouble() - 0.5, random.NextDouble() - 0.5);
+                    axis.Normalize();
+                    motionData.SetRotation(f, j, new Quaternion(axis, random.NextDouble() * 360 - 180));
+                }
+            }
+
+            return AssertRoundTrip(root, motionData);
+        }
+
+        private static string AssertRoundTrip(BVHNode root, BVHMotionData motionData)
+        {
+            string file = Path.Combine(Path.GetTempPath(), Guid.NewGuid() + ".bvh");
+            try
+            {
+                BVHReaderWriter.WriteBvh(file, root, motionData);
+
+                BVHMotionData read;
+                var readRoot = BVHReaderWriter.ReadBvh(file, out read);
+
+                AssertNode(root, readRoot);
+                Assert.AreEqual(motionData.FrameTime, read.FrameTime, 1e-12, "frame time");
+                Assert.AreEqual(motionData.FrameCount, read.FrameCount, "frame count");
+                Assert.AreEqual(motionData.Joints.Length, read.Joints.Length, "joint count");
+                for (int f = 0; f < motionData.FrameCount; f++)
+                {
+                    for (int j = 0; j < motionData.Joints.Length; j++)
+                    {
+                        Assert.AreEqual(0, Angle(motionData.GetRotation(f, j), read.GetRotation(f, j)), ANGLE_TOLERANCE,
+                            $"rotation of joint {j} in frame {f}");
+                    }
+                }
+
+                return File.ReadAllText(file);
+            }
+            finally
+            {
+                File.Delete(file);
+                File.Delete(BVHCache.GetCachePath(file));
+            }
+        }
+
+        /// <summary>
+        /// a root with two branches, one joint with two children. all joints with zyx channels as exported
+        /// </summary>
+        private static BVHNode CreateHierarchy()
+        {
+            var root = Joint(BVHNodeTypes.Root, "hips", 0, 90.5, -1.25);
+            var spine = Joint(BVHNodeTypes.Joint, "spine", 0, 10, 0);
+            var head = Joint(BVHNodeTypes.Joint, "head", 0, 25.125, 2);
+            var arm = Joint(BVHNodeTypes.Joint, "arm", -15, 20, 0);
+            var leg = Joint(BVHNodeTypes.Joint, "leg", 8, -45.75, 0.5);
+
+            root.Children.Add(spine);
+            root.Children.Add(leg);
+            spine.Children.Add(head);
+            spine.Children.Add(arm);
+            head.Children.Add(EndSite(0, 12, 0));
+            arm.Children.Add(EndSite(-30, 0, 0));
+            leg.Children.Add(EndSite(0, -40, 3));
+            return root;
+        }
+
+        private static BVHNode Joint(BVHNodeTypes type, string name, double x, double y, double z)
+        {
+            return new BVHNode
+            {
+                Type = type,
+                Name = name,
+                Offset = new Vector3D(x, y, z),
+                Channels = new[] { BVHChannels.Zrotation, BVHChannels.Yrotation, BVHChannels.Xrotation },
+            };
+        }
+
+        private static BVHNode EndSite(double x, double y, double z)
+        {
+            return new BVHNode { Type = BVHNodeTypes.EndSite, Offset = new Vector3D(x, y, z) };
+        }
+
+        /// <summary>
+        /// compares the hierarchies, end sites have no name in the file
+        /// </summary>
+        private static void AssertNode(BVHNode expected, BVHNode actual)
+        {
+            Assert.AreEqual(expected.Type, actual.Type, expected.Name);
+            if (expected.Type != BVHNodeTypes.EndSite)
+            {
+                Assert.AreEqual(expected.Name, actual.Name);
+                Assert.AreEqual(string.Join(" ", expected.Channels), string.Join(" ", actual.Channels), expected.Name + " channels");
+            }
+
+            Assert.AreEqual(expected.Offset.X, actual.Offset.X, 0.0, expected.Name + " offset x");
+            Assert.AreEqual(expected.Offset.Y, actual.Offset.Y, 0.0, expected.Name + " offset y");
+            Assert.AreEqual(expected.Offset.Z, actual.Offset.Z, 0.0, expected.Name + " offset z");
+            Assert.AreEqual(expected.Children.Count, actual.Children.Count, expected.Name + " children");
+            for (int i = 0; i < expected.Children.Count; i++)
+            {
+                AssertNode(expected.Children[i], actual.Children[i]);
+            }
+        }
+
+        private static double Angle(Quaternion a, Quaternion b)
+        {
+            double dot = a.W * b.W + a.X * b.X + a.Y * b.Y + a.Z * b.Z;
+            double lengths = (a.W * a.W + a.X * a.X + a.Y * a.Y + a.Z * a.Z) * (b.W * b.W + b.X * b.X + b.Y * b.Y + b.Z * b.Z);
+            return 2 * Math.Acos(Math.Min(1, Math.Abs(dot) / Math.Sqrt(lengths)));
+        }
+    }
+}
@@ -0,0 +1,138 @@
+﻿/*
+Part of Bewegungsfelder
+
+MIT-License
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using System;
+using System.Globalization;
+using System.IO;
+using System.Text;
+using Bewegungsfelder.BVH;
+using Microsoft.VisualStudio.TestTools.UnitTesting;
+
+namespace Bewegungsfelder.Tests
+{
+    /// <summary>
+    /// generates bvh files with random angles and compares hierarchies for the bvh tests
+    /// </summary>
+    static class BvhTestFiles
+    {
+        // rotation channels of the joints, cycled through so every order is parsed
+        private static readonly string[] ROTATION_ORDERS =
+        {
+            "Zrotation Xrotation Yrotation", "Zrotation Yrotation Xrotation", "Xrotation Yrotation Zrotation",
+            "Xrotation Zrotation Yrotation", "Yrotation Xrotation Zrotation", "Yrotation Zrotation Xrotation",
+        };
+
+        /// <summary>
+        /// writes a hierarchy of joints with two branches below the root, each ending in an end site.
+        /// the root has position channels
+        /// </summary>
+        /// <param name="newLine">line break, "\n" or "\r\n"</param>
+        /// <param name="finalNewLine">false to end the file without a line break after the last frame</param>
+        public static void Write(string path, int frames, int joints, int seed, string newLine = "\n",
+            bool finalNewLine = true)
+        {
+            var random = new Random(seed);
+            var text = new StringBuilder();
+            text.Append("HIERARCHY").Append(newLine);
+
+            // joints 1..half below the root in one chain, the rest in a second chain
+            int half = joints / 2;
+            WriteJoint(text, 0, 0, joints, half, newLine);
+
+            text.Append("MOTION").Append(newLine);
+            text.Append($"Frames: {frames}").Append(newLine);
+            text.Append("Frame Time: 0.008333").Append(newLine);
+
+            using (var writer = new StreamWriter(path, false, new UTF8Encoding(false)))
+            {
+                writer.Write(text.ToString());
+                for (int f = 0; f < frames; f++)
+                {
+                    text.Clear();
+                    for (int i = 0; i < 3 + 3 * joints; i++)
+                    {
+                        if (i > 0)
+                            text.Append(i % 7 == 0 ? "\t" : " ");
+                        double value = i < 3 ? random.NextDouble() * 200 - 100 : random.NextDouble() * 360 - 180;
+                        text.Append(value.ToString("F4", CultureInfo.InvariantCulture));
+                    }
+                    if (finalNewLine || f < frames - 1)
+                        text.Append(newLine);
+                    writer.Write(text.ToString());
+                }
+            }
+        }
+
+        /// <summary>
+        /// compares two hierarchies node by node, offsets exactly
+        /// </summary>
+        public static void AssertNode(BVHNode expected, BVHNode actual)
+        {
+            Assert.AreEqual(expected.Type, actual.Type, expected.Name);
+            Assert.AreEqual(expected.Name, actual.Name);
+            Assert.AreEqual(expected.Offset.X, actual.Offset.X, 0.0, expected.Name + " offset x");
+            Assert.AreEqual(expected.Offset.Y, actual.Offset.Y, 0.0, expected.Name + " offset y");
+            Assert.AreEqual(expected.Offset.Z, actual.Offset.Z, 0.0, expected.Name + " offset z");
+            Assert.AreEqual(string.Join(" ", expected.Channels ?? new BVHChannels[0]),
+                string.Join(" ", actual.Channels ?? new BVHChannels[0]), expected.Name + " channels");
+            Assert.AreEqual(expected.Children.Count, actual.Children.Count, expected.Name + " children");
+            for (int i = 0; i < expected.Children.Count; i++)
+            {
+                AssertNode(expected.Children[i], actual.Children[i]);
+            }
+        }
+
+        private static void WriteJoint(StringBuilder text, int joint, int depth, int joints, int half, string newLine)
+        {
+            string indent = new string('\t', depth);
+            text.Append(indent).Append(joint == 0 ? "ROOT" : "JOINT").Append(" joint").Append(joint).Append(newLine);
+            text.Append(indent).Append("{").Append(newLine);
+            text.Append(indent).Append($"\tOFFSET {joint}.5 -{joint} 0.25").Append(newLine);
+            text.Append(indent).Append(joint == 0
+                ? "\tCHANNELS 6 Xposition Yposition Zposition " + ROTATION_ORDERS[0]
+                : "\tCHANNELS 3 " + ROTATION_ORDERS[joint % ROTATION_ORDERS.Length]).Append(newLine);
+
+            if (joint == 0)
+            {
+                if (half >= 1)
+                    WriteJoint(text, 1, depth + 1, joints, half, newLine);
+                if (half + 1 < joints)
+                    WriteJoint(text, half + 1, depth + 1, joints, half, newLine);
+            }
+            else if (joint + 1 < joints && joint + 1 != half + 1)
+            {
+                WriteJoint(text, joint + 1, depth + 1, joints, half, newLine);
+            }
+            else
+            {
+                text.Append(indent).Append("\tEnd Site").Append(newLine);
+                text.Append(indent).Append("\t{").Append(newLine);
+                text.Append(indent).Append("\t\tOFFSET 0 1 0").Append(newLine);
+                text.Append(indent).Append("\t}").Append(newLine);
+            }
+
+            text.Append(indent).Append("}").Append(newLine);
+        }
+    }
+}
@@ -0,0 +1,207 @@
+﻿/*
+Part of Bewegungsfelder
+
+MIT-License
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using System;
+using System.Collections.Generic;
+using System.IO;
+using Bewegungsfelder.Core;
+using Bewegungsfelder.Mathematics;
+using Microsoft.VisualStudio.TestTools.UnitTesting;
+
+namespace Bewegungsfelder.Tests
+{
+    /// <summary>
+    /// damages chunks of capture files and checks that the reader drops them.
+    /// with a valid index the crc is checked on first access, without one while scanning
+    /// </summary>
+    [TestClass]
+    public class CaptureReaderTests
+    {
+        private const int SENSOR_ID = 3;
+        private const int FRAME_COUNT = 3 * CaptureWriter.FRAMES_PER_CHUNK;
+        private const int SAMPLE_COUNT = 2 * CaptureWriter.SAMPLES_PER_CHUNK + 88;
+
+        private static readonly DateTime START = new DateTime(2016, 6, 1, 12, 0, 0);
+
+        [TestMethod]
+        public void CorruptedFrameChunkIsDropped()
+        {
+            foreach (var maxFrameError in new[] { 0, 0.5 * Math.PI / 180 })
+            {
+                var path = WriteCapture(maxFrameError);
+                try
+                {
+                    var type = maxFrameError > 0 ? CaptureChunkType.CompressedFrames : CaptureChunkType.Frames;
+                    Corrupt(path, FindChunks(path, type)[1]);
+
+                    using (var reader = new CaptureReader(path))
+                    {
+                        Assert.IsTrue(reader.IsComplete, "the index was not used");
+                        Assert.AreEqual(FRAME_COUNT, reader.FrameCount);
+
+                        var frame = new float[4 * MotionData.JOINT_STRIDE];
+                        for (int f = 0; f < FRAME_COUNT; f++)
+                        {
+                            bool dropped = f / CaptureWriter.FRAMES_PER_CHUNK == 1;
+                            Assert.AreEqual(!dropped, reader.ReadFrame(f, frame), $"{type} frame {f}");
+                            Assert.AreEqual(!dropped, reader.GetSkeleton(f) != null, $"{type} skeleton of frame {f}");
+                        }
+                    }
+                }
+                finally
+                {
+                    File.Delete(path);
+                }
+            }
+        }
+
+        [TestMethod]
+        public void CorruptedSampleChunkThrows()
+        {
+            var path = WriteCapture(0);
+            try
+            {
+                Corrupt(path, FindChunks(path, CaptureChunkType.Samples)[1]);
+
+                using (var reader = new CaptureReader(path))
+                {
+                    Assert.AreEqual((long)SAMPLE_COUNT, reader.GetSampleCount(SENSOR_ID));
+                    Assert.AreEqual(10u, reader.ReadSample(SENSOR_ID, 10).SensorTimestamp);
+                    Assert.AreEqual(550u, reader.ReadSample(SENSOR_ID, 550).SensorTimestamp);
+
+                    try
+                    {
+                        reader.ReadSample(SENSOR_ID, CaptureWriter.SAMPLES_PER_CHUNK + 10);
+                        Assert.Fail("a corrupted value was read");
+                    }
+                    catch (InvalidDataException)
+                    {
+                    }
+                }
+            }
+            finally
+            {
+                File.Delete(path);
+            }
+        }
+
+        [TestMethod]
+        public void ScanStopsAtCorruptedChunk()
+        {
+            var path = WriteCapture(0);
+            try
+            {
+                Corrupt(path, FindChunks(path, CaptureChunkType.Frames)[1]);
+
+                // without the trailer the chunks are scanned
+                using (var file = new FileStream(path, FileMode.Open))
+                {
+                    file.SetLength(file.Length - CaptureFormat.TRAILER_LENGTH);
+                }
+
+                using (var reader = new CaptureReader(path))
+                {
+                    Assert.IsFalse(reader.IsComplete, "the damaged index was used");
+                    Assert.AreEqual(CaptureWriter.FRAMES_PER_CHUNK, reader.FrameCount);
+                }
+            }
+            finally
+            {
+                File.Delete(path);
+            }
+        }
+
+        /// <summary>
+        /// records a skeleton with four joints, FRAME_COUNT frames and SAMPLE_COUNT values of one sensor
+        /// </summary>
+        private static string WriteCapture(double maxFrameError)
+        {
+            var root = new Bone(null, "root");
+            var parent = root;
+            for (int i = 1; i < 4; i++)
+            {
+                var bone = new Bone(parent, "bone" + i, new Vector3D(0, 1, 0));
+                parent.Children.Add(bone);
+                parent = bone;
+            }
+            var skeleton = new CompiledSkeleton(root);
+            var motion = new MotionData();
+            motion.Reset(skeleton.Bones);
+
+            var path = Path.Combine(Path.GetTempPath(), Guid.NewGuid() + CaptureFormat.FILE_EXTENSION);
+            using (var writer = new CaptureWriter(path, maxFrameError))
+            {
+                writer.WriteSkeleton(skeleton, motion);
+                for (int f = 0; f < FRAME_COUNT; f++)
+                {
+                    var frame = motion.AddFrame();
+                    for (int j = 0; j < motion.JointCount; j++)
+                    {
+                        MotionData.Write(frame, j, new Quaternion(new Vector3D(1, 0, 0), f + j));
+                    }
+                    writer.AppendFrame(START.AddMilliseconds(f * 10), frame);
+                }
+
+                for (int i = 0; i < SAMPLE_COUNT; i++)
+                {
+                    writer.AppendSample(SENSOR_ID, new SensorValue(new Quaternion(0, 0, 0, 1), new Vector3D(0, 0, 1),
+                        new Vector3D(), START.AddMilliseconds(i), (uint)i, i));
+                }
+            }
+
+            return path;
+        }
+
+        /// <summary>
+        /// returns the offsets of all chunks of a type
+        /// </summary>
+        private static List<long> FindChunks(string path, CaptureChunkType type)
+        {
+            var offsets = new List<long>();
+            var bytes = File.ReadAllBytes(path);
+            long offset = CaptureFormat.FILE_HEADER_LENGTH;
+            while (offset + CaptureFormat.CHUNK_HEADER_LENGTH <= bytes.Length - CaptureFormat.TRAILER_LENGTH)
+            {
+                if ((CaptureChunkType)BitConverter.ToUInt16(bytes, (int)offset) == type)
+                    offsets.Add(offset);
+                offset += CaptureFormat.CHUNK_HEADER_LENGTH + BitConverter.ToInt32(bytes, (int)offset + 12);
+            }
+            return offsets;
+        }
+
+        /// <summary>
+        /// flips a bit in the payload of a chunk
+        /// </summary>
+        private static void Corrupt(string path, long chunkOffset)
+        {
+            using (var file = new FileStream(path, FileMode.Open))
+            {
+                file.Position = chunkOffset + CaptureFormat.CHUNK_HEADER_LENGTH + 12;
+                int value = file.ReadByte();
+                file.Position--;
+                file.WriteByte((byte)(value ^ 0x10));
+            }
+        }
+    }
+}
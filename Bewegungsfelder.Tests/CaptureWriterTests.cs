@@ -0,0 +1,383 @@
+﻿/*
+Part of Bewegungsfelder
+
+MIT-License
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using System;
+using System.Collections.Generic;
+using System.IO;
+using System.Linq;
+using Bewegungsfelder.Core;
+using Bewegungsfelder.Mathematics;
+using Microsoft.VisualStudio.TestTools.UnitTesting;
+
+namespace Bewegungsfelder.Tests
+{
+    /// <summary>
+    /// writes capture files and reads them back, closed properly and cut off like after a crash
+    /// </summary>
+    [TestClass]
+    public class CaptureWriterTests
+    {
+        private const int FRAME_COUNT = 2 * CaptureWriter.FRAMES_PER_CHUNK + 10;
+        private const int SAMPLE_COUNT = CaptureWriter.SAMPLES_PER_CHUNK + 20;
+        private static readonly int[] SENSOR_IDS = { 3, 7 };
+
+        private static readonly double MAX_FRAME_ERROR = 0.5 * Math.PI / 180;
+
+        // the rotations are stored as floats
+        private const double FLOAT_TOLERANCE = 1e-5;
+
+        private static readonly DateTime START = new DateTime(2016, 6, 1, 12, 0, 0);
+
+        [TestMethod]
+        public void FramesAndSamplesRoundTrip()
+        {
+            foreach (var maxFrameError in new[] { 0, MAX_FRAME_ERROR })
+            {
+                MotionData motion;
+                var skeleton = CreateSkeleton(out motion);
+                var path = NewPath();
+                try
+                {
+                    using (var writer = new CaptureWriter(path, maxFrameError))
+                    {
+                        Write(writer, skeleton, motion, 0, FRAME_COUNT);
+                        WriteSamples(writer);
+                        Assert.AreEqual(FRAME_COUNT, writer.FrameCount);
+                        Assert.AreEqual(FRAME_COUNT, motion.FrameCount);
+                    }
+
+                    using (var reader = new CaptureReader(path))
+                    {
+                        Assert.IsTrue(reader.IsComplete);
+                        Assert.AreEqual(FRAME_COUNT, reader.FrameCount);
+                        Assert.AreEqual(motion.FPS, reader.FPS);
+                        Assert.AreEqual(1, reader.Skeletons.Count);
+                        AssertSkeleton(skeleton, motion, reader.Skeletons[0]);
+
+                        var frame = new float[motion.FrameStride];
+                        for (int f = 0; f < FRAME_COUNT; f++)
+                        {
+                            Assert.AreEqual(reader.Skeletons[0], reader.GetSkeleton(f));
+                            Assert.IsTrue(reader.ReadFrame(f, frame), $"frame {f} was dropped");
+                            AssertFrame(motion, f, frame, maxFrameError);
+
+                            // compressed frame times are stored in microseconds
+                            var time = reader.GetFrameTime(f);
+                            Assert.AreEqual(0, (time - FrameTime(f)).Ticks, maxFrameError > 0 ? 10 : 0, $"time of frame {f}");
+                        }
+
+                        AssertSamples(reader, SAMPLE_COUNT);
+                    }
+                }
+                finally
+                {
+                    File.Delete(path);
+                }
+            }
+        }
+
+        [TestMethod]
+        public void FramesUseTheLastSkeleton()
+        {
+            MotionData motion;
+            var skeleton = CreateSkeleton(out motion);
+            var root = new Bone(null, "other");
+            root.Children.Add(new Bone(root, "end", new Vector3D(0, 1, 0)));
+            var other = new CompiledSkeleton(root);
+            var otherMotion = new MotionData { FPS = 60 };
+            otherMotion.Reset(new[] { root });
+
+            var path = NewPath();
+            try
+            {
+                using (var writer = new CaptureWriter(path, MAX_FRAME_ERROR))
+                {
+                    Write(writer, skeleton, motion, 0, 10);
+                    Write(writer, other, otherMotion, 10, 20);
+                }
+
+                using (var reader = new CaptureReader(path))
+                {
+                    Assert.AreEqual(2, reader.Skeletons.Count);
+                    Assert.AreEqual(30, reader.FrameCount);
+                    Assert.AreEqual(reader.Skeletons[0], reader.GetSkeleton(9));
+                    Assert.AreEqual(reader.Skeletons[1], reader.GetSkeleton(10));
+                    Assert.AreEqual("other", reader.Skeletons[1].Names[0]);
+
+                    var frame = new float[otherMotion.FrameStride];
+                    for (int f = 0; f < 20; f++)
+                    {
+                        Assert.IsTrue(reader.ReadFrame(10 + f, frame));
+                        AssertFrame(otherMotion, f, frame, MAX_FRAME_ERROR);
+                    }
+                }
+            }
+            finally
+            {
+                File.Delete(path);
+            }
+        }
+
+        [TestMethod]
+        public void FrameOfAnotherSkeletonIsRejected()
+        {
+            MotionData motion;
+            var skeleton = CreateSkeleton(out motion);
+            var path = NewPath();
+            try
+            {
+                using (var writer = new CaptureWriter(path))
+                {
+                    writer.WriteSkeleton(skeleton, motion);
+                    try
+                    {
+                        writer.AppendFrame(START, new ArraySegment<float>(new float[motion.FrameStride + 4]));
+                        Assert.Fail("a frame with more joints was appended");
+                    }
+                    catch (InvalidOperationException)
+                    {
+                    }
+                }
+            }
+            finally
+            {
+                File.Delete(path);
+            }
+        }
+
+        [TestMethod]
+        public void UnclosedFileIsRecovered()
+        {
+            foreach (var maxFrameError in new[] { 0, MAX_FRAME_ERROR })
+            {
+                MotionData motion;
+                var skeleton = CreateSkeleton(out motion);
+                var path = NewPath();
+                try
+                {
+                    using (var writer = new CaptureWriter(path, maxFrameError))
+                    {
+                        Write(writer, skeleton, motion, 0, FRAME_COUNT);
+                        WriteSamples(writer);
+                    }
+
+                    // cut the file in the middle of the last frame chunk, the index and the chunks behind are lost
+                    var chunks = ReadChunkHeaders(path);
+                    var frameType = maxFrameError > 0 ? CaptureChunkType.CompressedFrames : CaptureChunkType.Frames;
+                    var cut = chunks.Last(chunk => chunk.Type == frameType);
+                    using (var file = new FileStream(path, FileMode.Open))
+                    {
+                        file.SetLength(cut.Offset + CaptureFormat.CHUNK_HEADER_LENGTH + cut.Length / 2);
+                    }
+
+                    int samples = chunks.TakeWhile(chunk => chunk != cut)
+                        .Where(chunk => chunk.Type == CaptureChunkType.Samples && chunk.Id == SENSOR_IDS[0])
+                        .Sum(chunk => chunk.Count);
+
+                    using (var reader = new CaptureReader(path))
+                    {
+                        Assert.IsFalse(reader.IsComplete);
+                        Assert.AreEqual(cut.Id, reader.FrameCount);
+
+                        var frame = new float[motion.FrameStride];
+                        for (int f = 0; f < reader.FrameCount; f++)
+                        {
+                            Assert.IsTrue(reader.ReadFrame(f, frame), $"frame {f} was dropped");
+                            AssertFrame(motion, f, frame, maxFrameError);
+                        }
+
+                        Assert.AreEqual((long)samples, reader.GetSampleCount(SENSOR_IDS[0]));
+                    }
+                }
+                finally
+                {
+                    File.Delete(path);
+                }
+            }
+        }
+
+        private class ChunkHeader
+        {
+            public CaptureChunkType Type;
+            public int Id;
+            public int Count;
+            public int Length;
+            public long Offset;
+        }
+
+        private static List<ChunkHeader> ReadChunkHeaders(string path)
+        {
+            var chunks = new List<ChunkHeader>();
+            var bytes = File.ReadAllBytes(path);
+            int offset = CaptureFormat.FILE_HEADER_LENGTH;
+            while (offset + CaptureFormat.CHUNK_HEADER_LENGTH <= bytes.Length - CaptureFormat.TRAILER_LENGTH)
+            {
+                var chunk = new ChunkHeader
+                {
+                    Type = (CaptureChunkType)BitConverter.ToUInt16(bytes, offset),
+                    Id = BitConverter.ToInt32(bytes, offset + 4),
+                    Count = BitConverter.ToInt32(bytes, offset + 8),
+                    Length = BitConverter.ToInt32(bytes, offset + 12),
+                    Offset = offset,
+                };
+                chunks.Add(chunk);
+                offset += CaptureFormat.CHUNK_HEADER_LENGTH + chunk.Length;
+            }
+            return chunks;
+        }
+
+        /// <summary>
+        /// a root with two chains. the end sites are not recorded, like in the app
+        /// </summary>
+        private static CompiledSkeleton CreateSkeleton(out MotionData motion)
+        {
+            var root = new Bone(null, "hips", new Vector3D(0, 1, 0));
+            var spine = new Bone(root, "spine", new Vector3D(0, 0.5, 0));
+            var head = new Bone(spine, "head", new Vector3D(0, 0.3, 0.1));
+            var leg = new Bone(root, "leg", new Vector3D(0.2, -0.5, 0));
+            var foot = new Bone(leg, "foot", new Vector3D(0, -0.4, 0.1));
+            root.Children.Add(spine);
+            spine.Children.Add(head);
+            root.Children.Add(leg);
+            leg.Children.Add(foot);
+
+            var skeleton = new CompiledSkeleton(root);
+            motion = new MotionData { FPS = 120 };
+            motion.Reset(skeleton.Bones.Where(bone => !bone.IsEndSite));
+            return skeleton;
+        }
+
+        /// <summary>
+        /// writes the skeleton and appends count frames
+        /// </summary>
+        private static void Write(CaptureWriter writer, CompiledSkeleton skeleton, MotionData motion, int first, int count)
+        {
+            writer.WriteSkeleton(skeleton, motion);
+            for (int f = 0; f < count; f++)
+            {
+                var frame = motion.AddFrame();
+                for (int j = 0; j < motion.JointCount; j++)
+                {
+                    var axis = new Vector3D(j, 1, 0.5);
+                    axis.Normalize();
+                    MotionData.Write(frame, j, new Quaternion(axis, 30 * Math.Sin(0.05 * f + j)));
+                }
+                writer.AppendFrame(FrameTime(first + f), frame);
+            }
+        }
+
+        private static void WriteSamples(CaptureWriter writer)
+        {
+            for (int i = 0; i < SAMPLE_COUNT; i++)
+            {
+                foreach (int id in SENSOR_IDS)
+                {
+                    writer.AppendSample(id, Sample(id, i));
+                }
+            }
+        }
+
+        private static SensorValue Sample(int sensorId, int i)
+        {
+            return new SensorValue(new Quaternion(new Vector3D(0, 0, 1), i % 360), new Vector3D(0.1 * i, sensorId, 1),
+                new Vector3D(-i, 0.5, 2), START.AddMilliseconds(5 * i), (uint)(5000 * i), i % 65536);
+        }
+
+        /// <summary>
+        /// frames recorded with an uneven interval of about 8.3ms
+        /// </summary>
+        private static DateTime FrameTime(int frame)
+        {
+            return START.AddTicks(frame * 83333L + frame % 7 * 1234);
+        }
+
+        private static string NewPath()
+        {
+            return Path.Combine(Path.GetTempPath(), Guid.NewGuid() + CaptureFormat.FILE_EXTENSION);
+        }
+
+        private static void AssertSkeleton(CompiledSkeleton skeleton, MotionData motion, CaptureSkeleton read)
+        {
+            Assert.AreEqual(skeleton.Count, read.Count);
+            Assert.AreEqual(motion.JointCount, read.JointCount);
+            for (int i = 0; i < skeleton.Count; i++)
+            {
+                var bone = skeleton.Bones[i];
+                Assert.AreEqual(bone.Name, read.Names[i]);
+                Assert.AreEqual(skeleton.Parents[i], read.Parents[i]);
+                Assert.AreEqual(motion.IndexOf(bone), read.Joints[i]);
+                Assert.AreEqual(bone.Offset.X, read.Offsets[i].X, FLOAT_TOLERANCE);
+                Assert.AreEqual(bone.Offset.Y, read.Offsets[i].Y, FLOAT_TOLERANCE);
+                Assert.AreEqual(bone.Offset.Z, read.Offsets[i].Z, FLOAT_TOLERANCE);
+            }
+        }
+
+        private static void AssertFrame(MotionData motion, int f, float[] frame, double maxError)
+        {
+            var read = new ArraySegment<float>(frame);
+            for (int j = 0; j < motion.JointCount; j++)
+            {
+                var a = motion.GetRotation(f, j);
+                var b = MotionData.Read(read, j);
+                double dot = Math.Abs(a.W * b.W + a.X * b.X + a.Y * b.Y + a.Z * b.Z)
+                    / Math.Sqrt((a.W * a.W + a.X * a.X + a.Y * a.Y + a.Z * a.Z) * (b.W * b.W + b.X * b.X + b.Y * b.Y + b.Z * b.Z));
+                Assert.IsTrue(2 * Math.Acos(Math.Min(1, dot)) <= maxError + FLOAT_TOLERANCE, $"frame {f} joint {j}");
+            }
+        }
+
+        private static void AssertSamples(CaptureReader reader, int count)
+        {
+            AssertIds(SENSOR_IDS, reader.SensorIds);
+            foreach (int id in SENSOR_IDS)
+            {
+                Assert.AreEqual((long)count, reader.GetSampleCount(id));
+                for (int i = 0; i < count; i++)
+                {
+                    var expected = Sample(id, i);
+                    var actual = reader.ReadSample(id, i);
+                    string message = $"sensor {id} value {i}";
+
+                    Assert.AreEqual(expected.ArrivalTime, actual.ArrivalTime, message);
+                    Assert.AreEqual(expected.SensorTimestamp, actual.SensorTimestamp, message);
+                    Assert.AreEqual(expected.Sequence, actual.Sequence, message);
+                    Assert.AreEqual(expected.Orientation.W, actual.Orientation.W, FLOAT_TOLERANCE, message);
+                    Assert.AreEqual(expected.Orientation.X, actual.Orientation.X, FLOAT_TOLERANCE, message);
+                    Assert.AreEqual(expected.Orientation.Y, actual.Orientation.Y, FLOAT_TOLERANCE, message);
+                    Assert.AreEqual(expected.Orientation.Z, actual.Orientation.Z, FLOAT_TOLERANCE, message);
+                    Assert.AreEqual(expected.Acceleration.X, actual.Acceleration.X, FLOAT_TOLERANCE, message);
+                    Assert.AreEqual(expected.Acceleration.Y, actual.Acceleration.Y, FLOAT_TOLERANCE, message);
+                    Assert.AreEqual(expected.Acceleration.Z, actual.Acceleration.Z, FLOAT_TOLERANCE, message);
+                    Assert.AreEqual(expected.Gyro.X, actual.Gyro.X, FLOAT_TOLERANCE, message);
+                    Assert.AreEqual(expected.Gyro.Y, actual.Gyro.Y, FLOAT_TOLERANCE, message);
+                    Assert.AreEqual(expected.Gyro.Z, actual.Gyro.Z, FLOAT_TOLERANCE, message);
+                }
+            }
+        }
+
+        private static void AssertIds(IEnumerable<int> expected, IEnumerable<int> actual)
+        {
+            Assert.AreEqual(string.Join(",", expected.OrderBy(id => id)), string.Join(",", actual.OrderBy(id => id)));
+        }
+    }
+}
@@ -0,0 +1,228 @@
+﻿/*
+Part of Bewegungsfelder
+
+MIT-License
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using System;
+using System.IO;
+using System.Linq;
+using Bewegungsfelder.Core;
+using Bewegungsfelder.Mathematics;
+using Microsoft.VisualStudio.TestTools.UnitTesting;
+
+namespace Bewegungsfelder.Tests
+{
+    /// <summary>
+    /// compresses generated motions and checks every decoded rotation against the original one
+    /// </summary>
+    [TestClass]
+    public class CompressedMotionDataTests
+    {
+        private const int JOINT_COUNT = 6;
+        private const int FRAME_COUNT = 600;
+
+        // the rotations are stored as floats
+        private const double FLOAT_TOLERANCE = 1e-5;
+
+        private static readonly double DEGREE = Math.PI / 180;
+
+        [TestMethod]
+        public void DecodedRotationsStayWithinTheError()
+        {
+            var motion = CreateMotion(new Random(1));
+            foreach (var maxError in new[] { CompressedMotionData.MIN_MAX_ERROR, 0.1 * DEGREE, 0.5 * DEGREE, 5 * DEGREE })
+            {
+                var compressed = CompressedMotionData.Compress(motion, maxError);
+                Assert.AreEqual(CompressedMotionData.GetComponentBits(maxError), compressed.ComponentBits);
+                AssertWithinError(motion, compressed, maxError);
+            }
+        }
+
+        [TestMethod]
+        public void LargerErrorsKeepFewerKeys()
+        {
+            var motion = CreateMotion(new Random(2));
+            var fine = CompressedMotionData.Compress(motion, 0.1 * DEGREE);
+            var coarse = CompressedMotionData.Compress(motion, 2 * DEGREE);
+
+            Assert.IsTrue(coarse.KeyCount < fine.KeyCount, $"{coarse.KeyCount} keys for 2 degrees, {fine.KeyCount} for 0.1");
+            Assert.IsTrue(fine.KeyCount < JOINT_COUNT * FRAME_COUNT, "every frame is a key");
+        }
+
+        [TestMethod]
+        public void ErrorsBelowTheQuantizationAreRejected()
+        {
+            var motion = CreateMotion(new Random(3));
+            try
+            {
+                CompressedMotionData.Compress(motion, CompressedMotionData.MIN_MAX_ERROR * 0.99);
+                Assert.Fail("an error below the quantization was accepted");
+            }
+            catch (ArgumentOutOfRangeException)
+            {
+            }
+
+            var path = Path.Combine(Path.GetTempPath(), Guid.NewGuid() + ".bfcapture");
+            try
+            {
+                new CaptureWriter(path, CompressedMotionData.MIN_MAX_ERROR * 0.99).Dispose();
+                Assert.Fail("the capture writer accepted an error below the quantization");
+            }
+            catch (ArgumentOutOfRangeException)
+            {
+            }
+            Assert.IsFalse(File.Exists(path), "the capture file was created");
+        }
+
+        [TestMethod]
+        public void WriteAndReadRoundTrips()
+        {
+            var motion = CreateMotion(new Random(4));
+            var compressed = CompressedMotionData.Compress(motion, 0.5 * DEGREE);
+
+            var stream = new MemoryStream();
+            compressed.Write(new BinaryWriter(stream));
+            stream.Position = 0;
+            var read = CompressedMotionData.Read(new BinaryReader(stream));
+
+            Assert.AreEqual(stream.Length, stream.Position, "not all bytes were read");
+            Assert.AreEqual(compressed.JointCount, read.JointCount);
+            Assert.AreEqual(compressed.FrameCount, read.FrameCount);
+            Assert.AreEqual(compressed.ComponentBits, read.ComponentBits);
+            Assert.AreEqual(compressed.KeyCount, read.KeyCount);
+
+            // backwards, so every frame takes the search instead of the sequential cursor
+            var expected = new float[JOINT_COUNT * MotionData.JOINT_STRIDE];
+            var actual = new float[expected.Length];
+            for (int f = FRAME_COUNT - 1; f >= 0; f--)
+            {
+                compressed.ReadFrame(f, expected, 0);
+                read.ReadFrame(f, actual, 0);
+                AssertFrame(expected, actual, $"frame {f}");
+            }
+        }
+
+        [TestMethod]
+        public void TruncatedDataIsRejected()
+        {
+            var compressed = CompressedMotionData.Compress(CreateMotion(new Random(5)), 0.5 * DEGREE);
+            var stream = new MemoryStream();
+            compressed.Write(new BinaryWriter(stream));
+
+            var bytes = stream.ToArray();
+            try
+            {
+                CompressedMotionData.Read(new BinaryReader(new MemoryStream(bytes, 0, bytes.Length / 2)));
+                Assert.Fail("truncated data was read");
+            }
+            catch (InvalidDataException)
+            {
+            }
+            catch (EndOfStreamException)
+            {
+            }
+        }
+
+        /// <summary>
+        /// checks every joint of every frame, in order and at random
+        /// </summary>
+        private static void AssertWithinError(MotionData motion, CompressedMotionData compressed, double maxError)
+        {
+            var frame = new float[motion.FrameStride];
+            for (int f = 0; f < motion.FrameCount; f++)
+            {
+                compressed.ReadFrame(f, frame, 0);
+                var decoded = new ArraySegment<float>(frame);
+                for (int j = 0; j < motion.JointCount; j++)
+                {
+                    double angle = Angle(motion.GetRotation(f, j), MotionData.Read(decoded, j));
+                    Assert.IsTrue(angle <= maxError + FLOAT_TOLERANCE, $"frame {f} joint {j}: {angle} > {maxError}");
+                }
+            }
+
+            var random = new Random(0);
+            for (int i = 0; i < 1000; i++)
+            {
+                int f = random.Next(motion.FrameCount);
+                int j = random.Next(motion.JointCount);
+                double angle = Angle(motion.GetRotation(f, j), compressed.GetRotation(f, j));
+                Assert.IsTrue(angle <= maxError + FLOAT_TOLERANCE, $"frame {f} joint {j}: {angle} > {maxError}");
+            }
+        }
+
+        private static double Angle(Quaternion a, Quaternion b)
+        {
+            double dot = Math.Abs(a.W * b.W + a.X * b.X + a.Y * b.Y + a.Z * b.Z)
+                / Math.Sqrt((a.W * a.W + a.X * a.X + a.Y * a.Y + a.Z * a.Z) * (b.W * b.W + b.X * b.X + b.Y * b.Y + b.Z * b.Z));
+            return 2 * Math.Acos(Math.Min(1, dot));
+        }
+
+        private static void AssertFrame(float[] expected, float[] actual, string message)
+        {
+            for (int i = 0; i < expected.Length; i++)
+            {
+                Assert.AreEqual(expected[i], actual[i], $"{message} value {i}");
+            }
+        }
+
+        /// <summary>
+        /// joints swinging around random axes with a little noise, one joint standing still
+        /// and one with sudden turns, so keys are spaced from one frame to MAX_KEY_SPACING
+        /// </summary>
+        private static MotionData CreateMotion(Random random)
+        {
+            var root = new Bone(null, "root");
+            var joints = Enumerable.Range(0, JOINT_COUNT).Select(j => j == 0 ? root : new Bone(root, "joint" + j)).ToArray();
+            var motion = new MotionData();
+            motion.Reset(joints);
+
+            var axes = joints.Select(j => RandomAxis(random)).ToArray();
+            var phases = joints.Select(j => random.NextDouble() * 2 * Math.PI).ToArray();
+            var rotations = new Quaternion[JOINT_COUNT];
+            for (int f = 0; f < FRAME_COUNT; f++)
+            {
+                double t = f / motion.FPS;
+                for (int j = 0; j < JOINT_COUNT; j++)
+                {
+                    double degrees;
+                    if (j == 1)
+                        degrees = 30;
+                    else if (j == 2)
+                        degrees = f / 50 % 2 == 0 ? 170 : -170;
+                    else
+                        degrees = 90 * Math.Sin(j * t + phases[j]) + 0.05 * (random.NextDouble() - 0.5);
+
+                    var noise = new Quaternion(RandomAxis(random), 0.02 * random.NextDouble());
+                    rotations[j] = new Quaternion(axes[j], degrees) * noise;
+                }
+                motion.AddFrame(rotations);
+            }
+            return motion;
+        }
+
+        private static Vector3D RandomAxis(Random random)
+        {
+            var axis = new Vector3D(random.NextDouble() - 0.5, random.NextDouble() - 0.5, random.NextDouble() - 0.5);
+            return axis * (1 / axis.Length);
+        }
+    }
+}
@@ -0,0 +1,303 @@
+﻿/*
+Part of Bewegungsfelder
+
+MIT-License
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using System;
+using System.Collections.Generic;
+using System.Linq;
+using Bewegungsfelder.Mathematics;
+using Bewegungsfelder.Utilities;
+using Microsoft.VisualStudio.TestTools.UnitTesting;
+
+namespace Bewegungsfelder.Tests
+{
+    /// <summary>
+    /// checks EulerConversion against quaternions composed of the three axis rotations.
+    /// the simd path converts whole vectors of values and the padded rest of an array,
+    /// so every case is converted in bulk and one value at a time.
+    /// </summary>
+    [TestClass]
+    public class EulerConversionTests
+    {
+        private const double QUAT_TOLERANCE = 1e-5;
+
+        // rotation angle between the converted and the expected rotation
+        private const double ANGLE_TOLERANCE = 1e-3;
+
+        // EulerConversion.MAX_VECTOR_ANGLE, larger angles take the scalar path
+        private const float MAX_VECTOR_ANGLE = 8192;
+
+        private static readonly int WIDTH = System.Numerics.Vector<float>.Count;
+
+        private static IEnumerable<RotationOrder> Orders
+        {
+            get { return Enum.GetValues(typeof(RotationOrder)).Cast<RotationOrder>(); }
+        }
+
+        [TestMethod]
+        public void ToQuaternionsMatchesComposedRotations()
+        {
+            var random = new Random(1);
+            foreach (var order in Orders)
+            {
+                var angles = RandomAngles(random, 4 * WIDTH + 3, Math.PI);
+                AssertQuaternions(order, angles);
+            }
+        }
+
+        [TestMethod]
+        public void ToEulerAnglesRoundTrips()
+        {
+            var random = new Random(2);
+            foreach (var order in Orders)
+            {
+                var angles = RandomAngles(random, 4 * WIDTH + 3, Math.PI);
+                AssertEulerAngles(order, angles);
+            }
+        }
+
+        [TestMethod]
+        public void GimbalLockSetsThirdAngleToZero()
+        {
+            var random = new Random(3);
+            foreach (var order in Orders)
+            {
+                var angles = RandomAngles(random, 2 * WIDTH + 1, Math.PI);
+                for (int i = 0; i < angles[1].Length; i++)
+                {
+                    angles[1][i] = (float)(i % 2 == 0 ? Math.PI / 2 : -Math.PI / 2);
+                }
+
+                AssertQuaternions(order, angles);
+                var result = AssertEulerAngles(order, angles);
+                for (int i = 0; i < angles[1].Length; i++)
+                {
+                    Assert.AreEqual(angles[1][i], result[1][i], ANGLE_TOLERANCE, $"{order} second angle of {i}");
+                    Assert.AreEqual(0, result[2][i], ANGLE_TOLERANCE, $"{order} third angle of {i}");
+                }
+            }
+        }
+
+        [TestMethod]
+        public void TailsShorterThanAVectorAreConverted()
+        {
+            var random = new Random(4);
+            foreach (var order in Orders)
+            {
+                for (int count = 0; count < 2 * WIDTH; count++)
+                {
+                    AssertQuaternions(order, RandomAngles(random, count, Math.PI));
+                    AssertEulerAngles(order, RandomAngles(random, count, Math.PI));
+                }
+            }
+        }
+
+        [TestMethod]
+        public void AnglesBeyondTheVectorRangeAreConverted()
+        {
+            var random = new Random(5);
+            foreach (var order in Orders)
+            {
+                var angles = RandomAngles(random, 4 * WIDTH, Math.PI);
+
+                // one large angle in every vector, the other values stay in range
+                for (int i = 0; i < angles[0].Length; i += WIDTH)
+                {
+                    angles[i / WIDTH % 3][i] = (i / WIDTH % 2 == 0 ? 1 : -1) * MAX_VECTOR_ANGLE * (2 + i / WIDTH);
+                }
+
+                // all values of the last vector out of range, beyond 2^24 floats are even integers
+                for (int i = 3 * WIDTH; i < angles[0].Length; i++)
+                {
+                    angles[0][i] = 1e5f + i;
+                    angles[1][i] = -3e7f;
+                    angles[2][i] = MAX_VECTOR_ANGLE * 1.5f;
+                }
+
+                AssertQuaternions(order, angles);
+            }
+        }
+
+        [TestMethod]
+        public void ResultsDoNotDependOnTheIndex()
+        {
+            // the bvh readers convert blocks of frames that start at different frames
+            var random = new Random(6);
+            foreach (var order in Orders)
+            {
+                var angles = RandomAngles(random, 3 * WIDTH + 1, Math.PI);
+                var q = ToQuaternions(order, angles, 0, angles[0].Length);
+                var back = ToEulerAngles(order, q, 0, angles[0].Length);
+                for (int offset = 1; offset < angles[0].Length; offset++)
+                {
+                    var shiftedQ = ToQuaternions(order, angles, offset, angles[0].Length - offset);
+                    var shiftedBack = ToEulerAngles(order, q, offset, angles[0].Length - offset);
+                    for (int i = offset; i < angles[0].Length; i++)
+                    {
+                        for (int k = 0; k < 4; k++)
+                            Assert.AreEqual(q[k][i], shiftedQ[k][i - offset], $"{order} component {k} of {i} at offset {offset}");
+                        for (int k = 0; k < 3; k++)
+                            Assert.AreEqual(back[k][i], shiftedBack[k][i - offset], $"{order} angle {k} of {i} at offset {offset}");
+                    }
+                }
+            }
+        }
+
+        /// <summary>
+        /// converts all angles at once and one at a time and compares the quaternions to the composed rotations
+        /// </summary>
+        private static void AssertQuaternions(RotationOrder order, float[][] angles)
+        {
+            int count = angles[0].Length;
+            var bulk = ToQuaternions(order, angles, 0, count);
+
+            for (int i = 0; i < count; i++)
+            {
+                var expected = Compose(order, angles[0][i], angles[1][i], angles[2][i]);
+                var single = ToQuaternions(order, angles, i, 1);
+
+                AssertQuaternion(expected, bulk, i, $"{order} bulk {i} of {count}");
+                AssertQuaternion(expected, single, 0, $"{order} single {i}");
+            }
+        }
+
+        /// <summary>
+        /// converts the rotations of the angles back to angles, all at once and one at a time.
+        /// checks the ranges and that the angles describe the same rotations
+        /// </summary>
+        /// <returns>the angles of the bulk conversion</returns>
+        private static float[][] AssertEulerAngles(RotationOrder order, float[][] angles)
+        {
+            int count = angles[0].Length;
+            var q = ToQuaternions(order, angles, 0, count);
+            var bulk = ToEulerAngles(order, q, 0, count);
+
+            for (int i = 0; i < count; i++)
+            {
+                var expected = Compose(order, angles[0][i], angles[1][i], angles[2][i]);
+                var single = ToEulerAngles(order, q, i, 1);
+
+                AssertAngles(order, expected, bulk, i, $"{order} bulk {i} of {count}");
+                AssertAngles(order, expected, single, 0, $"{order} single {i}");
+
+                for (int k = 0; k < 3; k++)
+                {
+                    Assert.AreEqual(bulk[k][i], single[k][0], ANGLE_TOLERANCE, $"{order} angle {k} of {i}");
+                }
+            }
+
+            return bulk;
+        }
+
+        private static void AssertQuaternion(Quaternion expected, float[][] q, int i, string message)
+        {
+            // q and -q are the same rotation
+            double sign = expected.W * q[0][i] + expected.X * q[1][i] + expected.Y * q[2][i] + expected.Z * q[3][i] < 0 ? -1 : 1;
+            Assert.AreEqual(expected.W, sign * q[0][i], QUAT_TOLERANCE, message + " w");
+            Assert.AreEqual(expected.X, sign * q[1][i], QUAT_TOLERANCE, message + " x");
+            Assert.AreEqual(expected.Y, sign * q[2][i], QUAT_TOLERANCE, message + " y");
+            Assert.AreEqual(expected.Z, sign * q[3][i], QUAT_TOLERANCE, message + " z");
+        }
+
+        private static void AssertAngles(RotationOrder order, Quaternion expected, float[][] angles, int i, string message)
+        {
+            Assert.IsTrue(Math.Abs(angles[0][i]) <= Math.PI + 1e-6, message + " first angle out of range");
+            Assert.IsTrue(Math.Abs(angles[1][i]) <= Math.PI / 2 + 1e-6, message + " second angle out of range");
+            Assert.IsTrue(Math.Abs(angles[2][i]) <= Math.PI + 1e-6, message + " third angle out of range");
+
+            var actual = Compose(order, angles[0][i], angles[1][i], angles[2][i]);
+            double dot = Math.Abs(expected.W * actual.W + expected.X * actual.X + expected.Y * actual.Y + expected.Z * actual.Z);
+            Assert.AreEqual(0, 2 * Math.Acos(Math.Min(1, dot)), ANGLE_TOLERANCE, message + " rotation");
+        }
+
+        /// <summary>
+        /// q = q(first) * q(second) * q(third)
+        /// </summary>
+        private static Quaternion Compose(RotationOrder order, double first, double second, double third)
+        {
+            int a, b, c;
+            EulerConversion.GetAxes(order, out a, out b, out c);
+            return Rotation(a, first) * Rotation(b, second) * Rotation(c, third);
+        }
+
+        private static Quaternion Rotation(int axis, double radians)
+        {
+            var vector = new Vector3D(axis == 0 ? 1 : 0, axis == 1 ? 1 : 0, axis == 2 ? 1 : 0);
+            return new Quaternion(vector, radians * 180 / Math.PI);
+        }
+
+        private static float[][] RandomAngles(Random random, int count, double range)
+        {
+            var angles = new float[3][];
+            for (int k = 0; k < 3; k++)
+            {
+                angles[k] = new float[count];
+                for (int i = 0; i < count; i++)
+                {
+                    angles[k][i] = (float)((random.NextDouble() * 2 - 1) * range);
+                }
+            }
+            return angles;
+        }
+
+        /// <summary>
+        /// converts count angles starting at offset into arrays with one extra element,
+        /// which must stay untouched
+        /// </summary>
+        private static float[][] ToQuaternions(RotationOrder order, float[][] angles, int offset, int count)
+        {
+            var input = Slice(angles, offset, count);
+            var q = Outputs(4, count);
+            EulerConversion.ToQuaternions(order, input[0], input[1], input[2], q[0], q[1], q[2], q[3], count);
+            AssertUntouched(q, count);
+            return q;
+        }
+
+        private static float[][] ToEulerAngles(RotationOrder order, float[][] q, int offset, int count)
+        {
+            var input = Slice(q, offset, count);
+            var angles = Outputs(3, count);
+            EulerConversion.ToEulerAngles(order, input[0], input[1], input[2], input[3], angles[0], angles[1], angles[2], count);
+            AssertUntouched(angles, count);
+            return angles;
+        }
+
+        private static float[][] Slice(float[][] arrays, int offset, int count)
+        {
+            return arrays.Select(array => array.Skip(offset).Take(count).ToArray()).ToArray();
+        }
+
+        private static float[][] Outputs(int n, int count)
+        {
+            return Enumerable.Range(0, n).Select(k => Enumerable.Repeat(float.NaN, count + 1).ToArray()).ToArray();
+        }
+
+        private static void AssertUntouched(float[][] outputs, int count)
+        {
+            foreach (var output in outputs)
+            {
+                Assert.IsTrue(float.IsNaN(output[count]), $"value written after {count} values");
+            }
+        }
+    }
+}
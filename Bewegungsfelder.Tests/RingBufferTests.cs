@@ -0,0 +1,220 @@
+﻿/*
+Part of Bewegungsfelder
+
+MIT-License
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using System;
+using System.Linq;
+using System.Threading;
+using System.Threading.Tasks;
+using Bewegungsfelder.Utilities;
+using Microsoft.VisualStudio.TestTools.UnitTesting;
+
+namespace Bewegungsfelder.Tests
+{
+    /// <summary>
+    /// pushes numbered values into a RingBuffer across several wraparounds and checks every
+    /// way of reading them. the value at position p is p, so a reader can tell what it got
+    /// </summary>
+    [TestClass]
+    public class RingBufferTests
+    {
+        private const int CAPACITY = 5;
+
+        // values pushed while readers run on other threads
+        private const int CONCURRENT_PUSHES = 500000;
+
+        [TestMethod]
+        public void EmptyBufferHasNoValues()
+        {
+            var buffer = new RingBuffer<long>(CAPACITY);
+            long value;
+
+            Assert.AreEqual(0, buffer.Count);
+            Assert.AreEqual(0L, buffer.Start);
+            Assert.AreEqual(0L, buffer.End);
+            Assert.AreEqual(0L, buffer.Last);
+            Assert.IsFalse(buffer.TryRead(0, out value), "TryRead");
+            Assert.IsFalse(buffer.TryReadAt(0, out value), "TryReadAt");
+            Assert.AreEqual(0, buffer.CopyTo(new long[CAPACITY]), "CopyTo");
+            Assert.AreEqual(0, buffer.Take().Length, "Take");
+            Assert.AreEqual(0, buffer.GetSnapshot().Count(), "snapshot");
+        }
+
+        [TestMethod]
+        public void ValuesWrapAround()
+        {
+            var buffer = new RingBuffer<long>(CAPACITY);
+            for (long end = 1; end <= 5 * CAPACITY + 3; end++)
+            {
+                buffer.Push(end - 1);
+                long start = Math.Max(0, end - CAPACITY);
+                string message = $" after {end} values";
+
+                Assert.AreEqual((int)(end - start), buffer.Count, "Count" + message);
+                Assert.AreEqual(start, buffer.Start, "Start" + message);
+                Assert.AreEqual(end, buffer.End, "End" + message);
+                Assert.AreEqual(end - 1, buffer.Last, "Last" + message);
+
+                long value;
+                for (int age = 0; age <= CAPACITY; age++)
+                {
+                    bool expected = end - 1 - age >= start;
+                    Assert.AreEqual(expected, buffer.TryRead(age, out value), $"TryRead {age}" + message);
+                    Assert.AreEqual(expected ? end - 1 - age : 0, value, $"value of age {age}" + message);
+                }
+                Assert.IsFalse(buffer.TryRead(-1, out value), "TryRead -1" + message);
+
+                for (long position = start - 2; position <= end + 1; position++)
+                {
+                    bool expected = position >= start && position < end;
+                    Assert.AreEqual(expected, buffer.TryReadAt(position, out value), $"TryReadAt {position}" + message);
+                    Assert.AreEqual(expected ? position : 0, value, $"value at {position}" + message);
+                }
+
+                AssertValues(start, end, buffer.Take(), "Take" + message);
+                AssertValues(start, end, buffer.GetSnapshot().ToArray(), "snapshot" + message);
+                AssertValues(Math.Max(start, end - 2), end, buffer.Take(2), "Take 2" + message);
+                AssertValues(Math.Max(start, end - 3), end - 1,
+                    buffer.GetSnapshot(end - 3, end - 1).ToArray(), "partial snapshot" + message);
+                AssertValues(start, end, buffer.GetSnapshot(-10, end + 10).ToArray(), "clamped snapshot" + message);
+            }
+        }
+
+        [TestMethod]
+        public void CopyToWritesTheMostRecentValues()
+        {
+            var buffer = new RingBuffer<long>(CAPACITY);
+            for (long i = 0; i < 2 * CAPACITY + 2; i++)
+                buffer.Push(i);
+            long end = buffer.End;
+
+            for (int count = 0; count <= CAPACITY + 1; count++)
+            {
+                // one value before and after the copied range, which must stay untouched
+                var destination = Enumerable.Repeat(-1L, count + 2).ToArray();
+                int n = buffer.CopyTo(destination, 1, count);
+
+                Assert.AreEqual(Math.Min(count, CAPACITY), n, $"copied of {count}");
+                AssertValues(end - n, end, destination.Skip(1).Take(n).ToArray(), $"CopyTo {count}");
+                Assert.AreEqual(-1L, destination[0], $"value before the range of {count}");
+                Assert.AreEqual(-1L, destination[destination.Length - 1], $"value after the range of {count}");
+            }
+
+            try
+            {
+                buffer.CopyTo(new long[CAPACITY], 1, CAPACITY);
+                Assert.Fail("range beyond the destination accepted");
+            }
+            catch (ArgumentOutOfRangeException)
+            {
+            }
+        }
+
+        [TestMethod]
+        public void EnumerationSkipsOverwrittenValues()
+        {
+            var buffer = new RingBuffer<long>(CAPACITY);
+            for (long i = 0; i < CAPACITY; i++)
+                buffer.Push(i);
+
+            var enumerator = buffer.GetSnapshot().GetEnumerator();
+            Assert.IsTrue(enumerator.MoveNext(), "first value");
+            Assert.AreEqual(0L, enumerator.Current);
+
+            // push two values, the next one is no longer valid. the enumeration continues
+            // with the oldest value left and stops at the end of the snapshot
+            buffer.Push(CAPACITY);
+            buffer.Push(CAPACITY + 1);
+            Assert.IsTrue(enumerator.MoveNext(), "value after the overwritten one");
+            Assert.AreEqual(2L, enumerator.Current);
+            Assert.IsTrue(enumerator.MoveNext());
+            Assert.AreEqual(3L, enumerator.Current);
+            Assert.IsTrue(enumerator.MoveNext());
+            Assert.AreEqual(4L, enumerator.Current);
+            Assert.IsFalse(enumerator.MoveNext(), "value pushed after the snapshot");
+        }
+
+        [TestMethod]
+        public void ConcurrentReadersSeeConsecutiveValues()
+        {
+            var buffer = new RingBuffer<long>(CAPACITY);
+            bool done = false;
+            var readers = Enumerable.Range(0, 2).Select(r => Task.Run(() =>
+            {
+                var destination = new long[CAPACITY];
+                long reads = 0;
+                while (!Volatile.Read(ref done) || reads == 0)
+                {
+                    long start = buffer.Start;
+                    int n = buffer.CopyTo(destination);
+                    for (int i = 1; i < n; i++)
+                    {
+                        if (destination[i] != destination[i - 1] + 1)
+                            throw new InvalidOperationException($"CopyTo returned {destination[i - 1]} before {destination[i]}");
+                    }
+                    if (n > 0 && destination[0] < start)
+                        throw new InvalidOperationException($"CopyTo returned {destination[0]} before start {start}");
+
+                    long previous = -1;
+                    foreach (var value in buffer.GetSnapshot())
+                    {
+                        if (value <= previous)
+                            throw new InvalidOperationException($"snapshot returned {previous} before {value}");
+                        previous = value;
+                    }
+
+                    long last;
+                    if (buffer.TryRead(0, out last) && last < start)
+                        throw new InvalidOperationException($"TryRead returned {last} before start {start}");
+                    reads++;
+                }
+            })).ToArray();
+
+            for (long i = 0; i < CONCURRENT_PUSHES; i++)
+                buffer.Push(i);
+            Volatile.Write(ref done, true);
+
+            try
+            {
+                Task.WaitAll(readers);
+            }
+            catch (AggregateException ex)
+            {
+                Assert.Fail(ex.InnerExceptions[0].Message);
+            }
+            AssertValues(CONCURRENT_PUSHES - CAPACITY, CONCURRENT_PUSHES, buffer.Take(), "values after the writer");
+        }
+
+        /// <summary>
+        /// checks that values holds the positions [start, end)
+        /// </summary>
+        private static void AssertValues(long start, long end, long[] values, string message)
+        {
+            Assert.AreEqual((int)(end - start), values.Length, message + " count");
+            for (int i = 0; i < values.Length; i++)
+            {
+                Assert.AreEqual(start + i, values[i], $"{message} value {i}");
+            }
+        }
+    }
+}
@@ -0,0 +1,163 @@
+﻿/*
+Part of Bewegungsfelder
+
+MIT-License
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using System;
+using System.Linq;
+using Bewegungsfelder.Core;
+using Bewegungsfelder.Mathematics;
+using Microsoft.VisualStudio.TestTools.UnitTesting;
+
+namespace Bewegungsfelder.Tests
+{
+    /// <summary>
+    /// pushes values with sensor timestamps into a SensorHistory.
+    /// late values are dropped, a large jump back in time restarts the history
+    /// </summary>
+    [TestClass]
+    public class SensorHistoryTests
+    {
+        // sensor sample period in microseconds, 100Hz
+        private const uint PERIOD = 10000;
+
+        // SensorHistory.RESTART_DISTANCE
+        private const uint RESTART_DISTANCE = 1000 * 1000;
+
+        private static readonly TimeSpan RETENTION = TimeSpan.FromSeconds(2);
+
+        private static readonly DateTime START = new DateTime(2016, 6, 1, 12, 0, 0);
+
+        [TestMethod]
+        public void LateValuesAreDropped()
+        {
+            var history = new SensorHistory(RETENTION, SensorHistory.MIN_CAPACITY);
+            uint t0 = 10 * RESTART_DISTANCE;
+            for (int i = 0; i < 10; i++)
+                Assert.IsTrue(history.Push(Value(i, t0 + (uint)i * PERIOD)), $"value {i}");
+
+            // older than the last value, but too close to be a restart
+            Assert.IsFalse(history.Push(Value(10, t0 + 9 * PERIOD - 1)), "late value");
+            Assert.IsFalse(history.Push(Value(11, t0 + 9 * PERIOD - RESTART_DISTANCE)), "late value at the restart distance");
+            Assert.AreEqual(10, history.Count);
+            Assert.AreEqual(t0 + 9 * PERIOD, history.Last.SensorTimestamp);
+
+            // the same timestamp is kept
+            Assert.IsTrue(history.Push(Value(12, t0 + 9 * PERIOD)), "value with the same timestamp");
+            AssertTimestamps(history.All().ToArray(), Enumerable.Range(0, 10).Select(i => t0 + (uint)i * PERIOD)
+                .Concat(new[] { t0 + 9 * PERIOD }).ToArray());
+        }
+
+        [TestMethod]
+        public void JumpBackRestartsTheHistory()
+        {
+            var history = new SensorHistory(RETENTION, SensorHistory.MIN_CAPACITY);
+            uint t0 = 10 * RESTART_DISTANCE;
+            for (int i = 0; i < 10; i++)
+                history.Push(Value(i, t0 + (uint)i * PERIOD));
+            var before = history.All();
+
+            Assert.IsTrue(history.Push(Value(10, 5)), "value after the restart");
+            Assert.IsTrue(history.Push(Value(11, 5 + PERIOD)), "second value after the restart");
+            Assert.AreEqual(2, history.Count);
+            AssertTimestamps(history.All().ToArray(), new uint[] { 5, 5 + PERIOD });
+            AssertTimestamps(history.Range(0, t0).ToArray(), new uint[] { 5, 5 + PERIOD });
+
+            // readers keep the values of before the restart
+            Assert.AreEqual(10, before.Count());
+            Assert.AreEqual(t0, before.First().SensorTimestamp);
+        }
+
+        [TestMethod]
+        public void TimestampOverflowKeepsTheOrder()
+        {
+            var history = new SensorHistory(RETENTION, SensorHistory.MIN_CAPACITY);
+            uint t0 = uint.MaxValue - 4 * PERIOD;
+            var timestamps = Enumerable.Range(0, 10).Select(i => unchecked(t0 + (uint)i * PERIOD)).ToArray();
+            for (int i = 0; i < timestamps.Length; i++)
+                Assert.IsTrue(history.Push(Value(i, timestamps[i])), $"value {i}");
+
+            Assert.IsFalse(history.Push(Value(10, t0)), "late value before the overflow");
+            AssertTimestamps(history.All().ToArray(), timestamps);
+            AssertTimestamps(history.Range(timestamps[2], timestamps[7]).ToArray(), timestamps.Skip(2).Take(5).ToArray());
+        }
+
+        [TestMethod]
+        public void RangeAndSinceFindTheBounds()
+        {
+            var history = new SensorHistory(RETENTION, SensorHistory.MIN_CAPACITY);
+            for (int i = 0; i < 20; i++)
+                history.Push(Value(i, (uint)i * PERIOD));
+
+            // bounds between and on the timestamps
+            AssertTimestamps(history.Range(PERIOD / 2, 3 * PERIOD).ToArray(), new[] { PERIOD, 2 * PERIOD });
+            AssertTimestamps(history.Range(3 * PERIOD, 3 * PERIOD + 1).ToArray(), new[] { 3 * PERIOD });
+            Assert.AreEqual(0, history.Range(3 * PERIOD + 1, 4 * PERIOD).Count());
+            Assert.AreEqual(0, history.Range(30 * PERIOD, 40 * PERIOD).Count());
+
+            // all values fit into the initial capacity
+            Assert.AreEqual(20, history.Range(0, 20 * PERIOD).Count());
+
+            AssertTimestamps(history.Since(Arrival(17)).ToArray(), new[] { 18 * PERIOD, 19 * PERIOD });
+            Assert.AreEqual(20, history.Since(START.AddDays(-1)).Count());
+            Assert.AreEqual(0, history.Since(Arrival(19)).Count());
+        }
+
+        [TestMethod]
+        public void CapacityFollowsTheSampleRate()
+        {
+            var history = new SensorHistory(RETENTION, SensorHistory.MIN_CAPACITY);
+            int count = 1000;
+            for (int i = 0; i < count; i++)
+                history.Push(Value(i, (uint)i * PERIOD));
+
+            // 100Hz for 2 seconds with a margin of 25%
+            Assert.IsTrue(history.Capacity >= 250 && history.Capacity <= 260, $"capacity {history.Capacity}");
+
+            // the most recent values survive the resizing in order
+            var values = history.All().ToArray();
+            Assert.AreEqual(Math.Min(history.Capacity, count), values.Length, "count");
+            AssertTimestamps(values, Enumerable.Range(count - values.Length, values.Length)
+                .Select(i => (uint)i * PERIOD).ToArray());
+        }
+
+        private static void AssertTimestamps(SensorValue[] values, uint[] expected)
+        {
+            Assert.AreEqual(expected.Length, values.Length, "value count");
+            for (int i = 0; i < values.Length; i++)
+            {
+                Assert.AreEqual(expected[i], values[i].SensorTimestamp, $"timestamp {i}");
+            }
+        }
+
+        private static DateTime Arrival(int index)
+        {
+            return START.AddTicks(index * PERIOD * 10);
+        }
+
+        private static SensorValue Value(int index, uint timestamp)
+        {
+            return new SensorValue(new Quaternion(0, 0, 0, 1), new Vector3D(0, 0, 1), new Vector3D(), Arrival(index),
+                timestamp, index);
+        }
+    }
+}
@@ -0,0 +1,155 @@
+﻿/*
+Part of Bewegungsfelder
+
+MIT-License
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using System;
+using System.Collections.Generic;
+using System.Globalization;
+using System.IO;
+using System.Linq;
+using Bewegungsfelder.Core;
+using Bewegungsfelder.Mathematics;
+using Microsoft.VisualStudio.TestTools.UnitTesting;
+
+namespace Bewegungsfelder.Tests
+{
+    /// <summary>
+    /// decodes the golden datagrams of the firmware's host tests
+    /// (esp8266_mpu6050/host/test/sensor_packet.golden). the firmware encodes the same samples.
+    /// </summary>
+    [TestClass]
+    [DeploymentItem(@"Fixtures\sensor_packet.golden", "Fixtures")]
+    public class SensorPacketTests
+    {
+        private const double QUAT_TOLERANCE = 1e-3;
+        private const double VALUE_TOLERANCE = 1e-9;
+
+        private static readonly DateTime ARRIVAL = new DateTime(2016, 6, 1, 12, 0, 0);
+
+        [TestMethod]
+        public void DecodeSingleSample()
+        {
+            var values = Decode("single", 8);
+
+            Assert.AreEqual(1, values.Count);
+            AssertSample(values[0], 1000000, 42,
+                new Quaternion(0, 0, 0, 1), new Vector3D(0, 0, 1), new Vector3D(10, -10, 0));
+        }
+
+        [TestMethod]
+        public void DecodeBatchWithWrappingSequenceAndTimestamp()
+        {
+            var values = Decode("batch", 3);
+            double h = Math.Sqrt(0.5);
+
+            Assert.AreEqual(3, values.Count);
+            AssertSample(values[0], 0xfffff000, 0xfffe,
+                new Quaternion(-h, 0, 0, h),
+                new Vector3D(-1, 0.5, 1 / SensorPacket.ACCEL_SCALE),
+                new Vector3D(-32768 / SensorPacket.GYRO_SCALE, 32767 / SensorPacket.GYRO_SCALE, -1 / SensorPacket.GYRO_SCALE));
+            AssertSample(values[1], unchecked(0xfffff000u + 40000u), 0xffff,
+                new Quaternion(0, h, -h, 0),
+                new Vector3D(1, 2, 3) / SensorPacket.ACCEL_SCALE,
+                new Vector3D(4, 5, 6) / SensorPacket.GYRO_SCALE);
+            AssertSample(values[2], unchecked(0xfffff000u + 80000u), 0,
+                new Quaternion(0, 0, 0, -1),
+                new Vector3D(0, -1 / SensorPacket.ACCEL_SCALE, 0),
+                new Vector3D(0, 0, -100));
+        }
+
+        [TestMethod]
+        public void MillisecondTimestampsAreConverted()
+        {
+            // older firmware sent milliseconds and didn't set the flag
+            byte[] datagram = ReadGolden("single");
+            datagram[0] &= unchecked((byte)~SensorPacket.FLAG_TIMESTAMP_US);
+            BitConverter.GetBytes(1000u).CopyTo(datagram, 4);
+
+            var values = new List<SensorValue>();
+            int sensorId;
+            Assert.IsTrue(SensorPacket.Decode(datagram, datagram.Length, ARRIVAL, out sensorId, values));
+            Assert.AreEqual(1000000u, values[0].SensorTimestamp);
+        }
+
+        [TestMethod]
+        public void TruncatedDatagramIsRejected()
+        {
+            byte[] datagram = ReadGolden("batch");
+            int sensorId;
+
+            Assert.IsFalse(SensorPacket.Decode(datagram, datagram.Length - 1, ARRIVAL, out sensorId, new List<SensorValue>()));
+        }
+
+        private static List<SensorValue> Decode(string name, int expectedSensorId)
+        {
+            byte[] datagram = ReadGolden(name);
+            var values = new List<SensorValue>();
+            int sensorId;
+
+            Assert.IsTrue(SensorPacket.Decode(datagram, datagram.Length, ARRIVAL, out sensorId, values));
+            Assert.AreEqual(expectedSensorId, sensorId);
+            return values;
+        }
+
+        private static void AssertSample(SensorValue value, uint timestamp, int sequence,
+            Quaternion orientation, Vector3D acceleration, Vector3D gyro)
+        {
+            Assert.AreEqual(timestamp, value.SensorTimestamp);
+            Assert.AreEqual(sequence, value.Sequence);
+            Assert.AreEqual(ARRIVAL, value.ArrivalTime);
+
+            Assert.AreEqual(orientation.W, value.Orientation.W, QUAT_TOLERANCE);
+            Assert.AreEqual(orientation.X, value.Orientation.X, QUAT_TOLERANCE);
+            Assert.AreEqual(orientation.Y, value.Orientation.Y, QUAT_TOLERANCE);
+            Assert.AreEqual(orientation.Z, value.Orientation.Z, QUAT_TOLERANCE);
+
+            Assert.AreEqual(acceleration.X, value.Acceleration.X, VALUE_TOLERANCE);
+            Assert.AreEqual(acceleration.Y, value.Acceleration.Y, VALUE_TOLERANCE);
+            Assert.AreEqual(acceleration.Z, value.Acceleration.Z, VALUE_TOLERANCE);
+
+            Assert.AreEqual(gyro.X, value.Gyro.X, VALUE_TOLERANCE);
+            Assert.AreEqual(gyro.Y, value.Gyro.Y, VALUE_TOLERANCE);
+            Assert.AreEqual(gyro.Z, value.Gyro.Z, VALUE_TOLERANCE);
+        }
+
+        /// <summary>
+        /// reads a datagram of the golden file: one datagram per line, its name followed by the bytes in hex
+        /// </summary>
+        private static byte[] ReadGolden(string name)
+        {
+            string dir = Path.GetDirectoryName(typeof(SensorPacketTests).Assembly.Location);
+            string path = Path.Combine(dir, "Fixtures", "sensor_packet.golden");
+
+            foreach (var line in File.ReadLines(path))
+            {
+                var tokens = line.Split(new[] { ' ', '\t' }, StringSplitOptions.RemoveEmptyEntries);
+                if (tokens.Length == 0 || tokens[0].StartsWith("#") || tokens[0] != name)
+                    continue;
+
+                return tokens.Skip(1).Select(t => byte.Parse(t, NumberStyles.HexNumber)).ToArray();
+            }
+
+            throw new InvalidDataException($"{path} has no datagram {name}");
+        }
+    }
+}
@@ -0,0 +1,199 @@
+﻿/*
+Part of Bewegungsfelder
+
+MIT-License
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using System;
+using System.Linq;
+using Bewegungsfelder.Core;
+using Bewegungsfelder.Mathematics;
+using Microsoft.VisualStudio.TestTools.UnitTesting;
+
+namespace Bewegungsfelder.Tests
+{
+    /// <summary>
+    /// compares the window aggregates of SensorSampleStore to a double precision reference.
+    /// windows of every length up to beyond a block of vectors are checked, at every offset
+    /// into the arrays, so the simd blocks, the unrolled loop, the tail and the wraparound are covered
+    /// </summary>
+    [TestClass]
+    public class SensorSampleStoreTests
+    {
+        // SensorSampleStore.Accumulator.VECTOR_BLOCK
+        private const int VECTOR_BLOCK = 64;
+
+        // relative to the sum of absolute values, or to the variance
+        private const double SUM_TOLERANCE = 1e-6;
+        private const double VARIANCE_TOLERANCE = 1e-4;
+
+        private static readonly int WIDTH = System.Numerics.Vector<float>.Count;
+
+        private static readonly DateTime START = new DateTime(2016, 6, 1, 12, 0, 0);
+
+        [TestMethod]
+        public void AggregatesMatchTheReference()
+        {
+            var random = new Random(1);
+            int capacity = 2 * VECTOR_BLOCK * WIDTH + 3 * WIDTH + 1;
+            var store = new SensorSampleStore(capacity);
+            var values = new float[3 * capacity];
+            for (int i = 0; i < values.Length; i++)
+            {
+                values[i] = (float)(random.NextDouble() * 20 - 10);
+                store.Push(Value(i, values[i]));
+            }
+
+            long end = store.End;
+            foreach (int count in WindowLengths(capacity))
+            {
+                // windows ending at several offsets, some wrap around the end of the arrays
+                for (int back = 0; back < capacity - count; back += 1 + (capacity - count) / 7)
+                {
+                    long start = end - back - count;
+                    AssertStatistics(values, start, count, store.Aggregate(SensorChannel.AccelerationX, start, start + count),
+                        $"{count} values at {start}");
+                }
+            }
+        }
+
+        [TestMethod]
+        public void VarianceOfLargeValuesIsStable()
+        {
+            // a constant gravity with little noise, the sum of squares alone would cancel out
+            var random = new Random(2);
+            int count = 3 * VECTOR_BLOCK * WIDTH + 5;
+            var store = new SensorSampleStore(count);
+            var values = new float[count];
+            for (int i = 0; i < count; i++)
+            {
+                values[i] = (float)(1000 + random.NextDouble() * 0.01);
+                store.Push(Value(i, values[i]));
+            }
+
+            var statistics = store.Aggregate(SensorChannel.AccelerationX, 0, count);
+            AssertStatistics(values, 0, count, statistics, "gravity");
+            Assert.IsTrue(statistics.Variance > 0, "variance of the noise");
+        }
+
+        [TestMethod]
+        public void WindowsAreClampedToTheStoredSamples()
+        {
+            int capacity = 100;
+            var store = new SensorSampleStore(capacity);
+            var values = Enumerable.Range(0, 250).Select(i => (float)i).ToArray();
+            for (int i = 0; i < values.Length; i++)
+                store.Push(Value(i, values[i]));
+
+            Assert.AreEqual(150L, store.Start);
+            Assert.AreEqual(250L, store.End);
+            AssertStatistics(values, 150, 100, store.Aggregate(SensorChannel.AccelerationX, 0, 1000), "whole history");
+            AssertStatistics(values, 150, 10, store.Aggregate(SensorChannel.AccelerationX, 100, 160), "overwritten start");
+            Assert.AreEqual(0, store.Aggregate(SensorChannel.AccelerationX, 0, 150).Count, "overwritten window");
+            Assert.AreEqual(0, store.Aggregate(SensorChannel.AccelerationX, 250, 300).Count, "future window");
+            Assert.AreEqual(0, store.Aggregate(SensorChannel.AccelerationX, 200, 200).Count, "empty window");
+        }
+
+        [TestMethod]
+        public void ChannelsAreStoredSeparately()
+        {
+            var store = new SensorSampleStore(10);
+            for (int i = 0; i < 15; i++)
+            {
+                store.Push(new SensorValue(new Quaternion(7 + i, 8 + i, 9 + i, 6 + i), new Vector3D(i, 1 + i, 2 + i),
+                    new Vector3D(3 + i, 4 + i, 5 + i), START.AddMilliseconds(i), (uint)i));
+            }
+
+            // the channels hold channel + i, the last 10 values are kept
+            foreach (SensorChannel channel in Enum.GetValues(typeof(SensorChannel)))
+            {
+                var statistics = store.Aggregate(channel, 0, 15);
+                Assert.AreEqual(10, statistics.Count, $"{channel} count");
+                Assert.AreEqual((int)channel + 5, statistics.Min, 0.0, $"{channel} min");
+                Assert.AreEqual((int)channel + 14, statistics.Max, 0.0, $"{channel} max");
+
+                var copy = new float[10];
+                Assert.AreEqual(10, store.CopyTo(channel, 0, 15, copy), $"{channel} copied");
+                for (int i = 0; i < copy.Length; i++)
+                    Assert.AreEqual((int)channel + 5 + i, copy[i], 0f, $"{channel} value {i}");
+            }
+
+            var timestamps = new uint[4];
+            Assert.AreEqual(4, store.CopyTimestampsTo(0, 15, timestamps), "timestamps copied");
+            Assert.AreEqual("11 12 13 14", string.Join(" ", timestamps));
+            Assert.AreEqual(13L, store.FindSince(START.AddMilliseconds(12)));
+            Assert.AreEqual(5L, store.FindSince(START));
+        }
+
+        [TestMethod]
+        public void ResizeKeepsTheRecentSamples()
+        {
+            var store = new SensorSampleStore(50);
+            var values = Enumerable.Range(0, 120).Select(i => (float)(i % 17) - 3.5f).ToArray();
+            for (int i = 0; i < 80; i++)
+                store.Push(Value(i, values[i]));
+
+            store.Resize(30);
+            Assert.AreEqual(30, store.Capacity);
+            AssertStatistics(values, 50, 30, store.Aggregate(SensorChannel.AccelerationX, 0, 80), "after shrinking");
+
+            store.Resize(70);
+            for (int i = 80; i < 120; i++)
+                store.Push(Value(i, values[i]));
+            AssertStatistics(values, 50, 70, store.Aggregate(SensorChannel.AccelerationX, 0, 120), "after growing");
+        }
+
+        /// <summary>
+        /// lengths around multiples of the vector width and the vector block, up to the capacity
+        /// </summary>
+        private static int[] WindowLengths(int capacity)
+        {
+            var lengths = Enumerable.Range(1, 4 * WIDTH + 5)
+                .Concat(Enumerable.Range(VECTOR_BLOCK * WIDTH - 5, 10))
+                .Concat(Enumerable.Range(2 * VECTOR_BLOCK * WIDTH - 5, 10))
+                .Concat(new[] { capacity - 1 });
+            return lengths.Where(n => n < capacity).Distinct().ToArray();
+        }
+
+        private static void AssertStatistics(float[] values, long start, int count, WindowStatistics actual, string message)
+        {
+            var window = values.Skip((int)start).Take(count).Select(v => (double)v).ToArray();
+            double sum = window.Sum();
+            double absSum = window.Sum(v => Math.Abs(v));
+            double mean = sum / count;
+            double variance = window.Sum(v => (v - mean) * (v - mean)) / count;
+
+            Assert.AreEqual(count, actual.Count, message + " count");
+            Assert.AreEqual(sum, actual.Sum, SUM_TOLERANCE * absSum, message + " sum");
+            Assert.AreEqual(absSum, actual.AbsSum, SUM_TOLERANCE * absSum, message + " absolute sum");
+            Assert.AreEqual(window.Min(), actual.Min, 0.0, message + " min");
+            Assert.AreEqual(window.Max(), actual.Max, 0.0, message + " max");
+            Assert.AreEqual(mean, actual.Mean, SUM_TOLERANCE * absSum / count, message + " mean");
+            Assert.AreEqual(variance, actual.Variance, VARIANCE_TOLERANCE * variance + 1e-12, message + " variance");
+        }
+
+        private static SensorValue Value(int index, float accelerationX)
+        {
+            return new SensorValue(new Quaternion(0, 0, 0, 1), new Vector3D(accelerationX, 0, 9.81), new Vector3D(),
+                START.AddMilliseconds(index), (uint)index);
+        }
+    }
+}
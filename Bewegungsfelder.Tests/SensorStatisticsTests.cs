@@ -0,0 +1,108 @@
+﻿/*
+Part of Bewegungsfelder
+
+MIT-License
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using System;
+using Bewegungsfelder.Core;
+using Bewegungsfelder.Mathematics;
+using Microsoft.VisualStudio.TestTools.UnitTesting;
+
+namespace Bewegungsfelder.Tests
+{
+    /// <summary>
+    /// feeds SensorStatistics with the values of simulated datagrams
+    /// </summary>
+    [TestClass]
+    public class SensorStatisticsTests
+    {
+        // sensor sample period in microseconds
+        private const uint PERIOD = 10000;
+
+        private const double JITTER_TOLERANCE = 1e-6;
+
+        private static readonly DateTime START = new DateTime(2016, 6, 1, 12, 0, 0);
+
+        [TestMethod]
+        public void BatchedDatagramsWithoutDelayHaveNoJitter()
+        {
+            const int batch = 8;
+            var statistics = new SensorStatistics();
+            int sequence = 0;
+            for (int datagram = 0; datagram < 100; datagram++)
+            {
+                // every sample of the batch arrives with the datagram, right after the last one was sampled
+                var arrival = START.AddTicks((datagram + 1) * batch * PERIOD * 10);
+                for (int i = 0; i < batch; i++, sequence++)
+                {
+                    statistics.Update(Value(arrival, (uint)sequence * PERIOD, sequence));
+                }
+            }
+
+            Assert.AreEqual(800L, statistics.Received);
+            Assert.AreEqual(0L, statistics.Lost);
+            Assert.AreEqual(0, statistics.Jitter, JITTER_TOLERANCE);
+        }
+
+        [TestMethod]
+        public void DelayedDatagramsRaiseTheJitter()
+        {
+            const int batch = 4;
+            var statistics = new SensorStatistics();
+            int sequence = 0;
+            for (int datagram = 0; datagram < 200; datagram++)
+            {
+                // every other datagram is 2ms late
+                var arrival = START.AddTicks((datagram + 1) * batch * PERIOD * 10)
+                    .AddMilliseconds(datagram % 2 == 0 ? 0 : 2);
+                for (int i = 0; i < batch; i++, sequence++)
+                {
+                    statistics.Update(Value(arrival, (uint)sequence * PERIOD, sequence));
+                }
+            }
+
+            // every datagram changes the transit time by 2ms
+            Assert.AreEqual(2, statistics.Jitter, 0.01);
+        }
+
+        [TestMethod]
+        public void LateAndDuplicateValuesAreCounted()
+        {
+            var statistics = new SensorStatistics();
+            foreach (int sequence in new[] { 0, 1, 3, 4, 2, 4, 6 })
+            {
+                statistics.Update(Value(START.AddMilliseconds(sequence * 10), (uint)sequence * PERIOD, sequence));
+            }
+
+            Assert.AreEqual(7L, statistics.Received);
+            Assert.AreEqual(1L, statistics.Lost);
+            Assert.AreEqual(1L, statistics.Reordered);
+            Assert.AreEqual(1L, statistics.Duplicates);
+        }
+
+        private static SensorValue Value(DateTime arrival, uint timestamp, int sequence)
+        {
+            return new SensorValue(new Quaternion(0, 0, 0, 1), new Vector3D(0, 0, 1), new Vector3D(), arrival,
+                timestamp, sequence);
+        }
+    }
+}
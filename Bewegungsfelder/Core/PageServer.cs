@@ -1,7 +1,7 @@
 ﻿/*
-Part of Bewegungsfelder 
+Part of Bewegungsfelder
 
-MIT-License 
+MIT-License
 (C) 2016 Ivo Herzig
 
 Permission is hereby granted, free of charge, to any person obtaining a copy
@@ -27,16 +27,34 @@ using System.Collections.Generic;
 using System.Linq;
 using System.Text;
 using System.Threading.Tasks;
-using System.Windows.Media.Media3D;
+using System.Web.Http;
+using System.Web.Http.Routing;
+using System.Web.Http.SelfHost;
 
 namespace Bewegungsfelder.Core
 {
-    public class MotionData
+    /// <summary>
+    /// serves the sensor web page (html folder) that streams phone orientation data to the Server's websocket.
+    /// hosted by the app, so the core library doesn't depend on the asp.net self host
+    /// </summary>
+    public class PageServer
     {
-        public double FPS { get; set; } = 120;
+        public const int HTTP_PORT = 8080;
 
-        public Dictionary<Bone, List<Quaternion>> Data { get; } = new Dictionary<Bone, List<Quaternion>>();
+        private HttpSelfHostServer httpServer;
 
-        public int FrameCount { get { return Data.First().Value.Count; } }
+        public void Start()
+        {
+            if (httpServer != null)
+                throw new InvalidOperationException("Page server is already running");
+
+            var httpConfig = new HttpSelfHostConfiguration($"http://0.0.0.0:{HTTP_PORT}");
+            httpConfig.MessageHandlers.Add(new StaticServeHandler());
+
+            var route = new HttpRoute("");
+            httpConfig.Routes.Add("DefaultAPI", route);
+            httpServer = new HttpSelfHostServer(httpConfig);
+            httpServer.OpenAsync().Wait();
+        }
     }
 }
@@ -105,6 +105,18 @@ namespace Bewegungsfelder
             }
         }
 
+        private void OnLoadCaptureClick(object sender, RoutedEventArgs e)
+        {
+            OpenFileDialog fileDialog = new OpenFileDialog();
+            fileDialog.Multiselect = false;
+            fileDialog.Filter = $"Capture files|*{Core.CaptureFormat.FILE_EXTENSION}";
+
+            if (fileDialog.ShowDialog(this) == true)
+            {
+                ViewModel.LoadCaptureFileCommand.Execute(fileDialog.FileName);
+            }
+        }
+
         private void OnAboutClick(object sender, RoutedEventArgs e)
         {
             new About().ShowDialog();
@@ -0,0 +1,92 @@
+﻿/*
+Part of Bewegungsfelder
+
+MIT-License
+(C) 2016 Ivo Herzig
+
+Permission is hereby granted, free of charge, to any person obtaining a copy
+of this software and associated documentation files (the "Software"), to deal
+in the Software without restriction, including without limitation the rights
+to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+copies of the Software, and to permit persons to whom the Software is
+furnished to do so, subject to the following conditions:
+
+The above copyright notice and this permission notice shall be included in all
+copies or substantial portions of the Software.
+
+THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+SOFTWARE.
+*/
+using System;
+using System.Collections.Generic;
+using System.Linq;
+using System.Text;
+using System.Threading.Tasks;
+using Bewegungsfelder.Mathematics;
+using Media3D = System.Windows.Media.Media3D;
+
+namespace Bewegungsfelder.Utilities
+{
+    /// <summary>
+    /// converts between the math types of the core library and their wpf counterparts used for rendering and bindings.
+    /// both use the same conventions, so the conversions are plain copies
+    /// </summary>
+    public static class Media3DConversion
+    {
+        public static Media3D.Vector3D ToMedia3D(this Vector3D v)
+        {
+            return new Media3D.Vector3D(v.X, v.Y, v.Z);
+        }
+
+        public static Vector3D ToCore(this Media3D.Vector3D v)
+        {
+            return new Vector3D(v.X, v.Y, v.Z);
+        }
+
+        public static Media3D.Quaternion ToMedia3D(this Quaternion q)
+        {
+            // keep the identity distinguished so wpf's identity shortcuts still apply
+            if (q.IsIdentity)
+                return Media3D.Quaternion.Identity;
+
+            return new Media3D.Quaternion(q.X, q.Y, q.Z, q.W);
+        }
+
+        public static Quaternion ToCore(this Media3D.Quaternion q)
+        {
+            if (q.IsIdentity)
+                return Quaternion.Identity;
+
+            return new Quaternion(q.X, q.Y, q.Z, q.W);
+        }
+
+        public static Media3D.Matrix3D ToMedia3D(this Matrix3D m)
+        {
+            if (m.IsIdentity)
+                return Media3D.Matrix3D.Identity;
+
+            return new Media3D.Matrix3D(
+                m.M11, m.M12, m.M13, m.M14,
+                m.M21, m.M22, m.M23, m.M24,
+                m.M31, m.M32, m.M33, m.M34,
+                m.OffsetX, m.OffsetY, m.OffsetZ, m.M44);
+        }
+
+        public static Matrix3D ToCore(this Media3D.Matrix3D m)
+        {
+            if (m.IsIdentity)
+                return Matrix3D.Identity;
+
+            return new Matrix3D(
+                m.M11, m.M12, m.M13, m.M14,
+                m.M21, m.M22, m.M23, m.M24,
+                m.M31, m.M32, m.M33, m.M34,
+                m.OffsetX, m.OffsetY, m.OffsetZ, m.M44);
+        }
+    }
+}
@@ -29,6 +29,7 @@ using System;
 using System.Collections.Generic;
 using System.Collections.ObjectModel;
 using System.ComponentModel;
+using System.IO;
 using System.Linq;
 using System.Text;
 using System.Threading.Tasks;
@@ -42,6 +43,13 @@ namespace Bewegungsfelder.VM
 {
     public class AppVM : INotifyPropertyChanged
     {
+        // recordings are streamed to capture files in this directory
+        private static readonly string CAPTURE_DIRECTORY = Path.Combine(
+            Environment.GetFolderPath(Environment.SpecialFolder.MyDocuments), "Bewegungsfelder");
+
+        // recorded frames are compressed within half a degree, the raw sensor values are kept as is
+        private static readonly double CAPTURE_MAX_ERROR = 0.5 * Math.PI / 180;
+
         public enum AppState
         {
             Default,
@@ -58,6 +66,7 @@ namespace Bewegungsfelder.VM
 
         private ObservableCollection<SensorVM> sensors;
         private Server server;
+        private PageServer pageServer;
 
         private KinematicVM kinematic;
 
@@ -66,6 +75,9 @@ namespace Bewegungsfelder.VM
         private Dictionary<Sensor, SensorVM> sensorVMs;
         private Dictionary<SensorBoneLink, SensorBoneLinkVM> sensorBoneLinkVMs;
 
+        // sensor orientations of the current frame, reused while the skeleton doesn't change
+        private Pose livePose;
+
         /// <summary>
         /// the current state of the application
         /// </summary>
@@ -140,7 +152,17 @@ namespace Bewegungsfelder.VM
             {
                 if (animator != value)
                 {
+                    if (animator != null)
+                    {
+                        animator.PropertyChanged -= OnAnimatorPropertyChanged;
+                        animator.Reader?.Dispose();
+                    }
+
                     animator = value;
+                    animator.CaptureDirectory = CAPTURE_DIRECTORY;
+                    animator.CaptureMaxError = CAPTURE_MAX_ERROR;
+                    animator.PropertyChanged += OnAnimatorPropertyChanged;
+                    SetSensorCapture(animator.Capture);
 
                     PropertyChanged?.Invoke(this, new PropertyChangedEventArgs(nameof(Animator)));
                 }
@@ -166,6 +188,8 @@ namespace Bewegungsfelder.VM
 
         public ICommand SaveBVHFileCommand { get; }
 
+        public ICommand LoadCaptureFileCommand { get; }
+
         public ICommand AssignSensorToBoneCommand { get; }
 
         public ICommand StartCaptureCommand { get; }
@@ -184,6 +208,7 @@ namespace Bewegungsfelder.VM
         {
             server = new Server();
             server.SensorAdded += OnSensorAdded;
+            pageServer = new PageServer();
 
             // setup sensor-bone links
             SensorBoneMap = new SensorBoneMap();
@@ -218,6 +243,7 @@ namespace Bewegungsfelder.VM
             // setup commands
             LoadBVHFileCommand = new RelayCommand<string>(LoadBVHFile);
             SaveBVHFileCommand = new RelayCommand<string>(SaveBVHFile);
+            LoadCaptureFileCommand = new RelayCommand<string>(LoadCaptureFile);
             AssignSensorToBoneCommand = new RelayCommand<Tuple<BoneVM, SensorVM>>(AssignSensorToBone);
             StartCaptureCommand = new RelayCommand(StartCapture, CanStartCapture);
             StopCaptureCommand = new RelayCommand(StopCapture, CanStopCapture);
@@ -251,13 +277,35 @@ namespace Bewegungsfelder.VM
             Animator = new KinematicAnimatorVM(Kinematic, newMotionData);
         }
 
+        /// <summary>
+        /// opens a capture file for playback. the kinematic is created from the first recorded skeleton
+        /// </summary>
+        private void LoadCaptureFile(string file)
+        {
+            if (StopCaptureCommand.CanExecute(null))
+            {
+                StopCaptureCommand.Execute(null);
+            }
+
+            var reader = new CaptureReader(file);
+            if (reader.Skeletons.Count == 0)
+            {
+                reader.Dispose();
+                throw new InvalidDataException("The capture file contains no recorded frames");
+            }
+
+            var bones = reader.Skeletons[0].CreateBones();
+            Kinematic = new KinematicVM(new Core.KinematicStructure(bones[0]));
+            Animator = new KinematicAnimatorVM(Kinematic, reader);
+        }
+
         /// <summary>
         /// write the kinematic structure and any recorded motion data to a BVH file
         /// </summary>
         private void SaveBVHFile(string file)
         {
             BVHMotionData motionData;
-            var root = BVHConverter.ToBVHData(Kinematic.Root.Model, Animator.MotionData, out motionData);
+            var root = BVHConverter.ToBVHData(Kinematic.Root.Model, Animator.ReadMotionData(), out motionData);
             BVHReaderWriter.WriteBvh(file, root, motionData);
         }
 
@@ -315,11 +363,12 @@ namespace Bewegungsfelder.VM
         }
 
         /// <summary>
-        /// start sensor data colelctor server
+        /// start sensor data colelctor server and the web page for phone sensors
         /// </summary>
         public void StartServer()
         {
             server.Start();
+            pageServer.Start();
         }
 
         /// <summary>
@@ -332,18 +381,22 @@ namespace Bewegungsfelder.VM
                 item.Refresh();
             }
 
-            foreach (var item in sensorBoneLinkVMs.Values)
-            {
-                item.Refresh();
-            }
-
             if (State == AppState.Running)
             {
-                var orientations = SensorBoneMap.GetCalibratedSensorOrientations();
-                Kinematic.Model.ApplyWorldRotations(orientations);
+                if (livePose?.Skeleton != Kinematic.Model.Compiled)
+                    livePose = Kinematic.Model.CreatePose();
+
+                SensorBoneMap.GetCalibratedSensorOrientations(livePose);
+                Kinematic.Model.ApplyWorldRotations(livePose);
             }
 
+            // updates the compiled skeleton, the links are placed at the updated bone positions
             Kinematic.Refresh();
+
+            foreach (var item in sensorBoneLinkVMs.Values)
+            {
+                item.Refresh(Kinematic.Model.Compiled);
+            }
         }
 
         /// <summary>
@@ -354,6 +407,25 @@ namespace Bewegungsfelder.VM
         {
             sensors.Add(new SensorVM(model));
             sensorVMs.Add(model, sensors.Last());
+
+            model.Capture = Animator.Capture;
+        }
+
+        private void OnAnimatorPropertyChanged(object sender, PropertyChangedEventArgs e)
+        {
+            if (e.PropertyName == nameof(KinematicAnimatorVM.Capture))
+                SetSensorCapture(Animator.Capture);
+        }
+
+        /// <summary>
+        /// streams the raw values of all sensors to the capture file of the current recording
+        /// </summary>
+        private void SetSensorCapture(CaptureWriter capture)
+        {
+            foreach (var sensor in server.Sensors.Values)
+            {
+                sensor.Capture = capture;
+            }
         }
 
         private void StartSensorCalibration(SensorBoneLinkVM link)
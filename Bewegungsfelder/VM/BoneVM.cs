@@ -54,6 +54,9 @@ namespace Bewegungsfelder.VM
 
         private CSysVisual3D coordinateSystemVisual;
 
+        // reused for every refresh
+        private MatrixTransform3D visualTransform = new MatrixTransform3D();
+
         // visuals to connect to child bones
         private Dictionary<BoneVM, LinesVisual3D> childLinkVisualMap = new Dictionary<BoneVM, LinesVisual3D>();
 
@@ -109,10 +112,10 @@ namespace Bewegungsfelder.VM
         /// </summary>
         public Vector3D Offset
         {
-            get { return Model.Offset; }
+            get { return Model.Offset.ToMedia3D(); }
             set
             {
-                Model.Offset = value;
+                Model.Offset = value.ToCore();
                 Parent?.UpdateLinkVisual(this);
             }
         }
@@ -120,7 +123,7 @@ namespace Bewegungsfelder.VM
         /// <summary>
         /// the local orientation of this bone
         /// </summary>
-        public Quaternion LocalRotation { get { return Model.JointRotation; } set { Model.JointRotation = value; } }
+        public Quaternion LocalRotation { get { return Model.JointRotation.ToMedia3D(); } set { Model.JointRotation = value.ToCore(); } }
 
         /// <summary>
         /// this bones associated sensor.
@@ -165,6 +168,7 @@ namespace Bewegungsfelder.VM
             DisplaySettings.Get.PropertyChanged += OnDisplaySettingsPropertyChanged;
 
             Visual = new ModelVisual3D();
+            Visual.Transform = visualTransform;
             coordinateSystemVisual = new CSysVisual3D();
             coordinateSystemVisual.Length = DisplaySettings.Get.CSysSize;
 
@@ -241,13 +245,12 @@ namespace Bewegungsfelder.VM
             }
         }
 
-        public void Refresh()
+        /// <summary>
+        /// updates the visual. the visuals are nested like the bones, so only the local transform is needed
+        /// </summary>
+        public void Refresh(Matrix3D localTransform)
         {
-            Visual.Transform = new MatrixTransform3D(Model.LocalTransform);
-            foreach (var item in Children)
-            {
-                item.Refresh();
-            }
+            visualTransform.Matrix = localTransform;
         }
 
         /// <summary>
@@ -28,11 +28,13 @@ using Bewegungsfelder.Core;
 using System;
 using System.Collections.Generic;
 using System.ComponentModel;
+using System.Diagnostics;
+using System.IO;
 using System.Linq;
 using System.Text;
 using System.Threading.Tasks;
 using System.Windows.Input;
-using System.Windows.Media.Media3D;
+using Bewegungsfelder.Mathematics;
 using System.Windows.Threading;
 
 namespace Bewegungsfelder.VM
@@ -52,6 +54,33 @@ namespace Bewegungsfelder.VM
 
         private int playbackPosition;
 
+        // reused for every frame while the skeleton doesn't change
+        private Pose framePose;
+
+        // skeleton bone index of each recorded joint, -1 if the bone isn't part of the skeleton
+        private int[] jointBoneIndices;
+        private CompiledSkeleton jointBoneIndicesSkeleton;
+        private Bone[] jointBoneIndicesJoints;
+
+        // skeleton bone index of each joint of a capture skeleton, mapped by bone name
+        private int[] captureBoneIndices;
+        private CompiledSkeleton captureBoneIndicesSkeleton;
+        private CaptureSkeleton captureBoneIndicesSource;
+
+        // the frame read from the capture file, reused for every frame
+        private float[] captureFrame;
+
+        // capture files are never overwritten, a counter is appended while the name is taken
+        private const int MAX_CAPTURE_NAME_ATTEMPTS = 100;
+
+        private CaptureWriter capture;
+
+        private Exception captureError;
+
+        // the skeleton and joints last written to the capture file
+        private CompiledSkeleton captureSkeleton;
+        private Bone[] captureJoints;
+
         public double FPS
         {
             get { return MotionData.FPS; }
@@ -88,16 +117,7 @@ namespace Bewegungsfelder.VM
             }
         }
 
-        public int Length
-        {
-            get
-            {
-                if (MotionData.Data.Count == 0)
-                    return 0;
-
-                return MotionData.FrameCount;
-            }
-        }
+        public int Length { get { return Reader != null ? Reader.FrameCount : MotionData.FrameCount; } }
 
         public KinematicVM Kinematic { get; }
 
@@ -125,6 +145,54 @@ namespace Bewegungsfelder.VM
 
         public MotionData MotionData { get; }
 
+        /// <summary>
+        /// the capture file played back instead of the motion data, null if the motion data is played.
+        /// </summary>
+        public CaptureReader Reader { get; }
+
+        /// <summary>
+        /// directory of the capture files written while recording.
+        /// no capture file is written if null
+        /// </summary>
+        public string CaptureDirectory { get; set; }
+
+        /// <summary>
+        /// recorded frames are compressed within this angle in radians. 0 to write them uncompressed
+        /// </summary>
+        public double CaptureMaxError { get; set; }
+
+        /// <summary>
+        /// the capture file of the current recording, null if not recording
+        /// </summary>
+        public CaptureWriter Capture
+        {
+            get { return capture; }
+            private set
+            {
+                if (capture != value)
+                {
+                    capture = value;
+                    PropertyChanged?.Invoke(this, new PropertyChangedEventArgs(nameof(Capture)));
+                }
+            }
+        }
+
+        /// <summary>
+        /// the error that prevented or stopped the last capture file, null if it succeeded
+        /// </summary>
+        public Exception CaptureError
+        {
+            get { return captureError; }
+            private set
+            {
+                if (captureError != value)
+                {
+                    captureError = value;
+                    PropertyChanged?.Invoke(this, new PropertyChangedEventArgs(nameof(CaptureError)));
+                }
+            }
+        }
+
         public event PropertyChangedEventHandler PropertyChanged;
 
         public KinematicAnimatorVM(KinematicVM kinematic, MotionData motionData)
@@ -144,6 +212,15 @@ namespace Bewegungsfelder.VM
             timer.Tick += OnTimerTick;
         }
 
+        /// <summary>
+        /// plays a capture file. frames are read from the file when they are displayed
+        /// </summary>
+        public KinematicAnimatorVM(KinematicVM kinematic, CaptureReader reader)
+            : this(kinematic, new MotionData { FPS = reader.FPS })
+        {
+            this.Reader = reader;
+        }
+
 
         private void PlaybackPositionChanged()
         {
@@ -152,13 +229,40 @@ namespace Bewegungsfelder.VM
                 Pause();
             }
 
-            Dictionary<Bone, Quaternion> currentFramePose = new Dictionary<Bone, Quaternion>();
-            foreach (var item in MotionData.Data)
+            if (playbackPosition < 1)
+                return; // nothing recorded
+
+            var pose = GetFramePose();
+            int[] boneIndices;
+            ArraySegment<float> frame;
+            if (Reader != null)
+            {
+                var captureSkeleton = Reader.GetSkeleton(playbackPosition - 1);
+                if (captureSkeleton == null)
+                    return; // the frame was dropped while capturing
+
+                int count = captureSkeleton.JointCount * MotionData.JOINT_STRIDE;
+                if (captureFrame == null || captureFrame.Length < count)
+                    captureFrame = new float[count];
+
+                Reader.ReadFrame(playbackPosition - 1, captureFrame);
+                frame = new ArraySegment<float>(captureFrame, 0, count);
+                boneIndices = GetCaptureBoneIndices(pose.Skeleton, captureSkeleton);
+            }
+            else
             {
-                currentFramePose.Add(item.Key, item.Value[playbackPosition - 1]);
+                frame = MotionData.GetFrame(playbackPosition - 1);
+                boneIndices = GetJointBoneIndices(pose.Skeleton);
             }
 
-            Kinematic.Model.ApplyLocalRotation(currentFramePose);
+            pose.Clear();
+            for (int i = 0; i < boneIndices.Length; i++)
+            {
+                if (boneIndices[i] >= 0)
+                    pose.Set(boneIndices[i], MotionData.Read(frame, i));
+            }
+
+            Kinematic.Model.ApplyLocalRotation(pose);
         }
 
         private void OnTimerTick(object sender, EventArgs e)
@@ -168,19 +272,25 @@ namespace Bewegungsfelder.VM
 
             if (AnimatorState == State.Recording)
             {
-                Kinematic.Model.Root.Traverse(bone =>
+                var pose = GetFramePose();
+                Kinematic.Model.CollectLocalOrientations(pose);
+
+                // the first frame defines the recorded joints, end nodes are skipped
+                if (MotionData.FrameCount == 0)
+                    MotionData.Reset(pose.Skeleton.Bones.Where(bone => !bone.IsEndSite));
+
+                var boneIndices = GetJointBoneIndices(pose.Skeleton);
+                var frame = MotionData.AddFrame();
+                for (int i = 0; i < boneIndices.Length; i++)
                 {
-                    if (bone.Children.Count == 0)
-                        return; // skip end nodes
+                    int index = boneIndices[i];
+                    MotionData.Write(frame, i, index >= 0 ? pose.Rotations[index] : Quaternion.Identity);
+                }
 
-                    if (!MotionData.Data.ContainsKey(bone))
-                    {
-                        MotionData.Data.Add(bone, new List<Quaternion>());
-                    }
-                    MotionData.Data[bone].Add(bone.JointRotation);
+                if (Capture != null)
+                    CaptureFrame(pose.Skeleton, frame);
 
-                    PropertyChanged?.Invoke(this, new PropertyChangedEventArgs(nameof(Length)));
-                });
+                PropertyChanged?.Invoke(this, new PropertyChangedEventArgs(nameof(Length)));
             }
             else
             {
@@ -188,6 +298,198 @@ namespace Bewegungsfelder.VM
             }
         }
 
+        /// <summary>
+        /// returns the reused frame pose, recreated if the skeleton changed
+        /// </summary>
+        private Pose GetFramePose()
+        {
+            if (framePose?.Skeleton != Kinematic.Model.Compiled)
+                framePose = Kinematic.Model.CreatePose();
+
+            return framePose;
+        }
+
+        /// <summary>
+        /// returns the skeleton bone index of each recorded joint.
+        /// cached until the skeleton or the recorded joints change
+        /// </summary>
+        private int[] GetJointBoneIndices(CompiledSkeleton skeleton)
+        {
+            if (jointBoneIndicesSkeleton != skeleton || jointBoneIndicesJoints != MotionData.Joints)
+            {
+                jointBoneIndicesSkeleton = skeleton;
+                jointBoneIndicesJoints = MotionData.Joints;
+                jointBoneIndices = MotionData.Joints.Select(joint => skeleton.IndexOf(joint)).ToArray();
+            }
+
+            return jointBoneIndices;
+        }
+
+        /// <summary>
+        /// reads all frames of the capture file for the current skeleton.
+        /// returns the motion data if no capture file is played
+        /// </summary>
+        public MotionData ReadMotionData()
+        {
+            if (Reader == null)
+                return MotionData;
+
+            var skeleton = Kinematic.Model.Compiled;
+            var result = new MotionData { FPS = Reader.FPS };
+            result.Reset(skeleton.Bones.Where(bone => !bone.IsEndSite));
+
+            // skeleton bone index -> joint index of the result
+            var jointIndices = new int[skeleton.Count];
+            for (int i = 0; i < skeleton.Count; i++)
+            {
+                jointIndices[i] = result.IndexOf(skeleton.Bones[i]);
+            }
+
+            float[] source = new float[0];
+            for (int i = 0; i < Reader.FrameCount; i++)
+            {
+                var captureSkeleton = Reader.GetSkeleton(i);
+                if (captureSkeleton == null)
+                    continue; // dropped while capturing
+
+                int count = captureSkeleton.JointCount * MotionData.JOINT_STRIDE;
+                if (source.Length < count)
+                    source = new float[count];
+                Reader.ReadFrame(i, source);
+
+                var sourceFrame = new ArraySegment<float>(source, 0, count);
+                var frame = result.AddFrame();
+                for (int j = 0; j < result.JointCount; j++)
+                {
+                    MotionData.Write(frame, j, Quaternion.Identity);
+                }
+
+                var boneIndices = GetCaptureBoneIndices(skeleton, captureSkeleton);
+                for (int j = 0; j < boneIndices.Length; j++)
+                {
+                    if (boneIndices[j] >= 0)
+                        MotionData.Write(frame, jointIndices[boneIndices[j]], MotionData.Read(sourceFrame, j));
+                }
+            }
+
+            return result;
+        }
+
+        /// <summary>
+        /// returns the skeleton bone index of each joint of a capture skeleton.
+        /// joints are mapped by name as the capture may contain several skeletons
+        /// </summary>
+        private int[] GetCaptureBoneIndices(CompiledSkeleton skeleton, CaptureSkeleton source)
+        {
+            if (captureBoneIndicesSkeleton != skeleton || captureBoneIndicesSource != source)
+            {
+                var boneIndices = new Dictionary<string, int>();
+                for (int i = 0; i < skeleton.Count; i++)
+                {
+                    var bone = skeleton.Bones[i];
+                    if (!bone.IsEndSite && !boneIndices.ContainsKey(bone.Name))
+                        boneIndices.Add(bone.Name, i);
+                }
+
+                captureBoneIndices = Enumerable.Repeat(-1, source.JointCount).ToArray();
+                for (int i = 0; i < source.Count; i++)
+                {
+                    int index;
+                    if (source.Joints[i] >= 0 && boneIndices.TryGetValue(source.Names[i], out index))
+                        captureBoneIndices[source.Joints[i]] = index;
+                }
+
+                captureBoneIndicesSkeleton = skeleton;
+                captureBoneIndicesSource = source;
+            }
+
+            return captureBoneIndices;
+        }
+
+        /// <summary>
+        /// appends a recorded frame to the capture file.
+        /// the skeleton is written first whenever the recorded joints change
+        /// </summary>
+        private void CaptureFrame(CompiledSkeleton skeleton, ArraySegment<float> frame)
+        {
+            if (Capture.Error != null)
+            {
+                Debug.WriteLine($"Capture to {Capture.Path} stopped: {Capture.Error.Message}");
+                CaptureError = Capture.Error;
+                StopCapture();
+                return;
+            }
+
+            if (captureSkeleton != skeleton || captureJoints != MotionData.Joints)
+            {
+                Capture.WriteSkeleton(skeleton, MotionData);
+                captureSkeleton = skeleton;
+                captureJoints = MotionData.Joints;
+            }
+
+            Capture.AppendFrame(DateTime.Now, frame);
+        }
+
+        /// <returns>false if the capture file couldn't be created</returns>
+        private bool StartCapture()
+        {
+            if (CaptureDirectory == null)
+                return true;
+
+            captureSkeleton = null;
+            captureJoints = null;
+
+            try
+            {
+                Directory.CreateDirectory(CaptureDirectory);
+                Capture = CreateCaptureWriter();
+                CaptureError = null;
+                return true;
+            }
+            catch (Exception e) when (e is IOException || e is UnauthorizedAccessException)
+            {
+                Debug.WriteLine($"Capture to {CaptureDirectory} failed: {e.Message}");
+                CaptureError = e;
+                return false;
+            }
+        }
+
+        /// <summary>
+        /// creates a capture file named after the current time
+        /// </summary>
+        private CaptureWriter CreateCaptureWriter()
+        {
+            string name = $"capture_{DateTime.Now:yyyyMMdd_HHmmss_fff}";
+
+            for (int attempt = 0; ; attempt++)
+            {
+                string path = Path.Combine(CaptureDirectory,
+                    (attempt == 0 ? name : $"{name}_{attempt}") + CaptureFormat.FILE_EXTENSION);
+
+                if (File.Exists(path) && attempt < MAX_CAPTURE_NAME_ATTEMPTS)
+                    continue;
+
+                try
+                {
+                    return new CaptureWriter(path, CaptureMaxError);
+                }
+                catch (IOException) when (File.Exists(path) && attempt < MAX_CAPTURE_NAME_ATTEMPTS)
+                {
+                    // created by someone else in the meantime
+                }
+            }
+        }
+
+        private void StopCapture()
+        {
+            if (Capture == null)
+                return;
+
+            var writer = Capture;
+            Capture = null;
+            writer.Dispose();
+        }
+
         private void Play()
         {
             AnimatorState = State.Playback;
@@ -218,9 +520,13 @@ namespace Bewegungsfelder.VM
             { // stop recording
                 AnimatorState = State.Paused;
                 timer.Stop();
+                StopCapture();
             }
             else
             { // start recording
+                if (!StartCapture())
+                    return;
+
                 AnimatorState = State.Recording;
                 timer.Start();
             }
@@ -229,18 +535,19 @@ namespace Bewegungsfelder.VM
 
         private void ClearData()
         {
-            MotionData.Data.Clear();
+            MotionData.Clear();
             PropertyChanged?.Invoke(this, new PropertyChangedEventArgs(nameof(Length)));
         }
 
         private bool CanClear()
         {
-            return AnimatorState == State.Paused;
+            return Reader == null && AnimatorState == State.Paused;
         }
 
         private bool CanRecord()
         {
-            return AnimatorState == State.Paused || AnimatorState == State.Recording;
+            // capture files are played back read only
+            return Reader == null && (AnimatorState == State.Paused || AnimatorState == State.Recording);
         }
     }
 }
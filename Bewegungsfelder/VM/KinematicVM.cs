@@ -33,7 +33,8 @@ using System.Windows.Input;
 using GalaSoft.MvvmLight.CommandWpf;
 using System.Windows;
 using System.Collections.ObjectModel;
-using System.Windows.Media.Media3D;
+using Bewegungsfelder.Mathematics;
+using Bewegungsfelder.Utilities;
 
 namespace Bewegungsfelder.VM
 {
@@ -41,6 +42,10 @@ namespace Bewegungsfelder.VM
     {
         private BoneVM selectedItem;
 
+        // the bone view models in the order of the compiled skeleton they were collected for
+        private CompiledSkeleton compiledFor;
+        private BoneVM[] compiledBoneVMs;
+
         /// <summary>
         /// contains all Bone-BoneVM pairs
         /// </summary>
@@ -154,6 +159,7 @@ namespace Bewegungsfelder.VM
             SelectedItem.Model.Children.Add(model);
             SelectedItem.Children.Add(vm);
             BoneVMMap.Add(model, vm);
+            Model.Invalidate();
         }
 
         /// <summary>
@@ -176,6 +182,7 @@ namespace Bewegungsfelder.VM
 
             SelectedItem.Parent.Children.Remove(SelectedItem);
             BoneVMMap.Remove(SelectedItem.Model);
+            Model.Invalidate();
         }
 
         /// <summary>
@@ -191,8 +198,19 @@ namespace Bewegungsfelder.VM
         /// </summary>
         public void Refresh()
         {
-            foreach (var item in Roots)
-                item.Refresh();
+            var skeleton = Model.Compiled;
+            skeleton.Update();
+
+            if (compiledFor != skeleton)
+            {
+                compiledFor = skeleton;
+                compiledBoneVMs = skeleton.Bones.Select(bone => BoneVMMap[bone]).ToArray();
+            }
+
+            for (int i = 0; i < skeleton.Count; i++)
+            {
+                compiledBoneVMs[i].Refresh(skeleton.LocalTransforms[i].ToMedia3D());
+            }
         }
     }
 }
@@ -43,7 +43,7 @@ namespace Bewegungsfelder.VM
         private CSysVisual3D csysVisual;
         // private LinesVisual3D accelerationVisual;
 
-        public bool IsCalibrated { get { return Model.CalibrationTransform != Matrix3D.Identity; } }
+        public bool IsCalibrated { get { return !Model.CalibrationTransform.IsIdentity; } }
         public bool IsNotCalibrated { get { return !IsCalibrated; } }
 
         public CSysBuilder SensorFrameDefinition { get { return Model.SensorFrameDefinition; } }
@@ -90,13 +90,15 @@ namespace Bewegungsfelder.VM
             //Visual.Children.Add(accelerationVisual);
         }
 
-        public void Refresh()
+        /// <param name="skeleton">the updated skeleton the linked bone is part of</param>
+        public void Refresh(CompiledSkeleton skeleton)
         {
-            var boneTransform = Model.Bone.GetRootTransform();
+            int index = skeleton.IndexOf(Model.Bone);
+            var boneTransform = index < 0 ? Model.Bone.GetRootTransform() : skeleton.WorldTransforms[index];
 
             Matrix3D visualTransform = Matrix3D.Identity;
-            visualTransform.Rotate(Model.GetCalibratedOrientation());
-            visualTransform.Translate(boneTransform.GetOffset());
+            visualTransform.Rotate(Model.GetCalibratedOrientation().ToMedia3D());
+            visualTransform.Translate(boneTransform.GetOffset().ToMedia3D());
 
             csysVisual.Transform = new MatrixTransform3D(visualTransform);
             csysVisual.Length = DisplaySettings.Get.CSysSize;
@@ -32,6 +32,7 @@ using System.Net;
 using System.Text;
 using System.Threading.Tasks;
 using System.Windows.Media.Media3D;
+using Bewegungsfelder.Utilities;
 
 namespace Bewegungsfelder.VM
 {
@@ -48,10 +49,15 @@ namespace Bewegungsfelder.VM
         /// </summary>
         public double SampleRate { get; set; }
 
+        /// <summary>
+        /// link quality statistics of the underlying sensor
+        /// </summary>
+        public SensorStatistics Statistics { get { return Model.Statistics; } }
+
         /// <summary>
         /// returns the orientation from the last received value 
         /// </summary>
-        public Quaternion CurrentOrientation { get { return LastValue.Orientation; } }
+        public Quaternion CurrentOrientation { get { return LastValue.Orientation.ToMedia3D(); } }
 
         /// <summary>
         /// the last sensor value received.
@@ -78,7 +84,7 @@ namespace Bewegungsfelder.VM
         /// </summary>
         public void Refresh()
         {
-            //SampleRate = Model.GetSampleRate(5);
+            SampleRate = Model.Statistics.SampleRate;
 
             // empty property changed event is interpreted as a change on all properties
             PropertyChanged?.Invoke(this, new PropertyChangedEventArgs(null));
@@ -1,7 +1,7 @@
 ﻿/*
-Part of Bewegungsfelder 
+Part of Bewegungsfelder
 
-MIT-License 
+MIT-License
 (C) 2016 Ivo Herzig
 
 Permission is hereby granted, free of charge, to any person obtaining a copy
@@ -24,22 +24,35 @@ SOFTWARE.
 */
 using System;
 using System.Collections.Generic;
+using System.Globalization;
 using System.Linq;
 using System.Text;
 using System.Threading.Tasks;
-using System.Windows.Media.Media3D;
+using System.Windows.Data;
+using Bewegungsfelder.Utilities;
+using Media3D = System.Windows.Media.Media3D;
 
-namespace Bewegungsfelder.BVH
+namespace Bewegungsfelder.View
 {
-    public class BVHMotionData
+    /// <summary>
+    /// binds vectors of the core library to controls that edit wpf vectors, e.g. the Vector3DEditor
+    /// </summary>
+    class Media3DVectorConverter : IValueConverter
     {
-        public double FrameTime { get; }
-        public Dictionary<BVHNode, List<Quaternion>> Data { get; }
+        public object Convert(object value, Type targetType, object parameter, CultureInfo culture)
+        {
+            if (value is Mathematics.Vector3D)
+                return ((Mathematics.Vector3D)value).ToMedia3D();
+
+            return value;
+        }
 
-        public BVHMotionData(double frameTime, Dictionary<BVHNode, List<Quaternion>> motionData)
+        public object ConvertBack(object value, Type targetType, object parameter, CultureInfo culture)
         {
-            this.FrameTime = frameTime;
-            this.Data = motionData;
+            if (value is Media3D.Vector3D)
+                return ((Media3D.Vector3D)value).ToCore();
+
+            return value;
         }
     }
 }
@@ -23,6 +23,7 @@ OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
 SOFTWARE.
 */
 
+using Bewegungsfelder.Core;
 using Bewegungsfelder.VM;
 using OxyPlot;
 using System;
@@ -59,6 +60,13 @@ namespace Bewegungsfelder.View
         private List<DataPoint> yGyroData = new List<DataPoint>();
         private List<DataPoint> zGyroData = new List<DataPoint>();
 
+        // time span of values shown
+        private static readonly TimeSpan PLOT_WINDOW = TimeSpan.FromSeconds(10);
+
+        // reused for copying the samples
+        private uint[] timestamps = new uint[0];
+        private float[] channelValues = new float[0];
+
         public SensorVM Sensor
         {
             get { return (SensorVM)GetValue(SensorProperty); }
@@ -89,33 +97,49 @@ namespace Bewegungsfelder.View
 
         private void OnRefreshTimerTick(object sender, EventArgs e)
         {
-            xAccelData.Add(new DataPoint(Sensor.LastValue.SensorTimestamp, Sensor.LastValue.Acceleration.X));
-            yAccelData.Add(new DataPoint(Sensor.LastValue.SensorTimestamp, Sensor.LastValue.Acceleration.Y));
-            zAccelData.Add(new DataPoint(Sensor.LastValue.SensorTimestamp, Sensor.LastValue.Acceleration.Z));
-
-            xGyroData.Add(new DataPoint(Sensor.LastValue.SensorTimestamp, Sensor.LastValue.Gyro.X));
-            yGyroData.Add(new DataPoint(Sensor.LastValue.SensorTimestamp, Sensor.LastValue.Gyro.Y));
-            zGyroData.Add(new DataPoint(Sensor.LastValue.SensorTimestamp, Sensor.LastValue.Gyro.Z));
-
-            int numSamples = 100;
-            if (xAccelData.Count > numSamples)
-                xAccelData.RemoveRange(0, xAccelData.Count - numSamples);
-            if (yAccelData.Count > numSamples)
-                yAccelData.RemoveRange(0, yAccelData.Count - numSamples);
-            if (zAccelData.Count > numSamples)
-                zAccelData.RemoveRange(0, zAccelData.Count - numSamples);
-
-            if (xGyroData.Count > numSamples)
-                xGyroData.RemoveRange(0, xGyroData.Count - numSamples);
-            if (yGyroData.Count > numSamples)
-                yGyroData.RemoveRange(0, yGyroData.Count - numSamples);
-            if (zGyroData.Count > numSamples)
-                zGyroData.RemoveRange(0, zGyroData.Count - numSamples);
+            var samples = Sensor.Model.Samples;
+            long end = samples.End;
+            long start = samples.FindSince(DateTime.Now - PLOT_WINDOW);
+            int count = (int)(end - start);
+
+            if (timestamps.Length < count)
+            {
+                timestamps = new uint[count];
+                channelValues = new float[count];
+            }
+
+            int n = samples.CopyTimestampsTo(start, end, timestamps);
+
+            Fill(xAccelData, samples, SensorChannel.AccelerationX, start, end, n);
+            Fill(yAccelData, samples, SensorChannel.AccelerationY, start, end, n);
+            Fill(zAccelData, samples, SensorChannel.AccelerationZ, start, end, n);
+
+            Fill(xGyroData, samples, SensorChannel.GyroX, start, end, n);
+            Fill(yGyroData, samples, SensorChannel.GyroY, start, end, n);
+            Fill(zGyroData, samples, SensorChannel.GyroZ, start, end, n);
 
             plot_accel.InvalidatePlot();
             plot_gyro.InvalidatePlot();
         }
 
+        /// <summary>
+        /// replaces the points of a series with a channel of the samples [start, end).
+        /// the copies of the channels might lose different numbers of overwritten samples,
+        /// so the values are aligned with the timestamps at the most recent end.
+        /// </summary>
+        private void Fill(List<DataPoint> series, SensorSampleStore samples, SensorChannel channel,
+            long start, long end, int timestampCount)
+        {
+            int n = samples.CopyTo(channel, start, end, channelValues);
+            int count = Math.Min(n, timestampCount);
+
+            series.Clear();
+            for (int i = 0; i < count; i++)
+            {
+                series.Add(new DataPoint(timestamps[timestampCount - count + i], channelValues[n - count + i]));
+            }
+        }
+
         private static void OnSensorPropertyChanged(DependencyObject obj, DependencyPropertyChangedEventArgs e)
         {
             var view = (SensorDetailsView)obj;
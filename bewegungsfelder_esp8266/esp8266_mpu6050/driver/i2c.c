@@ -3,6 +3,7 @@
     Copyright (C) 2014 Rudy Hardeman (zarya) 
     Copyright (C) 2016 Ivo Herzig:
     	Added i2c_readBytes and i2c_writeBytes methods.
+    	Iram resident, cycle counted timing and clock stretching.
 
     This program is free software; you can redistribute it and/or modify
     it under the terms of the GNU General Public License as published by
@@ -22,7 +23,9 @@
 #include "ets_sys.h"
 #include "osapi.h"
 #include "gpio.h"
+#include "user_interface.h"
 #include "i2c.h"
+#include "ccount.h"
 
 // set  write bit in i2c address
 #define I2C_WRITE_BIT << 1
@@ -30,31 +33,90 @@
 // set read bit in i2c address
 #define I2C_READ_BIT << 1 | 1
 
+// bus timing in cpu cycles, calculated by i2c_init
+static uint32 low_cycles;
+static uint32 high_cycles;
+static uint32 stretch_cycles;
+
+// set when a slave stretched the clock for longer than I2C_STRETCH_TIMEOUT_US
+static uint8 stretch_timeout;
+
+/*
+ * both lines are open drain: writing a 1 releases the line to the pull-up,
+ * writing a 0 pulls it low. the set/clear registers change single pins
+ * without a read-modify-write of the output register.
+ */
+static inline void i2c_release(uint32 mask)
+{
+    GPIO_REG_WRITE(GPIO_OUT_W1TS_ADDRESS, mask);
+}
+
+static inline void i2c_pull(uint32 mask)
+{
+    GPIO_REG_WRITE(GPIO_OUT_W1TC_ADDRESS, mask);
+}
+
+static inline uint32 i2c_lines(void)
+{
+    return GPIO_REG_READ(GPIO_IN_ADDRESS);
+}
+
 /**
- * Set SDA to state
+ * busy waits until the given number of cycles passed since since.
+ * the time spent since the edge counts, so the overhead of the
+ * bit functions doesn't slow the bus down.
  */
-LOCAL void ICACHE_FLASH_ATTR
-i2c_sda(uint8 state)
+static inline void i2c_wait(uint32 since, uint32 cycles)
 {
-    state &= 0x01;
-    //Set SDA line to state
-    if (state)
-        gpio_output_set(1 << I2C_SDA_PIN, 0, 1 << I2C_SDA_PIN, 0);
-    else
-        gpio_output_set(0, 1 << I2C_SDA_PIN, 1 << I2C_SDA_PIN, 0);
+    while (get_ccount() - since < cycles)
+        ;
 }
 
 /**
- * Set SCK to state
+ * releases SCK and waits until it is high, a slave may stretch the clock
+ * by holding it low. returns the time SCK went high.
  */
-LOCAL void ICACHE_FLASH_ATTR
-i2c_sck(uint8 state)
+static inline uint32 i2c_sck_high(void)
 {
-    //Set SCK line to state
-    if (state)
-        gpio_output_set(1 << I2C_SCK_PIN, 0, 1 << I2C_SCK_PIN, 0);
+    uint32 start;
+
+    i2c_release(I2C_SCK_MASK);
+    start = get_ccount();
+    while (!(i2c_lines() & I2C_SCK_MASK)) {
+        if (get_ccount() - start > stretch_cycles) {
+            stretch_timeout = 1;
+            break;
+        }
+    }
+
+    return get_ccount();
+}
+
+/**
+ * clocks a single bit. SCK is low before and after.
+ * returns the state of SDA during the high phase.
+ */
+static inline uint8 i2c_bit(uint8 bit)
+{
+    uint32 t;
+    uint8 sda;
+
+    if (bit)
+        i2c_release(I2C_SDA_MASK);
     else
-        gpio_output_set(0, 1 << I2C_SCK_PIN, 1 << I2C_SCK_PIN, 0);
+        i2c_pull(I2C_SDA_MASK);
+
+    t = get_ccount();
+    i2c_wait(t, low_cycles);
+
+    t = i2c_sck_high();
+    i2c_wait(t, high_cycles);
+
+    // sample at the end of the high phase, right before the falling edge
+    sda = (i2c_lines() & I2C_SDA_MASK) ? 1 : 0;
+    i2c_pull(I2C_SCK_MASK);
+
+    return sda;
 }
 
 /**
@@ -64,9 +126,19 @@ i2c_sck(uint8 state)
 void ICACHE_FLASH_ATTR
 i2c_init(void)
 {
+    uint32 mhz = system_get_cpu_freq();
+
+    low_cycles = (I2C_LOW_NS * mhz + 999) / 1000;
+    high_cycles = (I2C_HIGH_NS * mhz + 999) / 1000;
+    stretch_cycles = I2C_STRETCH_TIMEOUT_US * mhz;
+
     //Disable interrupts
     ETS_GPIO_INTR_DISABLE();
 
+    // release both lines before the outputs are enabled, otherwise
+    // enabling SDA first pulls it low while SCK is high (a start condition)
+    i2c_release(I2C_SDA_MASK | I2C_SCK_MASK);
+
     //Set pin functions
     PIN_FUNC_SELECT(I2C_SDA_MUX, I2C_SDA_FUNC);
     PIN_FUNC_SELECT(I2C_SCK_MUX, I2C_SCK_FUNC);
@@ -91,38 +163,54 @@ i2c_init(void)
 
     //Turn interrupt back on
     ETS_GPIO_INTR_ENABLE();
-
-    i2c_sda(1);
-    i2c_sck(1);
     return;
 }
 
 /**
- * I2C Start signal 
+ * I2C Start signal. also used as repeated start, SCK may be low before.
+ * SCK is low afterwards
  */
-void ICACHE_FLASH_ATTR
+void ICACHE_RAM_ATTR
 i2c_start(void)
 {
-    i2c_sda(1);
-    i2c_sck(1);
-    os_delay_us(I2C_SLEEP_TIME);
-    i2c_sda(0);
-    os_delay_us(I2C_SLEEP_TIME);
-    i2c_sck(0);
-    os_delay_us(I2C_SLEEP_TIME);
+    uint32 t;
+
+    i2c_release(I2C_SDA_MASK);
+    t = get_ccount();
+    i2c_wait(t, low_cycles);
+
+    // start setup time
+    t = i2c_sck_high();
+    i2c_wait(t, high_cycles);
+
+    // start hold time
+    i2c_pull(I2C_SDA_MASK);
+    t = get_ccount();
+    i2c_wait(t, high_cycles);
+
+    i2c_pull(I2C_SCK_MASK);
 }
 
 /**
  * I2C Stop signal 
  */
-void ICACHE_FLASH_ATTR
+void ICACHE_RAM_ATTR
 i2c_stop(void)
 {
-    os_delay_us(I2C_SLEEP_TIME);
-    i2c_sck(1);
-    os_delay_us(I2C_SLEEP_TIME);
-    i2c_sda(1);
-    os_delay_us(I2C_SLEEP_TIME);
+    uint32 t;
+
+    i2c_pull(I2C_SDA_MASK);
+    t = get_ccount();
+    i2c_wait(t, low_cycles);
+
+    // stop setup time
+    t = i2c_sck_high();
+    i2c_wait(t, high_cycles);
+
+    // bus free time before the next start
+    i2c_release(I2C_SDA_MASK);
+    t = get_ccount();
+    i2c_wait(t, low_cycles);
 }
 
 /**
@@ -131,26 +219,13 @@ i2c_stop(void)
  *  1 for ACK
  *  0 for NACK
  */
-void ICACHE_FLASH_ATTR
+void ICACHE_RAM_ATTR
 i2c_send_ack(uint8 state)
 {
-    i2c_sck(0);
-    os_delay_us(I2C_SLEEP_TIME);
-    //Set SDA 
-    //  HIGH for NACK
     //  LOW  for ACK
-    i2c_sda((state?0:1));
-
-    //Pulse the SCK
-    i2c_sck(0);
-    os_delay_us(I2C_SLEEP_TIME);
-    i2c_sck(1);
-    os_delay_us(I2C_SLEEP_TIME);
-    i2c_sck(0);
-    os_delay_us(I2C_SLEEP_TIME);
-
-    i2c_sda(1);
-    os_delay_us(I2C_SLEEP_TIME);
+    //  HIGH for NACK
+    i2c_bit(state ? 0 : 1);
+    i2c_release(I2C_SDA_MASK);
 }
 
 /**
@@ -159,60 +234,26 @@ i2c_send_ack(uint8 state)
  *  1 for ACK
  *  0 for NACK
  */
-uint8 ICACHE_FLASH_ATTR
+uint8 ICACHE_RAM_ATTR
 i2c_check_ack(void)
 {
-    uint8 ack;
-    i2c_sda(1);
-    os_delay_us(I2C_SLEEP_TIME);
-    i2c_sck(0);
-    os_delay_us(I2C_SLEEP_TIME);
-    i2c_sck(1);
-    os_delay_us(I2C_SLEEP_TIME);
-
-    //Get SDA pin status
-    ack = esp_i2c_read();
-
-    os_delay_us(I2C_SLEEP_TIME);
-    i2c_sck(0);
-    os_delay_us(I2C_SLEEP_TIME);
-    i2c_sda(0);
-    os_delay_us(I2C_SLEEP_TIME);
-
-    return (ack?0:1);
+    return i2c_bit(1) ? 0 : 1;
 }
 
 /**
  * Receive byte from the I2C bus 
  * returns the byte 
  */
-uint8 ICACHE_FLASH_ATTR
+uint8 ICACHE_RAM_ATTR
 i2c_readByte(void)
 {
     uint8 data = 0;
-    uint8 data_bit;
     uint8 i;
 
-    i2c_sda(1);
-
+    // the slave drives SDA, keep it released
     for (i = 0; i < 8; i++)
-    {
-        os_delay_us(I2C_SLEEP_TIME);
-        i2c_sck(0);
-        os_delay_us(I2C_SLEEP_TIME);
-
-        i2c_sck(1);
-        os_delay_us(I2C_SLEEP_TIME);
+        data = (data << 1) | i2c_bit(1);
 
-        data_bit = esp_i2c_read();
-        os_delay_us(I2C_SLEEP_TIME);
-
-        data_bit <<= (7 - i);
-        data |= data_bit;
-    }
-    i2c_sck(0);
-    os_delay_us(I2C_SLEEP_TIME);
-    
     return data;
 }
 
@@ -220,23 +261,13 @@ i2c_readByte(void)
  * Write byte to I2C bus
  * uint8 data: to byte to be writen
  */
-void ICACHE_FLASH_ATTR
+void ICACHE_RAM_ATTR
 i2c_writeByte(uint8 data)
 {
-    uint8 data_bit;
     sint8 i;
 
-    os_delay_us(I2C_SLEEP_TIME);
-
-    for (i = 7; i >= 0; i--) {
-        data_bit = data >> i;
-        i2c_sda(data_bit);
-        os_delay_us(I2C_SLEEP_TIME);
-        i2c_sck(1);
-        os_delay_us(I2C_SLEEP_TIME);
-        i2c_sck(0);
-        os_delay_us(I2C_SLEEP_TIME);
-    }
+    for (i = 7; i >= 0; i--)
+        i2c_bit((data >> i) & 0x01);
 }
 
 /**
@@ -247,8 +278,9 @@ i2c_writeByte(uint8 data)
  * unsigned char const *data: data to write
  * return 0 on success, everything else is errors
  */
-int i2c_writeBytes(unsigned char slave_addr, unsigned char reg_addr,
+int ICACHE_RAM_ATTR i2c_writeBytes(unsigned char slave_addr, unsigned char reg_addr,
 		unsigned char length, unsigned char const *data) {
+	stretch_timeout = 0;
 	i2c_start();
 
 	i2c_writeByte(slave_addr << 1);
@@ -281,6 +313,11 @@ int i2c_writeBytes(unsigned char slave_addr, unsigned char reg_addr,
 
 	i2c_stop();
 
+	if (stretch_timeout) {
+		ets_uart_printf("i2c_writeBytes: clock stretch timeout, slave addr: 0x%x\n", slave_addr);
+		return -1;
+	}
+
 	return 0;
 }
 
@@ -292,9 +329,10 @@ int i2c_writeBytes(unsigned char slave_addr, unsigned char reg_addr,
  * unsigned char *data: read data is saved here
  * return 0 on success, everything else is errors
  */
-int i2c_readBytes(unsigned char slave_addr, unsigned char reg_addr,
+int ICACHE_RAM_ATTR i2c_readBytes(unsigned char slave_addr, unsigned char reg_addr,
 		unsigned char length, unsigned char* data) {
 
+	stretch_timeout = 0;
 	i2c_start();
 	i2c_writeByte(slave_addr I2C_WRITE_BIT);
 	if (!i2c_check_ack())
@@ -334,5 +372,10 @@ int i2c_readBytes(unsigned char slave_addr, unsigned char reg_addr,
 
 	i2c_stop();
 
+	if (stretch_timeout) {
+		ets_uart_printf("i2c_readBytes: clock stretch timeout, slave addr: 0x%x\n", slave_addr);
+		return -1;
+	}
+
 	return 0;
 }
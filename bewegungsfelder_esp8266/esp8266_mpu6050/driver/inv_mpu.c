@@ -1860,6 +1860,60 @@ int mpu_read_fifo_stream(unsigned short length, unsigned char *data,
     return 0;
 }
 
+/**
+ *  @brief      Get several unparsed packets from the FIFO in one transfer.
+ *  Ivo Herzig 2016: reads the FIFO count once, then up to @e max_packets
+ *  whole packets with a single read of the FIFO register.
+ *  @param[in]  length      Length of one FIFO packet.
+ *  @param[in]  max_packets Maximum number of packets to read. The transfer
+ *                          (length * max_packets) must not exceed 255 bytes.
+ *  @param[out] data        FIFO packets.
+ *  @param[out] more        Number of packets left in the FIFO.
+ *  @return     Number of packets read, 0 if the FIFO holds less than one
+ *              packet, -1 on bus errors, -2 if the FIFO overflowed (it
+ *              was reset).
+ */
+int mpu_read_fifo_stream_burst(unsigned short length,
+    unsigned char max_packets, unsigned char *data, unsigned char *more)
+{
+    unsigned char tmp[2];
+    unsigned short fifo_count, available;
+
+    more[0] = 0;
+    if (!st.chip_cfg.dmp_on)
+        return -1;
+    if (!st.chip_cfg.sensors)
+        return -1;
+    if (!length || length * max_packets > 255)
+        return -1;
+
+    if (i2c_read(st.hw->addr, st.reg->fifo_count_h, 2, tmp))
+        return -1;
+    fifo_count = (tmp[0] << 8) | tmp[1];
+    if (fifo_count < length)
+        return 0;
+    if (fifo_count > (st.hw->max_fifo >> 1)) {
+        /* FIFO is 50% full, better check overflow bit. */
+        if (i2c_read(st.hw->addr, st.reg->int_status, 1, tmp))
+            return -1;
+        if (tmp[0] & BIT_FIFO_OVERFLOW) {
+            mpu_reset_fifo();
+            return -2;
+        }
+    }
+
+    available = fifo_count / length;
+    if (available > max_packets)
+        available = max_packets;
+    if (!available)
+        return 0;
+
+    if (i2c_read(st.hw->addr, st.reg->fifo_r_w, length * available, data))
+        return -1;
+    more[0] = fifo_count / length - available;
+    return available;
+}
+
 /**
  *  @brief      Set device to bypass mode.
  *  @param[in]  bypass_on   1 to enable bypass mode.
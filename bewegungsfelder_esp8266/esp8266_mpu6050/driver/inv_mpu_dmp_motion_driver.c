@@ -1245,53 +1245,43 @@ int dmp_set_interrupt_mode(unsigned char mode)
 }
 
 /**
- *  @brief      Get one packet from the FIFO.
- *  If @e sensors does not contain a particular sensor, disregard the data
- *  returned to that pointer.
- *  \n @e sensors can contain a combination of the following flags:
- *  \n INV_X_GYRO, INV_Y_GYRO, INV_Z_GYRO
- *  \n INV_XYZ_GYRO
- *  \n INV_XYZ_ACCEL
- *  \n INV_WXYZ_QUAT
- *  \n If the FIFO has no new data, @e sensors will be zero.
- *  \n If the FIFO is disabled, @e sensors will be zero and this function will
- *  return a non-zero error code.
+ *  @brief      Parse one DMP packet.
+ *  Ivo Herzig 2016: split from dmp_read_fifo to share it with
+ *  dmp_read_fifo_burst.
+ *  @param[in]  fifo_data   Packet of dmp.packet_length bytes.
  *  @param[out] gyro        Gyro data in hardware units.
  *  @param[out] accel       Accel data in hardware units.
  *  @param[out] quat        3-axis quaternion data in hardware units.
- *  @param[out] timestamp   Timestamp in milliseconds.
- *  @param[out] sensors     Mask of sensors read from FIFO.
- *  @param[out] more        Number of remaining packets.
- *  @return     0 if successful.
+ *  @param[out] sensors     Mask of sensors in the packet.
+ *  @return     0 if successful, -1 if the packet is corrupted.
  */
-int dmp_read_fifo(short *gyro, short *accel, long *quat,
-    unsigned long *timestamp, short *sensors, unsigned char *more)
+static int parse_packet(unsigned char *fifo_data, short *gyro, short *accel,
+    long *quat, short *sensors)
 {
-    unsigned char fifo_data[MAX_PACKET_LENGTH];
     unsigned char ii = 0;
 
-    /* TODO: sensors[0] only changes when dmp_enable_feature is called. We can
-     * cache this value and save some cycles.
-     */
     sensors[0] = 0;
 
-    /* Get a packet. */
-    if (mpu_read_fifo_stream(dmp.packet_length, fifo_data, more))
-        return -1;
-
     /* Parse DMP packet. */
     if (dmp.feature_mask & (DMP_FEATURE_LP_QUAT | DMP_FEATURE_6X_LP_QUAT)) {
 #ifdef FIFO_CORRUPTION_CHECK
         long quat_q14[4], quat_mag_sq;
 #endif
-        quat[0] = ((long)fifo_data[0] << 24) | ((long)fifo_data[1] << 16) |
-            ((long)fifo_data[2] << 8) | fifo_data[3];
-        quat[1] = ((long)fifo_data[4] << 24) | ((long)fifo_data[5] << 16) |
-            ((long)fifo_data[6] << 8) | fifo_data[7];
-        quat[2] = ((long)fifo_data[8] << 24) | ((long)fifo_data[9] << 16) |
-            ((long)fifo_data[10] << 8) | fifo_data[11];
-        quat[3] = ((long)fifo_data[12] << 24) | ((long)fifo_data[13] << 16) |
-            ((long)fifo_data[14] << 8) | fifo_data[15];
+        /* Assemble the big-endian words as 32 bits, so the sign survives
+         * where long is wider (host build).
+         */
+        quat[0] = (long)(int32_t)(((uint32_t)fifo_data[0] << 24) |
+            ((uint32_t)fifo_data[1] << 16) | ((uint32_t)fifo_data[2] << 8) |
+            fifo_data[3]);
+        quat[1] = (long)(int32_t)(((uint32_t)fifo_data[4] << 24) |
+            ((uint32_t)fifo_data[5] << 16) | ((uint32_t)fifo_data[6] << 8) |
+            fifo_data[7]);
+        quat[2] = (long)(int32_t)(((uint32_t)fifo_data[8] << 24) |
+            ((uint32_t)fifo_data[9] << 16) | ((uint32_t)fifo_data[10] << 8) |
+            fifo_data[11]);
+        quat[3] = (long)(int32_t)(((uint32_t)fifo_data[12] << 24) |
+            ((uint32_t)fifo_data[13] << 16) | ((uint32_t)fifo_data[14] << 8) |
+            fifo_data[15]);
         ii += 16;
 #ifdef FIFO_CORRUPTION_CHECK
         /* We can detect a corrupted FIFO by monitoring the quaternion data and
@@ -1311,7 +1301,6 @@ int dmp_read_fifo(short *gyro, short *accel, long *quat,
         if ((quat_mag_sq < QUAT_MAG_SQ_MIN) ||
             (quat_mag_sq > QUAT_MAG_SQ_MAX)) {
             /* Quaternion is outside of the acceptable threshold. */
-            mpu_reset_fifo();
             sensors[0] = 0;
             return -1;
         }
@@ -1341,10 +1330,109 @@ int dmp_read_fifo(short *gyro, short *accel, long *quat,
     if (dmp.feature_mask & (DMP_FEATURE_TAP | DMP_FEATURE_ANDROID_ORIENT))
         decode_gesture(fifo_data + ii);
 
+    return 0;
+}
+
+/**
+ *  @brief      Get one packet from the FIFO.
+ *  If @e sensors does not contain a particular sensor, disregard the data
+ *  returned to that pointer.
+ *  \n @e sensors can contain a combination of the following flags:
+ *  \n INV_X_GYRO, INV_Y_GYRO, INV_Z_GYRO
+ *  \n INV_XYZ_GYRO
+ *  \n INV_XYZ_ACCEL
+ *  \n INV_WXYZ_QUAT
+ *  \n If the FIFO has no new data, @e sensors will be zero.
+ *  \n If the FIFO is disabled, @e sensors will be zero and this function will
+ *  return a non-zero error code.
+ *  @param[out] gyro        Gyro data in hardware units.
+ *  @param[out] accel       Accel data in hardware units.
+ *  @param[out] quat        3-axis quaternion data in hardware units.
+ *  @param[out] timestamp   Timestamp in milliseconds.
+ *  @param[out] sensors     Mask of sensors read from FIFO.
+ *  @param[out] more        Number of remaining packets.
+ *  @return     0 if successful.
+ */
+int dmp_read_fifo(short *gyro, short *accel, long *quat,
+    unsigned long *timestamp, short *sensors, unsigned char *more)
+{
+    unsigned char fifo_data[MAX_PACKET_LENGTH];
+
+    /* TODO: sensors[0] only changes when dmp_enable_feature is called. We can
+     * cache this value and save some cycles.
+     */
+    sensors[0] = 0;
+
+    /* Get a packet. */
+    if (mpu_read_fifo_stream(dmp.packet_length, fifo_data, more))
+        return -1;
+
+    if (parse_packet(fifo_data, gyro, accel, quat, sensors)) {
+        mpu_reset_fifo();
+        return -1;
+    }
+
     get_ms(timestamp);
     return 0;
 }
 
+/**
+ *  @brief      Get all pending packets from the FIFO in one I2C transfer.
+ *  Ivo Herzig 2016: reads the FIFO count once and then as many whole
+ *  packets as fit into @e packets and a single transfer of at most 255
+ *  bytes, instead of three transfers per packet like dmp_read_fifo.
+ *  \n If a packet is corrupted, the FIFO is reset and the packets before
+ *  it are returned.
+ *  \n There is no timestamp, the time of the read says little about when
+ *  the packets were sampled. The caller knows the interrupt times and can
+ *  tell the age of each packet from @e more and the FIFO rate.
+ *  @param[out] packets     Parsed packets, see dmp_read_fifo for the fields.
+ *  @param[in]  max_packets Size of @e packets.
+ *  @param[out] more        Number of packets left in the FIFO. The
+ *                          oldest packet of the FIFO is returned first.
+ *  @param[out] overflow    1 if the FIFO overflowed. It was reset and no
+ *                          packets were read.
+ *  @return     Number of packets read, 0 if the FIFO is empty, negative on
+ *              errors.
+ */
+int dmp_read_fifo_burst(struct dmp_packet *packets, unsigned char max_packets,
+    unsigned char *more, unsigned char *overflow)
+{
+    unsigned char fifo_data[DMP_BURST_MAX_BYTES];
+    unsigned char count, ii;
+    int result;
+
+    more[0] = 0;
+    overflow[0] = 0;
+
+    if (max_packets > DMP_BURST_MAX_BYTES / dmp.packet_length)
+        max_packets = DMP_BURST_MAX_BYTES / dmp.packet_length;
+
+    result = mpu_read_fifo_stream_burst(dmp.packet_length, max_packets,
+        fifo_data, more);
+    if (result == -2) {
+        overflow[0] = 1;
+        return 0;
+    }
+    if (result <= 0)
+        return result;
+
+    count = (unsigned char)result;
+    for (ii = 0; ii < count; ii++) {
+        struct dmp_packet *packet = &packets[ii];
+        if (parse_packet(fifo_data + ii * dmp.packet_length, packet->gyro,
+                packet->accel, packet->quat, &packet->sensors)) {
+            mpu_reset_fifo();
+            more[0] = 0;
+            if (!ii)
+                return -1;
+            break;
+        }
+    }
+
+    return ii;
+}
+
 /**
  *  @brief      Register a function to be executed on a tap event.
  *  The tap direction is represented by one of the following:
@@ -0,0 +1,73 @@
+/*
+   Host build stand-in for the ESP8266 SDK espconn.h
+   Copyright (C) 2016  Ivo Herzig
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __ESPCONN_H__
+#define __ESPCONN_H__
+
+#include "c_types.h"
+
+#define ESPCONN_OK 0
+#define ESPCONN_MEM -1
+#define ESPCONN_ARG -12
+#define ESPCONN_IF -14
+
+enum espconn_type {
+	ESPCONN_INVALID = 0,
+	ESPCONN_TCP = 0x10,
+	ESPCONN_UDP = 0x20,
+};
+
+enum espconn_state {
+	ESPCONN_NONE,
+	ESPCONN_WAIT,
+	ESPCONN_LISTEN,
+	ESPCONN_CONNECT,
+	ESPCONN_WRITE,
+	ESPCONN_READ,
+	ESPCONN_CLOSE
+};
+
+typedef struct _esp_udp {
+	int remote_port;
+	int local_port;
+	uint8 local_ip[4];
+	uint8 remote_ip[4];
+} esp_udp;
+
+typedef void (*espconn_recv_callback)(void *arg, char *pdata,
+		unsigned short len);
+typedef void (*espconn_sent_callback)(void *arg);
+
+struct espconn {
+	enum espconn_type type;
+	enum espconn_state state;
+	union {
+		void *tcp;
+		esp_udp *udp;
+	} proto;
+	espconn_recv_callback recv_callback;
+	espconn_sent_callback sent_callback;
+	uint8 link_cnt;
+	void *reverse;
+};
+
+sint8 espconn_create(struct espconn *espconn);
+sint8 espconn_delete(struct espconn *espconn);
+sint8 espconn_sendto(struct espconn *espconn, uint8 *psent, uint16 length);
+
+#endif
@@ -0,0 +1,50 @@
+/*
+   Host build stand-in for the ESP8266 SDK ets_sys.h
+   Copyright (C) 2016  Ivo Herzig
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _ETS_SYS_H
+#define _ETS_SYS_H
+
+#include "c_types.h"
+
+typedef uint32 ETSSignal;
+typedef uint32 ETSParam;
+
+typedef struct ETSEventTag {
+	ETSSignal sig;
+	ETSParam par;
+} ETSEvent;
+
+typedef void (*ETSTask)(ETSEvent *e);
+
+typedef void ETSTimerFunc(void *timer_arg);
+
+// timer_expire is the virtual system time in us, see sim_sdk.c
+typedef struct _ETSTIMER_ {
+	struct _ETSTIMER_ *timer_next;
+	uint32 timer_expire;
+	uint32 timer_period;
+	ETSTimerFunc *timer_func;
+	void *timer_arg;
+} ETSTimer;
+
+// the only interrupt source of the simulation is the gpio block
+void sim_gpio_intr_enable(bool enable);
+#define ETS_GPIO_INTR_ENABLE() sim_gpio_intr_enable(true)
+#define ETS_GPIO_INTR_DISABLE() sim_gpio_intr_enable(false)
+
+#endif
@@ -0,0 +1,86 @@
+/*
+   Host build stand-in for the ESP8266 SDK gpio.h
+   Copyright (C) 2016  Ivo Herzig
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _GPIO_H_
+#define _GPIO_H_
+
+#include "c_types.h"
+#include "ets_sys.h"
+
+// register offsets of the gpio block
+#define GPIO_OUT_ADDRESS 0x00
+#define GPIO_OUT_W1TS_ADDRESS 0x04
+#define GPIO_OUT_W1TC_ADDRESS 0x08
+#define GPIO_ENABLE_ADDRESS 0x0c
+#define GPIO_ENABLE_W1TS_ADDRESS 0x10
+#define GPIO_ENABLE_W1TC_ADDRESS 0x14
+#define GPIO_IN_ADDRESS 0x18
+#define GPIO_STATUS_ADDRESS 0x1c
+#define GPIO_STATUS_W1TS_ADDRESS 0x20
+#define GPIO_STATUS_W1TC_ADDRESS 0x24
+#define GPIO_PIN_COUNT 16
+#define GPIO_PIN_ADDR(i) (0x28 + (i) * 4)
+
+#define GPIO_PAD_DRIVER_ENABLE 1
+#define GPIO_PIN_PAD_DRIVER_SET(x) (((x) & 1) << 2)
+
+#define GPIO_ID_PIN(n) (n)
+
+// accesses go to the simulated gpio block, see sim_sdk.c
+uint32 gpio_reg_read(uint32 reg);
+void gpio_reg_write(uint32 reg, uint32 val);
+#define GPIO_REG_READ(reg) gpio_reg_read(reg)
+#define GPIO_REG_WRITE(reg, val) gpio_reg_write(reg, val)
+
+#define GPIO_OUTPUT_SET(gpio_no, bit_value) \
+	gpio_output_set((bit_value) << (gpio_no), ((~(bit_value)) & 0x01) << (gpio_no), \
+			1 << (gpio_no), 0)
+#define GPIO_DIS_OUTPUT(gpio_no) gpio_output_set(0, 0, 0, 1 << (gpio_no))
+#define GPIO_INPUT_GET(gpio_no) ((gpio_input_get() >> (gpio_no)) & BIT0)
+
+// the pin mux has no function in the simulation
+#define PERIPHS_IO_MUX_MTMS_U 0
+#define PERIPHS_IO_MUX_GPIO4_U 1
+#define PERIPHS_IO_MUX_GPIO5_U 2
+#define FUNC_GPIO4 0
+#define FUNC_GPIO5 0
+#define FUNC_GPIO14 3
+#define PIN_FUNC_SELECT(mux, func) ((void)(mux), (void)(func))
+#define PIN_PULLUP_EN(mux) ((void)(mux))
+#define PIN_PULLUP_DIS(mux) ((void)(mux))
+
+typedef enum {
+	GPIO_PIN_INTR_DISABLE = 0,
+	GPIO_PIN_INTR_POSEDGE = 1,
+	GPIO_PIN_INTR_NEGEDGE = 2,
+	GPIO_PIN_INTR_ANYEDGE = 3,
+	GPIO_PIN_INTR_LOLEVEL = 4,
+	GPIO_PIN_INTR_HILEVEL = 5
+} GPIO_INT_TYPE;
+
+typedef void (*gpio_intr_handler_fn_t)(uint32 intr_mask, void *arg);
+
+void gpio_init(void);
+void gpio_output_set(uint32 set_mask, uint32 clear_mask, uint32 enable_mask,
+		uint32 disable_mask);
+uint32 gpio_input_get(void);
+void gpio_pin_intr_state_set(uint32 i, GPIO_INT_TYPE intr_state);
+void gpio_intr_handler_register(gpio_intr_handler_fn_t fn, void *arg);
+void gpio_intr_ack(uint32 ack_mask);
+
+#endif
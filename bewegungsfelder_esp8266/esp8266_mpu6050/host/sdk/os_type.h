@@ -0,0 +1,31 @@
+/*
+   Host build stand-in for the ESP8266 SDK os_type.h
+   Copyright (C) 2016  Ivo Herzig
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _OS_TYPES_H_
+#define _OS_TYPES_H_
+
+#include "ets_sys.h"
+
+#define os_signal_t ETSSignal
+#define os_param_t ETSParam
+#define os_event_t ETSEvent
+#define os_task_t ETSTask
+#define os_timer_t ETSTimer
+#define os_timer_func_t ETSTimerFunc
+
+#endif
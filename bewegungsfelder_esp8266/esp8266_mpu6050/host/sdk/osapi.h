@@ -0,0 +1,43 @@
+/*
+   Host build stand-in for the ESP8266 SDK osapi.h
+   Copyright (C) 2016  Ivo Herzig
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef _OSAPI_H_
+#define _OSAPI_H_
+
+#include <stdio.h>
+#include <string.h>
+#include "os_type.h"
+
+#define os_memcmp memcmp
+#define os_memcpy memcpy
+#define os_memset memset
+#define os_strlen strlen
+#define os_sprintf sprintf
+#define os_printf ets_uart_printf
+
+int ets_uart_printf(const char *fmt, ...);
+
+// busy waits, advances the virtual clock
+void os_delay_us(uint32 us);
+
+void os_timer_setfn(os_timer_t *ptimer, os_timer_func_t *pfunction,
+		void *parg);
+void os_timer_arm(os_timer_t *ptimer, uint32 milliseconds, bool repeat_flag);
+void os_timer_disarm(os_timer_t *ptimer);
+
+#endif
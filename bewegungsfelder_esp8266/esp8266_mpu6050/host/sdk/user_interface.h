@@ -0,0 +1,100 @@
+/*
+   Host build stand-in for the ESP8266 SDK user_interface.h
+   Copyright (C) 2016  Ivo Herzig
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef __USER_INTERFACE_H__
+#define __USER_INTERFACE_H__
+
+#include "os_type.h"
+
+struct ip_addr {
+	uint32 addr;
+};
+
+struct ip_info {
+	struct ip_addr ip;
+	struct ip_addr netmask;
+	struct ip_addr gw;
+};
+
+struct station_config {
+	uint8 ssid[32];
+	uint8 password[64];
+	uint8 bssid_set;
+	uint8 bssid[6];
+};
+
+#define STATION_IF 0x00
+#define SOFTAP_IF 0x01
+
+#define NULL_MODE 0x00
+#define STATION_MODE 0x01
+#define SOFTAP_MODE 0x02
+#define STATIONAP_MODE 0x03
+
+enum {
+	USER_TASK_PRIO_0 = 0,
+	USER_TASK_PRIO_1,
+	USER_TASK_PRIO_2,
+	USER_TASK_PRIO_MAX
+};
+
+enum {
+	EVENT_STAMODE_CONNECTED = 0,
+	EVENT_STAMODE_DISCONNECTED,
+	EVENT_STAMODE_AUTHMODE_CHANGE,
+	EVENT_STAMODE_GOT_IP,
+	EVENT_STAMODE_DHCP_TIMEOUT,
+	EVENT_SOFTAPMODE_STACONNECTED,
+	EVENT_SOFTAPMODE_STADISCONNECTED,
+	EVENT_MAX
+};
+
+// the simulation only delivers the event id, no event_info
+typedef struct _esp_event {
+	uint32 event;
+} System_Event_t;
+
+typedef void (*wifi_event_handler_cb_t)(System_Event_t *event);
+typedef void (*init_done_cb_t)(void);
+
+uint32 system_get_time(void);
+uint8 system_get_cpu_freq(void);
+void system_init_done_cb(init_done_cb_t cb);
+void system_soft_wdt_stop(void);
+void system_soft_wdt_restart(void);
+void system_soft_wdt_feed(void);
+uint16 readvdd33(void);
+
+bool system_os_task(os_task_t task, uint8 prio, os_event_t *queue,
+		uint8 qlen);
+bool system_os_post(uint8 prio, os_signal_t sig, os_param_t par);
+
+bool wifi_set_opmode(uint8 opmode);
+bool wifi_station_get_config(struct station_config *config);
+bool wifi_station_set_config(struct station_config *config);
+bool wifi_station_connect(void);
+bool wifi_station_disconnect(void);
+bool wifi_station_dhcpc_start(void);
+bool wifi_station_dhcpc_stop(void);
+bool wifi_station_set_auto_connect(uint8 set);
+bool wifi_set_ip_info(uint8 if_index, struct ip_info *info);
+void wifi_set_event_handler_cb(wifi_event_handler_cb_t cb);
+
+uint32 ipaddr_addr(const char *cp);
+
+#endif
@@ -0,0 +1,80 @@
+/*
+   Host simulation of the sensor firmware
+   Copyright (C) 2016  Ivo Herzig
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+/*
+ * the host build runs user_main.c and the i2c, mpu and dmp drivers unchanged
+ * against a simulated sdk (sim_sdk.c), an open drain i2c bus (sim_i2c.c) and
+ * an mpu6050 register/dmp fifo model (sim_mpu6050.c). udp datagrams are sent
+ * to a real socket, so the desktop server can receive them.
+ *
+ * time is virtual: a 64 bit cpu cycle counter advances with every ccount
+ * read, gpio access and os_delay_us. the firmware code between those calls
+ * is free, so the measured durations are the bus and wait times the chip
+ * would see, not the instruction count of the host.
+ */
+
+#ifndef SIM_H
+#define SIM_H
+
+#include <c_types.h>
+
+#define SIM_CPU_MHZ 80
+
+// gpio pin of the mpu interrupt line, wired as in user_main.c
+#define SIM_MPU_INT_PIN 14
+
+// virtual clock (sim_sdk.c)
+extern uint64 sim_cycles;
+static inline uint64 sim_time_us(void) {
+	return sim_cycles / SIM_CPU_MHZ;
+}
+
+// sets the level of an input pin, raises the gpio interrupt on a matching edge
+void sim_gpio_input(int pin, int level);
+
+// runs the sdk event loop until the virtual time reaches end_us
+struct sim_options {
+	const char *server_host; // datagrams go here instead of the firmware's server ip
+	int server_port;         // 0: the port the firmware uses
+	int realtime;            // pace the virtual clock to the wall clock
+	int quiet;               // hide the firmware uart output
+	uint32 sendto_us;        // modelled cost of espconn_sendto
+};
+void sim_sdk_init(const struct sim_options *options);
+void sim_sdk_run(uint64 end_us);
+void sim_sdk_report(void);
+
+// i2c bus (sim_i2c.c). returns the levels of SDA/SCL for the given master outputs
+uint32 sim_i2c_lines(uint32 master_out);
+void sim_i2c_report(void);
+
+// i2c slave side of the mpu6050 model (sim_mpu6050.c)
+#define SIM_MPU_ADDRESS 0x68
+void sim_mpu6050_init(void);
+void sim_mpu6050_start(int read);
+int sim_mpu6050_write(uint8 data); // returns 1 for ack
+uint8 sim_mpu6050_read(void);
+void sim_mpu6050_stop(void);
+
+// produces dmp packets and interrupt pulses that are due at the current time
+void sim_mpu6050_update(void);
+// virtual time of the next sample or interrupt edge, in us
+uint64 sim_mpu6050_next_event(void);
+void sim_mpu6050_report(void);
+
+#endif
@@ -0,0 +1,274 @@
+/*
+   Simulated open drain i2c bus with a timing checker
+   Copyright (C) 2016  Ivo Herzig
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+
+#include <i2c.h>
+
+#include "sim.h"
+
+#define SDA I2C_SDA_MASK
+#define SCL I2C_SCK_MASK
+
+/*
+ * minimum times of the i2c specification (UM10204, table 10) in ns for the
+ * mode selected with I2C_SPEED. the driver has to meet these on the bus.
+ */
+#if I2C_SPEED == I2C_SPEED_100K
+#define SPEC_LOW_NS 4700
+#define SPEC_HIGH_NS 4000
+#define SPEC_HD_STA_NS 4000
+#define SPEC_SU_STA_NS 4700
+#define SPEC_SU_STO_NS 4000
+#define SPEC_BUF_NS 4700
+#elif I2C_SPEED == I2C_SPEED_400K
+#define SPEC_LOW_NS 1300
+#define SPEC_HIGH_NS 600
+#define SPEC_HD_STA_NS 600
+#define SPEC_SU_STA_NS 600
+#define SPEC_SU_STO_NS 600
+#define SPEC_BUF_NS 1300
+#else
+#define SPEC_LOW_NS 500
+#define SPEC_HIGH_NS 260
+#define SPEC_HD_STA_NS 260
+#define SPEC_SU_STA_NS 260
+#define SPEC_SU_STO_NS 260
+#define SPEC_BUF_NS 500
+#endif
+
+enum timing {
+	T_LOW, T_HIGH, T_HD_STA, T_SU_STA, T_SU_STO, T_BUF, T_COUNT
+};
+
+static const char *timing_names[T_COUNT] = {
+	"tLOW", "tHIGH", "tHD;STA", "tSU;STA", "tSU;STO", "tBUF"
+};
+
+static const uint32 timing_spec_ns[T_COUNT] = {
+	SPEC_LOW_NS, SPEC_HIGH_NS, SPEC_HD_STA_NS, SPEC_SU_STA_NS, SPEC_SU_STO_NS, SPEC_BUF_NS
+};
+
+static uint64 timing_min[T_COUNT];
+static uint32 timing_violations[T_COUNT];
+
+enum bus_state {
+	BUS_IDLE,    // between a stop and the next start
+	BUS_ADDRESS, // receiving the address byte
+	BUS_WRITE,   // master writes to the mpu
+	BUS_READ,    // mpu sends to the master
+	BUS_IGNORE   // not addressed or nacked, wait for the next start/stop
+};
+
+static enum bus_state state = BUS_IDLE;
+static int last_scl = 1;
+static int last_sda = 1;
+static uint64 last_scl_fall;
+static uint64 last_scl_rise;
+static uint64 last_start;
+static uint64 last_start_condition;
+static uint64 last_stop;
+
+// slave side of the current byte
+static uint8 shift;
+static int bits;
+static int ack_phase;
+static int master_nack;
+static int slave_sda = 1;
+static int addressed;
+
+// statistics
+static uint32 transactions;
+static uint32 nacks;
+static uint32 bytes_written;
+static uint32 bytes_read;
+static uint64 busy_cycles;
+
+static void check_timing(enum timing t, uint64 since) {
+	uint64 ns = (sim_cycles - since) * 1000 / SIM_CPU_MHZ;
+
+	if (!timing_min[t] || ns < timing_min[t])
+		timing_min[t] = ns;
+	if (ns < timing_spec_ns[t])
+		++timing_violations[t];
+}
+
+static void load_read_byte(void) {
+	shift = sim_mpu6050_read();
+	bits = 0;
+	slave_sda = shift >> 7;
+	++bytes_read;
+}
+
+static void on_start(void) {
+	if (state == BUS_IDLE) {
+		if (last_stop)
+			check_timing(T_BUF, last_stop);
+		last_start = sim_cycles;
+		++transactions;
+	} else {
+		check_timing(T_SU_STA, last_scl_rise);
+	}
+	last_start_condition = sim_cycles;
+
+	// the mpu model catches up with the time that passed since the last transfer
+	sim_mpu6050_update();
+
+	state = BUS_ADDRESS;
+	shift = 0;
+	bits = 0;
+	ack_phase = 0;
+	slave_sda = 1;
+}
+
+static void on_stop(void) {
+	if (state == BUS_IDLE)
+		return;
+
+	check_timing(T_SU_STO, last_scl_rise);
+	busy_cycles += sim_cycles - last_start;
+	last_stop = sim_cycles;
+
+	if (addressed)
+		sim_mpu6050_stop();
+	addressed = 0;
+	state = BUS_IDLE;
+	slave_sda = 1;
+}
+
+static void on_scl_rise(int sda) {
+	if (state == BUS_IDLE || state == BUS_IGNORE)
+		return;
+
+	if (ack_phase) {
+		if (state == BUS_READ)
+			master_nack = sda;
+		return;
+	}
+
+	if (state != BUS_READ) {
+		shift = (shift << 1) | sda;
+		++bits;
+	}
+}
+
+static void on_scl_fall(void) {
+	int ack;
+
+	if (state == BUS_IDLE || state == BUS_IGNORE)
+		return;
+
+	if (ack_phase) {
+		ack_phase = 0;
+		slave_sda = 1;
+
+		if (state != BUS_READ) {
+			shift = 0;
+			bits = 0;
+		} else if (master_nack) {
+			state = BUS_IGNORE;
+		} else {
+			load_read_byte();
+		}
+		return;
+	}
+
+	if (state == BUS_READ) {
+		if (++bits < 8) {
+			slave_sda = (shift >> (7 - bits)) & 1;
+		} else {
+			// release SDA for the ack of the master
+			slave_sda = 1;
+			ack_phase = 1;
+		}
+		return;
+	}
+
+	if (bits < 8)
+		return;
+
+	if (state == BUS_ADDRESS) {
+		ack = (shift >> 1) == SIM_MPU_ADDRESS;
+		if (ack) {
+			addressed = 1;
+			master_nack = 0;
+			state = (shift & 1) ? BUS_READ : BUS_WRITE;
+			sim_mpu6050_start(shift & 1);
+		}
+	} else {
+		ack = sim_mpu6050_write(shift);
+		++bytes_written;
+	}
+
+	if (ack) {
+		slave_sda = 0;
+		ack_phase = 1;
+	} else {
+		++nacks;
+		state = BUS_IGNORE;
+	}
+}
+
+uint32 sim_i2c_lines(uint32 master_out) {
+	// the mpu never stretches the clock, only the master drives SCL
+	int scl = (master_out & SCL) != 0;
+	int sda = (master_out & SDA) && slave_sda;
+
+	if (scl != last_scl) {
+		if (scl) {
+			if (state != BUS_IDLE)
+				check_timing(T_LOW, last_scl_fall);
+			last_scl_rise = sim_cycles;
+			on_scl_rise(sda);
+		} else {
+			if (state != BUS_IDLE) {
+				check_timing(T_HIGH, last_scl_rise);
+				if (state == BUS_ADDRESS && bits == 0)
+					check_timing(T_HD_STA, last_start_condition);
+			}
+			last_scl_fall = sim_cycles;
+			on_scl_fall();
+		}
+		last_scl = scl;
+
+		// the slave changes SDA while SCL is low
+		sda = (master_out & SDA) && slave_sda;
+	} else if (scl && sda != last_sda) {
+		if (!sda)
+			on_start();
+		else
+			on_stop();
+	}
+
+	last_sda = sda;
+	return (scl ? SCL : 0) | (sda ? SDA : 0);
+}
+
+void sim_i2c_report(void) {
+	int t;
+
+	fprintf(stderr, "sim: i2c: %u transactions, %u bytes written, %u read, %u nacks, "
+			"bus busy %.1f ms\n", transactions, bytes_written, bytes_read, nacks,
+			busy_cycles / (SIM_CPU_MHZ * 1000.0));
+
+	for (t = 0; t < T_COUNT; ++t) {
+		fprintf(stderr, "sim: i2c: %-8s min %5llu ns, spec %4u ns, %u violations\n",
+				timing_names[t], (unsigned long long) timing_min[t],
+				timing_spec_ns[t], timing_violations[t]);
+	}
+}
@@ -0,0 +1,80 @@
+/*
+   Runs the sensor firmware on the host
+   Copyright (C) 2016  Ivo Herzig
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <unistd.h>
+
+#include "sim.h"
+
+void user_init(void);
+
+static void usage(const char *name) {
+	fprintf(stderr,
+			"usage: %s [-t seconds] [-r] [-q] [-h host] [-p port] [-s us]\n"
+			"  -t  virtual run time, default 10 s\n"
+			"  -r  run in real time instead of as fast as possible\n"
+			"  -q  hide the firmware uart output\n"
+			"  -h  host the datagrams are sent to, default 127.0.0.1\n"
+			"  -p  udp port, default: the port of the firmware\n"
+			"  -s  time espconn_sendto takes in us, default 0\n", name);
+	exit(2);
+}
+
+int main(int argc, char **argv) {
+	struct sim_options options = { "127.0.0.1", 0, 0, 0, 0 };
+	double seconds = 10;
+	int opt;
+
+	while ((opt = getopt(argc, argv, "t:rqh:p:s:")) != -1) {
+		switch (opt) {
+		case 't':
+			seconds = atof(optarg);
+			break;
+		case 'r':
+			options.realtime = 1;
+			break;
+		case 'q':
+			options.quiet = 1;
+			break;
+		case 'h':
+			options.server_host = optarg;
+			break;
+		case 'p':
+			options.server_port = atoi(optarg);
+			break;
+		case 's':
+			options.sendto_us = atoi(optarg);
+			break;
+		default:
+			usage(argv[0]);
+		}
+	}
+
+	sim_sdk_init(&options);
+	sim_mpu6050_init();
+
+	user_init();
+	sim_sdk_run((uint64) (seconds * 1e6));
+
+	fflush(stdout);
+	sim_sdk_report();
+	sim_mpu6050_report();
+	sim_i2c_report();
+	return 0;
+}
@@ -0,0 +1,389 @@
+/*
+   MPU6050 register, dmp memory and fifo model with synthetic motion
+   Copyright (C) 2016  Ivo Herzig
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <math.h>
+
+#include "sim.h"
+
+// registers used by inv_mpu.c
+#define REG_GYRO_CONFIG 0x1B
+#define REG_ACCEL_CONFIG 0x1C
+#define REG_INT_PIN_CFG 0x37
+#define REG_INT_ENABLE 0x38
+#define REG_DMP_INT_STATUS 0x39
+#define REG_INT_STATUS 0x3A
+#define REG_ACCEL_XOUT_H 0x3B
+#define REG_GYRO_XOUT_H 0x43
+#define REG_USER_CTRL 0x6A
+#define REG_PWR_MGMT_1 0x6B
+#define REG_BANK_SEL 0x6D
+#define REG_MEM_START_ADDR 0x6E
+#define REG_MEM_R_W 0x6F
+#define REG_FIFO_COUNT_H 0x72
+#define REG_FIFO_COUNT_L 0x73
+#define REG_FIFO_R_W 0x74
+#define REG_WHO_AM_I 0x75
+#define REG_COUNT 0x80
+
+#define BIT_ACTL 0x80
+#define BIT_DMP_INT 0x02
+#define BIT_FIFO_OVERFLOW 0x10
+#define BIT_DMP_EN 0x80
+#define BIT_FIFO_EN 0x40
+#define BIT_DMP_RST 0x08
+#define BIT_FIFO_RST 0x04
+#define BIT_SIG_COND_RST 0x01
+#define BIT_RESET 0x80
+#define BIT_SLEEP 0x40
+
+#define FIFO_SIZE 1024
+#define DMP_MEM_SIZE 4096
+
+// the dmp runs at 200Hz and writes every (div + 1)th result to the fifo
+#define DMP_SAMPLE_RATE 200
+
+// length of the interrupt pulse when the interrupt isn't latched
+#define INT_PULSE_US 50
+
+/*
+ * dmp memory locations of the fifo rate divider and of the code fragments
+ * that select the packet contents. written by inv_mpu_dmp_motion_driver.c
+ * (D_0_22, CFG_LP_QUAT, CFG_8, CFG_15, CFG_27), the model reads them back
+ * to produce the packets the firmware asked for.
+ */
+#define DMP_FIFO_RATE_DIV 534
+#define DMP_CFG_LP_QUAT 2712
+#define DMP_CFG_6X_LP_QUAT 2718
+#define DMP_CFG_SEND 2727
+#define DMP_CFG_GESTURE 2742
+
+#define NEVER UINT64_MAX
+
+static uint8 regs[REG_COUNT];
+static uint8 dmp_mem[DMP_MEM_SIZE];
+
+static uint8 fifo[FIFO_SIZE];
+static uint16 fifo_head;
+static uint16 fifo_count;
+
+// register pointer of the current transfer
+static uint8 reg_addr;
+static int reg_addr_set;
+
+static uint64 next_sample_us = NEVER;
+static uint64 int_release_us = NEVER;
+static int int_asserted;
+
+// statistics
+static uint32 samples;
+static uint32 overflows;
+static uint32 fifo_resets;
+static uint16 fifo_max;
+static int packet_length;
+
+static void update_int_pin(void) {
+	int active_low = (regs[REG_INT_PIN_CFG] & BIT_ACTL) != 0;
+	sim_gpio_input(SIM_MPU_INT_PIN, int_asserted != active_low);
+}
+
+static void reset(void) {
+	memset(regs, 0, sizeof(regs));
+	regs[REG_PWR_MGMT_1] = BIT_SLEEP;
+	regs[REG_WHO_AM_I] = SIM_MPU_ADDRESS;
+
+	fifo_head = 0;
+	fifo_count = 0;
+	next_sample_us = NEVER;
+	int_release_us = NEVER;
+	int_asserted = 0;
+	update_int_pin();
+}
+
+void sim_mpu6050_init(void) {
+	memset(dmp_mem, 0, sizeof(dmp_mem));
+	reset();
+}
+
+static int dmp_running(void) {
+	return (regs[REG_USER_CTRL] & (BIT_DMP_EN | BIT_FIFO_EN)) == (BIT_DMP_EN | BIT_FIFO_EN)
+			&& !(regs[REG_PWR_MGMT_1] & BIT_SLEEP);
+}
+
+static uint64 sample_period_us(void) {
+	uint32 div = (dmp_mem[DMP_FIFO_RATE_DIV] << 8) | dmp_mem[DMP_FIFO_RATE_DIV + 1];
+	return 1000000ULL * (div + 1) / DMP_SAMPLE_RATE;
+}
+
+static void fifo_push(const uint8 *data, int length) {
+	int i;
+
+	for (i = 0; i < length; ++i) {
+		if (fifo_count == FIFO_SIZE) {
+			// the oldest byte is lost, the fifo is misaligned from now on
+			fifo_head = (fifo_head + 1) % FIFO_SIZE;
+			--fifo_count;
+			regs[REG_INT_STATUS] |= BIT_FIFO_OVERFLOW;
+			if (i == 0)
+				++overflows;
+		}
+		fifo[(fifo_head + fifo_count++) % FIFO_SIZE] = data[i];
+	}
+
+	if (fifo_count > fifo_max)
+		fifo_max = fifo_count;
+}
+
+static uint8 fifo_pop(void) {
+	uint8 data;
+
+	if (!fifo_count)
+		return 0;
+
+	data = fifo[fifo_head];
+	fifo_head = (fifo_head + 1) % FIFO_SIZE;
+	--fifo_count;
+	return data;
+}
+
+static uint8 *put16(uint8 *p, int value) {
+	if (value > 32767)
+		value = 32767;
+	if (value < -32768)
+		value = -32768;
+	*p++ = (uint8) (value >> 8);
+	*p++ = (uint8) value;
+	return p;
+}
+
+static uint8 *put32(uint8 *p, sint32 value) {
+	*p++ = (uint8) (value >> 24);
+	*p++ = (uint8) (value >> 16);
+	*p++ = (uint8) (value >> 8);
+	*p++ = (uint8) value;
+	return p;
+}
+
+/*
+ * synthetic motion: the sensor swings back and forth around a tilted axis.
+ * the dmp quaternion rotates from the sensor to the world frame, gravity
+ * points along the world z axis.
+ */
+#define MOTION_AMPLITUDE_DPS 180.0
+#define MOTION_FREQUENCY_HZ 0.25
+
+static void motion(double t, double q[4], double gyro_dps[3], double accel_g[3]) {
+	static const double axis[3] = { 0.267261, 0.534522, 0.801784 }; // (1, 2, 3) normalised
+	double w = 2 * M_PI * MOTION_FREQUENCY_HZ;
+	double rate = MOTION_AMPLITUDE_DPS * sin(w * t);
+	double angle = MOTION_AMPLITUDE_DPS * M_PI / 180 * (1 - cos(w * t)) / w;
+	double s = sin(angle / 2);
+	int i;
+
+	q[0] = cos(angle / 2);
+	for (i = 0; i < 3; ++i) {
+		q[i + 1] = axis[i] * s;
+		gyro_dps[i] = axis[i] * rate;
+	}
+
+	// third row of the rotation matrix: world z in sensor coordinates
+	accel_g[0] = 2 * (q[1] * q[3] - q[0] * q[2]);
+	accel_g[1] = 2 * (q[2] * q[3] + q[0] * q[1]);
+	accel_g[2] = 1 - 2 * (q[1] * q[1] + q[2] * q[2]);
+}
+
+static void produce_sample(uint64 t_us) {
+	uint8 packet[32];
+	uint8 *p = packet;
+	double q[4], gyro_dps[3], accel_g[3];
+	double gyro_lsb = 131.0 / (1 << ((regs[REG_GYRO_CONFIG] >> 3) & 3));
+	double accel_lsb = 16384.0 / (1 << ((regs[REG_ACCEL_CONFIG] >> 3) & 3));
+	uint8 accel_raw[6], gyro_raw[6];
+	int i;
+
+	motion(t_us / 1e6, q, gyro_dps, accel_g);
+
+	for (i = 0; i < 3; ++i) {
+		put16(accel_raw + 2 * i, (int) lround(accel_g[i] * accel_lsb));
+		put16(gyro_raw + 2 * i, (int) lround(gyro_dps[i] * gyro_lsb));
+	}
+	memcpy(regs + REG_ACCEL_XOUT_H, accel_raw, sizeof(accel_raw));
+	memcpy(regs + REG_GYRO_XOUT_H, gyro_raw, sizeof(gyro_raw));
+
+	// same order as the dmp: quaternion, accel, gyro, gesture
+	if (dmp_mem[DMP_CFG_LP_QUAT] == 0xC0 || dmp_mem[DMP_CFG_6X_LP_QUAT] == 0x20) {
+		for (i = 0; i < 4; ++i) {
+			double v = q[i] * (1 << 30);
+			p = put32(p, v >= 2147483647.0 ? 2147483647 : (sint32) lround(v));
+		}
+	}
+	if (dmp_mem[DMP_CFG_SEND + 1] == 0xC0) {
+		memcpy(p, accel_raw, sizeof(accel_raw));
+		p += sizeof(accel_raw);
+	}
+	if (dmp_mem[DMP_CFG_SEND + 4] == 0xC4) {
+		memcpy(p, gyro_raw, sizeof(gyro_raw));
+		p += sizeof(gyro_raw);
+	}
+	if (dmp_mem[DMP_CFG_GESTURE] == 0x20) {
+		// no tap or orientation events
+		memset(p, 0, 4);
+		p += 4;
+	}
+
+	packet_length = p - packet;
+	fifo_push(packet, packet_length);
+	++samples;
+
+	if (regs[REG_INT_ENABLE] & BIT_DMP_INT) {
+		regs[REG_INT_STATUS] |= BIT_DMP_INT;
+		int_asserted = 1;
+		int_release_us = t_us + INT_PULSE_US;
+		update_int_pin();
+	}
+}
+
+void sim_mpu6050_update(void) {
+	uint64 now = sim_time_us();
+
+	// process the events in order, the interrupt pin sees every pulse
+	for (;;) {
+		if (int_asserted && int_release_us <= now && int_release_us <= next_sample_us) {
+			int_asserted = 0;
+			int_release_us = NEVER;
+			update_int_pin();
+		} else if (dmp_running() && next_sample_us <= now) {
+			produce_sample(next_sample_us);
+			next_sample_us += sample_period_us();
+		} else {
+			break;
+		}
+	}
+}
+
+uint64 sim_mpu6050_next_event(void) {
+	uint64 next = dmp_running() ? next_sample_us : NEVER;
+	return int_release_us < next ? int_release_us : next;
+}
+
+static uint16 mem_address(void) {
+	return ((regs[REG_BANK_SEL] << 8) | regs[REG_MEM_START_ADDR]) % DMP_MEM_SIZE;
+}
+
+static void write_reg(uint8 reg, uint8 value) {
+	switch (reg) {
+	case REG_PWR_MGMT_1:
+		if (value & BIT_RESET) {
+			reset();
+			return;
+		}
+		break;
+	case REG_USER_CTRL:
+		if (value & BIT_FIFO_RST) {
+			fifo_head = 0;
+			fifo_count = 0;
+			++fifo_resets;
+		}
+		// the dmp starts a new sample period when it is (re)started
+		if ((value & BIT_DMP_RST) || ((value & BIT_DMP_EN) && !(regs[reg] & BIT_DMP_EN)))
+			next_sample_us = sim_time_us() + sample_period_us();
+		value &= ~(BIT_DMP_RST | BIT_FIFO_RST | BIT_SIG_COND_RST);
+		break;
+	case REG_INT_PIN_CFG:
+		regs[reg] = value;
+		update_int_pin();
+		return;
+	case REG_MEM_R_W:
+		dmp_mem[mem_address()] = value;
+		++regs[REG_MEM_START_ADDR];
+		return;
+	case REG_INT_STATUS:
+	case REG_DMP_INT_STATUS:
+	case REG_FIFO_COUNT_H:
+	case REG_FIFO_COUNT_L:
+	case REG_FIFO_R_W:
+	case REG_WHO_AM_I:
+		// read only
+		return;
+	}
+
+	regs[reg] = value;
+}
+
+static uint8 read_reg(uint8 reg) {
+	uint8 value;
+
+	switch (reg) {
+	case REG_INT_STATUS:
+		// cleared by reading
+		value = regs[reg];
+		regs[reg] = 0;
+		return value;
+	case REG_FIFO_COUNT_H:
+		return fifo_count >> 8;
+	case REG_FIFO_COUNT_L:
+		return fifo_count & 0xFF;
+	case REG_FIFO_R_W:
+		return fifo_pop();
+	case REG_MEM_R_W:
+		value = dmp_mem[mem_address()];
+		++regs[REG_MEM_START_ADDR];
+		return value;
+	}
+
+	return regs[reg];
+}
+
+// bursts to the memory and fifo ports stay on the port
+static void next_reg(void) {
+	if (reg_addr != REG_MEM_R_W && reg_addr != REG_FIFO_R_W)
+		reg_addr = (reg_addr + 1) % REG_COUNT;
+}
+
+void sim_mpu6050_start(int read) {
+	if (!read)
+		reg_addr_set = 0;
+}
+
+int sim_mpu6050_write(uint8 data) {
+	if (!reg_addr_set) {
+		reg_addr = data % REG_COUNT;
+		reg_addr_set = 1;
+		return 1;
+	}
+
+	write_reg(reg_addr, data);
+	next_reg();
+	return 1;
+}
+
+uint8 sim_mpu6050_read(void) {
+	uint8 value = read_reg(reg_addr);
+	next_reg();
+	return value;
+}
+
+void sim_mpu6050_stop(void) {
+}
+
+void sim_mpu6050_report(void) {
+	fprintf(stderr, "sim: mpu: %u samples of %d bytes every %.1f ms, %u overflows, "
+			"%u fifo resets, max fill %u bytes\n", samples, packet_length,
+			sample_period_us() / 1000.0, overflows, fifo_resets, fifo_max);
+}
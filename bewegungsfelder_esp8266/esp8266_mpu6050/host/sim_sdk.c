@@ -0,0 +1,666 @@
+/*
+   Simulated ESP8266 sdk: virtual clock, tasks, timers, gpio, wifi and udp
+   Copyright (C) 2016  Ivo Herzig
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdarg.h>
+#include <stdlib.h>
+#include <errno.h>
+#include <time.h>
+#include <sys/socket.h>
+#include <netinet/in.h>
+#include <arpa/inet.h>
+#include <netdb.h>
+
+#include <ets_sys.h>
+#include <osapi.h>
+#include <gpio.h>
+#include <user_interface.h>
+#include <espconn.h>
+#include <uart.h>
+#include <i2c.h>
+#include <ccount.h>
+
+#include "sim.h"
+
+// rough instruction costs in cpu cycles. the bus timing itself comes from
+// the ccount waits of the i2c driver, these only shift the edges a little.
+#define CCOUNT_READ_CYCLES 2
+#define GPIO_ACCESS_CYCLES 4
+
+// time from wifi_station_connect to the got ip event
+#define WIFI_CONNECT_US 500000
+
+#define NEVER UINT64_MAX
+
+uint64 sim_cycles;
+
+static struct sim_options options;
+
+/*
+ * clock
+ */
+uint32 get_ccount(void) {
+	sim_cycles += CCOUNT_READ_CYCLES;
+	return (uint32) sim_cycles;
+}
+
+uint32 system_get_time(void) {
+	return (uint32) sim_time_us();
+}
+
+uint8 system_get_cpu_freq(void) {
+	return SIM_CPU_MHZ;
+}
+
+void os_delay_us(uint32 us) {
+	sim_cycles += (uint64) us * SIM_CPU_MHZ;
+}
+
+/*
+ * uart, system
+ */
+void uart_init(UartBautRate uart0_br, UartBautRate uart1_br) {
+}
+
+int ets_uart_printf(const char *fmt, ...) {
+	va_list args;
+	int n;
+
+	if (options.quiet)
+		return 0;
+
+	va_start(args, fmt);
+	n = vprintf(fmt, args);
+	va_end(args);
+	return n;
+}
+
+void system_soft_wdt_stop(void) {
+}
+
+void system_soft_wdt_restart(void) {
+}
+
+void system_soft_wdt_feed(void) {
+}
+
+uint16 readvdd33(void) {
+	return 3300;
+}
+
+/*
+ * gpio. SDA and SCK are open drain, their levels come from the bus model.
+ * all other pins read the level set with sim_gpio_input.
+ */
+#define I2C_PINS (I2C_SDA_MASK | I2C_SCK_MASK)
+
+static uint32 gpio_out;
+static uint32 gpio_enable;
+static uint32 gpio_status;
+static uint32 gpio_inputs = 0xffff; // pulled up
+static uint32 gpio_pin_regs[GPIO_PIN_COUNT];
+static GPIO_INT_TYPE gpio_intr_type[GPIO_PIN_COUNT];
+static gpio_intr_handler_fn_t gpio_handler;
+static void *gpio_handler_arg;
+static bool gpio_intr_enabled = true;
+static bool in_interrupt;
+static uint32 interrupts;
+
+static uint32 gpio_in(void) {
+	// an enabled output with a 0 pulls the line low, everything else floats
+	uint32 released = ~(gpio_enable & ~gpio_out);
+	return (gpio_inputs & released & ~I2C_PINS)
+			| sim_i2c_lines(released & I2C_PINS);
+}
+
+/*
+ * calls the interrupt handler for pending status bits. interrupts preempt
+ * the running task like on the chip, they just can't nest.
+ */
+static void gpio_dispatch(void) {
+	if (!gpio_status || !gpio_handler || !gpio_intr_enabled || in_interrupt)
+		return;
+
+	in_interrupt = true;
+	++interrupts;
+	gpio_handler(gpio_status, gpio_handler_arg);
+	in_interrupt = false;
+}
+
+static bool gpio_level_triggers(int pin, int level) {
+	switch (gpio_intr_type[pin]) {
+	case GPIO_PIN_INTR_LOLEVEL:
+		return !level;
+	case GPIO_PIN_INTR_HILEVEL:
+		return level;
+	default:
+		return false;
+	}
+}
+
+void sim_gpio_input(int pin, int level) {
+	uint32 mask = BIT(pin);
+	bool trigger;
+
+	if (((gpio_inputs & mask) != 0) == (level != 0))
+		return;
+	gpio_inputs ^= mask;
+
+	switch (gpio_intr_type[pin]) {
+	case GPIO_PIN_INTR_POSEDGE:
+		trigger = level;
+		break;
+	case GPIO_PIN_INTR_NEGEDGE:
+		trigger = !level;
+		break;
+	case GPIO_PIN_INTR_ANYEDGE:
+		trigger = true;
+		break;
+	default:
+		trigger = gpio_level_triggers(pin, level);
+		break;
+	}
+
+	if (trigger) {
+		gpio_status |= mask;
+		gpio_dispatch();
+	}
+}
+
+void sim_gpio_intr_enable(bool enable) {
+	gpio_intr_enabled = enable;
+	gpio_dispatch();
+}
+
+uint32 gpio_reg_read(uint32 reg) {
+	sim_cycles += GPIO_ACCESS_CYCLES;
+
+	switch (reg) {
+	case GPIO_OUT_ADDRESS:
+		return gpio_out;
+	case GPIO_ENABLE_ADDRESS:
+		return gpio_enable;
+	case GPIO_IN_ADDRESS:
+		return gpio_in();
+	case GPIO_STATUS_ADDRESS:
+		return gpio_status;
+	}
+
+	if (reg >= GPIO_PIN_ADDR(0) && reg < GPIO_PIN_ADDR(GPIO_PIN_COUNT))
+		return gpio_pin_regs[(reg - GPIO_PIN_ADDR(0)) / 4];
+	return 0;
+}
+
+void gpio_reg_write(uint32 reg, uint32 val) {
+	sim_cycles += GPIO_ACCESS_CYCLES;
+
+	switch (reg) {
+	case GPIO_OUT_ADDRESS:
+		gpio_out = val;
+		break;
+	case GPIO_OUT_W1TS_ADDRESS:
+		gpio_out |= val;
+		break;
+	case GPIO_OUT_W1TC_ADDRESS:
+		gpio_out &= ~val;
+		break;
+	case GPIO_ENABLE_ADDRESS:
+		gpio_enable = val;
+		break;
+	case GPIO_ENABLE_W1TS_ADDRESS:
+		gpio_enable |= val;
+		break;
+	case GPIO_ENABLE_W1TC_ADDRESS:
+		gpio_enable &= ~val;
+		break;
+	case GPIO_STATUS_W1TS_ADDRESS:
+		gpio_status |= val;
+		break;
+	case GPIO_STATUS_W1TC_ADDRESS:
+		gpio_status &= ~val;
+		break;
+	default:
+		if (reg >= GPIO_PIN_ADDR(0) && reg < GPIO_PIN_ADDR(GPIO_PIN_COUNT))
+			gpio_pin_regs[(reg - GPIO_PIN_ADDR(0)) / 4] = val;
+		break;
+	}
+
+	// let the bus see the new output levels
+	gpio_in();
+}
+
+void gpio_init(void) {
+}
+
+void gpio_output_set(uint32 set_mask, uint32 clear_mask, uint32 enable_mask,
+		uint32 disable_mask) {
+	gpio_out = (gpio_out | set_mask) & ~clear_mask;
+	gpio_enable = (gpio_enable | enable_mask) & ~disable_mask;
+	gpio_in();
+}
+
+uint32 gpio_input_get(void) {
+	return gpio_in();
+}
+
+void gpio_pin_intr_state_set(uint32 i, GPIO_INT_TYPE intr_state) {
+	if (i >= GPIO_PIN_COUNT)
+		return;
+
+	gpio_intr_type[i] = intr_state;
+	if (gpio_level_triggers(i, (gpio_inputs >> i) & 1)) {
+		gpio_status |= BIT(i);
+		gpio_dispatch();
+	}
+}
+
+void gpio_intr_handler_register(gpio_intr_handler_fn_t fn, void *arg) {
+	gpio_handler = fn;
+	gpio_handler_arg = arg;
+}
+
+void gpio_intr_ack(uint32 ack_mask) {
+	gpio_status &= ~ack_mask;
+}
+
+/*
+ * tasks. one event per call, highest priority first, like the sdk scheduler
+ */
+struct task {
+	os_task_t fn;
+	os_event_t *queue;
+	uint8 length;
+	uint8 head;
+	uint8 count;
+
+	// run time statistics in cycles
+	uint32 runs;
+	uint64 total;
+	uint64 min;
+	uint64 max;
+};
+
+static struct task tasks[USER_TASK_PRIO_MAX];
+static uint32 failed_posts;
+
+bool system_os_task(os_task_t task, uint8 prio, os_event_t *queue,
+		uint8 qlen) {
+	if (prio >= USER_TASK_PRIO_MAX || !task || !queue || !qlen)
+		return false;
+
+	tasks[prio].fn = task;
+	tasks[prio].queue = queue;
+	tasks[prio].length = qlen;
+	tasks[prio].head = 0;
+	tasks[prio].count = 0;
+	tasks[prio].min = NEVER;
+	return true;
+}
+
+bool system_os_post(uint8 prio, os_signal_t sig, os_param_t par) {
+	struct task *t;
+	os_event_t *e;
+
+	if (prio >= USER_TASK_PRIO_MAX)
+		return false;
+
+	t = &tasks[prio];
+	if (!t->fn || t->count == t->length) {
+		++failed_posts;
+		return false;
+	}
+
+	e = &t->queue[(t->head + t->count++) % t->length];
+	e->sig = sig;
+	e->par = par;
+	return true;
+}
+
+static bool run_task(void) {
+	int prio;
+
+	for (prio = USER_TASK_PRIO_MAX - 1; prio >= 0; --prio) {
+		struct task *t = &tasks[prio];
+		os_event_t e;
+		uint64 start, cycles;
+
+		if (!t->count)
+			continue;
+
+		e = t->queue[t->head];
+		t->head = (t->head + 1) % t->length;
+		--t->count;
+
+		start = sim_cycles;
+		t->fn(&e);
+		cycles = sim_cycles - start;
+
+		++t->runs;
+		t->total += cycles;
+		if (cycles < t->min)
+			t->min = cycles;
+		if (cycles > t->max)
+			t->max = cycles;
+		return true;
+	}
+
+	return false;
+}
+
+/*
+ * software timers, armed timers are kept in a list
+ */
+static os_timer_t *timers;
+
+void os_timer_disarm(os_timer_t *ptimer) {
+	os_timer_t **t;
+
+	for (t = &timers; *t; t = &(*t)->timer_next) {
+		if (*t == ptimer) {
+			*t = ptimer->timer_next;
+			break;
+		}
+	}
+	ptimer->timer_next = NULL;
+}
+
+void os_timer_setfn(os_timer_t *ptimer, os_timer_func_t *pfunction,
+		void *parg) {
+	os_timer_disarm(ptimer);
+	ptimer->timer_func = pfunction;
+	ptimer->timer_arg = parg;
+}
+
+void os_timer_arm(os_timer_t *ptimer, uint32 milliseconds, bool repeat_flag) {
+	os_timer_disarm(ptimer);
+	ptimer->timer_expire = system_get_time() + milliseconds * 1000;
+	ptimer->timer_period = repeat_flag ? milliseconds * 1000 : 0;
+	ptimer->timer_next = timers;
+	timers = ptimer;
+}
+
+static uint64 next_timer_us(void) {
+	uint64 next = NEVER;
+	uint32 now = system_get_time();
+	os_timer_t *t;
+
+	for (t = timers; t; t = t->timer_next) {
+		uint64 expire = sim_time_us() + (sint32) (t->timer_expire - now);
+		if (expire < next)
+			next = expire;
+	}
+	return next;
+}
+
+static bool run_timer(void) {
+	uint32 now = system_get_time();
+	os_timer_t *t;
+
+	for (t = timers; t; t = t->timer_next) {
+		if ((sint32) (now - t->timer_expire) < 0)
+			continue;
+
+		os_timer_disarm(t);
+		if (t->timer_period) {
+			t->timer_expire += t->timer_period;
+			t->timer_next = timers;
+			timers = t;
+		}
+		t->timer_func(t->timer_arg);
+		return true;
+	}
+	return false;
+}
+
+/*
+ * wifi. the station connects a fixed time after wifi_station_connect
+ */
+static wifi_event_handler_cb_t wifi_handler;
+static init_done_cb_t init_done;
+static uint64 wifi_connect_at = NEVER;
+static bool wifi_connected;
+
+static void wifi_event(uint32 event) {
+	System_Event_t e;
+
+	if (!wifi_handler)
+		return;
+
+	memset(&e, 0, sizeof(e));
+	e.event = event;
+	wifi_handler(&e);
+}
+
+static bool run_wifi(void) {
+	if (sim_time_us() < wifi_connect_at)
+		return false;
+
+	wifi_connect_at = NEVER;
+	wifi_connected = true;
+	wifi_event(EVENT_STAMODE_CONNECTED);
+	wifi_event(EVENT_STAMODE_GOT_IP);
+	return true;
+}
+
+void system_init_done_cb(init_done_cb_t cb) {
+	init_done = cb;
+}
+
+void wifi_set_event_handler_cb(wifi_event_handler_cb_t cb) {
+	wifi_handler = cb;
+}
+
+bool wifi_station_connect(void) {
+	if (!wifi_connected)
+		wifi_connect_at = sim_time_us() + WIFI_CONNECT_US;
+	return true;
+}
+
+bool wifi_station_disconnect(void) {
+	wifi_connect_at = NEVER;
+	if (wifi_connected) {
+		wifi_connected = false;
+		wifi_event(EVENT_STAMODE_DISCONNECTED);
+	}
+	return true;
+}
+
+bool wifi_set_opmode(uint8 opmode) {
+	return true;
+}
+
+bool wifi_station_get_config(struct station_config *config) {
+	memset(config, 0, sizeof(*config));
+	return true;
+}
+
+bool wifi_station_set_config(struct station_config *config) {
+	return true;
+}
+
+bool wifi_station_dhcpc_start(void) {
+	return true;
+}
+
+bool wifi_station_dhcpc_stop(void) {
+	return true;
+}
+
+bool wifi_station_set_auto_connect(uint8 set) {
+	return true;
+}
+
+bool wifi_set_ip_info(uint8 if_index, struct ip_info *info) {
+	return true;
+}
+
+uint32 ipaddr_addr(const char *cp) {
+	return inet_addr(cp);
+}
+
+/*
+ * udp. all datagrams go to options.server_host over a real socket
+ */
+static int udp_socket = -1;
+static struct sockaddr_in server_addr;
+static uint32 datagrams;
+static uint64 datagram_bytes;
+static uint32 failed_sends;
+
+sint8 espconn_create(struct espconn *espconn) {
+	if (!espconn || espconn->type != ESPCONN_UDP || !espconn->proto.udp)
+		return ESPCONN_ARG;
+
+	if (udp_socket < 0) {
+		udp_socket = socket(AF_INET, SOCK_DGRAM, 0);
+		if (udp_socket < 0)
+			return ESPCONN_MEM;
+	}
+	return ESPCONN_OK;
+}
+
+sint8 espconn_delete(struct espconn *espconn) {
+	return ESPCONN_OK;
+}
+
+sint8 espconn_sendto(struct espconn *espconn, uint8 *psent, uint16 length) {
+	struct sockaddr_in to;
+	uint64 end;
+	int port;
+
+	if (!espconn || espconn->type != ESPCONN_UDP || udp_socket < 0)
+		return ESPCONN_ARG;
+	if (!wifi_connected)
+		return ESPCONN_IF;
+
+	// like the sdk, the proto struct is only read now, it has to outlive the call to espconn_create
+	port = options.server_port ? options.server_port : espconn->proto.udp->remote_port;
+	if (port <= 0 || port > 0xffff) {
+		++failed_sends;
+		return ESPCONN_ARG;
+	}
+
+	to = server_addr;
+	to.sin_port = htons(port);
+	if (sendto(udp_socket, psent, length, 0, (struct sockaddr *) &to,
+			sizeof(to)) != length) {
+		if (!failed_sends++)
+			fprintf(stderr, "sim: sendto failed: %s\n", strerror(errno));
+		return ESPCONN_MEM;
+	}
+
+	// the mpu interrupts preempt the sdk while it sends,
+	// deliver them at their time instead of after the send
+	end = sim_cycles + (uint64) options.sendto_us * SIM_CPU_MHZ;
+	while (sim_mpu6050_next_event() * SIM_CPU_MHZ < end) {
+		uint64 at = sim_mpu6050_next_event() * SIM_CPU_MHZ;
+		if (at > sim_cycles)
+			sim_cycles = at;
+		sim_mpu6050_update();
+	}
+	if (end > sim_cycles)
+		sim_cycles = end;
+
+	++datagrams;
+	datagram_bytes += length;
+	return ESPCONN_OK;
+}
+
+/*
+ * event loop
+ */
+static uint64 wall_us(void) {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (uint64) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+void sim_sdk_init(const struct sim_options *opt) {
+	struct addrinfo hints, *addr;
+
+	options = *opt;
+
+	memset(&hints, 0, sizeof(hints));
+	hints.ai_family = AF_INET;
+	hints.ai_socktype = SOCK_DGRAM;
+	if (getaddrinfo(options.server_host, NULL, &hints, &addr)) {
+		fprintf(stderr, "sim: unknown host %s\n", options.server_host);
+		exit(1);
+	}
+	memcpy(&server_addr, addr->ai_addr, sizeof(server_addr));
+	freeaddrinfo(addr);
+}
+
+void sim_sdk_run(uint64 end_us) {
+	uint64 wall_start = wall_us();
+	uint64 virtual_start = sim_time_us();
+
+	if (init_done) {
+		init_done_cb_t cb = init_done;
+		init_done = NULL;
+		cb();
+	}
+
+	while (sim_time_us() < end_us) {
+		uint64 next;
+
+		sim_mpu6050_update();
+		if (run_wifi() || run_task() || run_timer())
+			continue;
+
+		// idle, skip ahead to the next event
+		next = end_us;
+		if (sim_mpu6050_next_event() < next)
+			next = sim_mpu6050_next_event();
+		if (next_timer_us() < next)
+			next = next_timer_us();
+		if (wifi_connect_at < next)
+			next = wifi_connect_at;
+
+		if (options.realtime) {
+			uint64 wall = wall_us() - wall_start;
+			if (next - virtual_start > wall) {
+				uint64 us = next - virtual_start - wall;
+				struct timespec ts = { us / 1000000, (us % 1000000) * 1000 };
+				nanosleep(&ts, NULL);
+			}
+		}
+
+		if (next * SIM_CPU_MHZ > sim_cycles)
+			sim_cycles = next * SIM_CPU_MHZ;
+	}
+}
+
+void sim_sdk_report(void) {
+	int prio;
+
+	fprintf(stderr, "sim: %.3f s virtual time, %u gpio interrupts, %u failed posts\n",
+			sim_time_us() / 1e6, interrupts, failed_posts);
+
+	for (prio = 0; prio < USER_TASK_PRIO_MAX; ++prio) {
+		struct task *t = &tasks[prio];
+		if (!t->runs)
+			continue;
+		fprintf(stderr, "sim: task prio %d: %u runs, %.1f us avg, %.1f us min, %.1f us max\n",
+				prio, t->runs, (double) t->total / t->runs / SIM_CPU_MHZ,
+				(double) t->min / SIM_CPU_MHZ, (double) t->max / SIM_CPU_MHZ);
+	}
+
+	fprintf(stderr, "sim: udp: %u datagrams, %llu bytes to %s, %u failed\n",
+			datagrams, (unsigned long long) datagram_bytes,
+			inet_ntoa(server_addr.sin_addr), failed_sends);
+}
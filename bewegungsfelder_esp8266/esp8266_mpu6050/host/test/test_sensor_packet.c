@@ -0,0 +1,127 @@
+/*
+   Checks the datagram encoding against the golden datagrams
+   Copyright (C) 2016  Ivo Herzig
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include <sensor_packet.h>
+
+#define MAX_GOLDEN_LENGTH 256
+
+struct golden_sample {
+	uint32 timestamp;
+	long quat[4];
+	short accel[3];
+	short gyro[3];
+};
+
+static int failures = 0;
+
+/*
+ * reads the datagram called name from the golden file. returns its length.
+ */
+static int read_golden(const char *path, const char *name, uint8 *bytes) {
+	char line[1024];
+	FILE *file = fopen(path, "r");
+	int length = -1;
+
+	if (!file) {
+		perror(path);
+		exit(1);
+	}
+
+	while (length < 0 && fgets(line, sizeof(line), file)) {
+		char *token = strtok(line, " \t\r\n");
+		if (!token || token[0] == '#' || strcmp(token, name))
+			continue;
+
+		length = 0;
+		while ((token = strtok(NULL, " \t\r\n")) && length < MAX_GOLDEN_LENGTH)
+			bytes[length++] = (uint8) strtoul(token, NULL, 16);
+	}
+
+	fclose(file);
+	if (length < 0) {
+		fprintf(stderr, "%s: no datagram %s\n", path, name);
+		exit(1);
+	}
+	return length;
+}
+
+/*
+ * encodes the samples like user_main.c and compares the datagram.
+ */
+static void check(const char *path, const char *name, uint8 sensor_id,
+		uint16 sequence, const struct golden_sample *samples, int count) {
+	struct sensor_packet packet;
+	uint8 golden[MAX_GOLDEN_LENGTH];
+	int golden_length = read_golden(path, name, golden);
+	int length = SENSOR_PACKET_LENGTH(count);
+	int i;
+
+	sensor_packet_begin(&packet, sensor_id, sequence, samples[0].timestamp);
+	for (i = 0; i < count; ++i) {
+		uint32 previous = i ? samples[i - 1].timestamp : samples[0].timestamp;
+		sensor_packet_set_sample(&packet.samples[i],
+				samples[i].timestamp - previous, samples[i].quat,
+				samples[i].accel, samples[i].gyro);
+	}
+
+	if (length != golden_length) {
+		printf("FAIL %s: %d bytes, golden %d bytes\n", name, length,
+				golden_length);
+		++failures;
+		return;
+	}
+
+	for (i = 0; i < length; ++i) {
+		if (((uint8 *) &packet)[i] != golden[i]) {
+			printf("FAIL %s: byte %d is %02x, golden %02x\n", name, i,
+					((uint8 *) &packet)[i], golden[i]);
+			++failures;
+			return;
+		}
+	}
+
+	printf("ok   %s\n", name);
+}
+
+int main(int argc, char **argv) {
+	const char *path = argc > 1 ? argv[1] : "test/sensor_packet.golden";
+
+	// keep in sync with Bewegungsfelder.Tests/SensorPacketTests.cs
+	static const struct golden_sample single[] = {
+		{ 1000000, { 1 << 30, 0, 0, 0 }, { 0, 0, 8192 }, { 164, -164, 0 } },
+	};
+
+	// the sequence number and the timestamp wrap around
+	static const struct golden_sample batch[] = {
+		{ 0xfffff000, { 759250125, -759250125, 0, 0 }, { -8192, 4096, 1 },
+				{ -32768, 32767, -1 } },
+		{ 0xfffff000 + 40000, { 0, 0, 759250125, -759250125 }, { 1, 2, 3 },
+				{ 4, 5, 6 } },
+		{ 0xfffff000 + 80000, { -(1 << 30), 0, 0, 0 }, { 0, -1, 0 },
+				{ 0, 0, -1640 } },
+	};
+
+	check(path, "single", 8, 42, single, 1);
+	check(path, "batch", 3, 0xfffe, batch, 3);
+
+	return failures ? 1 : 0;
+}
@@ -0,0 +1,40 @@
+/*
+   Access to the cpu cycle counter
+   Copyright (C) 2016  Ivo Herzig
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef CCOUNT_H
+#define CCOUNT_H
+
+#include <c_types.h>
+
+/*
+ * the CCOUNT special register counts cpu cycles (80 or 160 MHz, see
+ * system_get_cpu_freq). it wraps every 53s at 80 MHz, so only use the
+ * unsigned difference of two readings.
+ */
+#ifdef __XTENSA__
+static inline uint32 get_ccount(void) {
+	uint32 ccount;
+	__asm__ __volatile__("rsr %0, ccount" : "=a"(ccount));
+	return ccount;
+}
+#else
+// provided by the host build
+uint32 get_ccount(void);
+#endif
+
+#endif
@@ -3,6 +3,7 @@
     Copyright (C) 2014 Rudy Hardeman (zarya)
     Copyright (C) 2016 Ivo Herzig:
     	Added i2c_readBytes and i2c_writeBytes methods.
+    	Iram resident, cycle counted timing and clock stretching.
 
 
     This program is free software; you can redistribute it and/or modify
@@ -27,7 +28,38 @@
 #include "osapi.h"
 #include "gpio.h"
 
-#define I2C_SLEEP_TIME 5
+// bus speeds, select one at build time, e.g. -DI2C_SPEED=I2C_SPEED_1M
+#define I2C_SPEED_100K 0
+#define I2C_SPEED_400K 1
+#define I2C_SPEED_1M 2 // fast mode plus, beyond the mpu6050 spec. needs strong pull-ups
+
+#ifndef I2C_SPEED
+#define I2C_SPEED I2C_SPEED_400K
+#endif
+
+// minimum scl low and high times in ns. the start/stop setup and hold
+// times and the bus free time are covered by these as well.
+#if I2C_SPEED == I2C_SPEED_100K
+#define I2C_LOW_NS 5000
+#define I2C_HIGH_NS 5000
+#elif I2C_SPEED == I2C_SPEED_400K
+#define I2C_LOW_NS 1300
+#define I2C_HIGH_NS 1200
+#elif I2C_SPEED == I2C_SPEED_1M
+#define I2C_LOW_NS 500
+#define I2C_HIGH_NS 450
+#else
+#error "Unknown I2C_SPEED"
+#endif
+
+// how long a slave may hold scl low (clock stretching) before the transfer fails
+#define I2C_STRETCH_TIMEOUT_US 1000
+
+// the bit level functions are timing critical and run from iram.
+// functions without a section attribute are linked to iram by the sdk.
+#ifndef ICACHE_RAM_ATTR
+#define ICACHE_RAM_ATTR
+#endif
 
 // SDA on GPIO4
 #define I2C_SDA_MUX PERIPHS_IO_MUX_GPIO4_U
@@ -39,8 +71,13 @@
 #define I2C_SCK_FUNC FUNC_GPIO5
 #define I2C_SCK_PIN 5
 
-#define esp_i2c_read() GPIO_INPUT_GET(GPIO_ID_PIN(I2C_SDA_PIN));
+#define I2C_SDA_MASK (1 << I2C_SDA_PIN)
+#define I2C_SCK_MASK (1 << I2C_SCK_PIN)
 
+/**
+ * sets up the pins. call again after changing the cpu frequency,
+ * the bus timing is calculated from it.
+ */
 void i2c_init(void);
 void i2c_start(void);
 void i2c_stop(void);
@@ -113,6 +113,8 @@ int ICACHE_FLASH_ATTR mpu_read_fifo(short *gyro, short *accel, unsigned long *ti
     unsigned char *sensors, unsigned char *more);
 int ICACHE_FLASH_ATTR mpu_read_fifo_stream(unsigned short length, unsigned char *data,
     unsigned char *more);
+int ICACHE_FLASH_ATTR mpu_read_fifo_stream_burst(unsigned short length,
+    unsigned char max_packets, unsigned char *data, unsigned char *more);
 int ICACHE_FLASH_ATTR mpu_reset_fifo(void);
 
 int ICACHE_FLASH_ATTR mpu_write_mem(unsigned short mem_addr, unsigned short length,
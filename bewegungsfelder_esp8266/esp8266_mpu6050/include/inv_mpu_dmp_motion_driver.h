@@ -97,5 +97,19 @@ int ICACHE_FLASH_ATTR dmp_enable_gyro_cal(unsigned char enable);
 int dmp_read_fifo(short *gyro, short *accel, long *quat,
     unsigned long *timestamp, short *sensors, unsigned char *more);
 
+/* One parsed DMP packet, see dmp_read_fifo_burst. */
+struct dmp_packet {
+    long quat[4];
+    short accel[3];
+    short gyro[3];
+    short sensors;
+};
+
+/* Largest single FIFO transfer, the i2c driver takes an 8 bit length. */
+#define DMP_BURST_MAX_BYTES (255)
+
+int dmp_read_fifo_burst(struct dmp_packet *packets, unsigned char max_packets,
+    unsigned char *more, unsigned char *overflow);
+
 #endif  /* #ifndef _INV_MPU_DMP_MOTION_DRIVER_H_ */
 
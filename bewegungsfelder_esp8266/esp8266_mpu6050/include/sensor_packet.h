@@ -0,0 +1,143 @@
+/*
+   Wire format of the datagrams sent to the Bewegungsfelder server.
+   Keep in sync with Bewegungsfelder.Core/Core/SensorPacket.cs
+
+   Copyright (C) 2016  Ivo Herzig
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef SENSOR_PACKET_H
+#define SENSOR_PACKET_H
+
+#include <c_types.h>
+
+/*
+ * Legacy format (unversioned, no longer sent): a single sample as long[12]
+ *   id, quat w/x/y/z, accel x/y/z, gyro x/y/z, timestamp
+ * The server recognises it by its size of exactly 48 bytes.
+ *
+ * Versioned formats start with a header byte: version in the upper
+ * nibble, flags in the lower nibble. All values are little endian.
+ * No versioned datagram is ever 48 bytes long.
+ *
+ * The legacy and version 1 timestamps are in milliseconds.
+ *
+ * Version 1 (no longer sent): batch of full precision samples
+ *   uint8 header, uint8 sensor id, uint8 count, uint8 reserved
+ *   <count> * { sint32 quat[4] (q30), sint16 accel[3], sint16 gyro[3], uint32 timestamp }
+ *
+ * Version 2: compact batch of samples, oldest first.
+ *   8 byte header followed by 1..n samples of 22 bytes each.
+ *   The sample count is given by the datagram length.
+ *   A datagram of n samples takes 8 + 22n bytes: 30 bytes for a single
+ *   sample, below 24 bytes per sample from 5 samples on. The firmware
+ *   only batches the samples that are pending in the fifo, so at low
+ *   sample rates most datagrams carry a single sample.
+ *   Timestamps are delta encoded: each sample carries the difference to
+ *   the previous one, the first sample's delta is 0.
+ *   Timestamps are in microseconds of the sensor clock (system_get_time)
+ *   at the time the dmp wrote the sample to its fifo. They wrap around
+ *   after 71 minutes. Older firmware sent milliseconds (get_ms) without
+ *   PACKET_FLAG_TIMESTAMP_US, the server converts those.
+ *
+ * Version 3: processing latency telemetry, sent every few seconds if
+ *   enabled (see SEND_TELEMETRY in user_main.c).
+ *   8 byte header followed by <stage count> stage records. Each record
+ *   holds the statistics since the previous telemetry datagram:
+ *   { uint32 count, uint32 min, uint32 max, uint32 total (all in us),
+ *     uint16 histogram[<bucket count>] }
+ *   Bucket 0 counts durations below 16us, bucket i durations in
+ *   [2^(i+3), 2^(i+4)) us, the last bucket everything above.
+ */
+#define PACKET_LEGACY_LENGTH (12 * 4)
+
+#define PACKET_HEADER(version, flags) ((uint8)(((version) << 4) | ((flags) & 0x0f)))
+
+#define PACKET_VERSION_BATCH 1
+#define PACKET_VERSION_COMPACT 2
+#define PACKET_VERSION_TELEMETRY 3
+
+// version 2: the timestamps are in microseconds, otherwise milliseconds
+#define PACKET_FLAG_TIMESTAMP_US 0x01
+
+// the maximum number of samples in a single datagram
+#define PACKET_MAX_BATCH_SIZE 8
+
+// the largest timestamp difference a sample can encode, 65ms.
+// samples further apart start a new datagram
+#define PACKET_MAX_TIMESTAMP_DELTA 0xffff
+
+struct __attribute__((packed)) sensor_sample {
+	uint16 dt;             // timestamp delta to the previous sample in us
+	sint16 quat[4];        // w, x, y, z as q14 fixed point
+	sint16 accel[3];       // raw accelerometer readings
+	sint16 gyro[3];        // raw gyro readings
+};
+
+struct __attribute__((packed)) sensor_packet {
+	uint8 header;          // PACKET_HEADER(PACKET_VERSION_COMPACT, PACKET_FLAG_TIMESTAMP_US)
+	uint8 sensor_id;
+	uint16 sequence;       // sequence number of the first sample
+	uint32 timestamp;      // timestamp of the first sample in us
+	struct sensor_sample samples[PACKET_MAX_BATCH_SIZE];
+};
+
+#define SENSOR_PACKET_HEADER_LENGTH 8
+#define SENSOR_PACKET_LENGTH(count) \
+	(SENSOR_PACKET_HEADER_LENGTH + (count) * sizeof(struct sensor_sample))
+
+/*
+ * start a compact datagram, see user/sensor_packet.c.
+ * host/test checks the encoding against golden datagrams.
+ */
+void sensor_packet_begin(struct sensor_packet *packet, uint8 sensor_id,
+		uint16 sequence, uint32 timestamp);
+
+/*
+ * encode a sample. quat is the q30 quaternion of the dmp.
+ */
+void sensor_packet_set_sample(struct sensor_sample *sample, uint16 dt,
+		const long *quat, const short *accel, const short *gyro);
+
+// stages of the path from the mpu interrupt to the sent datagram
+enum telemetry_stage {
+	TELEMETRY_STAGE_POST,  // interrupt until the send task runs
+	TELEMETRY_STAGE_READ,  // reading the dmp fifo
+	TELEMETRY_STAGE_SEND,  // espconn_sendto
+	TELEMETRY_STAGE_TOTAL, // interrupt until espconn_sendto returned
+	TELEMETRY_STAGE_COUNT
+};
+
+#define TELEMETRY_BUCKET_COUNT 12
+
+struct __attribute__((packed)) telemetry_stage_stats {
+	uint32 count;
+	uint32 min;
+	uint32 max;
+	uint32 total;
+	uint16 histogram[TELEMETRY_BUCKET_COUNT];
+};
+
+struct __attribute__((packed)) telemetry_packet {
+	uint8 header;          // PACKET_HEADER(PACKET_VERSION_TELEMETRY, 0)
+	uint8 sensor_id;
+	uint16 failed_posts;   // interrupts lost because the task queue was full
+	uint16 fifo_overflows;
+	uint8 stage_count;
+	uint8 bucket_count;
+	struct telemetry_stage_stats stages[TELEMETRY_STAGE_COUNT];
+};
+
+#endif
@@ -0,0 +1,42 @@
+/*
+   Latency statistics of the interrupt to datagram path
+   Copyright (C) 2016  Ivo Herzig
+
+    This program is free software: you can redistribute it and/or modify
+    it under the terms of the GNU General Public License as published by
+    the Free Software Foundation, either version 3 of the License, or
+    (at your option) any later version.
+
+    This program is distributed in the hope that it will be useful,
+    but WITHOUT ANY WARRANTY; without even the implied warranty of
+    MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+    GNU General Public License for more details.
+
+    You should have received a copy of the GNU General Public License
+    along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <c_types.h>
+#include <sensor_packet.h>
+
+/*
+ * records the duration of a stage. start and end are get_ccount() readings.
+ */
+void telemetry_record(enum telemetry_stage stage, uint32 start, uint32 end);
+
+/*
+ * count events that lose samples. safe to call from interrupt handlers.
+ */
+void telemetry_failed_post(void);
+void telemetry_fifo_overflow(void);
+
+/*
+ * fill the datagram with the statistics recorded since the last call
+ * and start over. returns the length of the datagram.
+ */
+uint16 telemetry_fill_packet(struct telemetry_packet *packet, uint8 sensor_id);
+
+#endif
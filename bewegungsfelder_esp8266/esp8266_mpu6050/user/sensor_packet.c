@@ -0,0 +1,47 @@
+/*
+ Encoding of the datagrams sent to the Bewegungsfelder server
+ Copyright (C) 2016  Ivo Herzig
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <c_types.h>
+
+#include <sensor_packet.h>
+
+void sensor_packet_begin(struct sensor_packet *packet, uint8 sensor_id,
+		uint16 sequence, uint32 timestamp) {
+	packet->header = PACKET_HEADER(PACKET_VERSION_COMPACT,
+			PACKET_FLAG_TIMESTAMP_US);
+	packet->sensor_id = sensor_id;
+	packet->sequence = sequence;
+	packet->timestamp = timestamp;
+}
+
+void sensor_packet_set_sample(struct sensor_sample *sample, uint16 dt,
+		const long *quat, const short *accel, const short *gyro) {
+	sample->dt = dt;
+
+	// the dmp delivers q30 quaternions, q14 is plenty for orientations
+	sample->quat[0] = quat[0] >> 16;
+	sample->quat[1] = quat[1] >> 16;
+	sample->quat[2] = quat[2] >> 16;
+	sample->quat[3] = quat[3] >> 16;
+	sample->accel[0] = accel[0];
+	sample->accel[1] = accel[1];
+	sample->accel[2] = accel[2];
+	sample->gyro[0] = gyro[0];
+	sample->gyro[1] = gyro[1];
+	sample->gyro[2] = gyro[2];
+}
@@ -0,0 +1,108 @@
+/*
+ Latency statistics of the interrupt to datagram path
+ Copyright (C) 2016  Ivo Herzig
+
+ This program is free software: you can redistribute it and/or modify
+ it under the terms of the GNU General Public License as published by
+ the Free Software Foundation, either version 3 of the License, or
+ (at your option) any later version.
+
+ This program is distributed in the hope that it will be useful,
+ but WITHOUT ANY WARRANTY; without even the implied warranty of
+ MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ GNU General Public License for more details.
+
+ You should have received a copy of the GNU General Public License
+ along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ */
+
+#include <ets_sys.h>
+#include <osapi.h>
+#include <user_interface.h>
+
+#include <telemetry.h>
+
+// durations are kept in cycles until they are reported. the totals of one
+// report interval stay far below the range of 26s at 160 MHz
+struct stage_counters {
+	uint32 count;
+	uint32 min;
+	uint32 max;
+	uint32 total;
+	uint16 histogram[TELEMETRY_BUCKET_COUNT];
+};
+
+static struct stage_counters stages[TELEMETRY_STAGE_COUNT];
+static uint16 failed_posts = 0;
+static uint16 fifo_overflows = 0;
+
+/*
+ * bucket 0: below 16us, bucket i: [2^(i+3), 2^(i+4)) us
+ */
+static uint8 ICACHE_FLASH_ATTR bucket_of(uint32 us) {
+	uint8 bucket = 0;
+	us >>= 4;
+	while (us && bucket < TELEMETRY_BUCKET_COUNT - 1) {
+		us >>= 1;
+		++bucket;
+	}
+	return bucket;
+}
+
+void ICACHE_FLASH_ATTR telemetry_record(enum telemetry_stage stage,
+		uint32 start, uint32 end) {
+	struct stage_counters *counters = &stages[stage];
+	uint32 cycles = end - start;
+
+	if (counters->count == 0 || cycles < counters->min)
+		counters->min = cycles;
+	if (cycles > counters->max)
+		counters->max = cycles;
+	counters->total += cycles;
+	++counters->count;
+
+	uint16 *bucket = &counters->histogram[bucket_of(
+			cycles / system_get_cpu_freq())];
+	if (*bucket < 0xffff)
+		++*bucket;
+}
+
+// the counters saturate instead of wrapping around
+void telemetry_failed_post(void) {
+	if (failed_posts < 0xffff)
+		++failed_posts;
+}
+
+void ICACHE_FLASH_ATTR telemetry_fifo_overflow(void) {
+	if (fifo_overflows < 0xffff)
+		++fifo_overflows;
+}
+
+uint16 ICACHE_FLASH_ATTR telemetry_fill_packet(
+		struct telemetry_packet *packet, uint8 sensor_id) {
+	uint32 mhz = system_get_cpu_freq();
+	int i, j;
+
+	packet->header = PACKET_HEADER(PACKET_VERSION_TELEMETRY, 0);
+	packet->sensor_id = sensor_id;
+	packet->failed_posts = failed_posts;
+	packet->fifo_overflows = fifo_overflows;
+	packet->stage_count = TELEMETRY_STAGE_COUNT;
+	packet->bucket_count = TELEMETRY_BUCKET_COUNT;
+
+	for (i = 0; i < TELEMETRY_STAGE_COUNT; ++i) {
+		struct telemetry_stage_stats *out = &packet->stages[i];
+		out->count = stages[i].count;
+		out->min = stages[i].min / mhz;
+		out->max = stages[i].max / mhz;
+		out->total = stages[i].total / mhz;
+		for (j = 0; j < TELEMETRY_BUCKET_COUNT; ++j)
+			out->histogram[j] = stages[i].histogram[j];
+	}
+
+	os_memset(stages, 0, sizeof(stages));
+	failed_posts = 0;
+	fifo_overflows = 0;
+
+	return sizeof(struct telemetry_packet);
+}
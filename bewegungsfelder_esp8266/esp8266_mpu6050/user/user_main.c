@@ -28,6 +28,9 @@
 #include <esp_mpu.h>
 #include <inv_mpu.h>
 #include <inv_mpu_dmp_motion_driver.h>
+#include <sensor_packet.h>
+#include <telemetry.h>
+#include <ccount.h>
 
 // wifi settings
 #define SSID "Bewegungsfelder"
@@ -44,6 +47,19 @@
 #define SENSOR_ID 8
 #define SAMPLE_RATE 25
 
+// 1: drain all pending FIFO packets into a single datagram (see sensor_packet.h)
+// 0: send every sample in its own datagram
+#define SEND_BATCHED 1
+
+#if SEND_BATCHED
+#define BATCH_SIZE PACKET_MAX_BATCH_SIZE
+#else
+#define BATCH_SIZE 1
+#endif
+
+// 1: send the latency statistics of telemetry.h with every heartbeat
+#define SEND_TELEMETRY 1
+
 #define HEARTBEAT_INTERVAL 2500
 
 // MPU interrupt pins
@@ -52,17 +68,46 @@
 #define SENSOR_INT_PIN_NO 14
 
 #define SEND_DATA_QUEUE_LEN 4 // the queue length for send_data tasks
+
+// send_data task signals. the parameter of an interrupt
+// is the cycle count when the interrupt handler was entered
+#define SIGNAL_INTERRUPT 0
+#define SIGNAL_DRAIN 1
 // task queue is used to offload work from the interrupt handler
 static os_event_t* send_data_queue;
 
 // set as soon as we get an ip address
 static bool got_ip = false;
 
+// time (system_get_time, us) and number of the last mpu interrupt.
+// the dmp raises an interrupt for every packet it writes to the fifo
+static volatile uint32 interrupt_time;
+static volatile uint32 interrupt_count = 0;
+
+// time between two fifo packets in us, from the configured fifo rate
+static uint32 sample_period;
+
+// the datagram currently being assembled
+static struct sensor_packet packet;
+static uint8 packet_count = 0;
+
+// timestamp of the last sample, kept across datagrams
+static uint32 packet_last_timestamp;
+static bool has_last_timestamp = false;
+
+// sequence number of the next sample
+static uint16 sequence = 0;
+
 static struct espconn data_connection;
+static esp_udp data_connection_proto;
 
 // heartbeat timer
 os_timer_t heartbeat_timer;
 
+#if SEND_TELEMETRY
+static struct telemetry_packet telemetry;
+#endif
+
 extern int ets_uart_printf(const char *fmt, ...);
 
 static void ICACHE_FLASH_ATTR init();
@@ -74,6 +119,12 @@ static void ICACHE_FLASH_ATTR init_sensor_interrupt();
 static void ICACHE_FLASH_ATTR on_wifi_event(System_Event_t *event);
 static void gpio_intr_handler(uint32 intr_mask, void *arg);
 static void send_data_handler(os_event_t* e);
+static void last_interrupt(uint32 *time, uint32 *count);
+static uint32 newest_sample_time(uint32 before, uint32 count_before,
+		uint32 fifo_packets);
+static void add_sample(long* quat, short* accel, short* gyro,
+		uint32 timestamp);
+static void send_packet();
 
 static void ICACHE_FLASH_ATTR heartbeat_tick();
 
@@ -104,9 +155,11 @@ void init() {
 
 	init_sensor_interrupt();
 
-    //os_timer_disarm(&heartbeat_timer);
-    //os_timer_setfn(&heartbeat_timer, (os_timer_func_t *)heartbeat_tick, (void *)0);
-    //os_timer_arm(&heartbeat_timer, HEARTBEAT_INTERVAL, 1);
+#if SEND_TELEMETRY
+    os_timer_disarm(&heartbeat_timer);
+    os_timer_setfn(&heartbeat_timer, (os_timer_func_t *)heartbeat_tick, (void *)0);
+    os_timer_arm(&heartbeat_timer, HEARTBEAT_INTERVAL, 1);
+#endif
 }
 
 /*
@@ -158,12 +211,10 @@ void init_wifi() {
 void init_data_connection() {
 	ets_uart_printf("Creating data connection \n");
 
-	// use udp to send data
-	//data_connection.proto.udp = &conn_proto;
+	// use udp to send data. the sdk keeps the pointer to the proto
+	// struct, so it must not live on the stack
 	data_connection.type = ESPCONN_UDP;
-
-	esp_udp conn_proto;
-	data_connection.proto.udp = &conn_proto;
+	data_connection.proto.udp = &data_connection_proto;
 
 	// setup address/port
 	char server_ip[15];
@@ -195,6 +246,7 @@ int init_sensor() {
 	ets_uart_printf("initialising sensor \n");
 
 	int status;
+	unsigned short rate;
 	if ((status = mpu_init(0)) != 0) {
 		ets_uart_printf("mpu_init failed. Status: %d\n", status);
 		return 1;
@@ -251,6 +303,8 @@ int init_sensor() {
 	if (dmp_set_fifo_rate(SAMPLE_RATE)) {
 		ets_uart_printf("dmp_set_fifo_rate failed\n");
 	}
+	dmp_get_fifo_rate(&rate);
+	sample_period = 1000000 / rate;
 
 	// start dmp processing
 	if (mpu_set_dmp_state(1)) {
@@ -284,6 +338,17 @@ void init_sensor_interrupt() {
 
 void heartbeat_tick() {
 	ets_uart_printf("vdd: %d\n", readvdd33());
+
+#if SEND_TELEMETRY
+	uint16 length = telemetry_fill_packet(&telemetry, SENSOR_ID);
+	if (got_ip) {
+		sint8 status = espconn_sendto(&data_connection, (uint8*) &telemetry,
+				length);
+		if (status) {
+			ets_uart_printf("sending telemetry failed. status: %d \n", status);
+		}
+	}
+#endif
 }
 
 /*
@@ -322,9 +387,16 @@ void on_wifi_event(System_Event_t *event) {
  * called when the mpu raises an interrupt to show that data is ready
  */
 void gpio_intr_handler(uint32 intr_mask, void *arg) {
+	uint32 now = get_ccount();
+
+	// the dmp has just written a packet to the fifo
+	interrupt_time = system_get_time();
+	++interrupt_count;
+
 	if (got_ip)
 	{
-		if (!system_os_post(USER_TASK_PRIO_2, 0, 0)) {
+		if (!system_os_post(USER_TASK_PRIO_2, SIGNAL_INTERRUPT, now)) {
+			telemetry_failed_post();
 			ets_uart_printf("post failed!\n");
 		}
 	}
@@ -340,35 +412,126 @@ static void send_data_handler(os_event_t* e) {
 	if (!got_ip)
 		return;
 
-	// read data from mpu buffer
-	short gyro[3], accel[3], sensors;
-	unsigned char more;
-	long quat[4];
-	unsigned long timestamp;
-	if (dmp_read_fifo(gyro, accel, quat, &timestamp, &sensors, &more)) {
-		ets_uart_printf("read_fifo_failed \n");
-		return;
+	static struct dmp_packet packets[BATCH_SIZE];
+	unsigned char more = 0, overflow = 0;
+	uint32 newest, interrupts;
+	int read, i;
+	uint32 started = get_ccount(), read_done, sent;
+
+	// drains reposted by this handler have no interrupt to measure from
+	if (e->sig == SIGNAL_INTERRUPT)
+		telemetry_record(TELEMETRY_STAGE_POST, e->par, started);
+
+	// drain all packets currently in the fifo, as many as fit into the
+	// datagram with each i2c transfer. the per-datagram overhead of the
+	// wifi stack is much larger than the size of a sample, so this keeps
+	// the fifo from overflowing at high rates.
+	do {
+		last_interrupt(&newest, &interrupts);
+		read = dmp_read_fifo_burst(packets, BATCH_SIZE - packet_count,
+				&more, &overflow);
+		if (overflow) {
+			// the lost samples leave a gap in the timestamps
+			has_last_timestamp = false;
+			telemetry_fifo_overflow();
+			ets_uart_printf("fifo overflow \n");
+		}
+		if (read < 0)
+			ets_uart_printf("read_fifo_failed \n");
+		if (read <= 0)
+			break;
+
+		// the newest packet in the fifo belongs to the last interrupt,
+		// the older ones were written one fifo period apart
+		newest = newest_sample_time(newest, interrupts, read + more);
+		for (i = 0; i < read; ++i)
+			add_sample(packets[i].quat, packets[i].accel, packets[i].gyro,
+					newest - (read + more - 1 - i) * sample_period);
+	} while (more && packet_count < BATCH_SIZE);
+
+	read_done = get_ccount();
+	telemetry_record(TELEMETRY_STAGE_READ, started, read_done);
+
+	if (packet_count > 0) {
+		send_packet();
+
+		sent = get_ccount();
+		telemetry_record(TELEMETRY_STAGE_SEND, read_done, sent);
+		if (e->sig == SIGNAL_INTERRUPT)
+			telemetry_record(TELEMETRY_STAGE_TOTAL, e->par, sent);
 	}
 
-	// send sensor data to server
-	long data[12];
-	data[0] = SENSOR_ID;
-	data[1] = quat[0];
-	data[2] = quat[1];
-	data[3] = quat[2];
-	data[4] = quat[3];
-	data[5] = accel[0];
-	data[6] = accel[1];
-	data[7] = accel[2];
-	data[8] = gyro[0];
-	data[9] = gyro[1];
-	data[10] = gyro[2];
-	data[11] = timestamp;
-
-	sint8 status = espconn_sendto(&data_connection, (uint8*) data,
-			12 * sizeof(long));
+	// the batch was full. schedule another run to drain the rest
+	if (more)
+		system_os_post(USER_TASK_PRIO_2, SIGNAL_DRAIN, 0);
+}
+
+/*
+ * time and number of the last interrupt, consistent with each other.
+ */
+static void last_interrupt(uint32 *time, uint32 *count) {
+	ETS_GPIO_INTR_DISABLE();
+	*time = interrupt_time;
+	*count = interrupt_count;
+	ETS_GPIO_INTR_ENABLE();
+}
+
+/*
+ * the timestamp of the newest of the fifo_packets packets that were in the
+ * fifo when its count was read. before is the last interrupt before the read.
+ */
+static uint32 newest_sample_time(uint32 before, uint32 count_before,
+		uint32 fifo_packets) {
+	uint32 after, count_after;
+	last_interrupt(&after, &count_after);
+	if (count_after == count_before || !has_last_timestamp)
+		return before;
+
+	// an interrupt fired during the read. its packet was only counted if it
+	// came before the fifo count was read. take the interrupt that continues
+	// the previous sample at the fifo rate.
+	uint32 expected = packet_last_timestamp + fifo_packets * sample_period;
+	sint32 error_before = (sint32) (expected - before);
+	sint32 error_after = (sint32) (expected - after);
+	return labs(error_before) <= labs(error_after) ? before : after;
+}
+
+/*
+ * append a sample to the current datagram.
+ */
+static void add_sample(long* quat, short* accel, short* gyro,
+		uint32 timestamp) {
+	// the delta has to fit into the sample, otherwise start a new datagram.
+	// a timestamp older than the previous one gives a huge unsigned delta
+	if (packet_count > 0
+			&& timestamp - packet_last_timestamp > PACKET_MAX_TIMESTAMP_DELTA)
+		send_packet();
+
+	if (packet_count == 0) {
+		sensor_packet_begin(&packet, SENSOR_ID, sequence, timestamp);
+		packet_last_timestamp = timestamp;
+	}
+
+	sensor_packet_set_sample(&packet.samples[packet_count++],
+			timestamp - packet_last_timestamp, quat, accel, gyro);
+
+	packet_last_timestamp = timestamp;
+	has_last_timestamp = true;
+	++sequence;
+}
+
+/*
+ * send the current datagram to the server, if it contains any samples.
+ */
+static void send_packet() {
+	if (packet_count == 0)
+		return;
+
+	sint8 status = espconn_sendto(&data_connection, (uint8*) &packet,
+			SENSOR_PACKET_LENGTH(packet_count));
 	if (status) {
 		ets_uart_printf("espconn_sendto failed. status: %d \n", status);
 	}
-}
 
+	packet_count = 0;
+}